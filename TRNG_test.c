@@ -31,6 +31,8 @@
  *                    Add comments to improve the readbility;
  *                    TRNGMode in header changes from[31:31] to [31:30];
  *                    Change dataBuff_ptr to a callback function
+ * 1.10 (19-Oct-2026): Add CC_TST_TRNG_PingPong: output batched into two
+ *                    caller buffers, handed over when full
  */
 
 /* RNG module registers and value defination */
@@ -95,6 +97,7 @@
 #define CC_TRNG_INVALID_PARAM_SAMPLE_CNT       (-3)
 #define CC_TRNG_INVALID_PARAM_BUF_SIZE         (-4)
 #define CC_TRNG_INVALID_PARAM_NULL_PTR         (-5)
+#define CC_TRNG_INVALID_PARAM_PING_PONG_SIZE   (-6)
 #define CC_TRNG_SAMPLE_LOST                    0x1
 
 /* other size and length defination */
@@ -124,14 +127,214 @@ typedef unsigned int uint32_t;
 */
 typedef void (*callback_TRNG)(uint32_t outputSize, uint8_t *outputBuffer);
 
+/*
+ * ping-pong buffers of CC_TST_TRNG_PingPong(), owned by the caller
+ * @buffer              two word aligned buffers
+ * @bufferSize          size of each buffer in bytes; a multiple of 4, at least 24
+ * @busy                set by CC_TST_TRNG_PingPong() when it hands a buffer over,
+ *                      cleared by the consumer when the buffer may be filled again
+ *                      (e.g. from the DMA completion interrupt or another thread)
+ * @handover            called with each full buffer, and with the last one
+ *                      when the collection ends. It runs inside the collection
+ *                      loop: it should only start the transfer and return.
+ * @stalls              handovers that had to wait for the consumer; samples may
+ *                      have been lost at each of them (CC_TRNG_SAMPLE_LOST)
+ */
+typedef struct
+{
+    uint32_t *buffer[2];
+    uint32_t bufferSize;
+    volatile uint32_t busy[2];
+    callback_TRNG handover;
+    uint32_t stalls;
+} CC_TST_TRNG_PingPong_t;
+
 /* report any compile errors in the next two lines to Arm */
 typedef int __testCharSize[((uint8_t)~0)==255?1:-1];
 typedef int __testUint32Size[(sizeof(uint32_t)==4)?1:-1];
 
+/* register access; may be predefined to run against a register model */
+#ifndef CC_GEN_WriteRegister
 #define CC_GEN_WriteRegister(base_addr, reg_addr, val) \
     do { ((volatile uint32_t*)(base_addr))[(reg_addr) / sizeof(uint32_t)] = (uint32_t)(val); } while(0)
+#endif
 
+#ifndef CC_GEN_ReadRegister
 #define CC_GEN_ReadRegister(base_addr, reg_addr)  ((volatile uint32_t*)(base_addr))[(reg_addr) / sizeof(uint32_t)]
+#endif
+
+/* busy flag of a ping-pong buffer; may be predefined to run the consumer of a register model */
+#ifndef CC_GEN_BufferBusy
+#define CC_GEN_BufferBusy(pingPong_ptr, idx)      ((pingPong_ptr)->busy[(idx)])
+#endif
+
+/* validate the inputs common to CC_TST_TRNG and CC_TST_TRNG_PingPong */
+static int TST_TRNG_CheckParams(uint32_t TRNGMode,
+                                uint32_t roscLength,
+                                uint32_t sampleCount,
+                                uint32_t buffSize)
+{
+    if (TRNGMode > TRNG_MODE_80090B)
+    {
+        return CC_TRNG_INVALID_PARAM_TRNG_MODE;
+    }
+
+    if (roscLength > TRNG_ROSC_MAX_LENGTH)
+    {
+        return CC_TRNG_INVALID_PARAM_ROSC_LEN;
+    }
+
+    if (sampleCount < MINIUM_SAMPLE_CNT)
+    {
+        return CC_TRNG_INVALID_PARAM_SAMPLE_CNT;
+    }
+
+    if ((buffSize < MIN_BUFFER_LENGTH) || (buffSize>= MAX_BUFFER_LENGTH))
+    {
+        return CC_TRNG_INVALID_PARAM_BUF_SIZE;
+    }
+
+    return 0;
+}
+
+/* reset the RNG block and start the RND source in TRNGMode */
+static void TST_TRNG_Start(unsigned long regBaseAddress,
+                           uint32_t TRNGMode,
+                           uint32_t roscLength,
+                           uint32_t sampleCount)
+{
+    uint32_t tmpSampleCnt = 0;
+
+    /* reset the RNG block */
+    CC_GEN_WriteRegister(regBaseAddress, HW_RNG_SW_RESET_REG_ADDR, HW_RNG_SW_RESET_REG_SET);
+
+    /* enable RNG clock and set sample counter value untile it is set correctly*/
+    do
+    {
+        /* enable the HW RNG clock */
+        CC_GEN_WriteRegister(regBaseAddress, HW_RNG_CLK_ENABLE_REG_ADDR, HW_RNG_CLK_ENABLE_REG_SET);
+        /* set sample counter value*/
+        CC_GEN_WriteRegister(regBaseAddress, HW_SAMPLE_CNT1_REG_ADDR, sampleCount);
+        /*read back sample counter value*/
+        tmpSampleCnt = CC_GEN_ReadRegister(regBaseAddress, HW_SAMPLE_CNT1_REG_ADDR);
+    }while (tmpSampleCnt != sampleCount); /* wait until the sample counter is set correctly*/
+
+    /* set RNG rosc Length */
+    CC_GEN_WriteRegister(regBaseAddress, HW_TRNG_CONFIG_REG_ADDR, roscLength);
+
+    /* configure TRNG debug control register based on different mode. */
+    if (TRNGMode == TRNG_MODE_FAST)
+    {
+        /* fast TRNG: bypass VNC, CRNGT and auto correlate, activate none. */
+        CC_GEN_WriteRegister(regBaseAddress, HW_TRNG_DEBUG_CONTROL_REG_ADDR , HW_TRNG_DEBUG_CONTROL_REG_FAST);
+    }
+    else if (TRNGMode == TRNG_MODE_FE)
+    {
+        /* FE TRNG: bypass none, activate all */
+        CC_GEN_WriteRegister(regBaseAddress, HW_TRNG_DEBUG_CONTROL_REG_ADDR , HW_TRNG_DEBUG_CONTROL_REG_FE);
+    }
+    else if (TRNGMode == TRNG_MODE_80090B)
+    {
+        /* 800-90B TRNG: bypass VNC and auto correlate, activate CRNGT */
+        CC_GEN_WriteRegister(regBaseAddress, HW_TRNG_DEBUG_CONTROL_REG_ADDR , HW_TRNG_DEBUG_CONTROL_REG_80090B);
+    }
+
+    /* enable the RND source */
+    CC_GEN_WriteRegister(regBaseAddress, HW_RND_SOURCE_ENABLE_REG_ADDR, HW_RND_SOURCE_ENABLE_REG_SET);
+}
+
+/* write the output format header into header_ptr */
+static void TST_TRNG_Header(uint32_t *header_ptr,
+                            uint32_t TRNGMode,
+                            uint32_t roscLength,
+                            uint32_t sampleCount,
+                            uint32_t buffSize)
+{
+    *(header_ptr++) = OUTPUT_FORMAT_HEADER_SIG_VAL;
+    *(header_ptr++) = (TRNGMode << OUTPUT_FORMAT_ROSC_LEN_SHIFT) |
+                      (roscLength << OUTPUT_FORMAT_TRNG_MODE_SHIFT) |
+                      buffSize;
+    *(header_ptr++) = sampleCount;
+    *(header_ptr++) = OUTPUT_FORMAT_HEADER_SIG_VAL;
+}
+
+/*
+ * wait for the next EHR and read it into ehr_ptr
+ *
+ * @blockIndex:         index of the EHR in the collection
+ * @Error_ptr:          error flags of the collection, updated
+ * @return              0 when the EHR was read, 1 on an autocorrelation error
+ *                      (the collection must stop)
+ */
+static int TST_TRNG_ReadEhr(unsigned long regBaseAddress,
+                            uint32_t blockIndex,
+                            uint32_t *Error_ptr,
+                            uint32_t *ehr_ptr)
+{
+    uint32_t valid_at_start, valid;
+    uint32_t j;
+
+    /*
+     * TRNG data collecting must be continuous.
+     * verification methodology:
+     * 1) initial state detection is vaild_at_start == HW_TRNG_VALID_REG_EHR_NOT_READY
+     * 2) proceed only after HW_RNG_ISR_REG_EHR_VALID bit changed from 0 to 1
+     *    (that means EHR data is ready for reading)
+     */
+    valid_at_start = CC_GEN_ReadRegister(regBaseAddress, HW_TRNG_VALID_REG_ADDR);
+    valid = valid_at_start;
+    /*
+     * wait for EHR valid. ISR_REG indicates whether EHR valid or any error detected.
+     * bit[0]-EHR_VALID, bit[1]-AUTOCORR_ERR, bit[2]-CRNGT_ERR, bit[3]-VN_ERR
+     */
+    while ((valid & (HW_RNG_ISR_REG_EHR_VALID|HW_RNG_ISR_REG_AUTOCORR_ERR)) == 0x0)
+    {
+        valid = CC_GEN_ReadRegister(regBaseAddress, HW_RNG_ISR_REG_ADDR);
+    }
+
+    /*
+     * after EHR data is ready, first check any error detected
+     * different bit in variable Error indicates different error
+     * Error bit[0] samples were lost during collection.
+     * Error bit[1] autocorrelation error. corresponding to ISR_REG[1].
+     *              this error will cause TRNG cease to function until next reset
+     * Error bit[2] CRNGT error. corresponding to ISR_REG[2].
+     *              This error occurs when 2 consecutive blocks of 16 collected bits are equal.
+     * Error bit[3] Von Neumann error. corresponding to ISR_REG[3].
+     *              this error occurs if 32 consecutive collected bits are identical.
+     */
+    /* if it is not the first interation, valid_at_start must be not ready. otherwise it means samples were lost */
+    if ((valid_at_start != HW_TRNG_VALID_REG_EHR_NOT_READY) && (blockIndex != DATA_COLLECTION_START_INDEX))
+    {
+        *Error_ptr = CC_TRNG_SAMPLE_LOST;
+    }
+
+    /*pass bit[31:1] to Error. mask out bit[0] which is used for CC_TRNG_SAMPLE_LOST*/
+    if ((valid & ~CC_TRNG_SAMPLE_LOST) != 0)
+    {
+        *Error_ptr |= (valid & ~CC_TRNG_SAMPLE_LOST);
+    }
+
+    if (*Error_ptr & HW_RNG_ISR_REG_AUTOCORR_ERR)
+    {
+        return 1; /* autocorrelation error is irrecoverable */
+    }
+
+    /* clean up interrupt status */
+    CC_GEN_WriteRegister(regBaseAddress, HW_RNG_ICR_REG_ADDR, ~0UL);
+
+    /*
+     * load the current random data from EHR registers to the output buffer.
+     * NOTE: TRNG hardware will auto start to re-fill bits to EHR_DATA_REG0-5
+     *       after the host read out all 6 registers
+     */
+    for (j=0; j<EHR_SIZE_IN_WORDS; j++)
+    {
+        *(ehr_ptr++) = CC_GEN_ReadRegister(regBaseAddress, HW_EHR_DATA_ADDR_0_REG_ADDR+(j*sizeof(uint32_t)));
+    }
+
+    return 0;
+}
 
 /*
  * collect TRNG output for characterization
@@ -168,176 +371,212 @@ int CC_TST_TRNG(    unsigned long regBaseAddress,
 
     /* loop variable */
     uint32_t i = 0;
-	uint32_t j = 0;
 
     /* the number of full blocks needed */
     uint32_t NumOfBlocks = 0;
 
     /* hardware parameters */
     uint32_t EhrSizeInWords = EHR_SIZE_IN_WORDS;
-    uint32_t tmpSampleCnt = 0;
     uint32_t dataArray[TRNG_BUFFER_SIZE_IN_WORDS] = {0};
     uint32_t *dataBuff_ptr = dataArray;
 
     /* FUNCTION LOGIC */
     /* ............... validate inputs .................................... */
     /* -------------------------------------------------------------------- */
-    if (TRNGMode > TRNG_MODE_80090B)
+    Error = TST_TRNG_CheckParams(TRNGMode, roscLength, sampleCount, buffSize);
+    if (Error != 0)
     {
-        return CC_TRNG_INVALID_PARAM_TRNG_MODE;
+        return Error;
     }
 
-    if (roscLength > TRNG_ROSC_MAX_LENGTH)
+    if (NULL == callbackFunc)
     {
-        return CC_TRNG_INVALID_PARAM_ROSC_LEN;
+        return CC_TRNG_INVALID_PARAM_NULL_PTR;
     }
 
-    if (sampleCount < MINIUM_SAMPLE_CNT)
-    {
-        return CC_TRNG_INVALID_PARAM_SAMPLE_CNT;
-    }
+    /* ........... initializing the hardware .............................. */
+    /* -------------------------------------------------------------------- */
+    TST_TRNG_Start(regBaseAddress, TRNGMode, roscLength, sampleCount);
 
-    if ((buffSize < MIN_BUFFER_LENGTH) || (buffSize>= MAX_BUFFER_LENGTH))
-    {
-        return CC_TRNG_INVALID_PARAM_BUF_SIZE;
-    }
+    /* ........... executing the RND operation ............................ */
+    /* -------------------------------------------------------------------- */
+    /* write header into buffer */
+    TST_TRNG_Header(dataArray, TRNGMode, roscLength, sampleCount, buffSize);
+    callbackFunc(OUTPUT_FORMAT_HEADER_LENGTH_IN_BYTES, (uint8_t *)dataArray);
 
-    if (NULL == callbackFunc)
+    /* calculate the number of full blocks needed */
+    NumOfBlocks = (buffSize/sizeof(uint32_t) - OUTPUT_FORMAT_OVERHEAD_LENGTH_IN_WORDS) / EhrSizeInWords;
+
+    /* fill the Output buffer with up to full blocks */
+    /* BEGIN TIMING: start time measurement at this point */
+    for (i = 0; i < NumOfBlocks; i++)
     {
-        return CC_TRNG_INVALID_PARAM_NULL_PTR;
+        if (TST_TRNG_ReadEhr(regBaseAddress, i, &Error, dataArray))
+        {
+            break; /* autocorrelation error is irrecoverable */
+        }
+        callbackFunc(EHR_SIZE_IN_BYTES, (uint8_t *)dataArray);
     }
+    /* END TIMING: end time measurement at this point */
 
-    /* ........... initializing the hardware .............................. */
+    /* write footer into buffer */
+    *(dataBuff_ptr++) = OUTPUT_FORMAT_FOOTER_SIG_VAL;
+    /* only record sample lost error in output buffer */
+    *(dataBuff_ptr++) = Error & CC_TRNG_SAMPLE_LOST;
+    *(dataBuff_ptr++) = OUTPUT_FORMAT_FOOTER_SIG_VAL;
+    callbackFunc(OUTPUT_FORMAT_FOOTER_LENGTH_IN_BYTES, (uint8_t *)dataArray);
+
+    /* disable the RND source */
+    CC_GEN_WriteRegister(regBaseAddress, HW_RND_SOURCE_ENABLE_REG_ADDR, HW_RND_SOURCE_ENABLE_REG_CLR);
+
+    /* .............. end of function ..................................... */
     /* -------------------------------------------------------------------- */
-    /* reset the RNG block */
-    CC_GEN_WriteRegister(regBaseAddress, HW_RNG_SW_RESET_REG_ADDR, HW_RNG_SW_RESET_REG_SET);
+    return Error;
+}
 
-    /* enable RNG clock and set sample counter value untile it is set correctly*/
-    do
+/* hand the current ping-pong buffer over to the consumer and switch to the other one */
+static void TST_TRNG_Handover(CC_TST_TRNG_PingPong_t *pingPong_ptr,
+                              uint32_t *bufIdx_ptr,
+                              uint32_t *wordIdx_ptr)
+{
+    pingPong_ptr->busy[*bufIdx_ptr] = 1;
+    pingPong_ptr->handover(*wordIdx_ptr * sizeof(uint32_t), (uint8_t *)pingPong_ptr->buffer[*bufIdx_ptr]);
+    *bufIdx_ptr ^= 1;
+    *wordIdx_ptr = 0;
+}
+
+/* append one word to the output stream, handing the buffer over when it is full */
+static void TST_TRNG_PutWord(CC_TST_TRNG_PingPong_t *pingPong_ptr,
+                             uint32_t *bufIdx_ptr,
+                             uint32_t *wordIdx_ptr,
+                             uint32_t word)
+{
+    pingPong_ptr->buffer[*bufIdx_ptr][(*wordIdx_ptr)++] = word;
+    if (*wordIdx_ptr == pingPong_ptr->bufferSize / sizeof(uint32_t))
     {
-        /* enable the HW RNG clock */
-        CC_GEN_WriteRegister(regBaseAddress, HW_RNG_CLK_ENABLE_REG_ADDR, HW_RNG_CLK_ENABLE_REG_SET);
-        /* set sample counter value*/
-        CC_GEN_WriteRegister(regBaseAddress, HW_SAMPLE_CNT1_REG_ADDR, sampleCount);
-        /*read back sample counter value*/
-        tmpSampleCnt = CC_GEN_ReadRegister(regBaseAddress, HW_SAMPLE_CNT1_REG_ADDR);
-    }while (tmpSampleCnt != sampleCount); /* wait until the sample counter is set correctly*/
+        TST_TRNG_Handover(pingPong_ptr, bufIdx_ptr, wordIdx_ptr);
+        /* the next word goes to the other buffer: wait until the consumer is done with it */
+        if (CC_GEN_BufferBusy(pingPong_ptr, *bufIdx_ptr))
+        {
+            pingPong_ptr->stalls++;
+            while (CC_GEN_BufferBusy(pingPong_ptr, *bufIdx_ptr))
+            {
+            }
+        }
+    }
+}
 
-    /* set RNG rosc Length */
-    CC_GEN_WriteRegister(regBaseAddress, HW_TRNG_CONFIG_REG_ADDR, roscLength);
+/*
+ * collect TRNG output for characterization into two caller buffers
+ *
+ * Same parameters, output format and return value as CC_TST_TRNG, but the
+ * collection loop only copies each EHR into the current buffer. A buffer is
+ * handed over (pingPong_ptr->handover) when it is full, and the loop goes on
+ * filling the other one while the consumer drains it, so the time between two
+ * EHR reads does not depend on the consumer. This keeps captures at the
+ * lowest sample counts free of CC_TRNG_SAMPLE_LOST.
+ *
+ * @pingPong_ptr:       buffers, busy flags and handover callback; the caller
+ *                      clears busy[] as the consumer completes. The last buffer
+ *                      (with the footer) is handed over before returning: wait
+ *                      for both busy flags to clear before reusing the buffers.
+ * @return              0 on succeeds. non-zero value on failure.
+ */
+int CC_TST_TRNG_PingPong(   unsigned long regBaseAddress,
+                            uint32_t TRNGMode,
+                            uint32_t roscLength,
+                            uint32_t sampleCount,
+                            uint32_t buffSize,
+                            CC_TST_TRNG_PingPong_t *pingPong_ptr)
+{
+    /*return value*/
+    uint32_t Error = 0;
 
-    /* configure TRNG debug control register based on different mode. */
-    if (TRNGMode == TRNG_MODE_FAST)
+    /* loop variables */
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    /* the number of full blocks needed */
+    uint32_t NumOfBlocks = 0;
+
+    /* current buffer and word position in it */
+    uint32_t bufIdx = 0;
+    uint32_t wordIdx = 0;
+
+    uint32_t dataArray[TRNG_BUFFER_SIZE_IN_WORDS] = {0};
+
+    /* FUNCTION LOGIC */
+    /* ............... validate inputs .................................... */
+    /* -------------------------------------------------------------------- */
+    Error = TST_TRNG_CheckParams(TRNGMode, roscLength, sampleCount, buffSize);
+    if (Error != 0)
     {
-        /* fast TRNG: bypass VNC, CRNGT and auto correlate, activate none. */
-        CC_GEN_WriteRegister(regBaseAddress, HW_TRNG_DEBUG_CONTROL_REG_ADDR , HW_TRNG_DEBUG_CONTROL_REG_FAST);
+        return Error;
     }
-    else if (TRNGMode == TRNG_MODE_FE)
+
+    if ((NULL == pingPong_ptr) || (NULL == pingPong_ptr->buffer[0]) ||
+        (NULL == pingPong_ptr->buffer[1]) || (NULL == pingPong_ptr->handover))
     {
-        /* FE TRNG: bypass none, activate all */
-        CC_GEN_WriteRegister(regBaseAddress, HW_TRNG_DEBUG_CONTROL_REG_ADDR , HW_TRNG_DEBUG_CONTROL_REG_FE);
+        return CC_TRNG_INVALID_PARAM_NULL_PTR;
     }
-    else if (TRNGMode == TRNG_MODE_80090B)
+
+    if ((pingPong_ptr->bufferSize < EHR_SIZE_IN_BYTES) || (pingPong_ptr->bufferSize % sizeof(uint32_t) != 0))
     {
-        /* 800-90B TRNG: bypass VNC and auto correlate, activate CRNGT */
-        CC_GEN_WriteRegister(regBaseAddress, HW_TRNG_DEBUG_CONTROL_REG_ADDR , HW_TRNG_DEBUG_CONTROL_REG_80090B);
+        return CC_TRNG_INVALID_PARAM_PING_PONG_SIZE;
     }
 
-    /* enable the RND source */
-    CC_GEN_WriteRegister(regBaseAddress, HW_RND_SOURCE_ENABLE_REG_ADDR, HW_RND_SOURCE_ENABLE_REG_SET);
+    pingPong_ptr->stalls = 0;
+
+    /* wait for a transfer of a previous collection to finish */
+    while (CC_GEN_BufferBusy(pingPong_ptr, bufIdx))
+    {
+    }
+
+    /* ........... initializing the hardware .............................. */
+    /* -------------------------------------------------------------------- */
+    TST_TRNG_Start(regBaseAddress, TRNGMode, roscLength, sampleCount);
 
     /* ........... executing the RND operation ............................ */
     /* -------------------------------------------------------------------- */
     /* write header into buffer */
-    *(dataBuff_ptr++) = OUTPUT_FORMAT_HEADER_SIG_VAL;
-    *(dataBuff_ptr++) = (TRNGMode << OUTPUT_FORMAT_ROSC_LEN_SHIFT) |
-                        (roscLength << OUTPUT_FORMAT_TRNG_MODE_SHIFT) |
-                        buffSize;
-    *(dataBuff_ptr++) = sampleCount;
-    *(dataBuff_ptr++) = OUTPUT_FORMAT_HEADER_SIG_VAL;
-    callbackFunc(OUTPUT_FORMAT_HEADER_LENGTH_IN_BYTES, (uint8_t *)dataArray);
-    dataBuff_ptr = dataArray;
+    TST_TRNG_Header(dataArray, TRNGMode, roscLength, sampleCount, buffSize);
+    for (j = 0; j < OUTPUT_FORMAT_HEADER_LENGTH_IN_WORDS; j++)
+    {
+        TST_TRNG_PutWord(pingPong_ptr, &bufIdx, &wordIdx, dataArray[j]);
+    }
 
     /* calculate the number of full blocks needed */
-    NumOfBlocks = (buffSize/sizeof(uint32_t) - OUTPUT_FORMAT_OVERHEAD_LENGTH_IN_WORDS) / EhrSizeInWords;
+    NumOfBlocks = (buffSize/sizeof(uint32_t) - OUTPUT_FORMAT_OVERHEAD_LENGTH_IN_WORDS) / EHR_SIZE_IN_WORDS;
 
-    /* fill the Output buffer with up to full blocks */
+    /* fill the buffers with up to full blocks */
     /* BEGIN TIMING: start time measurement at this point */
     for (i = 0; i < NumOfBlocks; i++)
     {
-        uint32_t valid_at_start, valid;
-        /*
-         * TRNG data collecting must be continuous.
-         * verification methodology:
-         * 1) initial state detection is vaild_at_start == HW_TRNG_VALID_REG_EHR_NOT_READY
-         * 2) proceed only after HW_RNG_ISR_REG_EHR_VALID bit changed from 0 to 1
-         *    (that means EHR data is ready for reading)
-         */
-        valid_at_start = CC_GEN_ReadRegister(regBaseAddress, HW_TRNG_VALID_REG_ADDR);
-        valid = valid_at_start;
-        /*
-         * wait for EHR valid. ISR_REG indicates whether EHR valid or any error detected.
-         * bit[0]-EHR_VALID, bit[1]-AUTOCORR_ERR, bit[2]-CRNGT_ERR, bit[3]-VN_ERR
-         */
-        while ((valid & (HW_RNG_ISR_REG_EHR_VALID|HW_RNG_ISR_REG_AUTOCORR_ERR)) == 0x0)
-        {
-            valid = CC_GEN_ReadRegister(regBaseAddress, HW_RNG_ISR_REG_ADDR);
-        }
-
-        /*
-         * after EHR data is ready, first check any error detected
-         * different bit in variable Error indicates different error
-         * Error bit[0] samples were lost during collection.
-         * Error bit[1] autocorrelation error. corresponding to ISR_REG[1].
-         *              this error will cause TRNG cease to function until next reset
-         * Error bit[2] CRNGT error. corresponding to ISR_REG[2].
-         *              This error occurs when 2 consecutive blocks of 16 collected bits are equal.
-         * Error bit[3] Von Neumann error. corresponding to ISR_REG[3].
-         *              this error occurs if 32 consecutive collected bits are identical.
-         */
-        /* if it is not the first interation, valid_at_start must be not ready. otherwise it means samples were lost */
-        if ((valid_at_start != HW_TRNG_VALID_REG_EHR_NOT_READY) && (i != DATA_COLLECTION_START_INDEX))
-        {
-            Error = CC_TRNG_SAMPLE_LOST;
-        }
-
-        /*pass bit[31:1] to Error. mask out bit[0] which is used for CC_TRNG_SAMPLE_LOST*/
-        if ((valid & ~CC_TRNG_SAMPLE_LOST) != 0)
-        {
-            Error |= (valid & ~CC_TRNG_SAMPLE_LOST);
-        }
-
-        if (Error & HW_RNG_ISR_REG_AUTOCORR_ERR)
+        if (TST_TRNG_ReadEhr(regBaseAddress, i, &Error, dataArray))
         {
             break; /* autocorrelation error is irrecoverable */
         }
-
-        /* clean up interrupt status */
-        CC_GEN_WriteRegister(regBaseAddress, HW_RNG_ICR_REG_ADDR, ~0UL);
-
-        /*
-         * load the current random data from EHR registers to the output buffer.
-         * NOTE: TRNG hardware will auto start to re-fill bits to EHR_DATA_REG0-5
-         *       after the host read out all 6 registers
-         */
-        for (j=0; j<EhrSizeInWords; j++)
+        for (j = 0; j < EHR_SIZE_IN_WORDS; j++)
         {
-            *(dataBuff_ptr++) = CC_GEN_ReadRegister(regBaseAddress, HW_EHR_DATA_ADDR_0_REG_ADDR+(j*sizeof(uint32_t)));
+            TST_TRNG_PutWord(pingPong_ptr, &bufIdx, &wordIdx, dataArray[j]);
         }
-        callbackFunc(EHR_SIZE_IN_BYTES, (uint8_t *)dataArray);
-        dataBuff_ptr = dataArray;
     }
     /* END TIMING: end time measurement at this point */
 
+    /* disable the RND source */
+    CC_GEN_WriteRegister(regBaseAddress, HW_RND_SOURCE_ENABLE_REG_ADDR, HW_RND_SOURCE_ENABLE_REG_CLR);
+
     /* write footer into buffer */
-    *(dataBuff_ptr++) = OUTPUT_FORMAT_FOOTER_SIG_VAL;
+    TST_TRNG_PutWord(pingPong_ptr, &bufIdx, &wordIdx, OUTPUT_FORMAT_FOOTER_SIG_VAL);
     /* only record sample lost error in output buffer */
-    *(dataBuff_ptr++) = Error & CC_TRNG_SAMPLE_LOST;
-    *(dataBuff_ptr++) = OUTPUT_FORMAT_FOOTER_SIG_VAL;
-    callbackFunc(OUTPUT_FORMAT_FOOTER_LENGTH_IN_BYTES, (uint8_t *)dataArray);
+    TST_TRNG_PutWord(pingPong_ptr, &bufIdx, &wordIdx, Error & CC_TRNG_SAMPLE_LOST);
+    TST_TRNG_PutWord(pingPong_ptr, &bufIdx, &wordIdx, OUTPUT_FORMAT_FOOTER_SIG_VAL);
 
-    /* disable the RND source */
-    CC_GEN_WriteRegister(regBaseAddress, HW_RND_SOURCE_ENABLE_REG_ADDR, HW_RND_SOURCE_ENABLE_REG_CLR);
+    /* hand the last, partly filled buffer over */
+    if (wordIdx != 0)
+    {
+        TST_TRNG_Handover(pingPong_ptr, &bufIdx, &wordIdx);
+    }
 
     /* .............. end of function ..................................... */
     /* -------------------------------------------------------------------- */
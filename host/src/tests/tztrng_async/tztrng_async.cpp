@@ -0,0 +1,384 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+
+#include "tztrng.hpp"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+#include "dx_rng.h"
+
+/*
+ * Coroutine reads of tztrng::AsyncSession (library built with
+ * CC_CONFIG_TRNG_ASYNC = 1 and CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * N coroutines each co_await K reads of 8 to 256 bytes, all pending at once on
+ * the one thread of the program. The executor loop drives the session either
+ * from the RNG interrupt line (model only: the model clock runs in small steps
+ * while the loop waits, and poll() is called when the line is raised) or from
+ * a timer that calls poll() every period. For comparison the same reads run
+ * through the blocking CC_TrngGetSource(). One CSV row per run:
+ * driver,period_us,coroutines,reads,bytes,collections,polls,isr_reads,max_pending,wall_ms
+ * polls counts the poll() calls, isr_reads the ISR reads of the driver (MMIO
+ * hook): the blocking driver spins on the ISR, the event driven one reads it
+ * once per interrupt. Every read must complete without a duplicate, and on the
+ * model a failing TRNG must fail the read with tztrng::Error and a wiped buffer,
+ * and CC_TrngGetSource() must be refused while a collection owns the TRNG.
+ */
+
+#define ASYNC_DEFAULT_COROUTINES	1000
+#define ASYNC_DEFAULT_READS		2
+#define ASYNC_DEFAULT_PERIOD_US		50
+#define ASYNC_MIN_READ			8
+#define ASYNC_MAX_READ			256
+/* model time: a 100 MHz rng clock */
+#define ASYNC_MODEL_CLOCKS_PER_US	100
+/* model clock step of the interrupt driven loop, the interrupt latency */
+#define ASYNC_MODEL_IRQ_STEP_CLOCKS	100
+/* the interrupt driven loop also polls after this long without an interrupt */
+#define ASYNC_IRQ_TIMEOUT_US		10000
+/* polls of the ownership check, one timer period of model time each */
+#define ASYNC_OWNER_MAX_POLLS		100000
+
+typedef enum {
+	ASYNC_DRIVER_IRQ = 0,
+	ASYNC_DRIVER_TIMER,
+	ASYNC_DRIVER_BLOCKING,
+} AsyncDriver_t;
+
+static const char *const gDriverNames[] = { "irq", "timer", "blocking" };
+
+static int gUseModel;
+static uint64_t gCollections;
+static uint64_t gIsrReads;
+
+static void asyncRequest(void *ctx, size_t reqBits)
+{
+	(void)ctx;
+	(void)reqBits;
+	gCollections++;
+}
+
+static void asyncAccess(void *ctx, uint32_t offset)
+{
+	(void)ctx;
+	if (offset == DX_RNG_ISR_REG_OFFSET)
+		gIsrReads++;
+}
+
+static const TztrngTestHooks_t gAsyncHooks = {
+	asyncAccess,
+	asyncRequest,
+	NULL,
+	NULL,
+	NULL,
+};
+
+/* Fire and forget coroutine: runs to its first co_await on the call, frees its frame at the end */
+struct AsyncTask {
+	struct promise_type {
+		AsyncTask get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
+
+typedef struct {
+	uint32_t len;
+	uint64_t print;			/* first 8 bytes, 0 if the read failed */
+} AsyncRead_t;
+
+typedef struct {
+	uint32_t done;			/* reads completed */
+	uint32_t errors;
+	uint64_t bytes;
+} AsyncTally_t;
+
+/* xorshift64: read sizes only */
+static uint32_t asyncRand(uint64_t *pState)
+{
+	*pState ^= *pState << 13;
+	*pState ^= *pState >> 7;
+	*pState ^= *pState << 17;
+	return (uint32_t)*pState;
+}
+
+static AsyncTask asyncReader(tztrng::AsyncSession &session, AsyncRead_t *reads, uint32_t count, AsyncTally_t &tally)
+{
+	std::byte buf[ASYNC_MAX_READ];
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		try {
+			co_await session.read(std::span<std::byte>(buf, reads[i].len));
+			std::memcpy(&reads[i].print, buf, sizeof(reads[i].print));
+			tally.bytes += reads[i].len;
+		} catch (const tztrng::Error &e) {
+			TZTRNG_PRINTF("read %u: %s\n", (unsigned int)i, e.what());
+			tally.errors++;
+		}
+		tally.done++;
+	}
+	tztrng::detail::SecureZero(buf, sizeof(buf));
+}
+
+static int asyncCmpPrint(const void *a, const void *b)
+{
+	uint64_t x = ((const AsyncRead_t *)a)->print, y = ((const AsyncRead_t *)b)->print;
+
+	return (x > y) - (x < y);
+}
+
+static void asyncSleepUs(uint32_t us)
+{
+	struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+
+	nanosleep(&ts, NULL);
+}
+
+/* Run one driver over all reads; 0 if every read completed without an error or a duplicate */
+static int asyncRun(unsigned long regBase, AsyncDriver_t driver, uint32_t periodUs, uint32_t coroutines,
+		    uint32_t reads, uint64_t seed)
+{
+	std::vector<AsyncRead_t> log((size_t)coroutines * reads);
+	AsyncTally_t tally = { 0, 0, 0 };
+	std::chrono::steady_clock::time_point t0;
+	uint64_t c0 = gCollections, i0 = gIsrReads, polls = 0;
+	size_t maxPending = 0, total = log.size(), i;
+	uint32_t duplicates = 0, idleClocks = 0;
+	double ms;
+
+	for (i = 0; i < total; i++) {
+		log[i].len = ASYNC_MIN_READ + asyncRand(&seed) % (ASYNC_MAX_READ - ASYNC_MIN_READ + 1);
+		log[i].print = 0;
+	}
+
+	t0 = std::chrono::steady_clock::now();
+	if (driver == ASYNC_DRIVER_BLOCKING) {
+		tztrng::Session session(regBase);
+		std::byte buf[ASYNC_MAX_READ];
+
+		for (i = 0; i < total; i++) {
+			try {
+				session.fill(std::span<std::byte>(buf, log[i].len));
+				std::memcpy(&log[i].print, buf, sizeof(log[i].print));
+				tally.bytes += log[i].len;
+			} catch (const tztrng::Error &e) {
+				TZTRNG_PRINTF("read %zu: %s\n", i, e.what());
+				tally.errors++;
+			}
+			tally.done++;
+		}
+		tztrng::detail::SecureZero(buf, sizeof(buf));
+	} else {
+		tztrng::AsyncSession session(regBase);
+
+		for (i = 0; i < coroutines; i++)
+			asyncReader(session, &log[i * reads], reads, tally);
+
+		/* the executor: one thread for all of them */
+		while (!session.idle()) {
+			maxPending = std::max(maxPending, session.pending());
+			if (driver == ASYNC_DRIVER_IRQ) {
+				tztrngModel_tick(ASYNC_MODEL_IRQ_STEP_CLOCKS);
+				idleClocks += ASYNC_MODEL_IRQ_STEP_CLOCKS;
+				if (!tztrngModel_irqPending() &&
+				    (idleClocks < ASYNC_IRQ_TIMEOUT_US * ASYNC_MODEL_CLOCKS_PER_US))
+					continue;
+				idleClocks = 0;
+			} else if (gUseModel) {
+				tztrngModel_tick(periodUs * ASYNC_MODEL_CLOCKS_PER_US);
+			} else {
+				asyncSleepUs(periodUs);
+			}
+			session.poll();
+			polls++;
+		}
+	}
+	ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+	printf("%s,%u,%u,%zu,%llu,%llu,%llu,%llu,%zu,%.1f\n", gDriverNames[driver],
+	       (driver == ASYNC_DRIVER_TIMER) ? (unsigned int)periodUs : 0,
+	       (driver == ASYNC_DRIVER_BLOCKING) ? 1 : (unsigned int)coroutines, total,
+	       (unsigned long long)tally.bytes, (unsigned long long)(gCollections - c0), (unsigned long long)polls,
+	       (unsigned long long)(gIsrReads - i0), maxPending, ms);
+	fflush(stdout);
+
+	std::qsort(log.data(), total, sizeof(log[0]), asyncCmpPrint);
+	for (i = 1; i < total; i++) {
+		if ((log[i].print != 0) && (log[i].print == log[i - 1].print))
+			duplicates++;
+	}
+
+	if ((tally.done != total) || tally.errors || duplicates) {
+		TZTRNG_PRINTF("%s: %u of %zu reads done, %u errors, %u duplicates\n", gDriverNames[driver],
+			      (unsigned int)tally.done, total, (unsigned int)tally.errors, (unsigned int)duplicates);
+		return 1;
+	}
+	return 0;
+}
+
+static AsyncTask asyncFailingReader(tztrng::AsyncSession &session, std::span<std::byte> buf, uint32_t &code, int &done)
+{
+	try {
+		co_await session.read(buf);
+	} catch (const tztrng::Error &e) {
+		code = e.code();
+	}
+	done = 1;
+}
+
+/* Model: all ROSCs stuck, the read fails with the code and a wiped buffer */
+static int asyncFaultCheck(unsigned long regBase)
+{
+	std::array<std::byte, 64> buf;
+	uint32_t i, code = 0;
+	int done = 0, fail;
+
+	buf.fill(std::byte{0xA5});
+	for (i = 0; i < CC_TRNG_NUM_OF_ROSCS; i++)
+		tztrngModel_setFault(i, TZTRNG_MODEL_FAULT_STUCK_0, 0);
+	{
+		tztrng::AsyncSession session(regBase);
+
+		asyncFailingReader(session, std::span<std::byte>(buf), code, done);
+		while (!session.idle()) {
+			tztrngModel_tick(ASYNC_DEFAULT_PERIOD_US * ASYNC_MODEL_CLOCKS_PER_US);
+			session.poll();
+		}
+	}
+	for (i = 0; i < CC_TRNG_NUM_OF_ROSCS; i++)
+		tztrngModel_setFault(i, TZTRNG_MODEL_FAULT_NONE, 0);
+
+	fail = !done || (code == 0) ||
+	       std::any_of(buf.begin(), buf.end(), [](std::byte b) { return b != std::byte{0}; });
+	if (fail)
+		TZTRNG_PRINTF("check failed: a failing TRNG fails the read with its code and a wiped buffer\n");
+	return fail;
+}
+
+/* Model: CC_TrngGetSource() is refused, with a wiped buffer, until the collection owning the TRNG ends */
+static int asyncOwnerCheck(unsigned long regBase)
+{
+	CCTrngAsync_t ctx, other;
+	std::array<uint8_t, 32> out, buf;
+	size_t len = buf.size();
+	uint32_t busy, err, polls;
+	int fail;
+
+	if (CC_TrngAsyncStart(&ctx, regBase, out.data(), out.size() * 8) != 0) {
+		TZTRNG_PRINTF("check failed: async start\n");
+		return 1;
+	}
+	/* the code of the conflict, as a second collection gets it */
+	busy = CC_TrngAsyncStart(&other, regBase, buf.data(), buf.size() * 8);
+	buf.fill(0xA5);
+	err = CC_TrngGetSource(regBase, buf.data(), &len, buf.size() * 8);
+	fail = (busy == 0) || (err != busy) || (len != 0) ||
+	       std::any_of(buf.begin(), buf.end(), [](uint8_t b) { return b != 0; });
+
+	/* the collection still completes */
+	err = CC_TRNG_ASYNC_PENDING;
+	for (polls = 0; (polls < ASYNC_OWNER_MAX_POLLS) && (err == CC_TRNG_ASYNC_PENDING); polls++) {
+		tztrngModel_tick(ASYNC_DEFAULT_PERIOD_US * ASYNC_MODEL_CLOCKS_PER_US);
+		err = CC_TrngAsyncPoll(&ctx);
+	}
+	if (err == CC_TRNG_ASYNC_PENDING)
+		CC_TrngAsyncCancel(&ctx);
+	fail |= (err != 0);
+
+	len = buf.size();
+	fail |= (CC_TrngGetSource(regBase, buf.data(), &len, buf.size() * 8) != 0);
+	if (fail)
+		TZTRNG_PRINTF("check failed: CC_TrngGetSource is refused while an async collection owns the TRNG\n");
+	return fail;
+}
+
+static void asyncUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-m] [-n coroutines] [-k reads] [-p periodUs]\n", prog);
+	TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+	TZTRNG_PRINTF("      (the interrupt driven run needs the model)\n");
+	TZTRNG_PRINTF("  -n  coroutines with reads pending at once (default %u)\n", ASYNC_DEFAULT_COROUTINES);
+	TZTRNG_PRINTF("  -k  reads per coroutine (default %u)\n", ASYNC_DEFAULT_READS);
+	TZTRNG_PRINTF("  -p  poll period of the timer driven run (default %u)\n", ASYNC_DEFAULT_PERIOD_US);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t coroutines = ASYNC_DEFAULT_COROUTINES, reads = ASYNC_DEFAULT_READS;
+	uint32_t periodUs = ASYNC_DEFAULT_PERIOD_US;
+	unsigned long regBase;
+	int opt, fail = 0;
+
+	while ((opt = getopt(argc, argv, "mn:k:p:")) != -1) {
+		switch (opt) {
+		case 'm':
+			gUseModel = 1;
+			break;
+		case 'n':
+			coroutines = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			reads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			periodUs = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			asyncUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((coroutines == 0) || (reads == 0) || (periodUs == 0)) {
+		asyncUsage(argv[0]);
+		return 1;
+	}
+
+	regBase = tztrngTest_target(gUseModel, NULL, &gAsyncHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	printf("# tztrng_async target=%s coroutines=%u reads=%u period_us=%u\n", gUseModel ? "model" : "hw",
+	       (unsigned int)coroutines, (unsigned int)reads, (unsigned int)periodUs);
+	printf("driver,period_us,coroutines,reads,bytes,collections,polls,isr_reads,max_pending,wall_ms\n");
+
+	if (gUseModel)
+		fail |= asyncRun(regBase, ASYNC_DRIVER_IRQ, periodUs, coroutines, reads, 0x5EED0001ULL);
+	fail |= asyncRun(regBase, ASYNC_DRIVER_TIMER, periodUs, coroutines, reads, 0x5EED0002ULL);
+	fail |= asyncRun(regBase, ASYNC_DRIVER_BLOCKING, periodUs, coroutines, reads, 0x5EED0003ULL);
+	if (gUseModel)
+		fail |= asyncFaultCheck(regBase) | asyncOwnerCheck(regBase);
+
+	CC_TrngSetMmioOps(NULL);
+	tztrngTest_targetRelease(regBase);
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
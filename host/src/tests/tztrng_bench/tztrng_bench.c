@@ -0,0 +1,494 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+/*
+ * Driver and characterization benchmark (library built with
+ * CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * getsource: CC_TrngGetSource requests of 16 B to 1 MiB, with the engine the
+ *            library was built for (CC_CONFIG_TRNG_MODE) and its ROSC and sample
+ *            count configuration.
+ * collect:   CC_TST_TRNG() captures for every TRNG mode, ROSC and sample count;
+ *            the latency is the time between two EHRs.
+ *
+ * One CSV row per configuration is written to stdout:
+ * bench,engine,rosc,sample_cnt,req_bytes,iterations,errors,bytes_per_sec,p50_ns,
+ * p99_ns,mmio_per_byte,health_ns_per_kbit,peak_stack_bytes
+ * Fields that were not measured are left empty: health_ns_per_kbit needs
+ * CC_CONFIG_TRNG_PROFILE = 1 and TRNG90B, peak_stack_bytes is measured for
+ * CC_TrngGetSource only.
+ *
+ * The target is the TRNG mapped through /dev/mem, or the RNG register model (-m)
+ * on any Linux host. On the model, the times are the cost of the driver and the
+ * model on the host CPU; mmio_per_byte is comparable between both targets.
+ */
+
+#define BENCH_MIN_REQ_BYTES 			16
+#define BENCH_MAX_REQ_BYTES 			(1024 * 1024)
+#define BENCH_DEFAULT_MAX_ITERATIONS 		200
+#define BENCH_MIN_ITERATIONS 			5
+/* bytes requested per request size, within the iteration limits */
+#define BENCH_DEFAULT_BUDGET_BYTES 		(4 * 1024 * 1024)
+#define BENCH_DEFAULT_COLLECT_EHRS 		200
+#define BENCH_EHR_BYTES 			24
+/* CC_TST_TRNG() header and footer */
+#define BENCH_TST_OVERHEAD_BYTES 		28
+#define BENCH_STACK_BYTES 			(256 * 1024)
+#define BENCH_STACK_PAINT 			0xA5
+#define BENCH_NS_PER_SEC 			1000000000ULL
+
+#if (CC_CONFIG_TRNG_MODE == 1)
+#define BENCH_ENGINE 				"trng90b"
+#else
+#define BENCH_ENGINE 				"fe"
+#endif
+
+/* TRNG_test.c */
+int CC_TST_TRNG(unsigned long regBaseAddress, uint32_t TRNGMode, uint32_t roscLength,
+		uint32_t sampleCount, uint32_t buffSize,
+		void (*callbackFunc)(uint32_t outputSize, uint8_t *outputBuffer));
+
+typedef struct {
+	const char *bench;
+	const char *engine;
+	int rosc;			/* < 0: chosen by the driver */
+	uint32_t sampleCnt;		/* 0: driver configuration */
+	size_t reqBytes;
+	uint32_t iterations;
+	uint32_t errors;
+	double bytesPerSec;
+	uint64_t p50Ns;
+	uint64_t p99Ns;
+	double mmioPerByte;
+	double healthNsPerKbit;		/* < 0: not measured */
+	long peakStack;			/* < 0: not measured */
+} BenchRow_t;
+
+typedef struct {
+	unsigned long regBase;
+	uint8_t *buf;
+	size_t reqBytes;
+	uint32_t err;
+} BenchReq_t;
+
+static const char *tstModeName[] = { "fast", "fe", "80090b" };
+static const uint32_t benchSampleCnts[] = { 50, 100, 200, 400, 800 };
+
+static int gUseModel;
+static uint64_t gMmioAccesses;
+
+/* EHR timestamps of the collect bench */
+static uint64_t *gEhrNs;
+static uint32_t gEhrCount;
+static uint32_t gEhrMax;
+
+static uint64_t benchNowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * BENCH_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/* counts the register accesses of the driver and of CC_TST_TRNG() */
+static void benchAccess(void *ctx, uint32_t offset)
+{
+	(void)ctx;
+	(void)offset;
+	gMmioAccesses++;
+}
+
+static const TztrngTestHooks_t gBenchHooks = {
+	benchAccess,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+};
+
+static void benchModelInit(void)
+{
+	TztrngModelCfg_t cfg;
+	uint32_t i;
+
+	tztrngModel_defaultCfg(&cfg);
+	/* longer rings oscillate slower */
+	for (i = 0; i < CC_TRNG_NUM_OF_ROSCS; i++)
+		cfg.rosc[i].clkScaleQ8 = 256 + i * 64;
+	tztrngModel_init(&cfg);
+}
+
+static int benchCmpU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void benchPercentiles(uint64_t *lat, uint32_t count, BenchRow_t *pRow)
+{
+	if (count == 0)
+		return;
+
+	qsort(lat, count, sizeof(lat[0]), benchCmpU64);
+	pRow->p50Ns = lat[(count - 1) * 50 / 100];
+	pRow->p99Ns = lat[(count - 1) * 99 / 100];
+}
+
+static void benchPrintHeader(void)
+{
+	printf("# tztrng_bench target=%s engine=%s\n", gUseModel ? "model" : "hw", BENCH_ENGINE);
+	printf("bench,engine,rosc,sample_cnt,req_bytes,iterations,errors,bytes_per_sec,p50_ns,p99_ns,"
+	       "mmio_per_byte,health_ns_per_kbit,peak_stack_bytes\n");
+}
+
+static void benchPrintRow(const BenchRow_t *pRow)
+{
+	printf("%s,%s,", pRow->bench, pRow->engine);
+	if (pRow->rosc >= 0)
+		printf("%d", pRow->rosc);
+	printf(",");
+	if (pRow->sampleCnt)
+		printf("%u", (unsigned int)pRow->sampleCnt);
+	printf(",%zu,%u,%u,%.0f,%llu,%llu,%.3f,", pRow->reqBytes, (unsigned int)pRow->iterations,
+	       (unsigned int)pRow->errors, pRow->bytesPerSec, (unsigned long long)pRow->p50Ns,
+	       (unsigned long long)pRow->p99Ns, pRow->mmioPerByte);
+	if (pRow->healthNsPerKbit >= 0)
+		printf("%.1f", pRow->healthNsPerKbit);
+	printf(",");
+	if (pRow->peakStack >= 0)
+		printf("%ld", pRow->peakStack);
+	printf("\n");
+	fflush(stdout);
+}
+
+/************************************************************************************/
+/* Peak stack: the call runs on a painted thread stack                              */
+/************************************************************************************/
+typedef struct {
+	void (*fn)(void *arg);
+	void *arg;
+} BenchStackJob_t;
+
+static void *benchStackThread(void *p)
+{
+	BenchStackJob_t *pJob = p;
+
+	if (pJob->fn != NULL)
+		pJob->fn(pJob->arg);
+
+	return NULL;
+}
+
+/* stack bytes used by a thread running fn, including the thread start-up */
+static long benchStackUsed(void (*fn)(void *arg), void *arg)
+{
+	BenchStackJob_t job = { fn, arg };
+	pthread_attr_t attr;
+	pthread_t thread;
+	uint8_t *stack = NULL;
+	long used = -1;
+	size_t i;
+
+	if (posix_memalign((void **)&stack, (size_t)sysconf(_SC_PAGESIZE), BENCH_STACK_BYTES) != 0)
+		return -1;
+	memset(stack, BENCH_STACK_PAINT, BENCH_STACK_BYTES);
+
+	if (pthread_attr_init(&attr) != 0)
+		goto End;
+	if ((pthread_attr_setstack(&attr, stack, BENCH_STACK_BYTES) == 0) &&
+	    (pthread_create(&thread, &attr, benchStackThread, &job) == 0))
+	{
+		pthread_join(thread, NULL);
+		/* the stack grows down: the lowest overwritten byte is the peak */
+		for (i = 0; (i < BENCH_STACK_BYTES) && (stack[i] == BENCH_STACK_PAINT); i++)
+			;
+		used = (long)(BENCH_STACK_BYTES - i);
+	}
+	pthread_attr_destroy(&attr);
+
+End:
+	free(stack);
+	return used;
+}
+
+static long benchStackPeak(void (*fn)(void *arg), void *arg)
+{
+	long used = benchStackUsed(fn, arg);
+	long base = benchStackUsed(NULL, NULL);
+
+	if ((used < 0) || (base < 0))
+		return -1;
+
+	return used - base;
+}
+
+/************************************************************************************/
+/* getsource: CC_TrngGetSource                                                      */
+/************************************************************************************/
+static void benchRequest(void *arg)
+{
+	BenchReq_t *pReq = arg;
+	size_t outputLen = 0;
+
+	pReq->err = CC_TrngGetSource(pReq->regBase, pReq->buf, &outputLen, pReq->reqBytes * 8);
+	if ((pReq->err == 0) && (outputLen != pReq->reqBytes))
+		pReq->err = 1;
+}
+
+static int benchGetSource(unsigned long regBase, size_t reqBytes, uint32_t maxIterations,
+			  size_t budgetBytes)
+{
+	BenchRow_t row;
+	BenchReq_t req;
+	uint64_t *lat;
+	uint64_t t0, t1, totalNs = 0;
+	uint32_t i, iterations;
+	#ifdef CC_CONFIG_TRNG_PROFILE
+	CCTrngProfile_t profile;
+	#endif
+
+	iterations = (uint32_t)(budgetBytes / reqBytes);
+	if (iterations > maxIterations)
+		iterations = maxIterations;
+	if (iterations < BENCH_MIN_ITERATIONS)
+		iterations = BENCH_MIN_ITERATIONS;
+
+	memset(&row, 0, sizeof(row));
+	row.bench = "getsource";
+	row.engine = BENCH_ENGINE;
+	row.rosc = -1;
+	row.reqBytes = reqBytes;
+	row.iterations = iterations;
+	row.healthNsPerKbit = -1;
+
+	lat = malloc(iterations * sizeof(lat[0]));
+	req.regBase = regBase;
+	req.reqBytes = reqBytes;
+	req.buf = malloc(reqBytes);
+	if ((lat == NULL) || (req.buf == NULL))
+	{
+		TZTRNG_PRINTF("failed to allocate %zu bytes\n", reqBytes);
+		free(lat);
+		free(req.buf);
+		return 1;
+	}
+
+	if (gUseModel)
+		benchModelInit();
+
+	row.peakStack = benchStackPeak(benchRequest, &req);
+
+	#ifdef CC_CONFIG_TRNG_PROFILE
+	CC_TrngResetProfile();
+	#endif
+	gMmioAccesses = 0;
+
+	for (i = 0; i < iterations; i++)
+	{
+		t0 = benchNowNs();
+		benchRequest(&req);
+		t1 = benchNowNs();
+		lat[i] = t1 - t0;
+		totalNs += t1 - t0;
+		if (req.err)
+		{
+			TZTRNG_PRINTF("getsource %zu bytes: request %u error(0x%X)\n", reqBytes,
+				      (unsigned int)i, req.err);
+			row.errors++;
+		}
+	}
+
+	if (totalNs)
+		row.bytesPerSec = (double)reqBytes * iterations * BENCH_NS_PER_SEC / totalNs;
+	row.mmioPerByte = (double)gMmioAccesses / ((double)reqBytes * iterations);
+	benchPercentiles(lat, iterations, &row);
+
+	#ifdef CC_CONFIG_TRNG_PROFILE
+	/* profile durations are nanoseconds on Linux */
+	if ((CC_TrngGetProfile(&profile) == 0) && profile.phase[CC_TRNG_PROF_CONT_TEST].count)
+		row.healthNsPerKbit = (double)profile.phase[CC_TRNG_PROF_CONT_TEST].sum * 1024 /
+				      ((double)reqBytes * 8 * iterations);
+	#endif
+
+	benchPrintRow(&row);
+
+	free(lat);
+	free(req.buf);
+
+	return row.errors ? 1 : 0;
+}
+
+/************************************************************************************/
+/* collect: CC_TST_TRNG()                                                           */
+/************************************************************************************/
+static void benchCollectCallback(uint32_t outputSize, uint8_t *outputBuffer)
+{
+	(void)outputBuffer;
+
+	/* the header starts the first EHR interval; the footer is not timed */
+	if (((outputSize == BENCH_EHR_BYTES) || (gEhrCount == 0)) && (gEhrCount < gEhrMax))
+		gEhrNs[gEhrCount++] = benchNowNs();
+}
+
+static int benchCollect(unsigned long regBase, uint32_t trngMode, uint32_t rosc,
+			uint32_t sampleCnt, uint32_t ehrs)
+{
+	BenchRow_t row;
+	uint64_t t0, t1;
+	uint32_t i;
+	int ret;
+
+	memset(&row, 0, sizeof(row));
+	row.bench = "collect";
+	row.engine = tstModeName[trngMode];
+	row.rosc = (int)rosc;
+	row.sampleCnt = sampleCnt;
+	row.reqBytes = (size_t)ehrs * BENCH_EHR_BYTES;
+	row.iterations = 1;
+	row.healthNsPerKbit = -1;
+	row.peakStack = -1;
+
+	if (gUseModel)
+		benchModelInit();
+
+	gEhrCount = 0;
+	gEhrMax = ehrs + 1;
+	gMmioAccesses = 0;
+
+	t0 = benchNowNs();
+	ret = CC_TST_TRNG(regBase, trngMode, rosc, sampleCnt,
+			  ehrs * BENCH_EHR_BYTES + BENCH_TST_OVERHEAD_BYTES, benchCollectCallback);
+	t1 = benchNowNs();
+
+	/* CRNGT and VN events are part of the characterization data, not errors */
+	if ((ret < 0) || (ret & 0x3))
+	{
+		TZTRNG_PRINTF("collect %s rosc %u sample count %u: error(0x%X)\n", tstModeName[trngMode],
+			      (unsigned int)rosc, (unsigned int)sampleCnt, (unsigned int)ret);
+		row.errors = 1;
+	}
+
+	if (t1 > t0)
+		row.bytesPerSec = (double)row.reqBytes * BENCH_NS_PER_SEC / (t1 - t0);
+	row.mmioPerByte = (double)gMmioAccesses / row.reqBytes;
+	for (i = 1; i < gEhrCount; i++)
+		gEhrNs[i - 1] = gEhrNs[i] - gEhrNs[i - 1];
+	if (gEhrCount)
+		benchPercentiles(gEhrNs, gEhrCount - 1, &row);
+
+	benchPrintRow(&row);
+
+	return row.errors;
+}
+
+static void benchUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-m] [-g|-c] [-s maxReqBytes] [-n maxIterations] [-b budgetBytes] [-e ehrs]\n", prog);
+	TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+	TZTRNG_PRINTF("  -g  CC_TrngGetSource sweep only\n");
+	TZTRNG_PRINTF("  -c  CC_TST_TRNG() sweep only\n");
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long regBase;
+	size_t reqBytes, maxReqBytes = BENCH_MAX_REQ_BYTES, budgetBytes = BENCH_DEFAULT_BUDGET_BYTES;
+	uint32_t maxIterations = BENCH_DEFAULT_MAX_ITERATIONS, ehrs = BENCH_DEFAULT_COLLECT_EHRS;
+	uint32_t mode, rosc, i;
+	int opt, runGetSource = 1, runCollect = 1, fail = 0;
+
+	while ((opt = getopt(argc, argv, "mgcs:n:b:e:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'm':
+			gUseModel = 1;
+			break;
+		case 'g':
+			runCollect = 0;
+			break;
+		case 'c':
+			runGetSource = 0;
+			break;
+		case 's':
+			maxReqBytes = (size_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			maxIterations = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			budgetBytes = (size_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			ehrs = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			benchUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((maxIterations == 0) || (ehrs == 0))
+	{
+		benchUsage(argv[0]);
+		return 1;
+	}
+
+	gEhrNs = malloc((ehrs + 1) * sizeof(gEhrNs[0]));
+	if (gEhrNs == NULL)
+	{
+		TZTRNG_PRINTF("failed to allocate buffers\n");
+		return 1;
+	}
+
+	regBase = tztrngTest_target(gUseModel, NULL, &gBenchHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	benchPrintHeader();
+
+	if (runGetSource)
+	{
+		for (reqBytes = BENCH_MIN_REQ_BYTES; reqBytes <= maxReqBytes; reqBytes *= 4)
+			fail |= benchGetSource(regBase, reqBytes, maxIterations, budgetBytes);
+	}
+
+	if (runCollect)
+	{
+		for (mode = 0; mode < sizeof(tstModeName) / sizeof(tstModeName[0]); mode++)
+			for (rosc = 0; rosc < CC_TRNG_NUM_OF_ROSCS; rosc++)
+				for (i = 0; i < sizeof(benchSampleCnts) / sizeof(benchSampleCnts[0]); i++)
+					fail |= benchCollect(regBase, mode, rosc, benchSampleCnts[i], ehrs);
+	}
+
+	CC_TrngSetMmioOps(NULL);
+	tztrngTest_targetRelease(regBase);
+	free(gEhrNs);
+
+	return fail;
+}
@@ -0,0 +1,32 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+/*
+ * CC_TST_TRNG() of the characterization package (TRNG_test.c), built with its
+ * register accesses counted by the benchmark.
+ */
+#include <stdint.h>
+
+#include "tztrng_target.h"
+
+#define CC_GEN_WriteRegister(base_addr, reg_addr, val) \
+	tztrngTest_regWrite((base_addr), (uint32_t)(reg_addr), (uint32_t)(val))
+
+#define CC_GEN_ReadRegister(base_addr, reg_addr) \
+	tztrngTest_regRead((base_addr), (uint32_t)(reg_addr))
+
+#include "TRNG_test.c"
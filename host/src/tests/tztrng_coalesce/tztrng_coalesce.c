@@ -0,0 +1,356 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+/*
+ * Request coalescing test tool (library built with CC_CONFIG_TRNG_COALESCE = 1,
+ * CC_CONFIG_TRNG_LOCK = 1 and CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * N client threads meet at a barrier and then each request 16 to 64 bytes at
+ * the same moment, for a number of bursts: first straight through
+ * CC_TrngGetSource(), then through CC_TrngGetSourceCoalesced(), where every
+ * -k'th client is CC_TRNG_PRIO_HIGH and the others CC_TRNG_PRIO_NORMAL.
+ * One CSV row per source and class is written to stdout:
+ * source,prio,threads,requests,collections,errors,duplicates,bytes_per_sec,p50_us,p99_us
+ * collections counts the TRNG collections of the run (MMIO request hook) and is
+ * the same in both rows of the coalesced run. The scheduler counters follow as
+ * a comment.
+ */
+
+#define COAL_DEFAULT_THREADS 		16
+#define COAL_DEFAULT_BURSTS 		50
+#define COAL_DEFAULT_HIGH_EVERY 	8
+#define COAL_MAX_THREADS 		256
+#define COAL_MIN_REQ_BYTES 		16
+#define COAL_MAX_REQ_BYTES 		64
+#define COAL_PRINT_BYTES 		16
+#define COAL_NS_PER_SEC 		1000000000ULL
+
+typedef struct {
+	uint64_t lo;
+	uint64_t hi;
+} CoalPrint_t;
+
+typedef struct {
+	pthread_t thread;
+	int coalesced;
+	CCTrngPriority_t prio;
+	uint32_t bursts;
+	uint64_t rng;
+	uint64_t *lat;			/* ns per request */
+	CoalPrint_t *prints;		/* leading bytes of every output */
+	uint64_t bytes;
+	uint32_t errors;
+} CoalThread_t;
+
+static int gUseModel;
+static unsigned long gRegBase;
+static pthread_mutex_t gModelLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_barrier_t gBurst;
+static volatile uint32_t gCollections;
+
+static uint64_t coalNowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * COAL_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/* start of a TRNG collection */
+static void coalRequest(void *ctx, size_t reqBits)
+{
+	(void)ctx;
+	(void)reqBits;
+	__sync_fetch_and_add(&gCollections, 1);
+}
+
+static void coalModelLock(void *ctx)
+{
+	(void)ctx;
+	pthread_mutex_lock(&gModelLock);
+}
+
+static void coalModelUnlock(void *ctx)
+{
+	(void)ctx;
+	pthread_mutex_unlock(&gModelLock);
+}
+
+static const TztrngTestHooks_t gCoalHooks = {
+	NULL,
+	coalRequest,
+	coalModelLock,
+	coalModelUnlock,
+	NULL,
+};
+
+/* xorshift64: request sizes only */
+static uint32_t coalRand(uint64_t *pState)
+{
+	*pState ^= *pState << 13;
+	*pState ^= *pState >> 7;
+	*pState ^= *pState << 17;
+	return (uint32_t)*pState;
+}
+
+static void *coalThread(void *arg)
+{
+	CoalThread_t *pThr = arg;
+	uint8_t buf[COAL_MAX_REQ_BYTES];
+	size_t len, outputLen;
+	uint64_t t0;
+	uint32_t b, err;
+
+	for (b = 0; b < pThr->bursts; b++) {
+		len = COAL_MIN_REQ_BYTES + coalRand(&pThr->rng) % (COAL_MAX_REQ_BYTES - COAL_MIN_REQ_BYTES + 1);
+		pthread_barrier_wait(&gBurst);
+
+		t0 = coalNowNs();
+		if (pThr->coalesced)
+			err = CC_TrngGetSourceCoalesced(gRegBase, buf, &outputLen, len * 8, pThr->prio);
+		else
+			err = CC_TrngGetSource(gRegBase, buf, &outputLen, len * 8);
+		pThr->lat[b] = coalNowNs() - t0;
+
+		if (err || (outputLen != len)) {
+			pThr->errors++;
+			TZTRNG_PRINTF("burst %u (%zu bytes): error(0x%X) len %zu\n", (unsigned int)b, len, err, outputLen);
+			continue;
+		}
+		pThr->bytes += len;
+		memcpy(&pThr->prints[b], buf, COAL_PRINT_BYTES);
+	}
+
+	return NULL;
+}
+
+static int coalCmpU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int coalCmpPrint(const void *a, const void *b)
+{
+	const CoalPrint_t *x = a, *y = b;
+
+	if (x->hi != y->hi)
+		return (x->hi > y->hi) - (x->hi < y->hi);
+	return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+/* one CSV row over the threads of one class (all classes if prio < 0) */
+static void coalReport(const char *src, int prio, CoalThread_t *thr, uint32_t threads,
+		       uint32_t bursts, uint32_t duplicates, uint64_t ns)
+{
+	uint64_t *lat, bytes = 0;
+	uint32_t i, n = 0, errors = 0;
+
+	lat = malloc(threads * bursts * sizeof(lat[0]));
+	if (lat == NULL)
+		return;
+	for (i = 0; i < threads; i++) {
+		if ((prio >= 0) && (thr[i].prio != (CCTrngPriority_t)prio))
+			continue;
+		memcpy(lat + n, thr[i].lat, bursts * sizeof(lat[0]));
+		n += bursts;
+		bytes += thr[i].bytes;
+		errors += thr[i].errors;
+	}
+	if (n > 0) {
+		qsort(lat, n, sizeof(lat[0]), coalCmpU64);
+		printf("%s,%s,%u,%u,%u,%u,%u,%.0f,%.1f,%.1f\n", src,
+		       (prio < 0) ? "all" : ((prio == CC_TRNG_PRIO_HIGH) ? "high" : "normal"),
+		       (unsigned int)threads, (unsigned int)n, (unsigned int)gCollections,
+		       (unsigned int)errors, (unsigned int)duplicates,
+		       (ns > 0) ? (double)bytes * COAL_NS_PER_SEC / ns : 0.0,
+		       lat[(n - 1) * 50 / 100] / 1000.0, lat[(n - 1) * 99 / 100] / 1000.0);
+	}
+	free(lat);
+}
+
+static int coalRun(int coalesced, uint32_t threads, uint32_t bursts, uint32_t highEvery)
+{
+	CoalThread_t thr[COAL_MAX_THREADS];
+	uint64_t *lat;
+	CoalPrint_t *prints;
+	uint64_t t0, t1;
+	uint32_t i, total = threads * bursts;
+	uint32_t errors = 0, duplicates = 0, n = 0;
+
+	lat = malloc(total * sizeof(lat[0]));
+	prints = malloc(total * sizeof(prints[0]));
+	if ((lat == NULL) || (prints == NULL) || (pthread_barrier_init(&gBurst, NULL, threads) != 0)) {
+		TZTRNG_PRINTF("failed to allocate buffers\n");
+		free(lat);
+		free(prints);
+		return 1;
+	}
+	memset(prints, 0, total * sizeof(prints[0]));
+	gCollections = 0;
+	CC_TrngResetCoalesceStats();
+
+	memset(thr, 0, sizeof(thr));
+	t0 = coalNowNs();
+	for (i = 0; i < threads; i++) {
+		thr[i].coalesced = coalesced;
+		thr[i].prio = (coalesced && highEvery && (i % highEvery == 0)) ? CC_TRNG_PRIO_HIGH : CC_TRNG_PRIO_NORMAL;
+		thr[i].bursts = bursts;
+		thr[i].rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+		thr[i].lat = lat + i * bursts;
+		thr[i].prints = prints + i * bursts;
+		if (pthread_create(&thr[i].thread, NULL, coalThread, &thr[i]) != 0) {
+			/* the barrier counts on all threads */
+			TZTRNG_PRINTF("failed to start thread %u\n", (unsigned int)i);
+			exit(1);
+		}
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(thr[i].thread, NULL);
+		errors += thr[i].errors;
+	}
+	t1 = coalNowNs();
+	pthread_barrier_destroy(&gBurst);
+
+	/* failed requests left their fingerprint zero */
+	qsort(prints, total, sizeof(prints[0]), coalCmpPrint);
+	for (i = 0; i < total; i++) {
+		if ((prints[i].lo == 0) && (prints[i].hi == 0))
+			continue;
+		if ((n > 0) && (coalCmpPrint(&prints[i], &prints[n - 1]) == 0))
+			duplicates++;
+		prints[n++] = prints[i];
+	}
+
+	if (!coalesced) {
+		coalReport("direct", -1, thr, threads, bursts, duplicates, t1 - t0);
+	} else {
+		CCTrngCoalesceStats_t stats;
+
+		coalReport("coalesced", CC_TRNG_PRIO_NORMAL, thr, threads, bursts, duplicates, t1 - t0);
+		coalReport("coalesced", CC_TRNG_PRIO_HIGH, thr, threads, bursts, duplicates, t1 - t0);
+		if (CC_TrngGetCoalesceStats(&stats) == 0)
+			printf("# coalesce requests=%u batches=%u batched_bytes=%u max_batch_requests=%u "
+			       "window_expired=%u threshold_reached=%u priority_kicks=%u request_errors=%u\n",
+			       (unsigned int)stats.requests, (unsigned int)stats.batches,
+			       (unsigned int)stats.batchedBytes, (unsigned int)stats.maxBatchRequests,
+			       (unsigned int)stats.windowExpired, (unsigned int)stats.thresholdReached,
+			       (unsigned int)stats.priorityKicks, (unsigned int)stats.requestErrors);
+	}
+	fflush(stdout);
+
+	free(lat);
+	free(prints);
+
+	return (errors || duplicates) ? 1 : 0;
+}
+
+static int coalCheck(int cond, const char *what)
+{
+	if (!cond)
+		TZTRNG_PRINTF("check failed: %s\n", what);
+	return cond ? 0 : 1;
+}
+
+static int coalApiChecks(void)
+{
+	uint8_t buf[COAL_MAX_REQ_BYTES];
+	size_t len = 1;
+
+	return coalCheck(CC_TrngGetSourceCoalesced(gRegBase, NULL, &len, 128, CC_TRNG_PRIO_NORMAL) != 0,
+			 "NULL output fails") |
+	       coalCheck(CC_TrngGetSourceCoalesced(gRegBase, buf, NULL, 128, CC_TRNG_PRIO_NORMAL) != 0,
+			 "NULL length fails") |
+	       coalCheck(CC_TrngGetSourceCoalesced(0, buf, &len, 128, CC_TRNG_PRIO_NORMAL) != 0,
+			 "zero base fails") |
+	       coalCheck(CC_TrngGetSourceCoalesced(gRegBase, buf, &len, 128, (CCTrngPriority_t)7) != 0,
+			 "illegal priority fails") |
+	       coalCheck((CC_TrngGetSourceCoalesced(gRegBase, buf, &len, 0, CC_TRNG_PRIO_LOW) == 0) && (len == 0),
+			 "empty request") |
+	       coalCheck((CC_TrngGetSourceCoalesced(gRegBase, buf, &len, 77, CC_TRNG_PRIO_LOW) == 0) && (len == 10),
+			 "single request, rounded up to bytes") |
+	       coalCheck(CC_TrngGetSourceCoalesced(gRegBase, NULL, NULL, 0, CC_TRNG_PRIO_HIGH) != 0,
+			 "NULL checked before the length");
+}
+
+static void coalUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-m] [-t threads] [-n bursts] [-k highEvery]\n", prog);
+	TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+	TZTRNG_PRINTF("  -k  every k'th client requests with CC_TRNG_PRIO_HIGH, 0: none (default %u)\n",
+		      (unsigned int)COAL_DEFAULT_HIGH_EVERY);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t threads = COAL_DEFAULT_THREADS, bursts = COAL_DEFAULT_BURSTS, highEvery = COAL_DEFAULT_HIGH_EVERY;
+	int opt, fail = 0;
+
+	while ((opt = getopt(argc, argv, "mt:n:k:")) != -1) {
+		switch (opt) {
+		case 'm':
+			gUseModel = 1;
+			break;
+		case 't':
+			threads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			bursts = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			highEvery = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			coalUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((threads == 0) || (threads > COAL_MAX_THREADS) || (bursts == 0)) {
+		coalUsage(argv[0]);
+		return 1;
+	}
+
+	gRegBase = tztrngTest_target(gUseModel, NULL, &gCoalHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	fail |= coalApiChecks();
+
+	printf("# tztrng_coalesce target=%s high_every=%u\n", gUseModel ? "model" : "hw", (unsigned int)highEvery);
+	printf("source,prio,threads,requests,collections,errors,duplicates,bytes_per_sec,p50_us,p99_us\n");
+	fail |= coalRun(0, threads, bursts, highEvery);
+	fail |= coalRun(1, threads, bursts, highEvery);
+
+	CC_TrngSetMmioOps(NULL);
+	tztrngTest_targetRelease(gRegBase);
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
@@ -0,0 +1,345 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tztrng_defs.h"
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+/*
+ * Conditioning component test and throughput tool (library built with
+ * CC_CONFIG_TRNG_CONDITIONING = 1 and CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * 1. SHA-256 known answers (FIPS 180-4 examples).
+ * 2. Conditioning known answers: a fixed data pattern streamed through
+ *    LLF_COND_Sink() in TRNG90B sized and odd sized pieces, checked against
+ *    SHA-256 and AES-256 CBC-MAC of each data block computed independently.
+ * 3. CC_TrngGetFullEntropy() on the TRNG: output length and the amount of TRNG
+ *    data requested for each conditioning function and request size.
+ * 4. Throughput, one CSV row per conditioning function to stdout:
+ *    func,data_bits_per_block,out_bits_per_block,cond_data_bytes_per_sec,
+ *    raw_bytes_per_sec,full_entropy_bytes_per_sec
+ *    cond_data_bytes_per_sec is the conditioning alone, raw_bytes_per_sec is
+ *    CC_TrngGetSource() on the same target; conditioning is not the bottleneck
+ *    while the first is well above the second.
+ *
+ * The TRNG is mapped through /dev/mem, or the RNG register model (-m) is used
+ * on any Linux host.
+ */
+
+#define COND_TEST_DEFAULT_BYTES 		(64UL << 20)
+#define COND_TEST_DEFAULT_REQ_BITS 		8192
+#define COND_TEST_DEFAULT_ITERATIONS 		20
+#define COND_TEST_PATTERN_BYTES 		240
+#define COND_TEST_TRNG_CHUNK 			144	/* CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES */
+#define COND_TEST_MAX_OUT_BYTES 		1024
+#define COND_TEST_NS_PER_SEC 			1000000000ULL
+
+typedef struct {
+	const char *msg;
+	uint32_t repeat;
+	const char *digest;
+} CondShaVector_t;
+
+static const CondShaVector_t condShaVectors[] = {
+	{ "abc", 1,
+	  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+	{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+	  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+	{ "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", 10000,
+	  "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+};
+#define COND_NUM_SHA_VECTORS (sizeof(condShaVectors) / sizeof(condShaVectors[0]))
+
+/* data[i] = i * 167 + 13: three SHA-256 blocks of 80 bytes (first 88 output
+   bytes) and three CBC-MAC blocks of 48 bytes (first 40 output bytes), at
+   entropy per bit = 0.5 */
+static const char condShaExpected[] =
+	"97a27d9afdd01a62d2991ceb24e5b7e0f7edf6a31b9b34b75cb24cacec43515d"
+	"6f7ad7b6e7508c317db6c322153d7b6e3ec4678f76abf800cd62ab5b810afd3c"
+	"550888966d4f8e7d";
+static const char condCbcMacExpected[] =
+	"c4a127c721ae297c557cbb7c977fb0182632808a0290c18e01d3f7dd36e2a6cc"
+	"5208704a5ce5436f";
+
+static const size_t condReqBits[] = { 1, 128, 256, 384, 1000, 8192 };
+#define COND_NUM_REQ_SIZES (sizeof(condReqBits) / sizeof(condReqBits[0]))
+
+static const char *condFuncName[] = { "sha256", "cbc_mac" };
+
+static int gUseModel;
+static size_t gLastReqBits;
+
+static void condRequest(void *ctx, size_t reqBits)
+{
+	(void)ctx;
+	gLastReqBits = reqBits;
+}
+
+static const TztrngTestHooks_t gCondHooks = {
+	NULL,
+	condRequest,
+	NULL,
+	NULL,
+	NULL,
+};
+
+static uint64_t condNowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * COND_TEST_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static size_t condHex(const char *hex, uint8_t *out)
+{
+	size_t len = strlen(hex) / 2, i;
+	unsigned int byte;
+
+	for (i = 0; i < len; i++) {
+		sscanf(hex + 2 * i, "%2x", &byte);
+		out[i] = (uint8_t)byte;
+	}
+	return len;
+}
+
+static int condTestSha(void)
+{
+	LLFSha256Ctx_t sha;
+	uint8_t digest[LLF_SHA256_DIGEST_BYTES], expected[LLF_SHA256_DIGEST_BYTES];
+	uint32_t i, r, failed = 0;
+
+	for (i = 0; i < COND_NUM_SHA_VECTORS; i++) {
+		LLF_SHA256_Init(&sha);
+		for (r = 0; r < condShaVectors[i].repeat; r++)
+			LLF_SHA256_Update(&sha, (const uint8_t *)condShaVectors[i].msg, strlen(condShaVectors[i].msg));
+		LLF_SHA256_Final(&sha, digest);
+		condHex(condShaVectors[i].digest, expected);
+		if (memcmp(digest, expected, sizeof(digest)) != 0) {
+			TZTRNG_PRINTF("SHA-256 vector %u: FAILED\n", (unsigned int)i);
+			failed++;
+		}
+	}
+
+	TZTRNG_PRINTF("SHA-256 vectors: %u/%u passed\n",
+		      (unsigned int)(COND_NUM_SHA_VECTORS - failed), (unsigned int)COND_NUM_SHA_VECTORS);
+	return (failed != 0);
+}
+
+/* Stream 'len' pattern bytes in pieces of 'piece' bytes, compare the output */
+static int condTestKat(CCTrngCondFunc_t func, const uint8_t *data, size_t len, size_t piece, const char *expectedHex)
+{
+	LLFCondCtx_t ctx;
+	uint8_t expected[COND_TEST_MAX_OUT_BYTES], out[COND_TEST_MAX_OUT_BYTES];
+	size_t outLen = condHex(expectedHex, expected), off, n;
+
+	memset(out, 0, sizeof(out));
+	if (LLF_COND_Init(&ctx, func, out, outLen) != CC_OK)
+		return 1;
+	for (off = 0; off < len; off += n) {
+		n = (len - off < piece) ? (len - off) : piece;
+		LLF_COND_Sink(&ctx, data + off, (uint32_t)n);
+	}
+
+	if (memcmp(out, expected, outLen) != 0) {
+		TZTRNG_PRINTF("%s known answer (%zu byte pieces): FAILED\n", condFuncName[func], piece);
+		return 1;
+	}
+	return 0;
+}
+
+static int condTestKats(void)
+{
+	uint8_t data[COND_TEST_PATTERN_BYTES];
+	int fail = 0;
+	uint32_t i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = (uint8_t)(i * 167 + 13);
+
+	fail |= condTestKat(CC_TRNG_COND_SHA256, data, 240, COND_TEST_TRNG_CHUNK, condShaExpected);
+	fail |= condTestKat(CC_TRNG_COND_SHA256, data, 240, 7, condShaExpected);
+	fail |= condTestKat(CC_TRNG_COND_CBC_MAC, data, 144, COND_TEST_TRNG_CHUNK, condCbcMacExpected);
+	fail |= condTestKat(CC_TRNG_COND_CBC_MAC, data, 144, 7, condCbcMacExpected);
+
+	TZTRNG_PRINTF("conditioning known answers: %s\n", fail ? "FAILED" : "passed");
+	return fail;
+}
+
+static int condTestApi(unsigned long regBase)
+{
+	LLFCondCtx_t ctx;
+	uint8_t out[COND_TEST_MAX_OUT_BYTES], prev[COND_TEST_MAX_OUT_BYTES];
+	size_t outLen, expectedRaw;
+	uint32_t f, i, err;
+	int fail = 0;
+
+	if (CC_TrngGetFullEntropy(regBase, (CCTrngCondFunc_t)2, out, &outLen, 256) != CC_RND_TRNG_ILLEGAL_COND_FUNC_ERROR) {
+		TZTRNG_PRINTF("API: illegal conditioning function: FAILED\n");
+		fail = 1;
+	}
+	if (CC_TrngGetFullEntropy(regBase, CC_TRNG_COND_SHA256, NULL, &outLen, 256) != LLF_RND_TRNG_ILLEGAL_PTR_ERROR) {
+		TZTRNG_PRINTF("API: NULL output: FAILED\n");
+		fail = 1;
+	}
+
+	for (f = CC_TRNG_COND_SHA256; f <= CC_TRNG_COND_CBC_MAC; f++) {
+		LLF_COND_Init(&ctx, (CCTrngCondFunc_t)f, out, 0);
+		memset(prev, 0, sizeof(prev));
+		for (i = 0; i < COND_NUM_REQ_SIZES; i++) {
+			expectedRaw = (condReqBits[i] + ctx.outBits - 1) / ctx.outBits * ctx.dataBytes * 8;
+			err = CC_TrngGetFullEntropy(regBase, (CCTrngCondFunc_t)f, out, &outLen, condReqBits[i]);
+			if ((err != CC_OK) || (outLen != (condReqBits[i] + 7) / 8) || (gLastReqBits != expectedRaw) ||
+			    ((outLen >= 16) && (memcmp(out, prev, 16) == 0))) {
+				TZTRNG_PRINTF("API: %s %zu bits: error(0x%X) len %zu data bits %zu (expected %zu): FAILED\n",
+					      condFuncName[f], condReqBits[i], (unsigned int)err, outLen,
+					      gLastReqBits, expectedRaw);
+				fail = 1;
+			}
+			memcpy(prev, out, outLen);
+		}
+	}
+
+	TZTRNG_PRINTF("API: %s\n", fail ? "FAILED" : "passed");
+	return fail;
+}
+
+static int condBench(unsigned long regBase, size_t condBytes, size_t reqBits, uint32_t iterations)
+{
+	LLFCondCtx_t ctx;
+	uint8_t *data, *out;
+	size_t off, outLen, rawBytes, rawLen;
+	uint64_t t0, tCond, tRaw, tFe;
+	uint32_t f, i, err = CC_OK;
+
+	data = malloc(condBytes);
+	out = malloc(condBytes);
+	if ((data == NULL) || (out == NULL)) {
+		TZTRNG_PRINTF("failed to allocate buffers\n");
+		free(data);
+		free(out);
+		return 1;
+	}
+	for (off = 0; off < condBytes; off++)
+		data[off] = (uint8_t)(off * 167 + 13);
+
+	for (f = CC_TRNG_COND_SHA256; (f <= CC_TRNG_COND_CBC_MAC) && (err == CC_OK); f++) {
+		/* conditioning alone, in TRNG90B sized pieces */
+		LLF_COND_Init(&ctx, (CCTrngCondFunc_t)f, out, condBytes);
+		t0 = condNowNs();
+		for (off = 0; off + COND_TEST_TRNG_CHUNK <= condBytes; off += COND_TEST_TRNG_CHUNK)
+			LLF_COND_Sink(&ctx, data + off, COND_TEST_TRNG_CHUNK);
+		tCond = condNowNs() - t0;
+
+		/* the TRNG data needed for reqBits, raw and conditioned */
+		rawBytes = (reqBits + ctx.outBits - 1) / ctx.outBits * ctx.dataBytes;
+		if (rawBytes > condBytes)
+			rawBytes = condBytes;
+		t0 = condNowNs();
+		for (i = 0; (i < iterations) && (err == CC_OK); i++)
+			err = CC_TrngGetSource(regBase, out, &rawLen, rawBytes * 8);
+		tRaw = condNowNs() - t0;
+		t0 = condNowNs();
+		for (i = 0; (i < iterations) && (err == CC_OK); i++)
+			err = CC_TrngGetFullEntropy(regBase, (CCTrngCondFunc_t)f, out, &outLen, reqBits);
+		tFe = condNowNs() - t0;
+
+		printf("%s,%u,%u,%.0f,%.0f,%.0f\n", condFuncName[f],
+		       (unsigned int)(ctx.dataBytes * 8), (unsigned int)ctx.outBits,
+		       (double)off * COND_TEST_NS_PER_SEC / (double)(tCond + 1),
+		       (double)rawBytes * iterations * COND_TEST_NS_PER_SEC / (double)(tRaw + 1),
+		       (double)((reqBits + 7) / 8) * iterations * COND_TEST_NS_PER_SEC / (double)(tFe + 1));
+		fflush(stdout);
+	}
+
+	free(data);
+	free(out);
+	if (err != CC_OK) {
+		TZTRNG_PRINTF("benchmark: error(0x%X)\n", (unsigned int)err);
+		return 1;
+	}
+	return 0;
+}
+
+static void condUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-m] [-n conditioningBytes] [-r reqBits] [-i iterations]\n", prog);
+	TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+	TZTRNG_PRINTF("  -n  data conditioned for the throughput (default %lu)\n", COND_TEST_DEFAULT_BYTES);
+	TZTRNG_PRINTF("  -r  full entropy bits per request (default %u)\n", (unsigned int)COND_TEST_DEFAULT_REQ_BITS);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t condBytes = COND_TEST_DEFAULT_BYTES, reqBits = COND_TEST_DEFAULT_REQ_BITS;
+	uint32_t iterations = COND_TEST_DEFAULT_ITERATIONS;
+	unsigned long regBase;
+	int opt, fail = 0;
+
+	while ((opt = getopt(argc, argv, "mn:r:i:")) != -1) {
+		switch (opt) {
+		case 'm':
+			gUseModel = 1;
+			break;
+		case 'n':
+			condBytes = (size_t)strtod(optarg, NULL);
+			break;
+		case 'r':
+			reqBits = (size_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			iterations = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			condUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((condBytes < COND_TEST_TRNG_CHUNK) || (reqBits == 0) || (iterations == 0)) {
+		condUsage(argv[0]);
+		return 1;
+	}
+
+	fail |= condTestSha();
+	fail |= condTestKats();
+
+	regBase = tztrngTest_target(gUseModel, NULL, &gCondHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	fail |= condTestApi(regBase);
+
+	printf("# tztrng_cond target=%s entropy_rate=%u\n", gUseModel ? "model" : "hw",
+	       (unsigned int)CC_CONFIG_TRNG_COND_ENTROPY_RATE);
+	printf("func,data_bits_per_block,out_bits_per_block,cond_data_bytes_per_sec,raw_bytes_per_sec,full_entropy_bytes_per_sec\n");
+	if (!fail)
+		fail |= condBench(regBase, condBytes, reqBits, iterations);
+
+	CC_TrngSetMmioOps(NULL);
+	tztrngTest_targetRelease(regBase);
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
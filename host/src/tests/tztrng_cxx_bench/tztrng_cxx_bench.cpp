@@ -0,0 +1,290 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <unistd.h>
+
+#include "tztrng.hpp"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+/*
+ * Benchmark of the C++ front end (library built with CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * Two workloads, std::uniform_int_distribution draws of a die and one
+ * std::shuffle of a vector, run on the hand-written adapter that calls
+ * CC_TrngGetSource() once per 32-bit draw, and on tztrng::Generator with
+ * blocks of 64 to 4096 bytes. One CSV row per adapter and workload:
+ * adapter,block_bytes,workload,draws,collections,draws_per_sec,ns_per_draw
+ * draws counts the generator calls, collections the TRNG collections (MMIO
+ * request hook). The results are checked (die faces in range, shuffle is a
+ * permutation), and on the model a failing TRNG must throw tztrng::Error.
+ */
+
+#define CXXB_DEFAULT_DRAWS 		1000
+#define CXXB_DEFAULT_SHUFFLE 		1000
+#define CXXB_DIE_FACES 			6
+
+static int gUseModel;
+static uint64_t gCollections;
+
+static void cxxbRequest(void *ctx, size_t reqBits)
+{
+	(void)ctx;
+	(void)reqBits;
+	gCollections++;
+}
+
+static const TztrngTestHooks_t gCxxbHooks = {
+	NULL,
+	cxxbRequest,
+	NULL,
+	NULL,
+	NULL,
+};
+
+/* The pattern this header replaces: one collection, with its start-up test, per draw */
+class PerCallGenerator {
+public:
+	using result_type = uint32_t;
+
+	explicit PerCallGenerator(unsigned long regBase) : mRegBase(regBase) {}
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return UINT32_MAX; }
+
+	result_type operator()()
+	{
+		result_type value;
+		size_t outLen;
+		uint32_t err;
+
+		err = CC_TrngGetSource(mRegBase, reinterpret_cast<uint8_t *>(&value), &outLen, 32);
+		if (err != 0)
+			throw tztrng::Error(err, "CC_TrngGetSource");
+		return value;
+	}
+
+private:
+	unsigned long mRegBase;
+};
+
+/* counts the calls of the standard algorithms into the generator */
+template <class G>
+class CountingGenerator {
+public:
+	using result_type = typename G::result_type;
+
+	explicit CountingGenerator(G &gen) : mGen(gen) {}
+
+	static constexpr result_type min() { return G::min(); }
+	static constexpr result_type max() { return G::max(); }
+
+	result_type operator()()
+	{
+		mCalls++;
+		return mGen();
+	}
+
+	uint64_t calls() const { return mCalls; }
+
+private:
+	G &mGen;
+	uint64_t mCalls = 0;
+};
+
+static void cxxbRow(const char *adapter, size_t blockBytes, const char *workload, uint64_t draws,
+		    uint64_t collections, std::chrono::nanoseconds elapsed)
+{
+	double ns = (double)elapsed.count();
+
+	printf("%s,%zu,%s,%llu,%llu,%.0f,%.1f\n", adapter, blockBytes, workload,
+	       (unsigned long long)draws, (unsigned long long)collections,
+	       (ns > 0) ? (double)draws * 1e9 / ns : 0.0, draws ? ns / (double)draws : 0.0);
+	fflush(stdout);
+}
+
+/* the two workloads on 'gen'; 0 if the results are sound */
+template <class G>
+static int cxxbRun(G &gen, const char *adapter, size_t blockBytes, uint32_t draws, uint32_t shuffleLen)
+{
+	std::uniform_int_distribution<int> die(1, CXXB_DIE_FACES);
+	std::vector<uint32_t> deck(shuffleLen);
+	std::chrono::steady_clock::time_point t0;
+	uint64_t c0;
+	uint32_t i;
+	int fail = 0, face;
+
+	try {
+		CountingGenerator<G> dieGen(gen);
+
+		c0 = gCollections;
+		t0 = std::chrono::steady_clock::now();
+		for (i = 0; i < draws; i++) {
+			face = die(dieGen);
+			if ((face < 1) || (face > CXXB_DIE_FACES))
+				fail = 1;
+		}
+		cxxbRow(adapter, blockBytes, "uniform_int", dieGen.calls(), gCollections - c0,
+			std::chrono::steady_clock::now() - t0);
+
+		CountingGenerator<G> shuffleGen(gen);
+
+		std::iota(deck.begin(), deck.end(), 0);
+		c0 = gCollections;
+		t0 = std::chrono::steady_clock::now();
+		std::shuffle(deck.begin(), deck.end(), shuffleGen);
+		cxxbRow(adapter, blockBytes, "shuffle", shuffleGen.calls(), gCollections - c0,
+			std::chrono::steady_clock::now() - t0);
+
+		std::sort(deck.begin(), deck.end());
+		for (i = 0; i < shuffleLen; i++)
+			fail |= (deck[i] != i);
+	} catch (const tztrng::Error &e) {
+		TZTRNG_PRINTF("%s: %s\n", adapter, e.what());
+		fail = 1;
+	}
+
+	if (fail)
+		TZTRNG_PRINTF("%s %zu: wrong results\n", adapter, blockBytes);
+	return fail;
+}
+
+template <size_t BlockBytes>
+static int cxxbRunBlock(tztrng::Session &session, uint32_t draws, uint32_t shuffleLen)
+{
+	tztrng::Generator<tztrng::Session, uint32_t, BlockBytes> gen(session);
+
+	return cxxbRun(gen, "generator", BlockBytes, draws, shuffleLen);
+}
+
+static int cxxbCheck(int cond, const char *what)
+{
+	if (!cond)
+		TZTRNG_PRINTF("check failed: %s\n", what);
+	return cond ? 0 : 1;
+}
+
+/* span fills, and (model) the errors of a failing TRNG */
+static int cxxbApiChecks(tztrng::Session &session)
+{
+	std::array<uint32_t, 16> words{};
+	std::vector<std::byte> bytes(100);
+	uint32_t i, code = 0;
+	int fail = 0, thrown = 0;
+
+	session.fill(std::span(words));
+	session.fill(std::span(bytes));
+	session.fill(std::span<std::byte>());
+	fail |= cxxbCheck(std::any_of(words.begin(), words.end(), [](uint32_t w) { return w != 0; }),
+			  "span fill of words");
+	fail |= cxxbCheck(std::any_of(bytes.begin(), bytes.end(), [](std::byte b) { return b != std::byte{0}; }),
+			  "span fill of bytes");
+
+	if (!gUseModel)
+		return fail;
+
+	for (i = 0; i < CC_TRNG_NUM_OF_ROSCS; i++)
+		tztrngModel_setFault(i, TZTRNG_MODEL_FAULT_STUCK_0, 0);
+	try {
+		tztrng::Generator<tztrng::Session, uint64_t, 64> gen(session);
+
+		(void)gen();
+	} catch (const tztrng::Error &e) {
+		thrown = 1;
+		code = e.code();
+	}
+	fail |= cxxbCheck(thrown && (code != 0), "a failing TRNG throws tztrng::Error with its code");
+	for (i = 0; i < CC_TRNG_NUM_OF_ROSCS; i++)
+		tztrngModel_setFault(i, TZTRNG_MODEL_FAULT_NONE, 0);
+
+	return fail;
+}
+
+static void cxxbUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-m] [-n draws] [-k shuffleLen]\n", prog);
+	TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t draws = CXXB_DEFAULT_DRAWS, shuffleLen = CXXB_DEFAULT_SHUFFLE;
+	unsigned long regBase;
+	int opt, fail = 0;
+
+	while ((opt = getopt(argc, argv, "mn:k:")) != -1) {
+		switch (opt) {
+		case 'm':
+			gUseModel = 1;
+			break;
+		case 'n':
+			draws = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			shuffleLen = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			cxxbUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((draws == 0) || (shuffleLen < 2)) {
+		cxxbUsage(argv[0]);
+		return 1;
+	}
+
+	regBase = tztrngTest_target(gUseModel, NULL, &gCxxbHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	{
+		tztrng::Session session(regBase);
+
+		try {
+			fail |= cxxbApiChecks(session);
+		} catch (const tztrng::Error &e) {
+			TZTRNG_PRINTF("%s\n", e.what());
+			fail = 1;
+		}
+
+		printf("# tztrng_cxx_bench target=%s draws=%u shuffle=%u\n", gUseModel ? "model" : "hw",
+		       (unsigned int)draws, (unsigned int)shuffleLen);
+		printf("adapter,block_bytes,workload,draws,collections,draws_per_sec,ns_per_draw\n");
+
+		PerCallGenerator perCall(regBase);
+
+		fail |= cxxbRun(perCall, "per_call", sizeof(uint32_t), draws, shuffleLen);
+		fail |= cxxbRunBlock<64>(session, draws, shuffleLen);
+		fail |= cxxbRunBlock<256>(session, draws, shuffleLen);
+		fail |= cxxbRunBlock<1024>(session, draws, shuffleLen);
+		fail |= cxxbRunBlock<4096>(session, draws, shuffleLen);
+	}
+
+	CC_TrngSetMmioOps(NULL);
+	tztrngTest_targetRelease(regBase);
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
@@ -0,0 +1,428 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tztrng_defs.h"
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+/*
+ * CTR_DRBG test and throughput tool (library built with CC_CONFIG_TRNG_DRBG = 1
+ * and CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * 1. AES-256 known answer (FIPS 197 C.3).
+ * 2. Vectors generated with the OpenSSL 3 CTR-DRBG (AES-256, derivation
+ *    function, 64 bytes from the second generate call) run through the
+ *    LLF_DRBG_* mechanism with the entropy input taken from the vector. They
+ *    are not from the NIST validation program: they check interoperability.
+ * 3. CC_DrbgSelfTest().
+ * 4. The CC_Drbg* API on the TRNG: argument checks, TRNG requests made by
+ *    instantiate, reseed and prediction resistance.
+ * 5. Generate throughput per request size, one CSV row per size to stdout:
+ *    req_bytes,prediction_resistance,calls,bytes_per_sec,trng_requests
+ *
+ * The TRNG is mapped through /dev/mem, or the RNG register model (-m) is used
+ * on any Linux host.
+ */
+
+#define DRBG_TEST_DEFAULT_BYTES 		(64UL << 20)
+#define DRBG_TEST_PR_BYTES 			(256UL << 10)
+#define DRBG_TEST_MAX_VECTOR_BYTES 		64
+#define DRBG_TEST_NS_PER_SEC 			1000000000ULL
+
+typedef enum {
+	DRBG_OPENSSL_NO_RESEED,		/* instantiate, generate, generate */
+	DRBG_OPENSSL_RESEED,		/* instantiate, reseed, generate, generate */
+	DRBG_OPENSSL_PR,		/* instantiate, (reseed, generate) x 2 */
+} DrbgOpensslKind_t;
+
+/* hex strings, empty when not used */
+typedef struct {
+	DrbgOpensslKind_t kind;
+	const char *entropy;
+	const char *nonce;
+	const char *pers;
+	const char *entropyReseed;	/* EntropyInputReseed, or EntropyInputPR for the first generate */
+	const char *addReseed;		/* AdditionalInputReseed */
+	const char *entropyPr2;		/* EntropyInputPR for the second generate */
+	const char *add1;
+	const char *add2;
+	const char *returned;
+} DrbgOpensslVector_t;
+
+static const DrbgOpensslVector_t drbgOpensslVectors[] = {
+	{ DRBG_OPENSSL_NO_RESEED,
+	  "c7831a77db72112ee95a76aa3a98275e68486c71c0b2707191f6b2034ac77b1f",
+	  "8f876a0b288d163226c2a6e19a6307f3",
+	  "",
+	  "",
+	  "",
+	  "",
+	  "",
+	  "",
+	  "f92017ad8d8e1e815e04bebc33926946c1b548926eeacf7d6b01d616609eb0fa"
+	  "9f6d114247abaa8d3bd280a85cd73a1b9a7f0fe37fac77bee9d904feeea3b4ca" },
+	{ DRBG_OPENSSL_NO_RESEED,
+	  "cce50af1da197b7b4d821b93dd85b0cfb6dd964963345230c0dde047c805be51",
+	  "80aee119774e1bb65315de372b2e61a7",
+	  "d43d00f4b8703cd25c814ea16b97be6d503d8cc95e5e6b436a12e2f5679cf37b",
+	  "",
+	  "",
+	  "",
+	  "a38e88a852970890cd7b372a3a9a236a4f50526b6aee342d02ebb831621a4462",
+	  "aed5852857c830b97c7bf63b4373f9be19ddc434949bfdd82cb48a366fd339bc",
+	  "a49a7f7b6750a89e0238db1e64c6341e25b3948547bb841325751f9894066b47"
+	  "adde396976b2514a429e72a4866269e0c736dc744622d80a889d096a79d923de" },
+	{ DRBG_OPENSSL_RESEED,
+	  "5c90764f533274e0a82c81e06e241c3b9e3c6276bf036f173471a67ea8ec70e9",
+	  "8dc9e0c6e6095e3957fb102a87294a22",
+	  "",
+	  "927472c019872d786f601822810712b7c2a0f364271cbe9dfd099ec68ed93c6c",
+	  "",
+	  "",
+	  "",
+	  "",
+	  "a495ee7618c93b350ef640455b3c736d49a1a85aef1987f25987db54a15b24ee"
+	  "5974c9315270129ec619a05d405e05bac489e6424bdae87609421b3db7afba80" },
+	{ DRBG_OPENSSL_RESEED,
+	  "adccec06c757f824aba7761a2d3033c236f123979b208808083b0b12298c8e2c",
+	  "aecc1a7c37480fa723c60318908ecbda",
+	  "6a8990c9637cb4980477590f0ad2a35e0cbf054190c11672a9a71dd56d12320f",
+	  "670063e9bd1a7f91da9a95f1b0f0eed93e055d6f061a299f7f11b45519ab65c5",
+	  "835ac83ed0bb0945f2f6b26a2dba8bb0463f65cf699ce06b5ca285d06ada0868",
+	  "",
+	  "0bc83d0184e722433f83b2ee80940c1c0dcb5b1cf5255f406de1492a39adb729",
+	  "0aca151d6cb64ab77f10a8fe70261883529d81a612abb718e22b0678c67c758a",
+	  "702257aff76bbb135c20f33048d9243d6b3b7edfe89b5341e3a3fa9b6bde3a9d"
+	  "b8eb2b2a941aff270bf822eaabdd56e84a2cd04b2d2d6b5088f1c9588c4b93d6" },
+	{ DRBG_OPENSSL_PR,
+	  "143948cc6cfe532167cb4173fa6b3e15910c8478ac82d0a2e71b040f1afa6660",
+	  "4c18da6498f509a9e1301728981d9b0a",
+	  "",
+	  "1964a59cad8ff81ae023cf8f1c0047f4fa6ec354f1fa032032fdca881a52bcff",
+	  "",
+	  "2550a83398aaaddc9b18f26f170bd7877ae0b75e2815e3ca72e58068b9b89007",
+	  "",
+	  "",
+	  "196d6dead349f3a737a298177eabf135b85de9807795224583a039f9c3f6391f"
+	  "ebf205cb2b4ab65b09712100584befffd8a85b005b5f45a2fa38b5ad710200ef" },
+	{ DRBG_OPENSSL_PR,
+	  "cd74e483f7f912e4e1d7d383e1829c7e6dab49a9aee29fd244bc1bad401d843f",
+	  "0b9f4a93a6a896dc63d3fd5ea20bf965",
+	  "92fd3c8b0ac6de8d80ff612bcae289bafd418616040616b2fe20d0688b202911",
+	  "37c31ea3f61f1bbe4557781b7f5902a76cd9e00fe035565f604f4be8ac235020",
+	  "",
+	  "958a49488eaad7a6a42e16a842fb8e06f74841c440dc7c3f53077820005aba49",
+	  "37245112b60051d1f89c8bbdbbd439c6e27ce16ca8dfd6ddfd14ca433e06f7a2",
+	  "9063c9add6f40a493214466edda27b841f8a2dfccbb686bbebc207d3509e1c2d",
+	  "0d1c1ba8e14fb557233e0c110bd3b28187f83f425ae6b7d142c6116984095a05"
+	  "9737f0f68a86c2b1a9177740dba4e4d53c31e68ca7042481e20005d61ffa9b9e" },
+};
+#define DRBG_OPENSSL_NUM_VECTORS (sizeof(drbgOpensslVectors) / sizeof(drbgOpensslVectors[0]))
+
+static const size_t drbgReqSizes[] = { 16, 64, 256, 1024, 4096, 16384, 65536 };
+#define DRBG_NUM_SIZES (sizeof(drbgReqSizes) / sizeof(drbgReqSizes[0]))
+
+static int gUseModel;
+static uint32_t gTrngRequests;
+
+static void drbgRequest(void *ctx, size_t reqBits)
+{
+	(void)ctx;
+	(void)reqBits;
+	gTrngRequests++;
+}
+
+static const TztrngTestHooks_t gDrbgHooks = {
+	NULL,
+	drbgRequest,
+	NULL,
+	NULL,
+	NULL,
+};
+
+static uint64_t drbgNowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * DRBG_TEST_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static size_t drbgHex(const char *hex, uint8_t *out)
+{
+	size_t len = strlen(hex) / 2, i;
+	unsigned int byte;
+
+	for (i = 0; i < len; i++) {
+		sscanf(hex + 2 * i, "%2x", &byte);
+		out[i] = (uint8_t)byte;
+	}
+	return len;
+}
+
+static int drbgTestAes(void)
+{
+	static const uint8_t key[32] = {
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+		0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+	};
+	static const uint8_t pt[16] = {
+		0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+	};
+	static const uint8_t ct[16] = {
+		0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf, 0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89,
+	};
+	uint32_t roundKeys[LLF_AES256_ROUND_KEY_WORDS];
+	uint8_t out[16];
+
+	LLF_AES_SetKey256(roundKeys, key);
+	LLF_AES_Encrypt(roundKeys, pt, out);
+	if (memcmp(out, ct, sizeof(ct)) != 0) {
+		TZTRNG_PRINTF("AES-256 FIPS 197 C.3: FAILED\n");
+		return 1;
+	}
+	TZTRNG_PRINTF("AES-256 FIPS 197 C.3: passed\n");
+	return 0;
+}
+
+static int drbgTestOpenssl(void)
+{
+	uint8_t ent[DRBG_TEST_MAX_VECTOR_BYTES], nonce[DRBG_TEST_MAX_VECTOR_BYTES], pers[DRBG_TEST_MAX_VECTOR_BYTES];
+	uint8_t entR[DRBG_TEST_MAX_VECTOR_BYTES], addR[DRBG_TEST_MAX_VECTOR_BYTES], entPr2[DRBG_TEST_MAX_VECTOR_BYTES];
+	uint8_t add1[DRBG_TEST_MAX_VECTOR_BYTES], add2[DRBG_TEST_MAX_VECTOR_BYTES];
+	uint8_t expected[DRBG_TEST_MAX_VECTOR_BYTES], out[DRBG_TEST_MAX_VECTOR_BYTES];
+	size_t entLen, nonceLen, persLen, entRLen, addRLen, entPr2Len, add1Len, add2Len, outLen;
+	CCDrbgState_t state;
+	uint32_t i, failed = 0;
+
+	for (i = 0; i < DRBG_OPENSSL_NUM_VECTORS; i++) {
+		const DrbgOpensslVector_t *v = &drbgOpensslVectors[i];
+
+		entLen = drbgHex(v->entropy, ent);
+		nonceLen = drbgHex(v->nonce, nonce);
+		persLen = drbgHex(v->pers, pers);
+		entRLen = drbgHex(v->entropyReseed, entR);
+		addRLen = drbgHex(v->addReseed, addR);
+		entPr2Len = drbgHex(v->entropyPr2, entPr2);
+		add1Len = drbgHex(v->add1, add1);
+		add2Len = drbgHex(v->add2, add2);
+		outLen = drbgHex(v->returned, expected);
+
+		LLF_DRBG_Instantiate(&state, ent, entLen, nonce, nonceLen, pers, persLen);
+		switch (v->kind) {
+		case DRBG_OPENSSL_RESEED:
+			LLF_DRBG_Reseed(&state, entR, entRLen, addR, addRLen);
+			/* fall through */
+		case DRBG_OPENSSL_NO_RESEED:
+			LLF_DRBG_Generate(&state, out, outLen, add1, add1Len);
+			LLF_DRBG_Generate(&state, out, outLen, add2, add2Len);
+			break;
+		case DRBG_OPENSSL_PR:
+			/* prediction resistance: the additional input goes into the reseed */
+			LLF_DRBG_Reseed(&state, entR, entRLen, add1, add1Len);
+			LLF_DRBG_Generate(&state, out, outLen, NULL, 0);
+			LLF_DRBG_Reseed(&state, entPr2, entPr2Len, add2, add2Len);
+			LLF_DRBG_Generate(&state, out, outLen, NULL, 0);
+			break;
+		default:
+			break;
+		}
+		CC_DrbgUninstantiate(&state);
+
+		if (memcmp(out, expected, outLen) != 0) {
+			TZTRNG_PRINTF("OpenSSL vector %u: FAILED\n", (unsigned int)i);
+			failed++;
+		}
+	}
+
+	TZTRNG_PRINTF("OpenSSL vectors: %u/%u passed\n",
+		      (unsigned int)(DRBG_OPENSSL_NUM_VECTORS - failed), (unsigned int)DRBG_OPENSSL_NUM_VECTORS);
+	return (failed != 0);
+}
+
+#define DRBG_CHECK(cond, what) 						\
+	do { 								\
+		if (!(cond)) { 						\
+			TZTRNG_PRINTF("API: %s: FAILED\n", (what)); 	\
+			fail = 1; 					\
+		} 							\
+	} while (0)
+
+static int drbgTestApi(unsigned long regBase)
+{
+	CCDrbgState_t state, other;
+	uint8_t out[64], out2[64];
+	static const uint8_t pers[] = "tztrng_drbg";
+	uint32_t requests;
+	int fail = 0;
+
+	memset(&state, 0, sizeof(state));
+	DRBG_CHECK(CC_DrbgGenerate(&state, out, sizeof(out), NULL, 0) == CC_RND_DRBG_NOT_INSTANTIATED_ERROR,
+		   "generate before instantiate");
+	DRBG_CHECK(CC_DrbgInstantiate(NULL, regBase, NULL, 0, 0) == LLF_RND_TRNG_ILLEGAL_PTR_ERROR,
+		   "NULL state");
+
+	/* entropy input and nonce in a single TRNG request */
+	requests = gTrngRequests;
+	DRBG_CHECK(CC_DrbgInstantiate(&state, regBase, pers, sizeof(pers), 0) == CC_OK, "instantiate");
+	DRBG_CHECK(gTrngRequests - requests == 1, "instantiate TRNG requests");
+	DRBG_CHECK(CC_DrbgInstantiate(&other, regBase, pers, sizeof(pers), 0) == CC_OK, "instantiate second state");
+
+	requests = gTrngRequests;
+	DRBG_CHECK(CC_DrbgGenerate(&state, out, sizeof(out), NULL, 0) == CC_OK, "generate");
+	DRBG_CHECK(CC_DrbgGenerate(&other, out2, sizeof(out2), NULL, 0) == CC_OK, "generate second state");
+	DRBG_CHECK(memcmp(out, out2, sizeof(out)) != 0, "independent states");
+	DRBG_CHECK(CC_DrbgGenerate(&state, out2, sizeof(out2), pers, sizeof(pers)) == CC_OK, "generate with additional input");
+	DRBG_CHECK(memcmp(out, out2, sizeof(out)) != 0, "consecutive outputs");
+	DRBG_CHECK(CC_DrbgGenerate(&state, out, 7, NULL, 0) == CC_OK, "partial block");
+	DRBG_CHECK(gTrngRequests == requests, "no TRNG request without prediction resistance");
+	DRBG_CHECK(CC_DrbgGenerate(&state, out, CC_DRBG_MAX_REQUEST_BYTES + 1, NULL, 0) == CC_RND_DRBG_ILLEGAL_LENGTH_ERROR,
+		   "request too large");
+
+	DRBG_CHECK(CC_DrbgReseed(&state, pers, sizeof(pers)) == CC_OK, "reseed");
+	DRBG_CHECK(gTrngRequests - requests == 1, "reseed TRNG requests");
+	DRBG_CHECK(state.reseedCounter == 1, "reseed counter");
+
+	CC_DrbgUninstantiate(&state);
+	CC_DrbgUninstantiate(&other);
+	DRBG_CHECK(CC_DrbgGenerate(&state, out, sizeof(out), NULL, 0) == CC_RND_DRBG_NOT_INSTANTIATED_ERROR,
+		   "generate after uninstantiate");
+
+	/* prediction resistance: one TRNG request per generate call */
+	DRBG_CHECK(CC_DrbgInstantiate(&state, regBase, NULL, 0, 1) == CC_OK, "instantiate with prediction resistance");
+	requests = gTrngRequests;
+	DRBG_CHECK(CC_DrbgGenerate(&state, out, sizeof(out), NULL, 0) == CC_OK, "generate with prediction resistance");
+	DRBG_CHECK(CC_DrbgGenerate(&state, out, sizeof(out), pers, sizeof(pers)) == CC_OK,
+		   "generate with prediction resistance and additional input");
+	DRBG_CHECK(gTrngRequests - requests == 2, "prediction resistance TRNG requests");
+	CC_DrbgUninstantiate(&state);
+
+	TZTRNG_PRINTF("API: %s\n", fail ? "FAILED" : "passed");
+	return fail;
+}
+
+static int drbgBench(unsigned long regBase, size_t totalBytes, uint32_t predictionResistance)
+{
+	CCDrbgState_t state;
+	uint8_t *buf;
+	uint64_t t0, t1;
+	uint32_t i, calls, c, requests;
+	size_t reqBytes;
+	uint32_t err = CC_OK;
+
+	buf = malloc(CC_DRBG_MAX_REQUEST_BYTES);
+	if (buf == NULL) {
+		TZTRNG_PRINTF("failed to allocate buffer\n");
+		return 1;
+	}
+
+	for (i = 0; (i < DRBG_NUM_SIZES) && (err == CC_OK); i++) {
+		reqBytes = drbgReqSizes[i];
+		calls = (uint32_t)(totalBytes / reqBytes);
+		if (calls == 0)
+			calls = 1;
+
+		err = CC_DrbgInstantiate(&state, regBase, NULL, 0, predictionResistance);
+		if (err != CC_OK)
+			break;
+
+		requests = gTrngRequests;
+		t0 = drbgNowNs();
+		for (c = 0; (c < calls) && (err == CC_OK); c++)
+			err = CC_DrbgGenerate(&state, buf, reqBytes, NULL, 0);
+		t1 = drbgNowNs();
+		CC_DrbgUninstantiate(&state);
+
+		printf("%zu,%u,%u,%.0f,%u\n", reqBytes, (unsigned int)predictionResistance, (unsigned int)calls,
+		       (double)reqBytes * calls * DRBG_TEST_NS_PER_SEC / (double)(t1 - t0 + 1),
+		       (unsigned int)(gTrngRequests - requests));
+		fflush(stdout);
+	}
+
+	free(buf);
+	if (err != CC_OK) {
+		TZTRNG_PRINTF("benchmark: error(0x%X)\n", (unsigned int)err);
+		return 1;
+	}
+	return 0;
+}
+
+static void drbgUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-m] [-n bytesPerSize] [-p bytesPerSizePR]\n", prog);
+	TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+	TZTRNG_PRINTF("  -n  bytes generated per request size (default %lu)\n", DRBG_TEST_DEFAULT_BYTES);
+	TZTRNG_PRINTF("  -p  same with prediction resistance, 0 to skip (default %lu)\n", DRBG_TEST_PR_BYTES);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t totalBytes = DRBG_TEST_DEFAULT_BYTES, prBytes = DRBG_TEST_PR_BYTES;
+	unsigned long regBase;
+	uint32_t err;
+	int opt, fail = 0;
+
+	while ((opt = getopt(argc, argv, "mn:p:")) != -1) {
+		switch (opt) {
+		case 'm':
+			gUseModel = 1;
+			break;
+		case 'n':
+			totalBytes = (size_t)strtod(optarg, NULL);
+			break;
+		case 'p':
+			prBytes = (size_t)strtod(optarg, NULL);
+			break;
+		default:
+			drbgUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	fail |= drbgTestAes();
+	fail |= drbgTestOpenssl();
+	err = CC_DrbgSelfTest();
+	TZTRNG_PRINTF("CC_DrbgSelfTest: %s\n", (err == CC_OK) ? "passed" : "FAILED");
+	fail |= (err != CC_OK);
+
+	regBase = tztrngTest_target(gUseModel, NULL, &gDrbgHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	fail |= drbgTestApi(regBase);
+
+	printf("# tztrng_drbg target=%s\n", gUseModel ? "model" : "hw");
+	printf("req_bytes,prediction_resistance,calls,bytes_per_sec,trng_requests\n");
+	if (!fail && (totalBytes > 0))
+		fail |= drbgBench(regBase, totalBytes, 0);
+	if (!fail && (prBytes > 0))
+		fail |= drbgBench(regBase, prBytes, 1);
+
+	CC_TrngSetMmioOps(NULL);
+	tztrngTest_targetRelease(regBase);
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
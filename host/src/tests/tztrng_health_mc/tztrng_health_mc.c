@@ -0,0 +1,394 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tztrng_defs.h"
+#include "tztrng_test_pal.h"
+
+/*
+ * Monte Carlo estimator of the continuous health tests of the TRNG90B engine.
+ *
+ * Synthetic noise with a given bias and correlation is cut into buffers of the
+ * size the driver tests (CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES by default), and each
+ * buffer goes through LLF_RND_RepetitionCounterTest() and
+ * LLF_RND_AdaptiveProportionTest() with the configured cutoffs. The tests keep no
+ * state between buffers, so the alarms are Bernoulli events per buffer: the tool
+ * reports the alarm rate per buffer with a 95% confidence interval and the
+ * expected number of noise bits before the first alarm.
+ *
+ * At or above the entropy the cutoffs were derived for (0.5 bit per sample), the
+ * rate is the false alarm rate; below it, it measures how quickly a degraded
+ * source is detected.
+ *
+ * Noise: bit = previous bit with probability rho, otherwise 1 with probability
+ * p1. Every thread draws from its own Philox4x32-10 stream, keyed by the seed and
+ * indexed by (sweep point, thread, block), so runs are reproducible for a given
+ * seed and thread count.
+ *
+ * One CSV row per sweep point is written to stdout.
+ */
+
+#define MC_DEFAULT_BUFFERS 			1000000ULL
+#define MC_DEFAULT_SEED 			0x5EED5EED5EED5EEDULL
+#define MC_DEFAULT_H_LIST 			"1,0.75,0.6,0.5,0.45,0.4,0.35,0.3,0.25"
+#define MC_MAX_POINTS 				64
+#define MC_MAX_THREADS 				256
+#define MC_MAX_BUF_BYTES 			CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES_STARTUP
+#define MC_Z_95 				1.959964
+#define MC_TWO_POW_32 				4294967296.0
+
+/* llf_rnd_cont.c */
+extern CCError_t LLF_RND_RepetitionCounterTest(uint32_t* pData, uint32_t sizeInBytes, uint32_t C);
+extern CCError_t LLF_RND_AdaptiveProportionTest(uint32_t* pData, uint32_t sizeInBytes, uint32_t C, uint32_t W);
+
+/* Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3") */
+#define PHILOX_M0 				0xD2511F53UL
+#define PHILOX_M1 				0xCD9E8D57UL
+#define PHILOX_W0 				0x9E3779B9UL
+#define PHILOX_W1 				0xBB67AE85UL
+#define PHILOX_ROUNDS 				10
+
+typedef struct {
+	uint32_t ctr[4];
+	uint32_t key[2];
+	uint32_t out[4];
+	uint32_t idx;
+} McPhilox_t;
+
+typedef struct {
+	double p1;			/* probability of a 1 bit */
+	double rho;			/* probability that a bit repeats the previous one */
+	uint32_t p1T;			/* thresholds on 32-bit uniforms */
+	uint32_t rhoT;
+} McPoint_t;
+
+typedef struct {
+	pthread_t thread;
+	uint32_t id;
+	uint32_t pointIdx;
+	const McPoint_t *pPoint;
+	uint64_t buffers;
+	uint64_t rctFail;
+	uint64_t aptFail;
+	uint64_t fail;			/* buffers failing either test */
+} McThread_t;
+
+static uint64_t gSeed = MC_DEFAULT_SEED;
+static uint32_t gBufBytes = CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES;
+static uint32_t gRctCutoff = CC_CONFIG_TRNG90B_REPETITION_COUNTER_CUTOFF;
+static uint32_t gAptCutoff = CC_CONFIG_TRNG90B_ADAPTIVE_PROPORTION_CUTOFF;
+static uint32_t gAptWindow = CC_CONFIG_TRNG90B_ADAPTIVE_PROPORTION_WINDOW_SIZE;
+
+static void mcPhiloxInit(McPhilox_t *pRng, uint32_t pointIdx, uint32_t threadId)
+{
+	pRng->ctr[0] = 0;
+	pRng->ctr[1] = 0;
+	pRng->ctr[2] = pointIdx;
+	pRng->ctr[3] = threadId;
+	pRng->key[0] = (uint32_t)gSeed;
+	pRng->key[1] = (uint32_t)(gSeed >> 32);
+	pRng->idx = 4;
+}
+
+static void mcPhiloxBlock(McPhilox_t *pRng)
+{
+	uint32_t c0 = pRng->ctr[0], c1 = pRng->ctr[1], c2 = pRng->ctr[2], c3 = pRng->ctr[3];
+	uint32_t k0 = pRng->key[0], k1 = pRng->key[1];
+	uint64_t p0, p1;
+	uint32_t r;
+
+	for (r = 0; r < PHILOX_ROUNDS; r++) {
+		p0 = (uint64_t)PHILOX_M0 * c0;
+		p1 = (uint64_t)PHILOX_M1 * c2;
+		c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+		c1 = (uint32_t)p1;
+		c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+		c3 = (uint32_t)p0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	pRng->out[0] = c0;
+	pRng->out[1] = c1;
+	pRng->out[2] = c2;
+	pRng->out[3] = c3;
+	pRng->idx = 0;
+
+	/* 64-bit block counter */
+	if (++pRng->ctr[0] == 0)
+		pRng->ctr[1]++;
+}
+
+static inline uint32_t mcPhiloxNext(McPhilox_t *pRng)
+{
+	if (pRng->idx == 4)
+		mcPhiloxBlock(pRng);
+	return pRng->out[pRng->idx++];
+}
+
+static void mcFill(McPhilox_t *pRng, const McPoint_t *pPoint, uint32_t *pBuf, uint32_t words,
+		   uint32_t *pPrev)
+{
+	uint32_t w, i, bit, word, prev = *pPrev;
+
+	/* unbiased, uncorrelated: whole words */
+	if ((pPoint->p1T == 0x80000000UL) && (pPoint->rhoT == 0)) {
+		for (w = 0; w < words; w++)
+			pBuf[w] = mcPhiloxNext(pRng);
+		*pPrev = pBuf[words - 1] >> 31;
+		return;
+	}
+
+	for (w = 0; w < words; w++) {
+		word = 0;
+		for (i = 0; i < 32; i++) {
+			if (pPoint->rhoT && (mcPhiloxNext(pRng) < pPoint->rhoT))
+				bit = prev;
+			else
+				bit = (mcPhiloxNext(pRng) < pPoint->p1T) ? 1 : 0;
+			word |= bit << i;
+			prev = bit;
+		}
+		pBuf[w] = word;
+	}
+	*pPrev = prev;
+}
+
+static void *mcThread(void *arg)
+{
+	McThread_t *pThr = arg;
+	uint32_t buf[MC_MAX_BUF_BYTES / sizeof(uint32_t)];
+	uint32_t words = gBufBytes / sizeof(uint32_t);
+	uint32_t prev = 0;
+	McPhilox_t rng;
+	CCError_t rct, apt;
+	uint64_t b;
+
+	mcPhiloxInit(&rng, pThr->pointIdx, pThr->id);
+
+	for (b = 0; b < pThr->buffers; b++) {
+		/* the noise stream continues across buffers, as on the hardware */
+		mcFill(&rng, pThr->pPoint, buf, words, &prev);
+		rct = LLF_RND_RepetitionCounterTest(buf, gBufBytes, gRctCutoff);
+		apt = LLF_RND_AdaptiveProportionTest(buf, gBufBytes, gAptCutoff, gAptWindow);
+		pThr->rctFail += (rct != CC_OK);
+		pThr->aptFail += (apt != CC_OK);
+		pThr->fail += ((rct != CC_OK) || (apt != CC_OK));
+	}
+
+	return NULL;
+}
+
+/* 95% interval of a binomial proportion: Wilson score, Clopper-Pearson upper bound for k = 0 */
+static void mcInterval(uint64_t k, uint64_t n, double *pLo, double *pHi)
+{
+	double z2 = MC_Z_95 * MC_Z_95;
+	double p, d, c, w;
+
+	if (k == 0) {
+		*pLo = 0;
+		*pHi = 1 - pow(0.025, 1.0 / (double)n);
+		return;
+	}
+
+	p = (double)k / n;
+	d = 1 + z2 / n;
+	c = (p + z2 / (2.0 * n)) / d;
+	w = MC_Z_95 * sqrt(p * (1 - p) / n + z2 / (4.0 * n * n)) / d;
+	*pLo = (c - w > 0) ? c - w : 0;
+	*pHi = (c + w < 1) ? c + w : 1;
+}
+
+static double mcTimeS(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t mcThreshold(double prob)
+{
+	double t = prob * MC_TWO_POW_32;
+
+	if (t >= MC_TWO_POW_32 - 1)
+		return 0xFFFFFFFFUL;
+	if (t <= 0)
+		return 0;
+	return (uint32_t)t;
+}
+
+static int mcRunPoint(uint32_t pointIdx, const McPoint_t *pPoint, uint64_t buffers, uint32_t threads)
+{
+	McThread_t thr[MC_MAX_THREADS];
+	uint64_t rctFail = 0, aptFail = 0, fail = 0;
+	double bufBits = gBufBytes * 8.0;
+	double h, rate, lo, hi, t0, t1;
+	uint32_t i, started;
+
+	memset(thr, 0, sizeof(thr));
+	t0 = mcTimeS();
+	for (started = 0; started < threads; started++) {
+		thr[started].id = started;
+		thr[started].pointIdx = pointIdx;
+		thr[started].pPoint = pPoint;
+		thr[started].buffers = buffers / threads + ((started < buffers % threads) ? 1 : 0);
+		if (pthread_create(&thr[started].thread, NULL, mcThread, &thr[started]) != 0) {
+			TZTRNG_PRINTF("failed to start thread %u\n", (unsigned int)started);
+			break;
+		}
+	}
+	for (i = 0; i < started; i++) {
+		pthread_join(thr[i].thread, NULL);
+		rctFail += thr[i].rctFail;
+		aptFail += thr[i].aptFail;
+		fail += thr[i].fail;
+	}
+	t1 = mcTimeS();
+	if (started != threads)
+		return 1;
+
+	/* min-entropy per bit of the biased draw */
+	h = -log2((pPoint->p1 > 0.5) ? pPoint->p1 : 1 - pPoint->p1);
+	rate = (double)fail / buffers;
+	mcInterval(fail, buffers, &lo, &hi);
+
+	printf("%.4f,%.6f,%.4f,%u,%llu,%llu,%llu,%llu,%.6e,%.6e,%.6e,%.2f,", h, pPoint->p1, pPoint->rho,
+	       (unsigned int)bufBits, (unsigned long long)buffers, (unsigned long long)rctFail,
+	       (unsigned long long)aptFail, (unsigned long long)fail, rate, lo, hi, log2(hi));
+	/* expected noise bits before the first alarm; unbounded above without alarms */
+	if (fail)
+		printf("%.6e,%.6e,%.6e\n", bufBits / rate, bufBits / hi, (lo > 0) ? bufBits / lo : INFINITY);
+	else
+		printf(",%.6e,\n", bufBits / hi);
+	fflush(stdout);
+
+	TZTRNG_PRINTF("h %.3f rho %.3f: %llu buffers in %.1f s (%.0f buffers/s)\n", h, pPoint->rho,
+		      (unsigned long long)buffers, t1 - t0, buffers / (t1 - t0));
+
+	return 0;
+}
+
+static uint32_t mcParseList(const char *str, double *pVals, uint32_t max)
+{
+	char *copy = strdup(str), *tok, *save = NULL;
+	uint32_t n = 0;
+
+	if (copy == NULL)
+		return 0;
+	for (tok = strtok_r(copy, ",", &save); (tok != NULL) && (n < max); tok = strtok_r(NULL, ",", &save))
+		pVals[n++] = strtod(tok, NULL);
+	free(copy);
+
+	return n;
+}
+
+static void mcUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-H h,...|-p p1,...] [-c rho] [-n buffers] [-t threads] [-b bytes] [-s seed]\n", prog);
+	TZTRNG_PRINTF("          [-R rctCutoff] [-A aptCutoff]\n");
+	TZTRNG_PRINTF("  -H  sweep of min-entropy per bit, p1 = 2^-h (default %s)\n", MC_DEFAULT_H_LIST);
+	TZTRNG_PRINTF("  -p  sweep of the probability of a 1 bit\n");
+	TZTRNG_PRINTF("  -c  probability that a bit repeats the previous one (default 0)\n");
+	TZTRNG_PRINTF("  -n  buffers per sweep point (default %llu)\n", (unsigned long long)MC_DEFAULT_BUFFERS);
+	TZTRNG_PRINTF("  -b  buffer size in bytes, multiple of 4 up to %u (default %u)\n",
+		      (unsigned int)MC_MAX_BUF_BYTES, (unsigned int)CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES);
+}
+
+int main(int argc, char *argv[])
+{
+	McPoint_t points[MC_MAX_POINTS];
+	double vals[MC_MAX_POINTS], rho = 0;
+	const char *hList = MC_DEFAULT_H_LIST, *pList = NULL;
+	uint64_t buffers = MC_DEFAULT_BUFFERS;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t threads = (cpus > 0) ? (uint32_t)cpus : 1;
+	uint32_t n, i;
+	int opt, fail = 0;
+
+	while ((opt = getopt(argc, argv, "H:p:c:n:t:b:s:R:A:")) != -1) {
+		switch (opt) {
+		case 'H':
+			hList = optarg;
+			break;
+		case 'p':
+			pList = optarg;
+			break;
+		case 'c':
+			rho = strtod(optarg, NULL);
+			break;
+		case 'n':
+			buffers = (uint64_t)strtod(optarg, NULL);
+			break;
+		case 't':
+			threads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			gBufBytes = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			gSeed = strtoull(optarg, NULL, 0);
+			break;
+		case 'R':
+			gRctCutoff = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'A':
+			gAptCutoff = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			mcUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (threads > MC_MAX_THREADS)
+		threads = MC_MAX_THREADS;
+	if ((buffers == 0) || (threads == 0) || (gBufBytes == 0) || (gBufBytes > MC_MAX_BUF_BYTES) ||
+	    (gBufBytes % sizeof(uint32_t)) || (rho < 0) || (rho >= 1)) {
+		mcUsage(argv[0]);
+		return 1;
+	}
+
+	n = mcParseList((pList != NULL) ? pList : hList, vals, MC_MAX_POINTS);
+	for (i = 0; i < n; i++) {
+		points[i].p1 = (pList != NULL) ? vals[i] : pow(2.0, -vals[i]);
+		points[i].rho = rho;
+		points[i].p1T = mcThreshold(points[i].p1);
+		points[i].rhoT = mcThreshold(rho);
+		if ((points[i].p1 < 0) || (points[i].p1 > 1)) {
+			mcUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	printf("# tztrng_health_mc rct_cutoff=%u apt_cutoff=%u apt_window=%u seed=0x%llx threads=%u\n",
+	       (unsigned int)gRctCutoff, (unsigned int)gAptCutoff, (unsigned int)gAptWindow,
+	       (unsigned long long)gSeed, (unsigned int)threads);
+	printf("h,p1,rho,buffer_bits,buffers,rct_fail,apt_fail,fail,fail_rate,fail_lo,fail_hi,fail_hi_log2,"
+	       "latency_bits,latency_lo_bits,latency_hi_bits\n");
+
+	for (i = 0; i < n; i++)
+		fail |= mcRunPoint(i, &points[i], buffers, threads);
+
+	return fail;
+}
@@ -0,0 +1,448 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+/*
+ * Cross-world entropy mailbox test (library built with CC_CONFIG_TRNG_MAILBOX = 1
+ * and CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * Two processes stand in for the two worlds of an Armv8-M TrustZone system.
+ * The parent is the secure world: it owns the TRNG and initializes the mailbox
+ * in a shared mapping, the memory both worlds can access. The child is the
+ * non-secure world. A gateway call is a message over a socket pair that the
+ * parent serves while the child waits for the answer, two world switches.
+ * The child makes -n requests of -s to -S bytes through two transports:
+ * - direct: one gateway call per request, the secure side calls
+ *   CC_TrngGetSource() into the shared mapping,
+ * - mailbox: CC_TrngMailboxRead(), one gateway call per ring.
+ * One CSV row per transport:
+ * transport,requests,bytes,gateway_calls,world_switches,switches_per_byte,collections,total_ms
+ * gateway_calls and collections (MMIO request hook) are counted by the secure
+ * side. Every request must start with distinct bytes.
+ */
+
+#define MBX_DEFAULT_REQUESTS 		1000
+#define MBX_DEFAULT_MIN_BYTES 		8
+#define MBX_DEFAULT_MAX_BYTES 		32
+#define MBX_MAX_REQUEST_BYTES 		256
+#define MBX_RING_BYTES 			(CC_TRNG_MAILBOX_BLOCKS * CC_TRNG_MAILBOX_BLOCK_BYTES)
+#define MBX_NS_PER_SEC 			1000000000ULL
+/* answer of a gateway whose message could not be exchanged */
+#define MBX_LINK_ERROR 			0xFFFFFFFFUL
+
+typedef enum {
+	MBX_CMD_GATEWAY = 0,	/* CC_TrngMailboxGateway() */
+	MBX_CMD_DIRECT,		/* CC_TrngGetSource() of 'arg' bytes into MbxShared_t.direct */
+	MBX_CMD_RESET,		/* clear the secure side counters */
+	MBX_CMD_STATS,		/* copy the secure side counters to MbxShared_t */
+	MBX_CMD_FAULT,		/* model only: all ROSCs stuck ('arg' 1) or healthy ('arg' 0) */
+	MBX_CMD_DONE,
+} MbxCmd_t;
+
+typedef struct {
+	uint32_t cmd;
+	uint32_t arg;
+} MbxMsg_t;
+
+typedef enum {
+	MBX_TRANSPORT_DIRECT = 0,
+	MBX_TRANSPORT_MAILBOX,
+} MbxTransport_t;
+
+static const char *const gTransportNames[] = { "direct", "mailbox" };
+
+/* The memory both worlds can access */
+typedef struct {
+	CCTrngMailbox_t mbox;
+	uint8_t direct[MBX_MAX_REQUEST_BYTES];	/* output buffer of a direct call */
+	uint32_t secureCalls;			/* secure side counters, on MBX_CMD_STATS */
+	uint32_t secureCollections;
+} MbxShared_t;
+
+static int gUseModel;
+static unsigned long gRegBase;
+/* secure side */
+static uint32_t gCalls;
+static uint32_t gCollections;
+
+static uint64_t mbxNowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * MBX_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift64: request sizes only */
+static uint32_t mbxRand(uint64_t *pState)
+{
+	*pState ^= *pState << 13;
+	*pState ^= *pState >> 7;
+	*pState ^= *pState << 17;
+	return (uint32_t)*pState;
+}
+
+/* start of a TRNG collection */
+static void mbxRequest(void *ctx, size_t reqBits)
+{
+	(void)ctx;
+	(void)reqBits;
+	gCollections++;
+}
+
+static const TztrngTestHooks_t gMbxHooks = {
+	NULL,
+	mbxRequest,
+	NULL,
+	NULL,
+	NULL,
+};
+
+/* Secure world: serve the messages of the non-secure world until MBX_CMD_DONE */
+static void mbxServe(int fd, MbxShared_t *pShm)
+{
+	MbxMsg_t msg;
+	size_t outLen;
+	uint32_t ret, i;
+
+	while (read(fd, &msg, sizeof(msg)) == (ssize_t)sizeof(msg)) {
+		ret = 0;
+		switch (msg.cmd) {
+		case MBX_CMD_GATEWAY:
+			gCalls++;
+			ret = CC_TrngMailboxGateway();
+			break;
+		case MBX_CMD_DIRECT:
+			gCalls++;
+			if (msg.arg > MBX_MAX_REQUEST_BYTES)
+				ret = MBX_LINK_ERROR;
+			else
+				ret = CC_TrngGetSource(gRegBase, pShm->direct, &outLen, (size_t)msg.arg * 8);
+			break;
+		case MBX_CMD_RESET:
+			gCalls = 0;
+			gCollections = 0;
+			break;
+		case MBX_CMD_STATS:
+			pShm->secureCalls = gCalls;
+			pShm->secureCollections = gCollections;
+			break;
+		case MBX_CMD_FAULT:
+			if (!gUseModel) {
+				ret = MBX_LINK_ERROR;
+				break;
+			}
+			for (i = 0; i < CC_TRNG_NUM_OF_ROSCS; i++)
+				tztrngModel_setFault(i, msg.arg ? TZTRNG_MODEL_FAULT_STUCK_0 : TZTRNG_MODEL_FAULT_NONE, 0);
+			break;
+		case MBX_CMD_DONE:
+			break;
+		default:
+			ret = MBX_LINK_ERROR;
+			break;
+		}
+		if (write(fd, &ret, sizeof(ret)) != (ssize_t)sizeof(ret))
+			break;
+		if (msg.cmd == MBX_CMD_DONE)
+			break;
+	}
+}
+
+/* Non-secure world: one message to the secure world and its answer */
+static uint32_t mbxCall(int fd, uint32_t cmd, uint32_t arg)
+{
+	MbxMsg_t msg = { cmd, arg };
+	uint32_t ret;
+
+	if ((write(fd, &msg, sizeof(msg)) != (ssize_t)sizeof(msg)) ||
+	    (read(fd, &ret, sizeof(ret)) != (ssize_t)sizeof(ret)))
+		return MBX_LINK_ERROR;
+	return ret;
+}
+
+/* CCTrngMailboxGateway_t of the client: the IPC stub of the secure entry */
+static uint32_t mbxGateway(void *ctx)
+{
+	return mbxCall(*(int *)ctx, MBX_CMD_GATEWAY, 0);
+}
+
+static int mbxCmpU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int mbxRun(MbxTransport_t transport, int fd, MbxShared_t *pShm, uint32_t requests, uint32_t minBytes,
+		  uint32_t maxBytes)
+{
+	CCTrngMailboxClient_t cli;
+	uint8_t buf[MBX_MAX_REQUEST_BYTES];
+	uint64_t *firsts, bytes = 0, tRun, seed = 0x9E3779B97F4A7C15ULL;
+	uint32_t i, len, err, errors = 0, duplicates = 0, switches;
+
+	firsts = calloc(requests, sizeof(firsts[0]));
+	if ((firsts == NULL) || (CC_TrngMailboxAttach(&cli, &pShm->mbox, mbxGateway, &fd) != 0)) {
+		TZTRNG_PRINTF("%s: failed to prepare the run\n", gTransportNames[transport]);
+		free(firsts);
+		return 1;
+	}
+	mbxCall(fd, MBX_CMD_RESET, 0);
+
+	tRun = mbxNowNs();
+	for (i = 0; i < requests; i++) {
+		len = minBytes + mbxRand(&seed) % (maxBytes - minBytes + 1);
+		if (transport == MBX_TRANSPORT_DIRECT) {
+			err = mbxCall(fd, MBX_CMD_DIRECT, len);
+			memcpy(buf, pShm->direct, len);
+			memset(pShm->direct, 0, len);
+		} else {
+			err = CC_TrngMailboxRead(&cli, buf, len);
+		}
+		if (err != 0) {
+			TZTRNG_PRINTF("%s: request %u: error 0x%x\n", gTransportNames[transport], (unsigned int)i,
+				      (unsigned int)err);
+			errors++;
+		}
+		memcpy(&firsts[i], buf, sizeof(firsts[i]));
+		bytes += len;
+	}
+	tRun = mbxNowNs() - tRun;
+	memset(buf, 0, sizeof(buf));
+
+	mbxCall(fd, MBX_CMD_STATS, 0);
+	switches = 2 * pShm->secureCalls;
+	if ((transport == MBX_TRANSPORT_MAILBOX) && (cli.stats.gatewayCalls != pShm->secureCalls)) {
+		TZTRNG_PRINTF("%s: %u gateway calls made, %u served\n", gTransportNames[transport],
+			      (unsigned int)cli.stats.gatewayCalls, (unsigned int)pShm->secureCalls);
+		errors++;
+	}
+
+	qsort(firsts, requests, sizeof(firsts[0]), mbxCmpU64);
+	for (i = 1; i < requests; i++)
+		duplicates += (firsts[i] == firsts[i - 1]);
+
+	printf("%s,%u,%llu,%u,%u,%.5f,%u,%.1f\n", gTransportNames[transport], (unsigned int)requests,
+	       (unsigned long long)bytes, (unsigned int)pShm->secureCalls, (unsigned int)switches,
+	       bytes ? (double)switches / (double)bytes : 0.0, (unsigned int)pShm->secureCollections, tRun / 1e6);
+	fflush(stdout);
+
+	memset(firsts, 0, (size_t)requests * sizeof(firsts[0]));
+	free(firsts);
+
+	if (errors || duplicates) {
+		TZTRNG_PRINTF("%s: %u errors, %u duplicate outputs\n", gTransportNames[transport], (unsigned int)errors,
+			      (unsigned int)duplicates);
+		return 1;
+	}
+	return 0;
+}
+
+static int mbxCheck(int cond, const char *what)
+{
+	if (!cond)
+		TZTRNG_PRINTF("check failed: %s\n", what);
+	return cond ? 0 : 1;
+}
+
+static int mbxIsWiped(const uint8_t *buf, size_t size, uint8_t fill)
+{
+	size_t i;
+
+	for (i = 0; (i < size) && ((buf[i] == fill) || (buf[i] == 0)); i++)
+		;
+	return i == size;
+}
+
+/* Non-secure side checks, on the ring CC_TrngMailboxInit() filled */
+static int mbxApiChecks(int fd, MbxShared_t *pShm)
+{
+	static uint8_t buf[MBX_RING_BYTES + CC_TRNG_MAILBOX_BLOCK_BYTES];
+	CCTrngMailbox_t blank;
+	CCTrngMailbox_t *pMbox = &pShm->mbox;
+	CCTrngMailboxClient_t cli;
+	uint32_t i, head, tail, errors, err;
+	int fail = 0, ok;
+
+	memset(&blank, 0, sizeof(blank));
+	fail |= mbxCheck(CC_TrngMailboxAttach(NULL, pMbox, mbxGateway, &fd) != 0, "NULL client fails");
+	fail |= mbxCheck(CC_TrngMailboxAttach(&cli, pMbox, NULL, &fd) != 0, "NULL gateway fails");
+	fail |= mbxCheck(CC_TrngMailboxAttach(&cli, &blank, mbxGateway, &fd) == CC_TRNG_MAILBOX_ERROR,
+			 "a mailbox not initialized fails");
+	fail |= mbxCheck(CC_TrngMailboxAttach(&cli, pMbox, mbxGateway, &fd) == 0, "attach");
+	fail |= mbxCheck(CC_TrngMailboxRead(&cli, NULL, 16) != 0, "NULL output fails");
+	fail |= mbxCheck((CC_TrngMailboxRead(&cli, buf, 0) == 0) && (cli.stats.gatewayCalls == 0),
+			 "empty read, no gateway call");
+
+	for (i = 0, ok = 1; i < CC_TRNG_MAILBOX_BLOCKS; i++)
+		ok &= (CC_TrngMailboxRead(&cli, buf, CC_TRNG_MAILBOX_BLOCK_BYTES) == 0);
+	fail |= mbxCheck(ok && (cli.stats.gatewayCalls == 0) && (pMbox->gatewayCalls == 0),
+			 "the ring filled by the init is read without a gateway call");
+	fail |= mbxCheck(mbxIsWiped(pMbox->block[0], MBX_RING_BYTES, 0), "read bytes are wiped from the ring");
+	fail |= mbxCheck((CC_TrngMailboxRead(&cli, buf, 16) == 0) && (cli.stats.gatewayCalls == 1) &&
+			 (pMbox->collections == 2) && (pMbox->head - pMbox->tail == CC_TRNG_MAILBOX_BLOCKS),
+			 "one gateway call refills the whole ring with one collection");
+
+	/* the secure side must not trust the tail written by the non-secure world */
+	head = pMbox->head;
+	tail = pMbox->tail;
+	errors = pMbox->errors;
+	pMbox->tail = head + 1;
+	err = mbxGateway(&fd);
+	fail |= mbxCheck((err == CC_TRNG_MAILBOX_ERROR) && (pMbox->head == head), "a tail ahead of the head is rejected");
+	pMbox->tail = head - CC_TRNG_MAILBOX_BLOCKS - 1;
+	err = mbxGateway(&fd);
+	fail |= mbxCheck((err == CC_TRNG_MAILBOX_ERROR) && (pMbox->head == head) && (pMbox->errors == errors + 2),
+			 "a tail more than a ring behind is rejected");
+	pMbox->tail = tail;
+
+	if (gUseModel) {
+		fail |= mbxCheck(mbxCall(fd, MBX_CMD_FAULT, 1) == 0, "set the ROSC faults");
+		memset(buf, 0xA5, sizeof(buf));
+		errors = pMbox->errors;
+		err = CC_TrngMailboxRead(&cli, buf, sizeof(buf));
+		fail |= mbxCheck((err != 0) && (err == pMbox->lastError) && (pMbox->errors == errors + 1) &&
+				 (cli.stats.errors == 1) && (pMbox->head == tail + CC_TRNG_MAILBOX_BLOCKS),
+				 "a failing TRNG fails the read with its error and publishes nothing");
+		fail |= mbxCheck(mbxIsWiped(buf, sizeof(buf), 0xA5), "no TRNG output left in the buffer of a failed read");
+		fail |= mbxCheck(mbxIsWiped(pMbox->block[0], MBX_RING_BYTES, 0), "no TRNG output left in the ring");
+		fail |= mbxCheck(mbxCall(fd, MBX_CMD_FAULT, 0) == 0, "clear the ROSC faults");
+		fail |= mbxCheck(CC_TrngMailboxRead(&cli, buf, 16) == 0, "the read succeeds once the TRNG recovers");
+	}
+	memset(buf, 0, sizeof(buf));
+
+	return fail;
+}
+
+/* Non-secure world: the child process */
+static int mbxClient(int fd, MbxShared_t *pShm, uint32_t requests, uint32_t minBytes, uint32_t maxBytes)
+{
+	int fail = 0;
+
+	fail |= mbxApiChecks(fd, pShm);
+	fail |= mbxRun(MBX_TRANSPORT_DIRECT, fd, pShm, requests, minBytes, maxBytes);
+	fail |= mbxRun(MBX_TRANSPORT_MAILBOX, fd, pShm, requests, minBytes, maxBytes);
+	mbxCall(fd, MBX_CMD_DONE, 0);
+
+	return fail;
+}
+
+static void mbxUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-m] [-n requests] [-s minBytes] [-S maxBytes]\n", prog);
+	TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+	TZTRNG_PRINTF("  -s  smallest request, at least 8 (default %u)\n", (unsigned int)MBX_DEFAULT_MIN_BYTES);
+	TZTRNG_PRINTF("  -S  largest request, at most %u (default %u)\n", (unsigned int)MBX_MAX_REQUEST_BYTES,
+		      (unsigned int)MBX_DEFAULT_MAX_BYTES);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t requests = MBX_DEFAULT_REQUESTS, minBytes = MBX_DEFAULT_MIN_BYTES, maxBytes = MBX_DEFAULT_MAX_BYTES;
+	MbxShared_t *pShm;
+	int opt, fail = 0, status, fds[2];
+	pid_t pid;
+
+	while ((opt = getopt(argc, argv, "mn:s:S:")) != -1) {
+		switch (opt) {
+		case 'm':
+			gUseModel = 1;
+			break;
+		case 'n':
+			requests = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			minBytes = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			maxBytes = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			mbxUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((requests == 0) || (minBytes < sizeof(uint64_t)) || (maxBytes < minBytes) ||
+	    (maxBytes > MBX_MAX_REQUEST_BYTES)) {
+		mbxUsage(argv[0]);
+		return 1;
+	}
+
+	pShm = mmap(NULL, sizeof(*pShm), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if ((pShm == MAP_FAILED) || (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)) {
+		TZTRNG_PRINTF("failed to create the shared mapping and the socket pair\n");
+		return 1;
+	}
+
+	gRegBase = tztrngTest_target(gUseModel, NULL, &gMbxHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	/* secure side checks, then the mailbox the child reads */
+	fail |= mbxCheck(CC_TrngMailboxGateway() != 0, "gateway call before the init fails");
+	fail |= mbxCheck(CC_TrngMailboxInit(gRegBase, NULL) != 0, "NULL mailbox fails");
+	fail |= mbxCheck(CC_TrngMailboxInit(0, &pShm->mbox) != 0, "zero base fails");
+	fail |= mbxCheck((CC_TrngMailboxInit(gRegBase, &pShm->mbox) == 0) &&
+			 (pShm->mbox.magic == CC_TRNG_MAILBOX_MAGIC) && (pShm->mbox.head == CC_TRNG_MAILBOX_BLOCKS) &&
+			 (pShm->mbox.collections == 1), "init fills the ring with one collection");
+	fail |= mbxCheck(CC_TrngMailboxInit(gRegBase, &pShm->mbox) != 0, "second init fails");
+
+	printf("# tztrng_mailbox target=%s requests=%u min_bytes=%u max_bytes=%u blocks=%u block_bytes=%u\n",
+	       gUseModel ? "model" : "hw", (unsigned int)requests, (unsigned int)minBytes, (unsigned int)maxBytes,
+	       (unsigned int)CC_TRNG_MAILBOX_BLOCKS, (unsigned int)CC_TRNG_MAILBOX_BLOCK_BYTES);
+	printf("transport,requests,bytes,gateway_calls,world_switches,switches_per_byte,collections,total_ms\n");
+	fflush(stdout);
+
+	pid = fork();
+	if (pid < 0) {
+		TZTRNG_PRINTF("fork failed\n");
+		fail = 1;
+	} else if (pid == 0) {
+		close(fds[0]);
+		_exit(mbxClient(fds[1], pShm, requests, minBytes, maxBytes));
+	} else {
+		close(fds[1]);
+		mbxServe(fds[0], pShm);
+		close(fds[0]);
+		if ((waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+			fail = 1;
+	}
+
+	CC_TrngMailboxClose();
+	fail |= mbxCheck((pShm->mbox.magic == 0) && mbxIsWiped(pShm->mbox.block[0], MBX_RING_BYTES, 0),
+			 "close wipes the mailbox");
+	munmap(pShm, sizeof(*pShm));
+
+	CC_TrngSetMmioOps(NULL);
+	tztrngTest_targetRelease(gRegBase);
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
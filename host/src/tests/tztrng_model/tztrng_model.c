@@ -0,0 +1,461 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <string.h>
+
+#include "tztrng_model.h"
+#include "dx_rng.h"
+
+/* registers used by CC_TST_TRNG() that dx_rng.h does not define */
+#define MODEL_RNG_VERSION_REG_OFFSET		0x1C0UL
+#define MODEL_RNG_CLK_ENABLE_REG_OFFSET		0x1C4UL
+
+#define MODEL_RNG_VERSION			0x00000001UL
+#define MODEL_SAMPLE_CNT1_RESET_VAL		0x0000FFFFUL
+#define MODEL_IMR_RESET_VAL			0x0000000FUL
+
+#define MODEL_ISR_EHR_VALID			(0x1UL << DX_RNG_ISR_EHR_VALID_BIT_SHIFT)
+#define MODEL_ISR_AUTOCORR_ERR			(0x1UL << DX_RNG_ISR_AUTOCORR_ERR_BIT_SHIFT)
+#define MODEL_ISR_CRNGT_ERR			(0x1UL << DX_RNG_ISR_CRNGT_ERR_BIT_SHIFT)
+#define MODEL_ISR_VN_ERR			(0x1UL << DX_RNG_ISR_VN_ERR_BIT_SHIFT)
+
+#define MODEL_DEBUG_VNC_BYPASS			0x2UL
+#define MODEL_DEBUG_CRNGT_BYPASS		0x4UL
+#define MODEL_DEBUG_AUTOCORR_BYPASS		0x8UL
+
+#define MODEL_EHR_WORDS				6
+#define MODEL_EHR_BITS				(MODEL_EHR_WORDS * 32)
+#define MODEL_EHR_READ_ALL			((1UL << MODEL_EHR_WORDS) - 1)
+#define MODEL_CRNGT_BLOCK_BITS			16
+#define MODEL_VN_MAX_RUN			32
+#define MODEL_AUTOCORR_MAX_LAG			3
+/* |equal pairs - n/2| above this fails the autocorrelation test: about 6 sigma for n = 192 */
+#define MODEL_AUTOCORR_MAX_DEVIATION		42
+#define MODEL_REPEAT_PATTERN			0xB5C3UL
+
+#define MODEL_Q16_ONE				0x10000UL
+
+typedef struct {
+	/* registers */
+	uint32_t imr;
+	uint32_t isr;
+	uint32_t config;
+	uint32_t valid;
+	uint32_t ehr[MODEL_EHR_WORDS];
+	uint32_t enable;
+	uint32_t sampleCnt;
+	uint32_t autocorrTrys;
+	uint32_t autocorrFails;
+	uint32_t debugCtrl;
+	uint32_t clkEnable;
+	/* SW reset in progress: accesses left */
+	uint32_t resetBusy;
+	/* collection */
+	uint32_t halted;		/* stopped by an autocorrelation error */
+	uint32_t clocksAcc;		/* clocks towards the next sample */
+	uint32_t fill[MODEL_EHR_WORDS];	/* EHR being filled */
+	uint32_t fillBits;
+	uint32_t readMask;		/* EHR words read since the EHR became valid */
+	uint32_t prevRaw;
+	uint32_t rawRun;		/* identical raw bits in a row */
+	uint32_t vnFirst;
+	uint32_t vnHalf;		/* first bit of a von Neumann pair is pending */
+	uint32_t block;
+	uint32_t blockBits;
+	uint32_t prevBlock;
+	uint32_t prevBlockValid;
+	uint64_t roscBits[CC_TRNG_NUM_OF_ROSCS];
+	uint64_t rng;
+} TztrngModelState_t;
+
+static TztrngModelCfg_t gCfg;
+static TztrngModelState_t gHw;
+static TztrngModelStats_t gStats;
+
+/* xorshift64*: 64 bits of noise */
+static uint64_t modelRand(void)
+{
+	gHw.rng ^= gHw.rng >> 12;
+	gHw.rng ^= gHw.rng << 25;
+	gHw.rng ^= gHw.rng >> 27;
+	return gHw.rng * 0x2545F4914F6CDD1DULL;
+}
+
+static void modelRestartFill(void)
+{
+	memset(gHw.fill, 0, sizeof(gHw.fill));
+	gHw.fillBits = 0;
+	gHw.vnHalf = 0;
+	gHw.rawRun = 0;
+	gHw.blockBits = 0;
+	gHw.prevBlockValid = 0;
+	gHw.clocksAcc = 0;
+}
+
+static void modelSwReset(void)
+{
+	memset(gHw.ehr, 0, sizeof(gHw.ehr));
+	gHw.imr = MODEL_IMR_RESET_VAL;
+	gHw.isr = 0;
+	gHw.config = 0;
+	gHw.valid = 0;
+	gHw.enable = 0;
+	gHw.sampleCnt = MODEL_SAMPLE_CNT1_RESET_VAL;
+	gHw.autocorrTrys = 0;
+	gHw.autocorrFails = 0;
+	gHw.debugCtrl = 0;
+	gHw.halted = 0;
+	gHw.readMask = 0;
+	gHw.resetBusy = gCfg.resetAccesses;
+	modelRestartFill();
+	gStats.swResets++;
+}
+
+static uint32_t modelRawBit(void)
+{
+	uint32_t rosc = gHw.config & (CC_TRNG_NUM_OF_ROSCS - 1);
+	const TztrngModelRosc_t *pRosc = &gCfg.rosc[rosc];
+	uint64_t r = modelRand();
+	uint32_t bit;
+
+	if ((pRosc->fault != TZTRNG_MODEL_FAULT_NONE) && (gHw.roscBits[rosc] >= pRosc->faultAfterBits)) {
+		switch (pRosc->fault) {
+		case TZTRNG_MODEL_FAULT_STUCK_0:
+			bit = 0;
+			break;
+		case TZTRNG_MODEL_FAULT_STUCK_1:
+			bit = 1;
+			break;
+		case TZTRNG_MODEL_FAULT_REPEAT_BLOCK:
+			bit = (MODEL_REPEAT_PATTERN >> (gHw.roscBits[rosc] % MODEL_CRNGT_BLOCK_BITS)) & 1;
+			break;
+		default:
+			bit = (uint32_t)(r & 1);
+			break;
+		}
+	} else if ((r & 0xFFFF) < pRosc->corrQ16) {
+		bit = gHw.prevRaw;
+	} else {
+		bit = (((r >> 16) & 0xFFFF) < pRosc->biasQ16) ? 1 : 0;
+	}
+
+	gHw.roscBits[rosc]++;
+	gStats.rawBits++;
+
+	return bit;
+}
+
+/* autocorrelation test over the complete EHR; returns 1 on failure */
+static uint32_t modelAutocorrFails(void)
+{
+	uint32_t lag, i, equal, b0, b1;
+
+	for (lag = 1; lag <= MODEL_AUTOCORR_MAX_LAG; lag++) {
+		equal = 0;
+		for (i = 0; i + lag < MODEL_EHR_BITS; i++) {
+			b0 = (gHw.fill[i / 32] >> (i % 32)) & 1;
+			b1 = (gHw.fill[(i + lag) / 32] >> ((i + lag) % 32)) & 1;
+			equal += (b0 == b1);
+		}
+		if ((equal > (MODEL_EHR_BITS - lag) / 2 + MODEL_AUTOCORR_MAX_DEVIATION) ||
+		    (equal + MODEL_AUTOCORR_MAX_DEVIATION < (MODEL_EHR_BITS - lag) / 2))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* one bit after the von Neumann balancer */
+static void modelPushBit(uint32_t bit)
+{
+	gHw.fill[gHw.fillBits / 32] |= bit << (gHw.fillBits % 32);
+	gHw.fillBits++;
+
+	if ((gHw.debugCtrl & MODEL_DEBUG_CRNGT_BYPASS) == 0) {
+		gHw.block = (gHw.block << 1) | bit;
+		if (++gHw.blockBits == MODEL_CRNGT_BLOCK_BITS) {
+			gHw.block &= (1UL << MODEL_CRNGT_BLOCK_BITS) - 1;
+			gHw.blockBits = 0;
+			if (gHw.prevBlockValid && (gHw.block == gHw.prevBlock)) {
+				gHw.isr |= MODEL_ISR_CRNGT_ERR;
+				gStats.crngtErrors++;
+				/* drop the EHR being filled */
+				memset(gHw.fill, 0, sizeof(gHw.fill));
+				gHw.fillBits = 0;
+			}
+			gHw.prevBlock = gHw.block;
+			gHw.prevBlockValid = 1;
+		}
+	}
+
+	if (gHw.fillBits < MODEL_EHR_BITS)
+		return;
+
+	if ((gHw.debugCtrl & MODEL_DEBUG_AUTOCORR_BYPASS) == 0) {
+		gHw.autocorrTrys++;
+		if (modelAutocorrFails()) {
+			gHw.autocorrFails++;
+			gStats.autocorrFails++;
+			gHw.isr |= MODEL_ISR_AUTOCORR_ERR;
+			gHw.halted = 1;
+			return;
+		}
+	}
+
+	memcpy(gHw.ehr, gHw.fill, sizeof(gHw.ehr));
+	memset(gHw.fill, 0, sizeof(gHw.fill));
+	gHw.fillBits = 0;
+	gHw.valid = 1;
+	gHw.readMask = 0;
+	gHw.isr |= MODEL_ISR_EHR_VALID;
+	gStats.ehrFilled++;
+}
+
+static void modelSample(void)
+{
+	uint32_t raw = modelRawBit();
+
+	if ((gHw.debugCtrl & MODEL_DEBUG_VNC_BYPASS) == 0) {
+		gHw.rawRun = (raw == gHw.prevRaw) ? gHw.rawRun + 1 : 1;
+		if (gHw.rawRun == MODEL_VN_MAX_RUN) {
+			gHw.isr |= MODEL_ISR_VN_ERR;
+			gStats.vnErrors++;
+			gHw.rawRun = 0;
+		}
+		gHw.prevRaw = raw;
+
+		/* von Neumann balancer: 01 -> 0, 10 -> 1, 00 and 11 dropped */
+		if (!gHw.vnHalf) {
+			gHw.vnFirst = raw;
+			gHw.vnHalf = 1;
+			return;
+		}
+		gHw.vnHalf = 0;
+		if (gHw.vnFirst == raw)
+			return;
+		modelPushBit(gHw.vnFirst);
+		return;
+	}
+
+	gHw.prevRaw = raw;
+	modelPushBit(raw);
+}
+
+/* the source samples for 'clocks' rng clocks */
+static void modelRun(uint32_t clocks)
+{
+	const TztrngModelRosc_t *pRosc = &gCfg.rosc[gHw.config & (CC_TRNG_NUM_OF_ROSCS - 1)];
+	uint32_t sampleClocks;
+
+	gStats.clocks += clocks;
+
+	/* the EHR waits to be read; the source does not sample meanwhile */
+	if (!gHw.enable || gHw.halted || gHw.valid)
+		return;
+
+	sampleClocks = (uint32_t)(((uint64_t)(gHw.sampleCnt ? gHw.sampleCnt : 1) * pRosc->clkScaleQ8) >> 8);
+	if (sampleClocks == 0)
+		sampleClocks = 1;
+
+	gHw.clocksAcc += clocks;
+	while ((gHw.clocksAcc >= sampleClocks) && !gHw.valid && !gHw.halted) {
+		gHw.clocksAcc -= sampleClocks;
+		modelSample();
+	}
+	if (gHw.valid)
+		gHw.clocksAcc = 0;
+}
+
+static void modelAdvance(uint32_t clocks)
+{
+	gStats.accesses++;
+	if (gHw.resetBusy)
+		gHw.resetBusy--;
+	modelRun(clocks);
+}
+
+void tztrngModel_tick(uint32_t clocks)
+{
+	modelRun(clocks);
+}
+
+void tztrngModel_defaultCfg(TztrngModelCfg_t *pCfg)
+{
+	uint32_t i;
+
+	memset(pCfg, 0, sizeof(*pCfg));
+	for (i = 0; i < CC_TRNG_NUM_OF_ROSCS; i++) {
+		pCfg->rosc[i].clkScaleQ8 = 256;
+		pCfg->rosc[i].biasQ16 = MODEL_Q16_ONE / 2;
+		pCfg->rosc[i].corrQ16 = 0;
+		pCfg->rosc[i].fault = TZTRNG_MODEL_FAULT_NONE;
+	}
+	pCfg->accessClocks = 16;
+	pCfg->resetAccesses = 4;
+	pCfg->seed = 0x7A7A5EEDULL;
+}
+
+void tztrngModel_init(const TztrngModelCfg_t *pCfg)
+{
+	gCfg = *pCfg;
+	memset(&gHw, 0, sizeof(gHw));
+	memset(&gStats, 0, sizeof(gStats));
+	gHw.rng = gCfg.seed ? gCfg.seed : 1;
+	modelSwReset();
+	gHw.resetBusy = 0;
+	gStats.swResets = 0;
+}
+
+void tztrngModel_setFault(uint32_t rosc, TztrngModelFault_t fault, uint32_t afterBits)
+{
+	if (rosc >= CC_TRNG_NUM_OF_ROSCS)
+		return;
+
+	gCfg.rosc[rosc].fault = fault;
+	gCfg.rosc[rosc].faultAfterBits = (uint32_t)gHw.roscBits[rosc] + afterBits;
+}
+
+uint32_t tztrngModel_read(uint32_t offset)
+{
+	uint32_t idx;
+
+	modelAdvance(gCfg.accessClocks);
+
+	switch (offset) {
+	case DX_RNG_IMR_REG_OFFSET:
+		return gHw.imr;
+	case DX_RNG_ISR_REG_OFFSET:
+		return gHw.isr;
+	case DX_TRNG_CONFIG_REG_OFFSET:
+		return gHw.config;
+	case DX_TRNG_VALID_REG_OFFSET:
+		return gHw.valid;
+	case DX_EHR_DATA_0_REG_OFFSET:
+	case DX_EHR_DATA_1_REG_OFFSET:
+	case DX_EHR_DATA_2_REG_OFFSET:
+	case DX_EHR_DATA_3_REG_OFFSET:
+	case DX_EHR_DATA_4_REG_OFFSET:
+	case DX_EHR_DATA_5_REG_OFFSET:
+		idx = (offset - DX_EHR_DATA_0_REG_OFFSET) / sizeof(uint32_t);
+		if (gHw.valid) {
+			gHw.readMask |= 1UL << idx;
+			if (gHw.readMask == MODEL_EHR_READ_ALL) {
+				/* all words read: refill */
+				gHw.valid = 0;
+				gHw.readMask = 0;
+			}
+		}
+		return gHw.ehr[idx];
+	case DX_RND_SOURCE_ENABLE_REG_OFFSET:
+		return gHw.enable;
+	case DX_SAMPLE_CNT1_REG_OFFSET:
+		return gHw.sampleCnt;
+	case DX_AUTOCORR_STATISTIC_REG_OFFSET:
+		return ((gHw.autocorrTrys & ((1UL << DX_AUTOCORR_STATISTIC_AUTOCORR_TRYS_BIT_SIZE) - 1))
+			<< DX_AUTOCORR_STATISTIC_AUTOCORR_TRYS_BIT_SHIFT) |
+		       ((gHw.autocorrFails & ((1UL << DX_AUTOCORR_STATISTIC_AUTOCORR_FAILS_BIT_SIZE) - 1))
+			<< DX_AUTOCORR_STATISTIC_AUTOCORR_FAILS_BIT_SHIFT);
+	case DX_TRNG_DEBUG_CONTROL_REG_OFFSET:
+		return gHw.debugCtrl;
+	case DX_RNG_BUSY_REG_OFFSET:
+		return (gHw.enable && !gHw.valid && !gHw.halted) ? 1 : 0;
+	case MODEL_RNG_VERSION_REG_OFFSET:
+		return MODEL_RNG_VERSION;
+	case MODEL_RNG_CLK_ENABLE_REG_OFFSET:
+		return gHw.clkEnable;
+	default:
+		return 0;
+	}
+}
+
+void tztrngModel_write(uint32_t offset, uint32_t val)
+{
+	modelAdvance(gCfg.accessClocks);
+
+	switch (offset) {
+	case DX_RNG_IMR_REG_OFFSET:
+		gHw.imr = val;
+		break;
+	case DX_RNG_ICR_REG_OFFSET:
+		gHw.isr &= ~val;
+		break;
+	case DX_TRNG_CONFIG_REG_OFFSET:
+		gHw.config = val & (CC_TRNG_NUM_OF_ROSCS - 1);
+		break;
+	case DX_RND_SOURCE_ENABLE_REG_OFFSET:
+		if ((val & 1) && !gHw.enable)
+			modelRestartFill();
+		gHw.enable = val & 1;
+		break;
+	case DX_SAMPLE_CNT1_REG_OFFSET:
+		/* lost while the reset is in progress; the driver reads it back */
+		if (!gHw.resetBusy)
+			gHw.sampleCnt = val;
+		break;
+	case DX_TRNG_DEBUG_CONTROL_REG_OFFSET:
+		gHw.debugCtrl = val;
+		break;
+	case DX_RNG_SW_RESET_REG_OFFSET:
+		if (val & 1)
+			modelSwReset();
+		break;
+	case DX_RST_BITS_COUNTER_REG_OFFSET:
+		modelRestartFill();
+		break;
+	case MODEL_RNG_CLK_ENABLE_REG_OFFSET:
+		gHw.clkEnable = val;
+		break;
+	default:
+		break;
+	}
+}
+
+uint32_t tztrngModel_irqPending(void)
+{
+	return gHw.isr & ~gHw.imr;
+}
+
+void tztrngModel_getStats(TztrngModelStats_t *pStats)
+{
+	*pStats = gStats;
+}
+
+static uint32_t modelOpsRead(void *ctx, unsigned long regBase, uint32_t offset)
+{
+	(void)ctx;
+	(void)regBase;
+	return tztrngModel_read(offset);
+}
+
+static void modelOpsWrite(void *ctx, unsigned long regBase, uint32_t offset, uint32_t val)
+{
+	(void)ctx;
+	(void)regBase;
+	tztrngModel_write(offset, val);
+}
+
+static const CCTrngMmioOps_t gModelOps = {
+	modelOpsRead,
+	modelOpsWrite,
+	NULL,
+	NULL,
+};
+
+const CCTrngMmioOps_t *tztrngModel_ops(void)
+{
+	return &gModelOps;
+}
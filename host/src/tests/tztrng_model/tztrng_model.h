@@ -0,0 +1,112 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+
+#ifndef _TZTRNG_MODEL_H_
+#define _TZTRNG_MODEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "tztrng.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Behavioral model of the RNG register block, for running the driver and
+ * CC_TST_TRNG() on a host without the hardware.
+ *
+ * Time is counted in rng clocks and advances by TztrngModelCfg_t.accessClocks on
+ * every register access, or by tztrngModel_tick(); a raw bit is sampled every
+ * SAMPLE_CNT1 * clkScaleQ8 / 256 clocks from the selected ROSC. The raw bits go
+ * through the von Neumann balancer, the CRNGT and the autocorrelation test as
+ * selected by TRNG_DEBUG_CONTROL, and fill the 192-bit EHR. The model covers:
+ * - SAMPLE_CNT1 (writes ignored while a SW reset is in progress), TRNG_CONFIG,
+ *   TRNG_DEBUG_CONTROL, RND_SOURCE_ENABLE, RNG_SW_RESET, RST_BITS_COUNTER, RNG_BUSY,
+ * - RNG_ISR/RNG_ICR/RNG_IMR: EHR_VALID, AUTOCORR_ERR, CRNGT_ERR and VN_ERR events,
+ * - EHR_DATA_0..5 and TRNG_VALID: the EHR refills once all 6 words were read,
+ * - AUTOCORR_STATISTIC.
+ * Model behaviors where the hardware documentation leaves room:
+ * - a CRNGT failure drops the EHR being filled,
+ * - a VN error is raised on 32 identical raw bits,
+ * - the autocorrelation test runs on each complete EHR (lags 1 to 3) and stops the
+ *   TRNG until the next SW reset when it fails.
+ */
+
+typedef enum {
+	TZTRNG_MODEL_FAULT_NONE = 0,
+	TZTRNG_MODEL_FAULT_STUCK_0,		/* ROSC output stuck at 0 */
+	TZTRNG_MODEL_FAULT_STUCK_1,		/* ROSC output stuck at 1 */
+	TZTRNG_MODEL_FAULT_REPEAT_BLOCK,	/* ROSC output repeats a 16-bit pattern */
+} TztrngModelFault_t;
+
+typedef struct {
+	uint32_t clkScaleQ8;		/* rng clocks per SAMPLE_CNT1 unit, 256 = 1 (sets the bit rate) */
+	uint32_t biasQ16;		/* probability of a 1 bit, 32768 = unbiased */
+	uint32_t corrQ16;		/* probability that a bit repeats the previous one */
+	TztrngModelFault_t fault;
+	uint32_t faultAfterBits;	/* raw bits of this ROSC before the fault shows */
+} TztrngModelRosc_t;
+
+typedef struct {
+	TztrngModelRosc_t rosc[CC_TRNG_NUM_OF_ROSCS];
+	uint32_t accessClocks;		/* rng clocks per register access */
+	uint32_t resetAccesses;		/* register accesses a SW reset stays in progress */
+	uint64_t seed;			/* seed of the noise generator, reproducible runs */
+} TztrngModelCfg_t;
+
+typedef struct {
+	uint64_t clocks;		/* rng clocks elapsed */
+	uint64_t accesses;		/* register accesses */
+	uint64_t rawBits;		/* raw bits sampled */
+	uint32_t ehrFilled;		/* EHRs made valid */
+	uint32_t crngtErrors;
+	uint32_t vnErrors;
+	uint32_t autocorrFails;
+	uint32_t swResets;
+} TztrngModelStats_t;
+
+/* Healthy, unbiased ROSCs at the nominal bit rate */
+void tztrngModel_defaultCfg(TztrngModelCfg_t *pCfg);
+
+/* Power-on reset with the given configuration (copied) */
+void tztrngModel_init(const TztrngModelCfg_t *pCfg);
+
+/* Change the fault of one ROSC at runtime */
+void tztrngModel_setFault(uint32_t rosc, TztrngModelFault_t fault, uint32_t afterBits);
+
+uint32_t tztrngModel_read(uint32_t offset);
+void tztrngModel_write(uint32_t offset, uint32_t val);
+
+/* Let 'clocks' rng clocks pass without a register access, e.g. while the CPU sleeps */
+void tztrngModel_tick(uint32_t clocks);
+
+/* RNG interrupt line: ISR events not masked in IMR */
+uint32_t tztrngModel_irqPending(void);
+
+void tztrngModel_getStats(TztrngModelStats_t *pStats);
+
+/* Register access backend for CC_TrngSetMmioOps (library built with CC_CONFIG_TRNG_MMIO_HOOKS) */
+const CCTrngMmioOps_t *tztrngModel_ops(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_TZTRNG_MODEL_H_
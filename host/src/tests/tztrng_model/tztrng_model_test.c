@@ -0,0 +1,355 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+
+/*
+ * Runs the unmodified driver (library built with CC_CONFIG_TRNG_MMIO_HOOKS = 1)
+ * and CC_TST_TRNG() against the RNG register model, on any Linux host.
+ */
+
+/* any non zero base: the model never dereferences it */
+#define MODEL_FAKE_REG_BASE 			0x1000UL
+#define MODEL_LARGE_REQ_BYTES 			10000
+#define MODEL_SMALL_REQ_BYTES 			256
+#define MODEL_SMALL_REQ_COUNT 			100
+/* CC_TST_TRNG() collection: header, 100 EHRs and footer */
+#define MODEL_TST_EHRS 				100
+#define MODEL_TST_BUF_BYTES 			(16 + MODEL_TST_EHRS * 24 + 12)
+#define MODEL_TST_SAMPLE_CNT 			200
+#define MODEL_TST_HEADER_SIG 			0xAABBCCDDUL
+#define MODEL_TST_FOOTER_SIG 			0xDDCCBBAAUL
+#define MODEL_TST_ISR_CRNGT_ERR 		0x4
+#define MODEL_TST_SAMPLE_LOST 			0x1
+/* CC_TST_TRNG_PingPong() collection: 1000 EHRs at the lowest sample count, 1 KB buffers */
+#define MODEL_PP_EHRS 				1000
+#define MODEL_PP_BUF_BYTES 			(16 + MODEL_PP_EHRS * 24 + 12)
+#define MODEL_PP_SAMPLE_CNT 			1
+#define MODEL_PP_BUFFER_BYTES 			1024
+/* consumer cost in rng clocks: a fixed setup plus a rate per byte, one the bit rate
+   can sustain when run in parallel, one it cannot */
+#define MODEL_PP_CONSUMER_CLOCKS 		2000
+#define MODEL_PP_FAST_CLOCKS_PER_BYTE 		2
+#define MODEL_PP_SLOW_CLOCKS_PER_BYTE 		16
+
+/* TRNG_test.c */
+int CC_TST_TRNG(unsigned long regBaseAddress, uint32_t TRNGMode, uint32_t roscLength,
+		uint32_t sampleCount, uint32_t buffSize,
+		void (*callbackFunc)(uint32_t outputSize, uint8_t *outputBuffer));
+/* tztrng_model_tst.c: CC_TST_TRNG_PingPong() with a simulated consumer */
+int tztrngModelTst_pingPong(unsigned long regBaseAddress, uint32_t TRNGMode, uint32_t roscLength,
+			    uint32_t sampleCount, uint32_t buffSize, uint32_t bufferSize,
+			    uint32_t consumerClocks, uint32_t consumerClocksPerByte,
+			    void (*collect)(uint32_t outputSize, uint8_t *outputBuffer),
+			    uint32_t *pStalls);
+
+static const char *tstModeName[] = { "FAST", "FE", "80090B" };
+
+/* large enough for both collections */
+static uint8_t gTstBuf[MODEL_PP_BUF_BYTES];
+static uint32_t gTstLen;
+
+static void modelTstCollect(uint32_t outputSize, uint8_t *outputBuffer)
+{
+	if (gTstLen + outputSize <= sizeof(gTstBuf))
+		memcpy(gTstBuf + gTstLen, outputBuffer, outputSize);
+	gTstLen += outputSize;
+}
+
+/* the same consumer run inline: the collection waits for it after every EHR */
+static void modelTstCollectSlow(uint32_t outputSize, uint8_t *outputBuffer)
+{
+	modelTstCollect(outputSize, outputBuffer);
+	tztrngModel_tick(MODEL_PP_CONSUMER_CLOCKS + MODEL_PP_FAST_CLOCKS_PER_BYTE * outputSize);
+}
+
+static void modelReset(void)
+{
+	TztrngModelCfg_t cfg;
+
+	tztrngModel_defaultCfg(&cfg);
+	tztrngModel_init(&cfg);
+}
+
+static void modelPrintStats(const char *name)
+{
+	TztrngModelStats_t stats;
+
+	tztrngModel_getStats(&stats);
+	TZTRNG_PRINTF("  %s: %llu accesses, %llu raw bits, %u EHRs, %u crngt, %u vn, %u autocorr, %u resets\n",
+		      name, (unsigned long long)stats.accesses, (unsigned long long)stats.rawBits,
+		      (unsigned int)stats.ehrFilled, (unsigned int)stats.crngtErrors,
+		      (unsigned int)stats.vnErrors, (unsigned int)stats.autocorrFails,
+		      (unsigned int)stats.swResets);
+}
+
+static uint32_t modelGet(uint8_t *buf, size_t bytes)
+{
+	size_t outputLen = 0;
+	uint32_t err;
+
+	err = CC_TrngGetSource(MODEL_FAKE_REG_BASE, buf, &outputLen, bytes * 8);
+	if ((err == 0) && (outputLen != bytes))
+		err = 1;
+
+	return err;
+}
+
+/* healthy ROSCs: requests succeed and never repeat */
+static int modelTestHealthy(void)
+{
+	uint8_t *large, *small;
+	uint32_t err;
+	int i, j, fail = 0;
+
+	large = malloc(MODEL_LARGE_REQ_BYTES);
+	small = malloc(MODEL_SMALL_REQ_COUNT * MODEL_SMALL_REQ_BYTES);
+	if ((large == NULL) || (small == NULL))
+	{
+		TZTRNG_PRINTF("failed to allocate buffers\n");
+		fail = 1;
+		goto End;
+	}
+
+	modelReset();
+
+	err = modelGet(large, MODEL_LARGE_REQ_BYTES);
+	if (err)
+	{
+		TZTRNG_PRINTF("  %d bytes request error(0x%X)\n", MODEL_LARGE_REQ_BYTES, err);
+		fail = 1;
+	}
+
+	for (i = 0; (i < MODEL_SMALL_REQ_COUNT) && !fail; i++)
+	{
+		err = modelGet(small + i * MODEL_SMALL_REQ_BYTES, MODEL_SMALL_REQ_BYTES);
+		if (err)
+		{
+			TZTRNG_PRINTF("  request %d error(0x%X)\n", i, err);
+			fail = 1;
+		}
+		for (j = 0; (j < i) && !fail; j++)
+		{
+			if (memcmp(small + i * MODEL_SMALL_REQ_BYTES, small + j * MODEL_SMALL_REQ_BYTES,
+				   MODEL_SMALL_REQ_BYTES) == 0)
+			{
+				TZTRNG_PRINTF("  requests %d and %d returned the same data\n", j, i);
+				fail = 1;
+			}
+		}
+	}
+
+	modelPrintStats("healthy");
+
+End:
+	free(large);
+	free(small);
+	return fail;
+}
+
+/* 'faulty' ROSCs repeat a 16-bit pattern: the driver must fall back or fail */
+static int modelTestFaulty(uint32_t faulty, int expectOk)
+{
+	uint8_t buf[MODEL_SMALL_REQ_BYTES];
+	uint32_t rosc, err;
+
+	modelReset();
+	for (rosc = 0; rosc < faulty; rosc++)
+		tztrngModel_setFault(rosc, TZTRNG_MODEL_FAULT_REPEAT_BLOCK, 0);
+
+	err = modelGet(buf, sizeof(buf));
+	modelPrintStats(expectOk ? "fallback" : "all faulty");
+
+	if (expectOk && err)
+	{
+		TZTRNG_PRINTF("  %u faulty ROSCs: request error(0x%X), expected fallback\n",
+			      (unsigned int)faulty, err);
+		return 1;
+	}
+	if (!expectOk && !err)
+	{
+		TZTRNG_PRINTF("  %u faulty ROSCs: request succeeded, expected an error\n",
+			      (unsigned int)faulty);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int modelTestTst(uint32_t trngMode)
+{
+	uint32_t sig;
+	int ret;
+
+	modelReset();
+	gTstLen = 0;
+
+	ret = CC_TST_TRNG(MODEL_FAKE_REG_BASE, trngMode, 0, MODEL_TST_SAMPLE_CNT,
+			  MODEL_TST_BUF_BYTES, modelTstCollect);
+	memcpy(&sig, gTstBuf, sizeof(sig));
+	modelPrintStats(tstModeName[trngMode]);
+
+	/* a CRNGT event on healthy noise is possible and only reported */
+	if ((ret & ~MODEL_TST_ISR_CRNGT_ERR) != 0)
+	{
+		TZTRNG_PRINTF("  CC_TST_TRNG(%s) returned 0x%X\n", tstModeName[trngMode], ret);
+		return 1;
+	}
+	if ((gTstLen != MODEL_TST_BUF_BYTES) || (sig != MODEL_TST_HEADER_SIG))
+	{
+		TZTRNG_PRINTF("  CC_TST_TRNG(%s): %u bytes collected, header 0x%08X\n",
+			      tstModeName[trngMode], (unsigned int)gTstLen, (unsigned int)sig);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* 'ret' and the collected stream of a capture of 'bytes' bytes; 'lost' is the expected
+   CC_TRNG_SAMPLE_LOST; 'ref' (optional) the stream of a lossless capture */
+static int modelCheckCapture(const char *name, int ret, uint32_t bytes, uint32_t lost,
+			     const uint8_t *ref)
+{
+	uint32_t sig, footer[3];
+
+	memcpy(&sig, gTstBuf, sizeof(sig));
+	memcpy(footer, gTstBuf + bytes - sizeof(footer), sizeof(footer));
+
+	if (((uint32_t)ret & ~(MODEL_TST_ISR_CRNGT_ERR | MODEL_TST_SAMPLE_LOST)) != 0)
+	{
+		TZTRNG_PRINTF("  %s returned 0x%X\n", name, ret);
+		return 1;
+	}
+	if ((gTstLen != bytes) || (sig != MODEL_TST_HEADER_SIG) ||
+	    (footer[0] != MODEL_TST_FOOTER_SIG) || (footer[2] != footer[0]))
+	{
+		TZTRNG_PRINTF("  %s: %u bytes collected, header 0x%08X, footer 0x%08X\n",
+			      name, (unsigned int)gTstLen, (unsigned int)sig, (unsigned int)footer[0]);
+		return 1;
+	}
+	if ((((uint32_t)ret & MODEL_TST_SAMPLE_LOST) != lost) || (footer[1] != lost))
+	{
+		TZTRNG_PRINTF("  %s: samples %s (returned 0x%X, footer %u)\n", name,
+			      lost ? "not lost, expected a loss" : "lost", ret, (unsigned int)footer[1]);
+		return 1;
+	}
+	if ((ref != NULL) && (memcmp(gTstBuf, ref, bytes) != 0))
+	{
+		TZTRNG_PRINTF("  %s: stream differs from the lossless capture\n", name);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* lowest sample count, FAST mode: a consumer inline in the collection loop loses samples,
+   the same consumer behind the ping-pong buffers does not */
+static int modelTestPingPong(void)
+{
+	uint8_t *ref;
+	uint32_t stalls;
+	int ret, fail = 0;
+
+	ref = malloc(MODEL_PP_BUF_BYTES);
+	if (ref == NULL)
+	{
+		TZTRNG_PRINTF("failed to allocate buffers\n");
+		return 1;
+	}
+
+	/* reference: no consumer cost at all */
+	modelReset();
+	gTstLen = 0;
+	ret = CC_TST_TRNG(MODEL_FAKE_REG_BASE, 0, 0, MODEL_PP_SAMPLE_CNT, MODEL_PP_BUF_BYTES,
+			  modelTstCollect);
+	fail |= modelCheckCapture("no consumer", ret, MODEL_PP_BUF_BYTES, 0, NULL);
+	memcpy(ref, gTstBuf, MODEL_PP_BUF_BYTES);
+
+	modelReset();
+	gTstLen = 0;
+	ret = CC_TST_TRNG(MODEL_FAKE_REG_BASE, 0, 0, MODEL_PP_SAMPLE_CNT, MODEL_PP_BUF_BYTES,
+			  modelTstCollectSlow);
+	modelPrintStats("inline consumer");
+	fail |= modelCheckCapture("inline consumer", ret, MODEL_PP_BUF_BYTES, MODEL_TST_SAMPLE_LOST, NULL);
+
+	modelReset();
+	gTstLen = 0;
+	ret = tztrngModelTst_pingPong(MODEL_FAKE_REG_BASE, 0, 0, MODEL_PP_SAMPLE_CNT, MODEL_PP_BUF_BYTES,
+				      MODEL_PP_BUFFER_BYTES, MODEL_PP_CONSUMER_CLOCKS,
+				      MODEL_PP_FAST_CLOCKS_PER_BYTE, modelTstCollect, &stalls);
+	modelPrintStats("ping-pong");
+	fail |= modelCheckCapture("ping-pong", ret, MODEL_PP_BUF_BYTES, 0, ref);
+	if (stalls != 0)
+	{
+		TZTRNG_PRINTF("  ping-pong: %u stalls\n", (unsigned int)stalls);
+		fail = 1;
+	}
+
+	/* a consumer slower than the bit rate: the collection has to wait for it */
+	modelReset();
+	gTstLen = 0;
+	ret = tztrngModelTst_pingPong(MODEL_FAKE_REG_BASE, 0, 0, MODEL_PP_SAMPLE_CNT, MODEL_PP_BUF_BYTES,
+				      MODEL_PP_BUFFER_BYTES, MODEL_PP_CONSUMER_CLOCKS,
+				      MODEL_PP_SLOW_CLOCKS_PER_BYTE, modelTstCollect, &stalls);
+	modelPrintStats("ping-pong, slow consumer");
+	fail |= modelCheckCapture("ping-pong, slow consumer", ret, MODEL_PP_BUF_BYTES,
+				  MODEL_TST_SAMPLE_LOST, NULL);
+	if (stalls == 0)
+	{
+		TZTRNG_PRINTF("  ping-pong, slow consumer: no stalls\n");
+		fail = 1;
+	}
+
+	free(ref);
+	return fail;
+}
+
+int main(void)
+{
+	int fail = 0;
+	uint32_t mode;
+
+	CC_TrngSetMmioOps(tztrngModel_ops());
+
+	TZTRNG_PRINTF("driver, healthy ROSCs\n");
+	fail |= modelTestHealthy();
+
+	TZTRNG_PRINTF("driver, ROSC fallback\n");
+	fail |= modelTestFaulty(CC_TRNG_NUM_OF_ROSCS - 1, 1);
+
+	TZTRNG_PRINTF("driver, all ROSCs faulty\n");
+	fail |= modelTestFaulty(CC_TRNG_NUM_OF_ROSCS, 0);
+
+	CC_TrngSetMmioOps(NULL);
+
+	TZTRNG_PRINTF("CC_TST_TRNG\n");
+	for (mode = 0; mode < sizeof(tstModeName) / sizeof(tstModeName[0]); mode++)
+		fail |= modelTestTst(mode);
+
+	TZTRNG_PRINTF("CC_TST_TRNG_PingPong\n");
+	fail |= modelTestPingPong();
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
@@ -0,0 +1,108 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+/*
+ * CC_TST_TRNG() of the characterization package (TRNG_test.c), built with its
+ * register accesses routed to the RNG model. CC_TST_TRNG_PingPong() gets a
+ * simulated consumer: each handed over buffer stays busy for a fixed number of
+ * rng clocks plus a number per byte, running in parallel with the collection.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "tztrng_model.h"
+
+#define CC_GEN_WriteRegister(base_addr, reg_addr, val) \
+	do { (void)(base_addr); tztrngModel_write((uint32_t)(reg_addr), (uint32_t)(val)); } while (0)
+
+#define CC_GEN_ReadRegister(base_addr, reg_addr) \
+	((void)(base_addr), tztrngModel_read((uint32_t)(reg_addr)))
+
+static uint32_t modelTstBufferBusy(volatile uint32_t *pBusy, uint32_t idx);
+
+#define CC_GEN_BufferBusy(pingPong_ptr, idx) \
+	modelTstBufferBusy(&(pingPong_ptr)->busy[(idx)], (idx))
+
+#include "TRNG_test.c"
+
+#define MODEL_TST_POLL_CLOCKS 			16
+
+static CC_TST_TRNG_PingPong_t gPingPong;
+static callback_TRNG gCollect;
+static uint32_t gConsumerClocks;
+static uint32_t gConsumerClocksPerByte;
+/* model time at which the consumer is done with each buffer */
+static uint64_t gDoneAt[2];
+
+static uint64_t modelTstNow(void)
+{
+	TztrngModelStats_t stats;
+
+	tztrngModel_getStats(&stats);
+	return stats.clocks;
+}
+
+/* the consumer: takes the data at once, keeps the buffer busy for the transfer time */
+static void modelTstHandover(uint32_t outputSize, uint8_t *outputBuffer)
+{
+	uint32_t idx = (outputBuffer == (uint8_t *)gPingPong.buffer[1]);
+
+	gCollect(outputSize, outputBuffer);
+	gDoneAt[idx] = modelTstNow() + gConsumerClocks + (uint64_t)gConsumerClocksPerByte * outputSize;
+}
+
+/* polled by CC_TST_TRNG_PingPong(): model time passes while it waits */
+static uint32_t modelTstBufferBusy(volatile uint32_t *pBusy, uint32_t idx)
+{
+	if (*pBusy && (modelTstNow() >= gDoneAt[idx]))
+		*pBusy = 0;
+	if (*pBusy)
+		tztrngModel_tick(MODEL_TST_POLL_CLOCKS);
+
+	return *pBusy;
+}
+
+int tztrngModelTst_pingPong(unsigned long regBaseAddress, uint32_t TRNGMode, uint32_t roscLength,
+			    uint32_t sampleCount, uint32_t buffSize, uint32_t bufferSize,
+			    uint32_t consumerClocks, uint32_t consumerClocksPerByte,
+			    callback_TRNG collect, uint32_t *pStalls)
+{
+	int ret;
+
+	gPingPong.buffer[0] = malloc(bufferSize);
+	gPingPong.buffer[1] = malloc(bufferSize);
+	gPingPong.bufferSize = bufferSize;
+	gPingPong.busy[0] = 0;
+	gPingPong.busy[1] = 0;
+	gPingPong.handover = modelTstHandover;
+	gCollect = collect;
+	gConsumerClocks = consumerClocks;
+	gConsumerClocksPerByte = consumerClocksPerByte;
+
+	ret = CC_TST_TRNG_PingPong(regBaseAddress, TRNGMode, roscLength, sampleCount, buffSize, &gPingPong);
+
+	/* let the last transfers complete */
+	while (modelTstBufferBusy(&gPingPong.busy[0], 0) || modelTstBufferBusy(&gPingPong.busy[1], 1))
+	{
+	}
+
+	*pStalls = gPingPong.stalls;
+	free(gPingPong.buffer[0]);
+	free(gPingPong.buffer[1]);
+
+	return ret;
+}
@@ -0,0 +1,120 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_target.h"
+#include "tztrng_test_pal_api.h"
+
+#include "dx_reg_base_host.h"
+
+static int gTargetModel;
+static const TztrngTestHooks_t *gTargetHooks;
+
+unsigned long tztrngTest_target(int useModel, const TztrngModelCfg_t *pCfg,
+				const TztrngTestHooks_t *pHooks)
+{
+	TztrngModelCfg_t cfg;
+
+	gTargetModel = useModel;
+	gTargetHooks = pHooks;
+	if (!useModel)
+		return tztrngTest_pal_mapCcRegs(DX_BASE_RNG);
+
+	if (pCfg == NULL) {
+		tztrngModel_defaultCfg(&cfg);
+		pCfg = &cfg;
+	}
+	tztrngModel_init(pCfg);
+
+	return TZTRNG_TEST_MODEL_REG_BASE;
+}
+
+void tztrngTest_targetRelease(unsigned long regBase)
+{
+	if (!gTargetModel)
+		tztrngTest_pal_unmapCcRegs(regBase);
+	gTargetHooks = NULL;
+}
+
+uint32_t tztrngTest_regRead(unsigned long regBase, uint32_t offset)
+{
+	const TztrngTestHooks_t *pHooks = gTargetHooks;
+	uint32_t val;
+
+	if ((pHooks != NULL) && (pHooks->access != NULL))
+		pHooks->access(pHooks->ctx, offset);
+	if (!gTargetModel)
+		return *(volatile uint32_t *)(regBase + offset);
+
+	if ((pHooks != NULL) && (pHooks->lock != NULL))
+		pHooks->lock(pHooks->ctx);
+	val = tztrngModel_read(offset);
+	if ((pHooks != NULL) && (pHooks->unlock != NULL))
+		pHooks->unlock(pHooks->ctx);
+
+	return val;
+}
+
+void tztrngTest_regWrite(unsigned long regBase, uint32_t offset, uint32_t val)
+{
+	const TztrngTestHooks_t *pHooks = gTargetHooks;
+
+	if ((pHooks != NULL) && (pHooks->access != NULL))
+		pHooks->access(pHooks->ctx, offset);
+	if (!gTargetModel) {
+		*(volatile uint32_t *)(regBase + offset) = val;
+		return;
+	}
+
+	if ((pHooks != NULL) && (pHooks->lock != NULL))
+		pHooks->lock(pHooks->ctx);
+	tztrngModel_write(offset, val);
+	if ((pHooks != NULL) && (pHooks->unlock != NULL))
+		pHooks->unlock(pHooks->ctx);
+}
+
+static uint32_t targetOpsRead(void *ctx, unsigned long regBase, uint32_t offset)
+{
+	(void)ctx;
+	return tztrngTest_regRead(regBase, offset);
+}
+
+static void targetOpsWrite(void *ctx, unsigned long regBase, uint32_t offset, uint32_t val)
+{
+	(void)ctx;
+	tztrngTest_regWrite(regBase, offset, val);
+}
+
+static void targetOpsRequest(void *ctx, size_t reqBits)
+{
+	const TztrngTestHooks_t *pHooks = gTargetHooks;
+
+	(void)ctx;
+	if ((pHooks != NULL) && (pHooks->request != NULL))
+		pHooks->request(pHooks->ctx, reqBits);
+}
+
+static const CCTrngMmioOps_t gTargetOps = {
+	targetOpsRead,
+	targetOpsWrite,
+	targetOpsRequest,
+	NULL,
+};
+
+const CCTrngMmioOps_t *tztrngTest_mmioOps(void)
+{
+	return &gTargetOps;
+}
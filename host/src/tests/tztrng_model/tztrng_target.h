@@ -0,0 +1,74 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+
+#ifndef _TZTRNG_TARGET_H_
+#define _TZTRNG_TARGET_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "tztrng.h"
+#include "tztrng_model.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Register target of the host test tools: the RNG registers mapped through the
+ * test PAL (/dev/mem on Linux), or the RNG register model (-m). The tools install
+ * tztrngTest_mmioOps() with CC_TrngSetMmioOps() and pass the base returned by
+ * tztrngTest_target() to the driver.
+ */
+
+/* any non zero base: the model never dereferences it */
+#define TZTRNG_TEST_MODEL_REG_BASE	0x1000UL
+
+/* usage line of the option selecting the model */
+#define TZTRNG_TEST_MODEL_USAGE		"  -m  run against the RNG register model instead of /dev/mem\n"
+
+/* Tool hooks of the target, all optional */
+typedef struct {
+	void (*access)(void *ctx, uint32_t offset);	/* before every register access */
+	void (*request)(void *ctx, size_t reqBits);	/* start of every CC_TrngGetSource call */
+	void (*lock)(void *ctx);			/* serialize model accesses (not thread safe) */
+	void (*unlock)(void *ctx);
+	void *ctx;
+} TztrngTestHooks_t;
+
+/* Select the target: initialize the model with pCfg (the default configuration if
+   NULL), or map the RNG registers. pHooks (may be NULL) is kept by reference.
+   Returns the register base for the driver. */
+unsigned long tztrngTest_target(int useModel, const TztrngModelCfg_t *pCfg,
+				const TztrngTestHooks_t *pHooks);
+
+/* Unmap the RNG registers of tztrngTest_target() */
+void tztrngTest_targetRelease(unsigned long regBase);
+
+/* Register access on the selected target, with the hooks */
+uint32_t tztrngTest_regRead(unsigned long regBase, uint32_t offset);
+void tztrngTest_regWrite(unsigned long regBase, uint32_t offset, uint32_t val);
+
+/* Register access backend of the selected target for CC_TrngSetMmioOps */
+const CCTrngMmioOps_t *tztrngTest_mmioOps(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_TZTRNG_TARGET_H_
@@ -0,0 +1,344 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+/*
+ * Raw-noise tap test (library built with CC_CONFIG_TRNG_NOISE_TAP = 1 and
+ * CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * The main thread makes -n collections of -b bytes with CC_TrngGetSource()
+ * while a consumer thread drains the tap with CC_TrngNoiseTapRead() and writes
+ * the EHR bytes of every record to the -o file (8 bits per sample, the input
+ * of SP 800-90B estimators). Three phases:
+ * - off: the tap is off, the reference collection time,
+ * - fast: the consumer reads up to 64 records at a time, without a pause,
+ * - slow: the consumer reads one record every -d microseconds, so the ring
+ *   fills up and EHRs are dropped.
+ * One CSV row per phase:
+ * phase,collections,ehrs,records,drops,written,collect_p50_us,collect_max_us
+ * The records must arrive in order and the sequence gaps, with the EHRs after
+ * the last record, must add up to the drops. The collection time must not
+ * depend on the consumer.
+ */
+
+#define TAP_DEFAULT_COLLECTIONS 	200
+#define TAP_DEFAULT_BYTES 		32
+#define TAP_DEFAULT_DELAY_US 		1000
+#define TAP_MAX_BYTES 			4096
+#define TAP_FAST_BATCH 			64
+#define TAP_IDLE_US 			100
+#define TAP_NS_PER_SEC 			1000000000ULL
+
+typedef enum {
+	TAP_PHASE_OFF = 0,
+	TAP_PHASE_FAST,
+	TAP_PHASE_SLOW,
+} TapPhase_t;
+
+static const char *const gPhaseNames[] = { "off", "fast", "slow" };
+
+typedef struct {
+	pthread_t thread;
+	int fd;				/* output file, -1 for none */
+	uint32_t batch;			/* records per read */
+	uint32_t delayUs;		/* pause after each read */
+	uint32_t stop;			/* drain the ring and return */
+	uint32_t nextSeq;		/* sequence number of the next EHR */
+	uint32_t records;
+	uint32_t gaps;			/* EHRs missing before a record */
+	uint32_t disorder;		/* records older than the last one */
+	uint32_t badSource;		/* records of an impossible ROSC or sample count */
+	uint64_t written;		/* bytes written to fd */
+} TapConsumer_t;
+
+static int gUseModel;
+static unsigned long gRegBase;
+static uint32_t gCollections;
+
+static uint64_t tapNowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * TAP_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/* start of a TRNG collection */
+static void tapRequest(void *ctx, size_t reqBits)
+{
+	(void)ctx;
+	(void)reqBits;
+	gCollections++;
+}
+
+static const TztrngTestHooks_t gTapHooks = {
+	NULL,
+	tapRequest,
+	NULL,
+	NULL,
+	NULL,
+};
+
+static void *tapConsumer(void *arg)
+{
+	TapConsumer_t *pCon = (TapConsumer_t *)arg;
+	CCTrngNoiseRecord_t recs[TAP_FAST_BATCH];
+	uint32_t n, i;
+
+	for (;;) {
+		if (CC_TrngNoiseTapRead(recs, pCon->batch, &n) != 0)
+			break;
+		for (i = 0; i < n; i++) {
+			if ((int32_t)(recs[i].seq - pCon->nextSeq) < 0)
+				pCon->disorder++;
+			else
+				pCon->gaps += recs[i].seq - pCon->nextSeq;
+			pCon->nextSeq = recs[i].seq + 1;
+			if ((recs[i].rosc >= CC_TRNG_NUM_OF_ROSCS) || (recs[i].sampleCnt == 0))
+				pCon->badSource++;
+			if ((pCon->fd >= 0) &&
+			    (write(pCon->fd, recs[i].ehr, sizeof(recs[i].ehr)) == (ssize_t)sizeof(recs[i].ehr)))
+				pCon->written += sizeof(recs[i].ehr);
+		}
+		pCon->records += n;
+		memset(recs, 0, n * sizeof(recs[0]));
+		if ((n == 0) && __atomic_load_n(&pCon->stop, __ATOMIC_ACQUIRE))
+			break;
+		if (pCon->delayUs)
+			usleep(pCon->delayUs);
+		else if (n == 0)
+			usleep(TAP_IDLE_US);
+	}
+
+	return NULL;
+}
+
+static int tapCmpU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int tapRun(TapPhase_t phase, uint32_t collections, size_t bytes, uint32_t delayUs, int fd)
+{
+	static uint8_t buf[TAP_MAX_BYTES];
+	CCTrngNoiseTapStats_t s0, s1;
+	TapConsumer_t con;
+	uint64_t *lat, t0;
+	size_t outLen;
+	uint32_t i, ehrs, records, drops, errors = 0;
+
+	lat = calloc(collections, sizeof(lat[0]));
+	if (lat == NULL) {
+		TZTRNG_PRINTF("failed to allocate buffers\n");
+		return 1;
+	}
+	memset(&con, 0, sizeof(con));
+	con.fd = fd;
+	con.batch = (phase == TAP_PHASE_SLOW) ? 1 : TAP_FAST_BATCH;
+	con.delayUs = (phase == TAP_PHASE_SLOW) ? delayUs : 0;
+
+	CC_TrngNoiseTapGetStats(&s0);
+	con.nextSeq = s0.ehrs;
+	if (phase != TAP_PHASE_OFF) {
+		CC_TrngNoiseTapStart();
+		if (pthread_create(&con.thread, NULL, tapConsumer, &con) != 0) {
+			TZTRNG_PRINTF("failed to start the consumer\n");
+			CC_TrngNoiseTapStop();
+			free(lat);
+			return 1;
+		}
+	}
+
+	gCollections = 0;
+	for (i = 0; i < collections; i++) {
+		t0 = tapNowNs();
+		if (CC_TrngGetSource(gRegBase, buf, &outLen, bytes * 8) != 0)
+			errors++;
+		lat[i] = tapNowNs() - t0;
+	}
+	memset(buf, 0, sizeof(buf));
+
+	if (phase != TAP_PHASE_OFF) {
+		CC_TrngNoiseTapStop();
+		__atomic_store_n(&con.stop, 1, __ATOMIC_RELEASE);
+		pthread_join(con.thread, NULL);
+	}
+	CC_TrngNoiseTapGetStats(&s1);
+	ehrs = s1.ehrs - s0.ehrs;
+	records = s1.records - s0.records;
+	drops = s1.drops - s0.drops;
+
+	qsort(lat, collections, sizeof(lat[0]), tapCmpU64);
+	printf("%s,%u,%u,%u,%u,%llu,%.1f,%.1f\n", gPhaseNames[phase], (unsigned int)gCollections, (unsigned int)ehrs,
+	       (unsigned int)records, (unsigned int)drops, (unsigned long long)con.written,
+	       lat[(collections - 1) * 50 / 100] / 1000.0, lat[collections - 1] / 1000.0);
+	fflush(stdout);
+	free(lat);
+
+	if (phase == TAP_PHASE_OFF) {
+		if (ehrs != 0) {
+			TZTRNG_PRINTF("%s: %u EHRs counted with the tap off\n", gPhaseNames[phase], (unsigned int)ehrs);
+			errors++;
+		}
+	} else if ((records + drops != ehrs) || (con.records != records) ||
+		   (con.gaps + (s1.ehrs - con.nextSeq) != drops) ||
+		   (con.disorder != 0) || (con.badSource != 0) || (s1.level != 0)) {
+		TZTRNG_PRINTF("%s: %u EHRs, %u records (%u read), %u drops (%u gaps), %u out of order, "
+			      "%u bad sources, %u left\n", gPhaseNames[phase], (unsigned int)ehrs,
+			      (unsigned int)records, (unsigned int)con.records, (unsigned int)drops,
+			      (unsigned int)con.gaps, (unsigned int)con.disorder, (unsigned int)con.badSource,
+			      (unsigned int)s1.level);
+		errors++;
+	}
+	if ((phase == TAP_PHASE_SLOW) && (drops == 0)) {
+		TZTRNG_PRINTF("%s: the consumer never fell behind, raise -d\n", gPhaseNames[phase]);
+		errors++;
+	}
+	if (errors) {
+		TZTRNG_PRINTF("%s: FAILED\n", gPhaseNames[phase]);
+		return 1;
+	}
+	return 0;
+}
+
+static int tapCheck(int cond, const char *what)
+{
+	if (!cond)
+		TZTRNG_PRINTF("check failed: %s\n", what);
+	return cond ? 0 : 1;
+}
+
+static int tapApiChecks(void)
+{
+	CCTrngNoiseRecord_t rec;
+	CCTrngNoiseTapStats_t s0, s1;
+	uint8_t buf[32];
+	size_t outLen;
+	uint32_t n = 1;
+	int fail = 0;
+
+	fail |= tapCheck(CC_TrngNoiseTapRead(NULL, 1, &n) != 0, "NULL records fails");
+	fail |= tapCheck(CC_TrngNoiseTapRead(&rec, 1, NULL) != 0, "NULL count fails");
+	fail |= tapCheck(CC_TrngNoiseTapGetStats(NULL) != 0, "NULL stats fails");
+	fail |= tapCheck((CC_TrngNoiseTapRead(&rec, 1, &n) == 0) && (n == 0), "empty ring, no record");
+
+	/* records left in the ring are discarded by the next start */
+	CC_TrngNoiseTapGetStats(&s0);
+	CC_TrngNoiseTapStart();
+	CC_TrngGetSource(gRegBase, buf, &outLen, sizeof(buf) * 8);
+	CC_TrngNoiseTapStop();
+	CC_TrngNoiseTapGetStats(&s1);
+	fail |= tapCheck((s1.records > s0.records) && (s1.level == s1.records - s0.records), "a collection is recorded");
+	fail |= tapCheck((CC_TrngNoiseTapRead(&rec, 1, &n) == 0) && (n == 1) && (rec.seq == s0.ehrs),
+			 "the records stay readable after the stop");
+	CC_TrngNoiseTapStart();
+	CC_TrngNoiseTapStop();
+	CC_TrngNoiseTapGetStats(&s1);
+	fail |= tapCheck(s1.level == 0, "the start discards the records left");
+	memset(buf, 0, sizeof(buf));
+	memset(&rec, 0, sizeof(rec));
+
+	return fail;
+}
+
+static void tapUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-m] [-n collections] [-b bytes] [-d delayUs] [-o file]\n", prog);
+	TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+	TZTRNG_PRINTF("  -b  bytes per collection, at most %u (default %u)\n", (unsigned int)TAP_MAX_BYTES,
+		      (unsigned int)TAP_DEFAULT_BYTES);
+	TZTRNG_PRINTF("  -d  pause of the slow consumer after each record (default %u)\n",
+		      (unsigned int)TAP_DEFAULT_DELAY_US);
+	TZTRNG_PRINTF("  -o  file for the raw EHR bytes of the fast and slow phases\n");
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t collections = TAP_DEFAULT_COLLECTIONS, delayUs = TAP_DEFAULT_DELAY_US;
+	size_t bytes = TAP_DEFAULT_BYTES;
+	const char *outPath = NULL;
+	int opt, fd = -1, fail = 0;
+
+	while ((opt = getopt(argc, argv, "mn:b:d:o:")) != -1) {
+		switch (opt) {
+		case 'm':
+			gUseModel = 1;
+			break;
+		case 'n':
+			collections = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			bytes = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			delayUs = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			outPath = optarg;
+			break;
+		default:
+			tapUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((collections == 0) || (bytes == 0) || (bytes > TAP_MAX_BYTES) || (delayUs == 0)) {
+		tapUsage(argv[0]);
+		return 1;
+	}
+	if (outPath != NULL) {
+		fd = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if (fd < 0) {
+			TZTRNG_PRINTF("cannot open %s\n", outPath);
+			return 1;
+		}
+	}
+
+	gRegBase = tztrngTest_target(gUseModel, NULL, &gTapHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	fail |= tapApiChecks();
+
+	printf("# tztrng_noise_tap target=%s collections=%u bytes=%zu slow_delay_us=%u\n",
+	       gUseModel ? "model" : "hw", (unsigned int)collections, bytes, (unsigned int)delayUs);
+	printf("phase,collections,ehrs,records,drops,written,collect_p50_us,collect_max_us\n");
+	fail |= tapRun(TAP_PHASE_OFF, collections, bytes, delayUs, fd);
+	fail |= tapRun(TAP_PHASE_FAST, collections, bytes, delayUs, fd);
+	fail |= tapRun(TAP_PHASE_SLOW, collections, bytes, delayUs, fd);
+
+	if (fd >= 0)
+		close(fd);
+	CC_TrngSetMmioOps(NULL);
+	tztrngTest_targetRelease(gRegBase);
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
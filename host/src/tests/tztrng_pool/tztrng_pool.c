@@ -0,0 +1,450 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+/*
+ * Entropy pool test tool (library built with CC_CONFIG_TRNG_POOL = 1,
+ * CC_CONFIG_TRNG_LOCK = 1 and CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * N reader threads request 16 to 256 bytes at a time, first straight from
+ * CC_TrngGetSource(), then from CC_TrngPoolRead() on a pool that was allowed to
+ * fill first. One CSV row per source is written to stdout:
+ * source,threads,reads,errors,duplicates,reader_hw_accesses,bytes_per_sec,p50_us,p99_us,max_us
+ * reader_hw_accesses counts register accesses made on a reader thread; it must
+ * be 0 for the pool. The pool status after the run is written as a comment.
+ * Readers that together ask for more than the TRNG produces drain the pool and
+ * then wait for the producer; -p paces each reader to measure below that rate.
+ *
+ * The API checks cover start and stop errors, concurrent starts of which
+ * exactly one may succeed, reads of a stopped pool, and a
+ * TRNG failure (all ROSCs stuck, model only): once the pool is drained the
+ * readers get the error, and the pool recovers after the fault is cleared.
+ */
+
+#define POOL_DEFAULT_THREADS 		8
+#define POOL_DEFAULT_READS 		200
+#define POOL_MAX_THREADS 		256
+#define POOL_MIN_READ_BYTES 		16
+#define POOL_MAX_READ_BYTES 		256
+#define POOL_PRINT_BYTES 		16
+#define POOL_FILL_TIMEOUT_MS 		10000
+#define POOL_POLL_MS 			1
+#define POOL_NS_PER_SEC 		1000000000ULL
+/* threads racing CC_TrngPoolStart, and rounds of the race */
+#define POOL_START_RACERS 		8
+#define POOL_START_ROUNDS 		2000
+
+typedef enum {
+	POOL_SRC_DIRECT = 0,
+	POOL_SRC_POOL = 1,
+} PoolSrc_t;
+
+typedef struct {
+	uint64_t lo;
+	uint64_t hi;
+} PoolPrint_t;
+
+typedef struct {
+	pthread_t thread;
+	PoolSrc_t src;
+	uint32_t reads;
+	uint64_t rng;
+	uint64_t *lat;			/* ns per read */
+	PoolPrint_t *prints;		/* leading bytes of every output */
+	uint64_t bytes;
+	uint32_t errors;
+} PoolThread_t;
+
+static int gUseModel;
+static unsigned long gRegBase;
+static uint32_t gPauseUs;
+static pthread_mutex_t gModelLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int gIsReader;
+static volatile uint32_t gReaderHwAccesses;
+
+static uint64_t poolNowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * POOL_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static void poolSleepMs(uint32_t ms)
+{
+	usleep(ms * 1000);
+}
+
+/* register accesses made by reader threads: zero once the pool serves them */
+static void poolAccess(void *ctx, uint32_t offset)
+{
+	(void)ctx;
+	(void)offset;
+	if (gIsReader)
+		__sync_fetch_and_add(&gReaderHwAccesses, 1);
+}
+
+static void poolModelLock(void *ctx)
+{
+	(void)ctx;
+	pthread_mutex_lock(&gModelLock);
+}
+
+static void poolModelUnlock(void *ctx)
+{
+	(void)ctx;
+	pthread_mutex_unlock(&gModelLock);
+}
+
+static const TztrngTestHooks_t gPoolHooks = {
+	poolAccess,
+	NULL,
+	poolModelLock,
+	poolModelUnlock,
+	NULL,
+};
+
+/* xorshift64: read sizes only */
+static uint32_t poolRand(uint64_t *pState)
+{
+	*pState ^= *pState << 13;
+	*pState ^= *pState >> 7;
+	*pState ^= *pState << 17;
+	return (uint32_t)*pState;
+}
+
+static void *poolThread(void *arg)
+{
+	PoolThread_t *pThr = arg;
+	uint8_t buf[POOL_MAX_READ_BYTES];
+	size_t len, outputLen;
+	uint64_t t0;
+	uint32_t r, err;
+
+	gIsReader = 1;
+	for (r = 0; r < pThr->reads; r++) {
+		len = POOL_MIN_READ_BYTES +
+		      poolRand(&pThr->rng) % (POOL_MAX_READ_BYTES - POOL_MIN_READ_BYTES + 1);
+
+		t0 = poolNowNs();
+		if (pThr->src == POOL_SRC_POOL) {
+			err = CC_TrngPoolRead(buf, len);
+			outputLen = len;
+		} else {
+			err = CC_TrngGetSource(gRegBase, buf, &outputLen, len * 8);
+		}
+		pThr->lat[r] = poolNowNs() - t0;
+
+		if (err || (outputLen != len)) {
+			pThr->errors++;
+			TZTRNG_PRINTF("read %u (%zu bytes): error(0x%X)\n", (unsigned int)r, len, err);
+			continue;
+		}
+		pThr->bytes += len;
+		memcpy(&pThr->prints[r], buf, POOL_PRINT_BYTES);
+		if (gPauseUs)
+			usleep(gPauseUs);
+	}
+
+	return NULL;
+}
+
+static int poolCmpU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int poolCmpPrint(const void *a, const void *b)
+{
+	const PoolPrint_t *x = a, *y = b;
+
+	if (x->hi != y->hi)
+		return (x->hi > y->hi) - (x->hi < y->hi);
+	return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+/* wait until the pool reaches its high watermark */
+static int poolWaitFull(void)
+{
+	CCTrngPoolStatus_t status;
+	uint32_t ms;
+
+	for (ms = 0; ms < POOL_FILL_TIMEOUT_MS; ms += POOL_POLL_MS) {
+		if ((CC_TrngPoolGetStatus(&status) == 0) && (status.level >= status.highWatermark))
+			return 0;
+		poolSleepMs(POOL_POLL_MS);
+	}
+
+	TZTRNG_PRINTF("pool not filled after %u ms\n", (unsigned int)POOL_FILL_TIMEOUT_MS);
+	return 1;
+}
+
+static int poolRun(PoolSrc_t src, uint32_t threads, uint32_t reads)
+{
+	PoolThread_t thr[POOL_MAX_THREADS];
+	uint64_t *lat;
+	PoolPrint_t *prints;
+	uint64_t t0, t1, bytes = 0;
+	uint32_t i, started, total = threads * reads;
+	uint32_t errors = 0, duplicates = 0, n = 0;
+
+	lat = malloc(total * sizeof(lat[0]));
+	prints = malloc(total * sizeof(prints[0]));
+	if ((lat == NULL) || (prints == NULL)) {
+		TZTRNG_PRINTF("failed to allocate buffers\n");
+		free(lat);
+		free(prints);
+		return 1;
+	}
+	memset(prints, 0, total * sizeof(prints[0]));
+	gReaderHwAccesses = 0;
+
+	memset(thr, 0, sizeof(thr));
+	t0 = poolNowNs();
+	for (started = 0; started < threads; started++) {
+		thr[started].src = src;
+		thr[started].reads = reads;
+		thr[started].rng = 0x9E3779B97F4A7C15ULL * (started + 1);
+		thr[started].lat = lat + started * reads;
+		thr[started].prints = prints + started * reads;
+		if (pthread_create(&thr[started].thread, NULL, poolThread, &thr[started]) != 0) {
+			TZTRNG_PRINTF("failed to start thread %u\n", (unsigned int)started);
+			break;
+		}
+	}
+	for (i = 0; i < started; i++) {
+		pthread_join(thr[i].thread, NULL);
+		bytes += thr[i].bytes;
+		errors += thr[i].errors;
+	}
+	t1 = poolNowNs();
+
+	/* failed reads left their fingerprint zero */
+	qsort(prints, started * reads, sizeof(prints[0]), poolCmpPrint);
+	for (i = 0; i < started * reads; i++) {
+		if ((prints[i].lo == 0) && (prints[i].hi == 0))
+			continue;
+		if ((n > 0) && (poolCmpPrint(&prints[i], &prints[n - 1]) == 0))
+			duplicates++;
+		prints[n++] = prints[i];
+	}
+
+	total = started * reads;
+	qsort(lat, total, sizeof(lat[0]), poolCmpU64);
+	printf("%s,%u,%u,%u,%u,%u,%.0f,%.1f,%.1f,%.1f\n", (src == POOL_SRC_POOL) ? "pool" : "direct",
+	       (unsigned int)started, (unsigned int)total, (unsigned int)errors, (unsigned int)duplicates,
+	       (unsigned int)gReaderHwAccesses,
+	       (t1 > t0) ? (double)bytes * POOL_NS_PER_SEC / (t1 - t0) : 0.0,
+	       lat[(total - 1) * 50 / 100] / 1000.0, lat[(total - 1) * 99 / 100] / 1000.0,
+	       lat[total - 1] / 1000.0);
+	fflush(stdout);
+
+	free(lat);
+	free(prints);
+
+	return ((started != threads) || errors || duplicates ||
+		((src == POOL_SRC_POOL) && gReaderHwAccesses)) ? 1 : 0;
+}
+
+static int poolCheck(int cond, const char *what)
+{
+	if (!cond)
+		TZTRNG_PRINTF("check failed: %s\n", what);
+	return cond ? 0 : 1;
+}
+
+static void poolSetFault(TztrngModelFault_t fault)
+{
+	uint32_t i;
+
+	pthread_mutex_lock(&gModelLock);
+	for (i = 0; i < CC_TRNG_NUM_OF_ROSCS; i++)
+		tztrngModel_setFault(i, fault, 0);
+	pthread_mutex_unlock(&gModelLock);
+}
+
+static pthread_barrier_t gStartBarrier;
+static volatile uint32_t gStarts;
+
+static void *poolStartThread(void *arg)
+{
+	(void)arg;
+	pthread_barrier_wait(&gStartBarrier);
+	if (CC_TrngPoolStart(gRegBase) == 0)
+		__sync_fetch_and_add(&gStarts, 1);
+	return NULL;
+}
+
+/* concurrent starts: exactly one claims the pool, and it stops cleanly */
+static int poolStartRace(void)
+{
+	pthread_t thr[POOL_START_RACERS];
+	uint32_t round, i, started;
+	int fail = 0;
+
+	pthread_barrier_init(&gStartBarrier, NULL, POOL_START_RACERS);
+	for (round = 0; (round < POOL_START_ROUNDS) && !fail; round++) {
+		gStarts = 0;
+		for (started = 0; started < POOL_START_RACERS; started++) {
+			if (pthread_create(&thr[started], NULL, poolStartThread, NULL) != 0)
+				break;
+		}
+		/* a short race leaves the others at the barrier forever */
+		if (started != POOL_START_RACERS) {
+			TZTRNG_PRINTF("failed to start the start racers\n");
+			exit(1);
+		}
+		for (i = 0; i < started; i++)
+			pthread_join(thr[i], NULL);
+		fail |= poolCheck(gStarts == 1, "exactly one of concurrent starts succeeds");
+		fail |= poolCheck(CC_TrngPoolStop() == 0, "stop after concurrent starts");
+	}
+	pthread_barrier_destroy(&gStartBarrier);
+
+	return fail;
+}
+
+/* start/stop errors, reads of a stopped pool and (model) a failing TRNG */
+static int poolApiChecks(void)
+{
+	CCTrngPoolStatus_t status;
+	uint8_t buf[POOL_MAX_READ_BYTES];
+	uint32_t err, i, fail = 0;
+
+	memset(buf, 0xA5, sizeof(buf));
+	fail |= poolCheck(CC_TrngPoolRead(buf, sizeof(buf)) != 0, "read before start fails");
+	fail |= poolCheck(buf[0] == 0 && buf[sizeof(buf) - 1] == 0, "failed read wipes the output");
+	fail |= poolCheck(CC_TrngPoolStop() != 0, "stop before start fails");
+	fail |= poolCheck(CC_TrngPoolStart(0) != 0, "start with a zero base fails");
+	fail |= poolCheck(CC_TrngPoolStart(gRegBase) == 0, "start");
+	fail |= poolCheck(CC_TrngPoolStart(gRegBase) != 0, "second start fails");
+	fail |= poolCheck(CC_TrngPoolRead(NULL, 1) != 0, "NULL read fails");
+	fail |= poolCheck(CC_TrngPoolGetStatus(NULL) != 0, "NULL status fails");
+	fail |= poolCheck(CC_TrngPoolRead(buf, sizeof(buf)) == 0, "read");
+
+	if (gUseModel) {
+		/* the producer fails from now on; the readers get the error once the pool is empty */
+		poolSetFault(TZTRNG_MODEL_FAULT_STUCK_0);
+		err = 0;
+		for (i = 0; (i < 1000) && (err == 0); i++)
+			err = CC_TrngPoolRead(buf, sizeof(buf));
+		fail |= poolCheck(err != 0, "reads fail once the pool is drained on a failing TRNG");
+		fail |= poolCheck((CC_TrngPoolGetStatus(&status) == 0) && (status.refillErrors > 0) &&
+				  (status.lastError == err), "status reports the refill error");
+
+		poolSetFault(TZTRNG_MODEL_FAULT_NONE);
+		err = 1;
+		for (i = 0; (i < POOL_FILL_TIMEOUT_MS / POOL_POLL_MS) && (err != 0); i++) {
+			err = CC_TrngPoolRead(buf, sizeof(buf));
+			if (err != 0)
+				poolSleepMs(POOL_POLL_MS);
+		}
+		fail |= poolCheck(err == 0, "pool recovers after the fault is cleared");
+	}
+
+	fail |= poolCheck(CC_TrngPoolStop() == 0, "stop");
+	fail |= poolCheck(CC_TrngPoolRead(buf, sizeof(buf)) != 0, "read after stop fails");
+	fail |= poolCheck(CC_TrngPoolStop() != 0, "second stop fails");
+	fail |= poolStartRace();
+
+	return fail;
+}
+
+static void poolUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-m] [-t threads] [-n readsPerThread] [-p pauseUs]\n", prog);
+	TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+	TZTRNG_PRINTF("  -p  pause of each reader between reads (default 0)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	CCTrngPoolStatus_t status;
+	uint32_t threads = POOL_DEFAULT_THREADS, reads = POOL_DEFAULT_READS;
+	int opt, fail = 0;
+
+	while ((opt = getopt(argc, argv, "mt:n:p:")) != -1) {
+		switch (opt) {
+		case 'm':
+			gUseModel = 1;
+			break;
+		case 't':
+			threads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			reads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			gPauseUs = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			poolUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((threads == 0) || (threads > POOL_MAX_THREADS) || (reads == 0)) {
+		poolUsage(argv[0]);
+		return 1;
+	}
+
+	gRegBase = tztrngTest_target(gUseModel, NULL, &gPoolHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	fail |= poolApiChecks();
+
+	printf("# tztrng_pool target=%s pause_us=%u\n", gUseModel ? "model" : "hw", (unsigned int)gPauseUs);
+	printf("source,threads,reads,errors,duplicates,reader_hw_accesses,bytes_per_sec,p50_us,p99_us,max_us\n");
+
+	fail |= poolRun(POOL_SRC_DIRECT, threads, reads);
+
+	if (CC_TrngPoolStart(gRegBase) != 0) {
+		TZTRNG_PRINTF("failed to start the pool\n");
+		fail = 1;
+	} else {
+		fail |= poolWaitFull();
+		fail |= poolRun(POOL_SRC_POOL, threads, reads);
+		if (CC_TrngPoolGetStatus(&status) == 0)
+			printf("# pool capacity=%u low=%u high=%u level=%u refills=%u refill_errors=%u "
+			       "reads=%u read_waits=%u bytes_read=%u\n",
+			       (unsigned int)status.capacity, (unsigned int)status.lowWatermark,
+			       (unsigned int)status.highWatermark, (unsigned int)status.level,
+			       (unsigned int)status.refills, (unsigned int)status.refillErrors,
+			       (unsigned int)status.reads, (unsigned int)status.readWaits,
+			       (unsigned int)status.bytesRead);
+		fail |= (CC_TrngPoolStop() != 0);
+	}
+
+	CC_TrngSetMmioOps(NULL);
+	tztrngTest_targetRelease(gRegBase);
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
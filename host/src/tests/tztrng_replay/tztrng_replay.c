@@ -0,0 +1,235 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_test_pal_api.h"
+
+#include "dx_reg_base_host.h"
+
+/*
+ * MMIO trace tool (library built with CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * record: on a Linux target, maps the TRNG through /dev/mem, runs 'count'
+ *         CC_TrngGetSource calls of 'reqBits' bits and writes the register
+ *         access trace to a file.
+ * replay: on any Linux host, runs the unmodified driver against a trace,
+ *         issuing the same requests, and reports divergences and the MMIO
+ *         cost per delivered byte.
+ */
+
+#define REPLAY_TRACE_MAX_BYTES 			(16 * 1024 * 1024)
+#define REPLAY_DEFAULT_REQ_BITS 		(256 * 8)
+#define REPLAY_DEFAULT_COUNT 			100
+/* any non zero base: the replay backend never dereferences it */
+#define REPLAY_FAKE_REG_BASE 			0x1000UL
+
+static const char *opName[] = { "read", "write", "request" };
+
+static void replayUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s record <trace> [reqBits] [count]\n", prog);
+	TZTRNG_PRINTF("       %s replay <trace>\n", prog);
+}
+
+static int replayRecord(const char *path, size_t reqBits, int count)
+{
+	int err = 0, i;
+	unsigned long baseRngReg;
+	uint32_t *trace;
+	unsigned char *buf;
+	size_t outputLen, traceLen = 0;
+	FILE *fp;
+
+	trace = tztrngTest_pal_malloc(REPLAY_TRACE_MAX_BYTES);
+	buf = tztrngTest_pal_malloc((reqBits + 7) / 8);
+	if ((trace == NULL) || (buf == NULL))
+	{
+		TZTRNG_PRINTF("failed to allocate buffers\n");
+		err = 1;
+		goto EndNoUnmap;
+	}
+
+	baseRngReg = tztrngTest_pal_mapCcRegs(DX_BASE_RNG);
+
+	err = CC_TrngMmioRecordStart(trace, REPLAY_TRACE_MAX_BYTES);
+	if (err)
+	{
+		TZTRNG_PRINTF("CC_TrngMmioRecordStart error(0x%X)\n", err);
+		goto End;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		err = CC_TrngGetSource(baseRngReg, buf, &outputLen, reqBits);
+		if (err)
+		{
+			/* failures are part of the behavior being recorded */
+			TZTRNG_PRINTF("request %d error(0x%X)\n", i, err);
+		}
+	}
+
+	err = CC_TrngMmioRecordStop(&traceLen);
+	if (err)
+		TZTRNG_PRINTF("trace truncated, increase REPLAY_TRACE_MAX_BYTES\n");
+
+	fp = fopen(path, "wb");
+	if ((fp == NULL) || (fwrite(trace, traceLen, 1, fp) != 1))
+	{
+		TZTRNG_PRINTF("failed to write %s\n", path);
+		err = 1;
+	}
+	if (fp != NULL)
+		fclose(fp);
+
+	TZTRNG_PRINTF("recorded %d requests, %u accesses, %zu bytes\n", count,
+		      (unsigned int)((CCTrngMmioTraceHdr_t *)(void *)trace)->records, traceLen);
+
+End:
+	tztrngTest_pal_unmapCcRegs(baseRngReg);
+
+EndNoUnmap:
+	tztrngTest_pal_free(buf);
+	tztrngTest_pal_free(trace);
+
+	return err;
+}
+
+static int replayRun(const char *path)
+{
+	int err = 0;
+	uint32_t *trace;
+	unsigned char *buf = NULL;
+	size_t traceLen, outputLen, bufSize = 0, delivered = 0;
+	uint32_t i, failed = 0;
+	const CCTrngMmioTraceHdr_t *pHdr;
+	const CCTrngMmioTraceRec_t *pRec;
+	CCTrngMmioReplayReport_t report;
+	FILE *fp;
+
+	trace = tztrngTest_pal_malloc(REPLAY_TRACE_MAX_BYTES);
+	if (trace == NULL)
+	{
+		TZTRNG_PRINTF("failed to allocate trace buffer\n");
+		return 1;
+	}
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+	{
+		TZTRNG_PRINTF("failed to open %s\n", path);
+		tztrngTest_pal_free(trace);
+		return 1;
+	}
+	traceLen = fread(trace, 1, REPLAY_TRACE_MAX_BYTES, fp);
+	fclose(fp);
+
+	err = CC_TrngMmioReplayStart(trace, traceLen);
+	if (err)
+	{
+		TZTRNG_PRINTF("CC_TrngMmioReplayStart error(0x%X): bad trace or TRNG mode mismatch\n", err);
+		tztrngTest_pal_free(trace);
+		return 1;
+	}
+
+	/* issue the recorded requests, in order */
+	pHdr = (const CCTrngMmioTraceHdr_t *)(void *)trace;
+	pRec = (const CCTrngMmioTraceRec_t *)(const void *)(pHdr + 1);
+	for (i = 0; i < pHdr->records; i++)
+	{
+		if (pRec[i].op != CC_TRNG_MMIO_OP_REQUEST)
+			continue;
+
+		if (bufSize < (pRec[i].value + 7) / 8)
+		{
+			tztrngTest_pal_free(buf);
+			bufSize = (pRec[i].value + 7) / 8;
+			buf = tztrngTest_pal_malloc(bufSize);
+			if (buf == NULL)
+			{
+				TZTRNG_PRINTF("failed to allocate %zu bytes\n", bufSize);
+				break;
+			}
+		}
+
+		if (CC_TrngGetSource(REPLAY_FAKE_REG_BASE, buf, &outputLen, pRec[i].value) == 0)
+			delivered += outputLen;
+		else
+			failed++;
+	}
+
+	CC_TrngMmioReplayStop(&report);
+
+	TZTRNG_PRINTF("trace: %u records%s\n", (unsigned int)report.records,
+		      (pHdr->flags & CC_TRNG_MMIO_TRACE_TRUNCATED) ? " (truncated)" : "");
+	TZTRNG_PRINTF("requests: %u (%u failed), bytes delivered: %zu\n",
+		      (unsigned int)report.requests, (unsigned int)failed, delivered);
+	TZTRNG_PRINTF("mmio: %u reads, %u writes", (unsigned int)report.reads, (unsigned int)report.writes);
+	if (delivered != 0)
+		TZTRNG_PRINTF(", %.2f accesses/byte, %.1f traced ticks/byte",
+			      (double)(report.reads + report.writes) / delivered,
+			      (double)report.tracedTicks / delivered);
+	TZTRNG_PRINTF("\n");
+	TZTRNG_PRINTF("consumed: %u of %u records%s\n", (unsigned int)report.consumed,
+		      (unsigned int)report.records, report.exhausted ? ", trace exhausted" : "");
+
+	if (report.divergences != 0)
+	{
+		TZTRNG_PRINTF("DIVERGED: %u accesses did not match the trace\n", (unsigned int)report.divergences);
+		TZTRNG_PRINTF("first at record %u: expected %s 0x%03x = 0x%08x, got %s 0x%03x = 0x%08x\n",
+			      (unsigned int)report.firstDivergenceIdx,
+			      opName[report.expected.op % 3], (unsigned int)report.expected.offset,
+			      (unsigned int)report.expected.value,
+			      opName[report.actual.op % 3], (unsigned int)report.actual.offset,
+			      (unsigned int)report.actual.value);
+		err = 2;
+	}
+	else if (report.consumed != report.records)
+	{
+		TZTRNG_PRINTF("DIVERGED: %u trailing records not replayed\n",
+			      (unsigned int)(report.records - report.consumed));
+		err = 2;
+	}
+	else
+	{
+		TZTRNG_PRINTF("replay matched\n");
+	}
+
+	tztrngTest_pal_free(buf);
+	tztrngTest_pal_free(trace);
+
+	return err;
+}
+
+int main(int argc, char *argv[])
+{
+	if ((argc >= 3) && (strcmp(argv[1], "record") == 0))
+	{
+		return replayRecord(argv[2],
+				    (argc > 3) ? (size_t)strtoul(argv[3], NULL, 0) : REPLAY_DEFAULT_REQ_BITS,
+				    (argc > 4) ? atoi(argv[4]) : REPLAY_DEFAULT_COUNT);
+	}
+	if ((argc == 3) && (strcmp(argv[1], "replay") == 0))
+		return replayRun(argv[2]);
+
+	replayUsage(argv[0]);
+	return 1;
+}
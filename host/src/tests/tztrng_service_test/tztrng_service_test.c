@@ -0,0 +1,490 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+#include "tztrng_defs.h"
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+/*
+ * FreeRTOS entropy service test (library built with TEE_OS=freertos,
+ * FREERTOS_PORT=posix, CC_CONFIG_TRNG_SERVICE = 1 and
+ * CC_CONFIG_TRNG_MMIO_HOOKS = 1), on the FreeRTOS POSIX port and the RNG
+ * register model.
+ *
+ * A "hardware" task at the top priority lets -c model clocks pass every tick
+ * and calls CC_TrngServiceIrqHandler() while the RNG interrupt line of the
+ * model is raised. The phases:
+ * - mixed: -n requester tasks at each of three priorities make -k requests of
+ *   8 to 256 bytes; the highest ones are urgent,
+ * - inversion_normal / inversion_urgent: a task of a priority between the
+ *   service and the requester spins for SVC_HOG_TICKS while a high priority
+ *   requester makes -k requests, first plain, then urgent. Only the urgent
+ *   ones lend the requester's priority to the service, so only they are served
+ *   while the spinning task runs; their latency must stay below half of it,
+ * - fault: a request on failing ROSCs must fail with a wiped buffer, the next
+ *   one on healthy ROSCs must succeed,
+ * - stop: SVC_STOP_TASKS requester tasks keep requesting while the service
+ *   is stopped under them, SVC_STOP_ROUNDS times. Every call must return,
+ *   with the state error once the service stops, within SVC_STOP_TICKS.
+ * One CSV row per phase:
+ * phase,requests,urgent,bytes,buffer_hits,collections,irq_wakeups,timeout_wakeups,boosts,p50_ms,max_ms
+ * counted by the service over the phase; p50/max is the request latency.
+ * Every request must succeed without a duplicate.
+ */
+
+#define SVC_DEFAULT_TASKS		4
+#define SVC_DEFAULT_REQUESTS		25
+/* model time: a 100 MHz rng clock and a 1 ms tick */
+#define SVC_DEFAULT_CLOCKS_PER_TICK	100000
+#define SVC_MIN_READ			8
+#define SVC_MAX_READ			256
+#define SVC_HOG_TICKS			pdMS_TO_TICKS(500)
+/* request of the fault check: more than the prefill buffer, so a collection is needed */
+#define SVC_FAULT_READ			2048
+#define SVC_MAX_LOG			4096
+#define SVC_STOP_ROUNDS			200
+#define SVC_STOP_TASKS			16
+#define SVC_STOP_TICKS			pdMS_TO_TICKS(2000)
+
+#define SVC_PRIO_SERVICE		CC_CONFIG_TRNG_SERVICE_TASK_PRIORITY
+#define SVC_PRIO_LOW			(SVC_PRIO_SERVICE)
+#define SVC_PRIO_MID			(SVC_PRIO_SERVICE + 1)
+#define SVC_PRIO_HOG			(SVC_PRIO_SERVICE + 2)
+#define SVC_PRIO_HIGH			(SVC_PRIO_SERVICE + 3)
+#define SVC_PRIO_CONTROL		(configMAX_PRIORITIES - 2)
+#define SVC_PRIO_HW			(configMAX_PRIORITIES - 1)
+
+typedef struct {
+	UBaseType_t priority;
+	uint32_t flags;
+	uint32_t requests;
+	uint64_t seed;
+} SvcRequester_t;
+
+static uint32_t gClocksPerTick = SVC_DEFAULT_CLOCKS_PER_TICK;
+static uint32_t gTasks = SVC_DEFAULT_TASKS;
+static uint32_t gRequests = SVC_DEFAULT_REQUESTS;
+static SemaphoreHandle_t gDone;
+static volatile uint32_t gHogRunning;
+
+/* request log of the phase, under the critical section */
+static uint64_t gPrints[SVC_MAX_LOG];
+static uint32_t gLatency[SVC_MAX_LOG];
+static uint32_t gLogged;
+static uint32_t gErrors;
+static unsigned long gRegBase;
+
+static void svcModelLock(void *ctx)
+{
+	(void)ctx;
+	taskENTER_CRITICAL();
+}
+
+static void svcModelUnlock(void *ctx)
+{
+	(void)ctx;
+	taskEXIT_CRITICAL();
+}
+
+static const TztrngTestHooks_t gSvcHooks = {
+	NULL,
+	NULL,
+	svcModelLock,
+	svcModelUnlock,
+	NULL,
+};
+
+/* configASSERT of FreeRTOSConfig.h */
+void vAssertCalled(const char *file, unsigned long line)
+{
+	TZTRNG_PRINTF("assert %s:%lu\n", file, line);
+	exit(2);
+}
+
+/* xorshift64: request sizes only */
+static uint32_t svcRand(uint64_t *pState)
+{
+	*pState ^= *pState << 13;
+	*pState ^= *pState >> 7;
+	*pState ^= *pState << 17;
+	return (uint32_t)*pState;
+}
+
+/* The RNG: model time passes, the interrupt is raised while an unmasked event is pending */
+static void svcHwTask(void *arg)
+{
+	uint32_t pending;
+
+	(void)arg;
+	for (;;) {
+		vTaskDelay(1);
+		taskENTER_CRITICAL();
+		tztrngModel_tick(gClocksPerTick);
+		pending = tztrngModel_irqPending();
+		taskEXIT_CRITICAL();
+		if (pending)
+			CC_TrngServiceIrqHandler();
+	}
+}
+
+static void svcRequesterTask(void *arg)
+{
+	SvcRequester_t *pReq = (SvcRequester_t *)arg;
+	uint8_t buf[SVC_MAX_READ];
+	uint64_t print;
+	uint32_t i, len, err;
+	TickType_t start, latency;
+
+	for (i = 0; i < pReq->requests; i++) {
+		len = SVC_MIN_READ + svcRand(&pReq->seed) % (SVC_MAX_READ - SVC_MIN_READ + 1);
+		start = xTaskGetTickCount();
+		err = CC_TrngServiceGet(buf, len, pReq->flags);
+		latency = xTaskGetTickCount() - start;
+		memcpy(&print, buf, sizeof(print));
+
+		taskENTER_CRITICAL();
+		if (err != 0) {
+			gErrors++;
+		} else if (gLogged < SVC_MAX_LOG) {
+			gPrints[gLogged] = print;
+			gLatency[gLogged] = (uint32_t)latency;
+			gLogged++;
+		}
+		taskEXIT_CRITICAL();
+		if (err != 0)
+			TZTRNG_PRINTF("request failed, err[0x%x]\n", (unsigned int)err);
+		if (!gHogRunning)
+			vTaskDelay(1 + svcRand(&pReq->seed) % 3);
+	}
+
+	xSemaphoreGive(gDone);
+	vTaskDelete(NULL);
+}
+
+/* Spin between the service and the high priority requesters */
+static void svcHogTask(void *arg)
+{
+	TickType_t start = xTaskGetTickCount();
+
+	(void)arg;
+	gHogRunning = 1;
+	while ((xTaskGetTickCount() - start) < SVC_HOG_TICKS)
+		;
+	gHogRunning = 0;
+
+	xSemaphoreGive(gDone);
+	vTaskDelete(NULL);
+}
+
+static int svcCmpU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int svcCmpU32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Start the requesters of a phase and wait for them and the spinning task */
+static int svcRunPhase(const char *phase, const SvcRequester_t *pReqs, uint32_t count, uint32_t hog,
+		       uint32_t maxLatency)
+{
+	static SvcRequester_t reqs[3 * 64];
+	CCTrngServiceStats_t before, after;
+	uint32_t i, duplicates = 0;
+	int fail = 0;
+
+	gLogged = 0;
+	gErrors = 0;
+	CC_TrngServiceGetStats(&before);
+
+	if (hog) {
+		/* it runs once the control task waits, ahead of the requesters below it */
+		gHogRunning = 1;
+		xTaskCreate(svcHogTask, "hog", configMINIMAL_STACK_SIZE, NULL, SVC_PRIO_HOG, NULL);
+	}
+	for (i = 0; i < count; i++) {
+		reqs[i] = pReqs[i];
+		xTaskCreate(svcRequesterTask, "req", configMINIMAL_STACK_SIZE, &reqs[i], reqs[i].priority, NULL);
+	}
+	for (i = 0; i < count + hog; i++)
+		xSemaphoreTake(gDone, portMAX_DELAY);
+
+	CC_TrngServiceGetStats(&after);
+
+	qsort(gPrints, gLogged, sizeof(gPrints[0]), svcCmpU64);
+	for (i = 1; i < gLogged; i++)
+		duplicates += (gPrints[i] == gPrints[i - 1]);
+	qsort(gLatency, gLogged, sizeof(gLatency[0]), svcCmpU32);
+
+	printf("%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", phase,
+	       (unsigned int)(after.requests - before.requests),
+	       (unsigned int)(after.urgentRequests - before.urgentRequests),
+	       (unsigned int)(after.bytes - before.bytes),
+	       (unsigned int)(after.bufferHits - before.bufferHits),
+	       (unsigned int)(after.collections - before.collections),
+	       (unsigned int)(after.irqWakeups - before.irqWakeups),
+	       (unsigned int)(after.timeoutWakeups - before.timeoutWakeups),
+	       (unsigned int)(after.boosts - before.boosts),
+	       (unsigned int)(gLogged ? gLatency[gLogged / 2] : 0),
+	       (unsigned int)(gLogged ? gLatency[gLogged - 1] : 0));
+	fflush(stdout);
+
+	if (gErrors || duplicates) {
+		TZTRNG_PRINTF("%s: %u errors, %u duplicates\n", phase, (unsigned int)gErrors,
+			      (unsigned int)duplicates);
+		fail = 1;
+	}
+	if (maxLatency && gLogged && (gLatency[gLogged - 1] >= maxLatency)) {
+		TZTRNG_PRINTF("%s: urgent request waited %u ms\n", phase, (unsigned int)gLatency[gLogged - 1]);
+		fail = 1;
+	}
+
+	return fail;
+}
+
+/* A request on failing ROSCs fails with a wiped buffer, the next one succeeds */
+static int svcFaultCheck(void)
+{
+	static uint8_t buf[SVC_FAULT_READ];
+	uint32_t i, r, err;
+	int fail = 0;
+
+	for (r = 0; r < CC_TRNG_NUM_OF_ROSCS; r++)
+		tztrngModel_setFault(r, TZTRNG_MODEL_FAULT_STUCK_0, 0);
+	memset(buf, 0xA5, sizeof(buf));
+	err = CC_TrngServiceGet(buf, sizeof(buf), 0);
+	for (i = 0; i < sizeof(buf); i++) {
+		if (buf[i] != 0)
+			break;
+	}
+	if ((err == 0) || (i != sizeof(buf))) {
+		TZTRNG_PRINTF("fault: err[0x%x], output %s\n", (unsigned int)err,
+			      (i != sizeof(buf)) ? "not wiped" : "wiped");
+		fail = 1;
+	}
+
+	for (r = 0; r < CC_TRNG_NUM_OF_ROSCS; r++)
+		tztrngModel_setFault(r, TZTRNG_MODEL_FAULT_NONE, 0);
+	err = CC_TrngServiceGet(buf, SVC_MAX_READ, 0);
+	if (err != 0) {
+		TZTRNG_PRINTF("fault: no recovery, err[0x%x]\n", (unsigned int)err);
+		fail = 1;
+	}
+
+	return fail;
+}
+
+/* Requests until the service stops under them */
+static void svcStopRequesterTask(void *arg)
+{
+	uint32_t flags = (uint32_t)(uintptr_t)arg;
+	uint8_t buf[SVC_MAX_READ];
+	uint32_t err;
+
+	do {
+		err = CC_TrngServiceGet(buf, sizeof(buf), flags);
+	} while (err == 0);
+	if (err != CC_RND_TRNG_SERVICE_STATE_ERROR) {
+		taskENTER_CRITICAL();
+		gErrors++;
+		taskEXIT_CRITICAL();
+	}
+
+	xSemaphoreGive(gDone);
+	vTaskDelete(NULL);
+}
+
+/* CC_TrngServiceStop while requesters are inside CC_TrngServiceGet: none may be left blocked */
+static int svcStopCheck(unsigned long regBase)
+{
+	uint32_t r, i, returned;
+	int fail = 0;
+
+	gErrors = 0;
+	for (r = 0; (r < SVC_STOP_ROUNDS) && !fail; r++) {
+		if (CC_TrngServiceStart(regBase) != 0) {
+			TZTRNG_PRINTF("stop: CC_TrngServiceStart failed\n");
+			return 1;
+		}
+		for (i = 0; i < SVC_STOP_TASKS; i++)
+			xTaskCreate(svcStopRequesterTask, "stop_req", configMINIMAL_STACK_SIZE,
+				    (void *)(uintptr_t)((i & 1) ? CC_TRNG_SERVICE_URGENT : 0),
+				    (i & 1) ? SVC_PRIO_HIGH : SVC_PRIO_LOW, NULL);
+		vTaskDelay(1 + r % 5);
+		fail |= (CC_TrngServiceStop() != 0);
+
+		for (returned = 0; returned < SVC_STOP_TASKS; returned++) {
+			if (xSemaphoreTake(gDone, SVC_STOP_TICKS) != pdPASS)
+				break;
+		}
+		if (returned != SVC_STOP_TASKS) {
+			TZTRNG_PRINTF("stop: round %u, %u of %u requesters blocked\n", (unsigned int)r,
+				      (unsigned int)(SVC_STOP_TASKS - returned), (unsigned int)SVC_STOP_TASKS);
+			fail = 1;
+		}
+	}
+	if (gErrors) {
+		TZTRNG_PRINTF("stop: %u requests failed with another error\n", (unsigned int)gErrors);
+		fail = 1;
+	}
+
+	return fail;
+}
+
+/* Errors of the start, stop and request calls outside the running service */
+static int svcApiCheck(unsigned long regBase, int running)
+{
+	uint8_t buf[16];
+	int fail = 0;
+
+	if (running) {
+		fail |= (CC_TrngServiceStart(regBase) == 0);
+		fail |= (CC_TrngServiceGet(NULL, sizeof(buf), 0) == 0);
+		fail |= (CC_TrngServiceGet(buf, 0, 0) == 0);
+	} else {
+		fail |= (CC_TrngServiceStart(0) == 0);
+		fail |= (CC_TrngServiceGet(buf, sizeof(buf), 0) == 0);
+		fail |= (CC_TrngServiceStop() == 0);
+	}
+	fail |= (CC_TrngServiceGetStats(NULL) == 0);
+	if (fail)
+		TZTRNG_PRINTF("API check failed (service %s)\n", running ? "running" : "stopped");
+
+	return fail;
+}
+
+static void svcControlTask(void *arg)
+{
+	SvcRequester_t reqs[3 * 64];
+	CCTrngServiceStats_t stats;
+	unsigned long regBase = gRegBase;
+	uint32_t i;
+	int fail = 0;
+
+	(void)arg;
+	fail |= svcApiCheck(regBase, 0);
+	if (CC_TrngServiceStart(regBase) != 0) {
+		TZTRNG_PRINTF("CC_TrngServiceStart failed\n");
+		exit(1);
+	}
+	fail |= svcApiCheck(regBase, 1);
+
+	/* let the service fill its buffer first */
+	vTaskDelay(pdMS_TO_TICKS(200));
+
+	for (i = 0; i < 3 * gTasks; i++) {
+		reqs[i].priority = (i < gTasks) ? SVC_PRIO_LOW : (i < 2 * gTasks) ? SVC_PRIO_MID : SVC_PRIO_HIGH;
+		reqs[i].flags = (i < 2 * gTasks) ? 0 : CC_TRNG_SERVICE_URGENT;
+		reqs[i].requests = gRequests;
+		reqs[i].seed = 0x5EED0001ULL + i;
+	}
+	fail |= svcRunPhase("mixed", reqs, 3 * gTasks, 0, 0);
+
+	reqs[0].priority = SVC_PRIO_HIGH;
+	reqs[0].flags = 0;
+	reqs[0].seed = 0x5EED1001ULL;
+	fail |= svcRunPhase("inversion_normal", reqs, 1, 1, 0);
+	reqs[0].flags = CC_TRNG_SERVICE_URGENT;
+	reqs[0].seed = 0x5EED1002ULL;
+	fail |= svcRunPhase("inversion_urgent", reqs, 1, 1, SVC_HOG_TICKS / 2);
+
+	fail |= svcFaultCheck();
+
+	CC_TrngServiceGetStats(&stats);
+	if (CC_TrngServiceStop() != 0) {
+		TZTRNG_PRINTF("CC_TrngServiceStop failed\n");
+		fail = 1;
+	}
+	fail |= svcApiCheck(regBase, 0);
+	fail |= svcStopCheck(regBase);
+	TZTRNG_PRINTF("service: %u requests, %u collections, %u errors, last error 0x%x\n",
+		      (unsigned int)stats.requests, (unsigned int)stats.collections, (unsigned int)stats.errors,
+		      (unsigned int)stats.lastError);
+
+	CC_TrngSetMmioOps(NULL);
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+	exit(fail);
+}
+
+static void svcUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-n tasks] [-k requests] [-c clocks]\n", prog);
+	TZTRNG_PRINTF("  -n  requester tasks per priority of the mixed phase (default %u, at most 64)\n",
+		      SVC_DEFAULT_TASKS);
+	TZTRNG_PRINTF("  -k  requests per task (default %u)\n", SVC_DEFAULT_REQUESTS);
+	TZTRNG_PRINTF("  -c  model rng clocks per tick (default %u)\n", SVC_DEFAULT_CLOCKS_PER_TICK);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:k:c:")) != -1) {
+		switch (opt) {
+		case 'n':
+			gTasks = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			gRequests = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			gClocksPerTick = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			svcUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((gTasks == 0) || (gTasks > 64) || (gRequests == 0) || (gClocksPerTick == 0) ||
+	    (3 * gTasks * gRequests > SVC_MAX_LOG)) {
+		svcUsage(argv[0]);
+		return 1;
+	}
+
+	gRegBase = tztrngTest_target(1, NULL, &gSvcHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	gDone = xSemaphoreCreateCounting(3 * 64 + 1, 0);
+	xTaskCreate(svcHwTask, "rng_hw", configMINIMAL_STACK_SIZE, NULL, SVC_PRIO_HW, NULL);
+	xTaskCreate(svcControlTask, "control", configMINIMAL_STACK_SIZE, NULL, SVC_PRIO_CONTROL, NULL);
+
+	printf("# tztrng_service_test target=model tasks=%u requests=%u clocks_per_tick=%u\n",
+	       (unsigned int)gTasks, (unsigned int)gRequests, (unsigned int)gClocksPerTick);
+	printf("phase,requests,urgent,bytes,buffer_hits,collections,irq_wakeups,timeout_wakeups,boosts,p50_ms,max_ms\n");
+	fflush(stdout);
+
+	vTaskStartScheduler();
+
+	return 1;
+}
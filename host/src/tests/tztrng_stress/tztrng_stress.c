@@ -0,0 +1,382 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+/*
+ * Multi-threaded stress and scaling harness (library built with
+ * CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * For 1, 2, 4 ... N threads, every thread issues CC_TrngGetSource requests of
+ * mixed sizes. Each step checks:
+ * - errors:     requests that failed or returned a short length,
+ * - corruption: guard bytes around the output buffers were overwritten,
+ * - duplicates: two requests returned the same leading 16 bytes,
+ * - violations: a register access came from another thread than the one whose
+ *               request is in progress (the MMIO request hook marks the owner),
+ *               i.e. two requests were interleaved on the hardware.
+ * A library built without CC_CONFIG_TRNG_LOCK = 1 is expected to fail the last
+ * check as soon as two threads run; the interleaved register sequences can also
+ * leave a request waiting forever for the EHR, so a step that does not finish in
+ * time is reported as a hang and ends the run.
+ *
+ * One CSV row per step is written to stdout:
+ * threads,requests,errors,corruptions,duplicates,violations,bytes_per_sec,p50_us,p99_us,p999_us
+ *
+ * The target is the TRNG mapped through /dev/mem, or the RNG register model (-m)
+ * on any Linux host. The model itself is protected by a mutex of the harness, so
+ * an interleaving is detected instead of corrupting the model.
+ */
+
+#define STRESS_DEFAULT_MAX_THREADS 		8
+#define STRESS_DEFAULT_REQUESTS 		100
+#define STRESS_DEFAULT_TIMEOUT_S 		120
+#define STRESS_MAX_THREADS 			256
+#define STRESS_GUARD_BYTES 			32
+#define STRESS_GUARD_VAL 			0xC5
+#define STRESS_PRINT_BYTES 			16
+#define STRESS_NS_PER_SEC 			1000000000ULL
+
+static const size_t stressReqSizes[] = { 16, 32, 64, 128, 256, 1024, 4096 };
+#define STRESS_NUM_SIZES (sizeof(stressReqSizes) / sizeof(stressReqSizes[0]))
+#define STRESS_MAX_REQ_BYTES 			4096
+
+typedef struct {
+	uint64_t lo;
+	uint64_t hi;
+} StressPrint_t;
+
+typedef struct {
+	pthread_t thread;
+	uint32_t id;
+	uint32_t requests;
+	uint64_t rng;
+	uint64_t *lat;			/* ns per request */
+	StressPrint_t *prints;		/* leading bytes of every output */
+	uint64_t bytes;
+	uint32_t errors;
+	uint32_t corruptions;
+} StressThread_t;
+
+static int gUseModel;
+static unsigned long gRegBase;
+static pthread_mutex_t gModelLock = PTHREAD_MUTEX_INITIALIZER;
+/* thread whose request is in progress on the hardware */
+static pthread_t gOwner;
+static volatile int gOwnerValid;
+static volatile uint32_t gViolations;
+/* threads done in the current step */
+static pthread_mutex_t gDoneLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gDoneCond = PTHREAD_COND_INITIALIZER;
+static uint32_t gDone;
+static uint32_t gTimeoutS = STRESS_DEFAULT_TIMEOUT_S;
+
+static uint64_t stressNowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * STRESS_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static void stressCheckOwner(void)
+{
+	if (gOwnerValid && !pthread_equal(gOwner, pthread_self()))
+		__sync_fetch_and_add(&gViolations, 1);
+}
+
+static void stressAccess(void *ctx, uint32_t offset)
+{
+	(void)ctx;
+	(void)offset;
+	stressCheckOwner();
+}
+
+/* start of a CC_TrngGetSource request: the calling thread owns the hardware */
+static void stressRequest(void *ctx, size_t reqBits)
+{
+	(void)ctx;
+	(void)reqBits;
+	gOwner = pthread_self();
+	__sync_synchronize();
+	gOwnerValid = 1;
+}
+
+static void stressModelLock(void *ctx)
+{
+	(void)ctx;
+	pthread_mutex_lock(&gModelLock);
+}
+
+static void stressModelUnlock(void *ctx)
+{
+	(void)ctx;
+	pthread_mutex_unlock(&gModelLock);
+}
+
+static const TztrngTestHooks_t gStressHooks = {
+	stressAccess,
+	stressRequest,
+	stressModelLock,
+	stressModelUnlock,
+	NULL,
+};
+
+/* xorshift64: request sizes only */
+static uint32_t stressRand(uint64_t *pState)
+{
+	*pState ^= *pState << 13;
+	*pState ^= *pState >> 7;
+	*pState ^= *pState << 17;
+	return (uint32_t)*pState;
+}
+
+static void *stressThread(void *arg)
+{
+	StressThread_t *pThr = arg;
+	uint8_t *buf;
+	size_t reqBytes, outputLen, i;
+	uint64_t t0;
+	uint32_t r, err;
+
+	buf = malloc(STRESS_MAX_REQ_BYTES + 2 * STRESS_GUARD_BYTES);
+	if (buf == NULL) {
+		pThr->errors = pThr->requests;
+		return NULL;
+	}
+
+	for (r = 0; r < pThr->requests; r++) {
+		reqBytes = stressReqSizes[stressRand(&pThr->rng) % STRESS_NUM_SIZES];
+		memset(buf, STRESS_GUARD_VAL, STRESS_MAX_REQ_BYTES + 2 * STRESS_GUARD_BYTES);
+		outputLen = 0;
+
+		t0 = stressNowNs();
+		err = CC_TrngGetSource(gRegBase, buf + STRESS_GUARD_BYTES, &outputLen, reqBytes * 8);
+		pThr->lat[r] = stressNowNs() - t0;
+
+		if (err || (outputLen != reqBytes)) {
+			pThr->errors++;
+			TZTRNG_PRINTF("thread %u request %u (%zu bytes): error(0x%X) len %zu\n",
+				      (unsigned int)pThr->id, (unsigned int)r, reqBytes, err, outputLen);
+			continue;
+		}
+		pThr->bytes += reqBytes;
+
+		for (i = 0; i < STRESS_GUARD_BYTES; i++) {
+			if ((buf[i] != STRESS_GUARD_VAL) ||
+			    (buf[STRESS_GUARD_BYTES + reqBytes + i] != STRESS_GUARD_VAL)) {
+				pThr->corruptions++;
+				break;
+			}
+		}
+		memcpy(&pThr->prints[r], buf + STRESS_GUARD_BYTES, STRESS_PRINT_BYTES);
+	}
+
+	free(buf);
+
+	pthread_mutex_lock(&gDoneLock);
+	gDone++;
+	pthread_cond_signal(&gDoneCond);
+	pthread_mutex_unlock(&gDoneLock);
+
+	return NULL;
+}
+
+/* wait for the step threads; exits the process if they hang */
+static void stressWaitDone(uint32_t threads)
+{
+	struct timespec deadline;
+	int rc = 0;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += gTimeoutS;
+
+	pthread_mutex_lock(&gDoneLock);
+	while ((gDone < threads) && (rc == 0))
+		rc = pthread_cond_timedwait(&gDoneCond, &gDoneLock, &deadline);
+	pthread_mutex_unlock(&gDoneLock);
+
+	if (gDone < threads) {
+		printf("# %u threads: hang, %u threads not done after %u s, %u violations\n",
+		       (unsigned int)threads, (unsigned int)(threads - gDone), (unsigned int)gTimeoutS,
+		       (unsigned int)gViolations);
+		fflush(stdout);
+		TZTRNG_PRINTF("FAILED\n");
+		exit(1);
+	}
+}
+
+static int stressCmpU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int stressCmpPrint(const void *a, const void *b)
+{
+	const StressPrint_t *x = a, *y = b;
+
+	if (x->hi != y->hi)
+		return (x->hi > y->hi) - (x->hi < y->hi);
+	return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+static int stressStep(uint32_t threads, uint32_t requests)
+{
+	StressThread_t thr[STRESS_MAX_THREADS];
+	uint64_t *lat;
+	StressPrint_t *prints;
+	uint64_t t0, t1, bytes = 0;
+	uint32_t i, started, total = threads * requests;
+	uint32_t errors = 0, corruptions = 0, duplicates = 0, n = 0;
+
+	lat = malloc(total * sizeof(lat[0]));
+	prints = malloc(total * sizeof(prints[0]));
+	if ((lat == NULL) || (prints == NULL)) {
+		TZTRNG_PRINTF("failed to allocate buffers\n");
+		free(lat);
+		free(prints);
+		return 1;
+	}
+	memset(prints, 0, total * sizeof(prints[0]));
+
+	if (gUseModel) {
+		TztrngModelCfg_t cfg;
+
+		tztrngModel_defaultCfg(&cfg);
+		tztrngModel_init(&cfg);
+	}
+	gOwnerValid = 0;
+	gViolations = 0;
+	gDone = 0;
+
+	memset(thr, 0, sizeof(thr));
+	t0 = stressNowNs();
+	for (started = 0; started < threads; started++) {
+		thr[started].id = started;
+		thr[started].requests = requests;
+		thr[started].rng = 0x9E3779B97F4A7C15ULL * (started + 1);
+		thr[started].lat = lat + started * requests;
+		thr[started].prints = prints + started * requests;
+		if (pthread_create(&thr[started].thread, NULL, stressThread, &thr[started]) != 0) {
+			TZTRNG_PRINTF("failed to start thread %u\n", (unsigned int)started);
+			break;
+		}
+	}
+	stressWaitDone(started);
+	for (i = 0; i < started; i++) {
+		pthread_join(thr[i].thread, NULL);
+		bytes += thr[i].bytes;
+		errors += thr[i].errors;
+		corruptions += thr[i].corruptions;
+	}
+	t1 = stressNowNs();
+
+	/* failed requests left their fingerprint zero */
+	qsort(prints, started * requests, sizeof(prints[0]), stressCmpPrint);
+	for (i = 0; i < started * requests; i++) {
+		if ((prints[i].lo == 0) && (prints[i].hi == 0))
+			continue;
+		if ((n > 0) && (stressCmpPrint(&prints[i], &prints[n - 1]) == 0))
+			duplicates++;
+		prints[n++] = prints[i];
+	}
+
+	total = started * requests;
+	qsort(lat, total, sizeof(lat[0]), stressCmpU64);
+	printf("%u,%u,%u,%u,%u,%u,%.0f,%.1f,%.1f,%.1f\n", (unsigned int)started, (unsigned int)total,
+	       (unsigned int)errors, (unsigned int)corruptions, (unsigned int)duplicates,
+	       (unsigned int)gViolations, (t1 > t0) ? (double)bytes * STRESS_NS_PER_SEC / (t1 - t0) : 0.0,
+	       lat[(total - 1) * 50 / 100] / 1000.0, lat[(total - 1) * 99 / 100] / 1000.0,
+	       lat[(total - 1) * 999 / 1000] / 1000.0);
+	fflush(stdout);
+
+	free(lat);
+	free(prints);
+
+	return ((started != threads) || errors || corruptions || duplicates || gViolations) ? 1 : 0;
+}
+
+static void stressUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-m] [-t maxThreads] [-n requestsPerThread] [-w timeoutSeconds]\n", prog);
+	TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+	TZTRNG_PRINTF("  -w  time limit of each step (default %u s)\n", (unsigned int)STRESS_DEFAULT_TIMEOUT_S);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t maxThreads = STRESS_DEFAULT_MAX_THREADS, requests = STRESS_DEFAULT_REQUESTS, threads;
+	int opt, fail = 0;
+
+	while ((opt = getopt(argc, argv, "mt:n:w:")) != -1) {
+		switch (opt) {
+		case 'm':
+			gUseModel = 1;
+			break;
+		case 't':
+			maxThreads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			requests = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			gTimeoutS = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			stressUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((maxThreads == 0) || (maxThreads > STRESS_MAX_THREADS) || (requests == 0)) {
+		stressUsage(argv[0]);
+		return 1;
+	}
+
+	gRegBase = tztrngTest_target(gUseModel, NULL, &gStressHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	printf("# tztrng_stress target=%s\n", gUseModel ? "model" : "hw");
+	printf("threads,requests,errors,corruptions,duplicates,violations,bytes_per_sec,p50_us,p99_us,p999_us\n");
+
+	/* 1, 2, 4 ... and maxThreads */
+	for (threads = 1; ; threads *= 2) {
+		if (threads > maxThreads)
+			threads = maxThreads;
+		fail |= stressStep(threads, requests);
+		if (threads == maxThreads)
+			break;
+	}
+
+	CC_TrngSetMmioOps(NULL);
+	tztrngTest_targetRelease(gRegBase);
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
@@ -19,6 +19,10 @@
 #ifndef _TZTRNG_TEST_HAL__API_H_
 #define _TZTRNG_TEST_HAL__API_H_
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * @brief Undo actions that were done while getting the hardware register address
  * Finalize the use of any resource.
@@ -70,4 +74,8 @@ void tztrngTest_pal_free(void *pvAddress);
  */
 int tztrngTest_pal_dumpData(unsigned char *large_buf, size_t outputLen);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif //_TZTRNG_TEST_HAL__API_H_
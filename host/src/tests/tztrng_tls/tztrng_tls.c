@@ -0,0 +1,337 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_model.h"
+#include "tztrng_target.h"
+
+/*
+ * TLS entropy poll adapter benchmark (library built with
+ * CC_CONFIG_TRNG_TLS_POLL = 1 and CC_CONFIG_TRNG_MMIO_HOOKS = 1).
+ *
+ * A handshake-heavy server seeds a DRBG every -r handshakes (1: a DRBG per
+ * connection). Seeding runs the gathering loop of a TLS entropy accumulator
+ * (the pattern of mbedtls_entropy_gather()): the source callback is polled for
+ * -c bytes at a time until the bytes of -e bits of min-entropy are counted
+ * (CC_TrngTlsPollThreshold). Three sources run the same handshakes:
+ * - direct: a callback that calls CC_TrngGetSource() for every poll,
+ * - buffered: CC_TrngTlsPoll(),
+ * - prefetch: CC_TrngTlsPoll(), and CC_TrngTlsPrefetch() between handshakes
+ *   ahead of every reseed point.
+ * One CSV row per source:
+ * source,handshakes,reseeds,polls,collections,bytes,entropy_bits,seed_p50_us,seed_p99_us,total_ms
+ * collections counts the TRNG collections (MMIO request hook), seed_p50/p99
+ * the seeding time inside a handshake, total_ms includes the prefetches.
+ * Every seed must be distinct.
+ */
+
+#define TLS_DEFAULT_HANDSHAKES 		200
+#define TLS_DEFAULT_RESEED_EVERY 	1
+#define TLS_DEFAULT_CHUNK 		16
+#define TLS_DEFAULT_ENTROPY_BITS 	256
+#define TLS_SEED_BYTES 			32
+#define TLS_NS_PER_SEC 			1000000000ULL
+
+typedef enum {
+	TLS_SOURCE_DIRECT = 0,
+	TLS_SOURCE_BUFFERED,
+	TLS_SOURCE_PREFETCH,
+} TlsSource_t;
+
+static const char *const gSourceNames[] = { "direct", "buffered", "prefetch" };
+
+/* entropy source callback of the TLS stack */
+typedef int (*TlsPollFunc_t)(void *data, unsigned char *output, size_t len, size_t *olen);
+
+static int gUseModel;
+static unsigned long gRegBase;
+static uint32_t gCollections;
+
+static uint64_t tlsNowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * TLS_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/* start of a TRNG collection */
+static void tlsRequest(void *ctx, size_t reqBits)
+{
+	(void)ctx;
+	(void)reqBits;
+	gCollections++;
+}
+
+static const TztrngTestHooks_t gTlsHooks = {
+	NULL,
+	tlsRequest,
+	NULL,
+	NULL,
+	NULL,
+};
+
+/* The callback a TLS stack gets without the adapter: one collection per poll */
+static int tlsDirectPoll(void *data, unsigned char *output, size_t len, size_t *olen)
+{
+	size_t outLen = 0;
+
+	(void)data;
+	*olen = 0;
+	if (CC_TrngGetSource(gRegBase, output, &outLen, len * 8) != 0)
+		return CC_TRNG_TLS_POLL_FAILED;
+	*olen = outLen;
+	return 0;
+}
+
+/* Gather 'threshold' bytes in polls of 'chunk' and fold them into a seed, as an
+   entropy accumulator does (XOR in place of its hash); 0 on success */
+static int tlsGather(TlsPollFunc_t poll, void *data, size_t threshold, size_t chunk, uint8_t *seed,
+		     uint32_t *pPolls)
+{
+	uint8_t buf[TLS_SEED_BYTES];
+	size_t counted = 0, olen, i;
+	int ret = 0;
+
+	memset(seed, 0, TLS_SEED_BYTES);
+	while (counted < threshold) {
+		ret = poll(data, buf, chunk, &olen);
+		(*pPolls)++;
+		if (ret != 0)
+			break;
+		for (i = 0; i < olen; i++)
+			seed[(counted + i) % TLS_SEED_BYTES] ^= buf[i];
+		counted += olen;
+	}
+	memset(buf, 0, sizeof(buf));
+
+	return ret;
+}
+
+static int tlsCmpU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int tlsCmpSeed(const void *a, const void *b)
+{
+	return memcmp(a, b, TLS_SEED_BYTES);
+}
+
+static int tlsRun(TlsSource_t source, uint32_t handshakes, uint32_t reseedEvery, size_t chunk,
+		  size_t entropyBits)
+{
+	CCTrngTlsPoll_t adapter;
+	size_t threshold = CC_TrngTlsPollThreshold(entropyBits);
+	uint8_t *seeds;
+	uint64_t *lat, t0, t1, tRun;
+	uint64_t bytes;
+	uint32_t h, n = 0, polls = 0, errors = 0, duplicates = 0, collections;
+	TlsPollFunc_t poll = (source == TLS_SOURCE_DIRECT) ? tlsDirectPoll : CC_TrngTlsPoll;
+
+	if (chunk > TLS_SEED_BYTES)
+		chunk = TLS_SEED_BYTES;
+	seeds = calloc(handshakes, TLS_SEED_BYTES);
+	lat = calloc(handshakes, sizeof(lat[0]));
+	if ((seeds == NULL) || (lat == NULL) || (CC_TrngTlsPollInit(&adapter, gRegBase) != 0)) {
+		TZTRNG_PRINTF("failed to allocate buffers\n");
+		free(seeds);
+		free(lat);
+		return 1;
+	}
+	gCollections = 0;
+
+	tRun = tlsNowNs();
+	for (h = 0; h < handshakes; h++) {
+		if (h % reseedEvery != 0)
+			continue;
+
+		/* idle time before the connection: fill the adapter for the coming reseed */
+		if ((source == TLS_SOURCE_PREFETCH) && (CC_TrngTlsPrefetch(&adapter, threshold) != 0))
+			errors++;
+
+		t0 = tlsNowNs();
+		if (tlsGather(poll, &adapter, threshold, chunk, seeds + n * TLS_SEED_BYTES, &polls) != 0) {
+			TZTRNG_PRINTF("%s: handshake %u: seeding failed\n", gSourceNames[source], (unsigned int)h);
+			errors++;
+		}
+		t1 = tlsNowNs();
+		lat[n++] = t1 - t0;
+	}
+	tRun = tlsNowNs() - tRun;
+	collections = gCollections;
+
+	if (source == TLS_SOURCE_DIRECT)
+		bytes = (uint64_t)polls * chunk;
+	else
+		bytes = adapter.stats.bytes;
+
+	qsort(seeds, n, TLS_SEED_BYTES, tlsCmpSeed);
+	for (h = 1; h < n; h++)
+		duplicates += (memcmp(seeds + h * TLS_SEED_BYTES, seeds + (h - 1) * TLS_SEED_BYTES, TLS_SEED_BYTES) == 0);
+	qsort(lat, n, sizeof(lat[0]), tlsCmpU64);
+
+	printf("%s,%u,%u,%u,%u,%llu,%llu,%.1f,%.1f,%.1f\n", gSourceNames[source], (unsigned int)handshakes,
+	       (unsigned int)n, (unsigned int)polls, (unsigned int)collections, (unsigned long long)bytes,
+	       (unsigned long long)CC_TrngTlsPollEntropyBits((size_t)bytes),
+	       n ? lat[(n - 1) * 50 / 100] / 1000.0 : 0.0, n ? lat[(n - 1) * 99 / 100] / 1000.0 : 0.0,
+	       tRun / 1e6);
+	fflush(stdout);
+
+	CC_TrngTlsPollFree(&adapter);
+	memset(seeds, 0, (size_t)handshakes * TLS_SEED_BYTES);
+	free(seeds);
+	free(lat);
+
+	if (errors || duplicates) {
+		TZTRNG_PRINTF("%s: %u errors, %u duplicate seeds\n", gSourceNames[source], (unsigned int)errors,
+			      (unsigned int)duplicates);
+		return 1;
+	}
+	return 0;
+}
+
+static int tlsCheck(int cond, const char *what)
+{
+	if (!cond)
+		TZTRNG_PRINTF("check failed: %s\n", what);
+	return cond ? 0 : 1;
+}
+
+static int tlsApiChecks(void)
+{
+	CCTrngTlsPoll_t adapter;
+	uint8_t buf[64];
+	size_t olen = 1;
+	uint32_t i;
+	int fail = 0, ret;
+
+	fail |= tlsCheck(CC_TrngTlsPollInit(NULL, gRegBase) != 0, "NULL adapter fails");
+	fail |= tlsCheck(CC_TrngTlsPollInit(&adapter, 0) != 0, "zero base fails");
+	fail |= tlsCheck(CC_TrngTlsPollInit(&adapter, gRegBase) == 0, "init");
+	fail |= tlsCheck(CC_TrngTlsPoll(&adapter, NULL, 16, &olen) == CC_TRNG_TLS_POLL_FAILED, "NULL output fails");
+	fail |= tlsCheck(CC_TrngTlsPrefetch(&adapter, CC_TRNG_TLS_POLL_BYTES + 1) != 0, "prefetch above the buffer fails");
+	fail |= tlsCheck((CC_TrngTlsPoll(&adapter, buf, 0, &olen) == 0) && (olen == 0) &&
+			 (adapter.stats.collections == 0), "empty poll, no collection");
+	fail |= tlsCheck((CC_TrngTlsPoll(&adapter, buf, sizeof(buf), &olen) == 0) && (olen == sizeof(buf)) &&
+			 (adapter.stats.collections == 1) && (adapter.level == CC_TRNG_TLS_POLL_BYTES - sizeof(buf)),
+			 "first poll collects a buffer");
+	fail |= tlsCheck((CC_TrngTlsPoll(&adapter, buf, sizeof(buf), &olen) == 0) && (adapter.stats.collections == 1),
+			 "second poll from the buffer");
+	fail |= tlsCheck((CC_TrngTlsPrefetch(&adapter, 16) == 0) && (adapter.stats.prefetches == 0),
+			 "prefetch of buffered bytes does nothing");
+	fail |= tlsCheck((CC_TrngTlsPrefetch(&adapter, CC_TRNG_TLS_POLL_BYTES) == 0) &&
+			 (adapter.level == CC_TRNG_TLS_POLL_BYTES) && (adapter.stats.collections == 2),
+			 "prefetch tops the buffer up");
+	fail |= tlsCheck(adapter.stats.entropyBits == CC_TrngTlsPollEntropyBits(2 * sizeof(buf)),
+			 "entropy of the bytes handed out");
+	fail |= tlsCheck(CC_TrngTlsPollEntropyBits(CC_TrngTlsPollThreshold(256)) >= 256,
+			 "the threshold covers the entropy");
+
+	if (gUseModel) {
+		for (i = 0; i < CC_TRNG_NUM_OF_ROSCS; i++)
+			tztrngModel_setFault(i, TZTRNG_MODEL_FAULT_STUCK_0, 0);
+		CC_TrngTlsPollFree(&adapter);
+		CC_TrngTlsPollInit(&adapter, gRegBase);
+		memset(buf, 0xA5, sizeof(buf));
+		ret = CC_TrngTlsPoll(&adapter, buf, sizeof(buf), &olen);
+		fail |= tlsCheck((ret == CC_TRNG_TLS_POLL_FAILED) && (olen == 0) && (adapter.stats.errors == 1) &&
+				 (adapter.stats.lastError != 0), "a failing TRNG fails the poll with its error");
+		for (i = 0; (i < sizeof(buf)) && ((buf[i] == 0xA5) || (buf[i] == 0)); i++)
+			;
+		fail |= tlsCheck(i == sizeof(buf), "no TRNG output left in the buffer of a failed poll");
+		for (i = 0; i < CC_TRNG_NUM_OF_ROSCS; i++)
+			tztrngModel_setFault(i, TZTRNG_MODEL_FAULT_NONE, 0);
+	}
+	CC_TrngTlsPollFree(&adapter);
+
+	return fail;
+}
+
+static void tlsUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-m] [-n handshakes] [-r reseedEvery] [-c chunk] [-e entropyBits]\n", prog);
+	TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+	TZTRNG_PRINTF("  -r  handshakes per DRBG reseed (default %u)\n", (unsigned int)TLS_DEFAULT_RESEED_EVERY);
+	TZTRNG_PRINTF("  -c  bytes per poll, at most %u (default %u)\n", (unsigned int)TLS_SEED_BYTES,
+		      (unsigned int)TLS_DEFAULT_CHUNK);
+	TZTRNG_PRINTF("  -e  min-entropy per seed in bits (default %u)\n", (unsigned int)TLS_DEFAULT_ENTROPY_BITS);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t handshakes = TLS_DEFAULT_HANDSHAKES, reseedEvery = TLS_DEFAULT_RESEED_EVERY;
+	size_t chunk = TLS_DEFAULT_CHUNK, entropyBits = TLS_DEFAULT_ENTROPY_BITS;
+	int opt, fail = 0;
+
+	while ((opt = getopt(argc, argv, "mn:r:c:e:")) != -1) {
+		switch (opt) {
+		case 'm':
+			gUseModel = 1;
+			break;
+		case 'n':
+			handshakes = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			reseedEvery = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			chunk = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			entropyBits = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			tlsUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((handshakes == 0) || (reseedEvery == 0) || (chunk == 0) || (chunk > TLS_SEED_BYTES) ||
+	    (entropyBits == 0) || (CC_TrngTlsPollThreshold(entropyBits) > CC_TRNG_TLS_POLL_BYTES)) {
+		tlsUsage(argv[0]);
+		return 1;
+	}
+
+	gRegBase = tztrngTest_target(gUseModel, NULL, &gTlsHooks);
+	CC_TrngSetMmioOps(tztrngTest_mmioOps());
+
+	fail |= tlsApiChecks();
+
+	printf("# tztrng_tls target=%s handshakes=%u reseed_every=%u chunk=%zu entropy_bits=%zu threshold=%zu\n",
+	       gUseModel ? "model" : "hw", (unsigned int)handshakes, (unsigned int)reseedEvery, chunk, entropyBits,
+	       CC_TrngTlsPollThreshold(entropyBits));
+	printf("source,handshakes,reseeds,polls,collections,bytes,entropy_bits,seed_p50_us,seed_p99_us,total_ms\n");
+	fail |= tlsRun(TLS_SOURCE_DIRECT, handshakes, reseedEvery, chunk, entropyBits);
+	fail |= tlsRun(TLS_SOURCE_BUFFERED, handshakes, reseedEvery, chunk, entropyBits);
+	fail |= tlsRun(TLS_SOURCE_PREFETCH, handshakes, reseedEvery, chunk, entropyBits);
+
+	CC_TrngSetMmioOps(NULL);
+	tztrngTest_targetRelease(gRegBase);
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
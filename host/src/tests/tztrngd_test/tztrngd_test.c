@@ -0,0 +1,542 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#include "tztrngd_client.h"
+#include "tztrng_test_pal.h"
+
+/*
+ * Entropy daemon test tool: runs against a tztrngd serving the -s socket.
+ *
+ * N client threads, each on its own connection, request 16 bytes to four
+ * times TZTRNGD_MAX_REQUEST_BYTES at a time, so the longer requests are split
+ * and pipelined by tztrngd_get(). One CSV row is written to stdout:
+ * source,threads,requests,errors,rate_limited,duplicates,bytes_per_sec,p50_us,p99_us,max_us
+ * The connection counters of the daemon must match what each client saw.
+ *
+ * With -S the same clients then read the shared-memory ring of the daemon
+ * (tztrngd -S) through their own mappings, and the ring counters are written
+ * as a comment: empty_waits counts the consumer futex sleeps, the only system
+ * calls on that path. -p paces each client to measure below the TRNG rate.
+ * A consumer process is also killed while it holds a block: the producer must
+ * take the block back and keep the ring running.
+ *
+ * With -l the daemon is expected to run with a rate limit (tztrngd -r): the
+ * clients must then be refused at least once, and the refusals are not errors.
+ * The protocol checks cover a missing socket, truncated and oversized requests.
+ */
+
+#define DTEST_DEFAULT_THREADS 		8
+#define DTEST_DEFAULT_REQUESTS 		200
+#define DTEST_MAX_THREADS 		64
+#define DTEST_MIN_BYTES 		16
+#define DTEST_MAX_BYTES 		(4 * TZTRNGD_MAX_REQUEST_BYTES)
+#define DTEST_PRINT_BYTES 		16
+#define DTEST_NS_PER_SEC 		1000000000ULL
+#define DTEST_FILL_TIMEOUT_MS 		10000
+
+typedef enum {
+	DTEST_SRC_SOCKET = 0,
+	DTEST_SRC_SHM = 1,
+} DtestSrc_t;
+
+typedef struct {
+	uint64_t lo;
+	uint64_t hi;
+} DtestPrint_t;
+
+typedef struct {
+	pthread_t thread;
+	DtestSrc_t src;
+	uint32_t requests;
+	uint64_t rng;
+	uint64_t *lat;			/* ns per request */
+	DtestPrint_t *prints;		/* leading bytes of every output */
+	uint64_t bytes;
+	uint32_t chunks;		/* GET requests sent by the client library */
+	uint32_t errors;
+	uint32_t rateLimited;
+} DtestThread_t;
+
+static const char *gPath = TZTRNGD_DEFAULT_SOCKET;
+static const char *gShmName;
+static int gExpectLimit;
+static uint32_t gPauseUs;
+
+static uint64_t dtestNowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * DTEST_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift64: request sizes only */
+static uint32_t dtestRand(uint64_t *pState)
+{
+	*pState ^= *pState << 13;
+	*pState ^= *pState >> 7;
+	*pState ^= *pState << 17;
+	return (uint32_t)*pState;
+}
+
+static int dtestCheckStats(int fd, const DtestThread_t *pThr)
+{
+	TztrngdStats_t stats;
+
+	if (tztrngd_stats(fd, &stats) != 0) {
+		TZTRNG_PRINTF("stats failed\n");
+		return 1;
+	}
+	if ((stats.bytes != pThr->bytes) || (stats.rateLimited != pThr->rateLimited) ||
+	    (stats.requests < pThr->chunks)) {
+		TZTRNG_PRINTF("stats mismatch: requests %u/%u bytes %llu/%llu rate_limited %u/%u\n",
+			      (unsigned int)stats.requests, (unsigned int)pThr->chunks,
+			      (unsigned long long)stats.bytes, (unsigned long long)pThr->bytes,
+			      (unsigned int)stats.rateLimited, (unsigned int)pThr->rateLimited);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void *dtestThread(void *arg)
+{
+	DtestThread_t *pThr = arg;
+	TztrngdShm_t *pShm = NULL;
+	uint8_t buf[DTEST_MAX_BYTES];
+	size_t len;
+	uint64_t t0;
+	uint32_t r;
+	int fd = -1, ret;
+
+	if (pThr->src == DTEST_SRC_SHM)
+		pShm = tztrngd_shm_open(gShmName);
+	else
+		fd = tztrngd_connect(gPath);
+	if ((fd < 0) && (pShm == NULL)) {
+		TZTRNG_PRINTF("connect to %s: %s\n", (pThr->src == DTEST_SRC_SHM) ? gShmName : gPath,
+			      strerror(errno));
+		pThr->errors = pThr->requests;
+		return NULL;
+	}
+
+	for (r = 0; r < pThr->requests; r++) {
+		len = DTEST_MIN_BYTES + dtestRand(&pThr->rng) % (DTEST_MAX_BYTES - DTEST_MIN_BYTES + 1);
+
+		t0 = dtestNowNs();
+		if (pShm != NULL) {
+			ret = tztrngd_shm_read(pShm, buf, len);
+		} else {
+			ret = tztrngd_get(fd, buf, len);
+			pThr->chunks += (uint32_t)((len + TZTRNGD_MAX_REQUEST_BYTES - 1) / TZTRNGD_MAX_REQUEST_BYTES);
+		}
+		pThr->lat[r] = dtestNowNs() - t0;
+
+		if (ret == TZTRNGD_STATUS_RATE_LIMITED) {
+			pThr->rateLimited++;
+			if (!gExpectLimit)
+				pThr->errors++;
+			continue;
+		}
+		if (ret != 0) {
+			pThr->errors++;
+			TZTRNG_PRINTF("request %u (%zu bytes): %d (%s)\n", (unsigned int)r, len, ret,
+				      (ret < 0) ? strerror(errno) : "refused");
+			if (ret < 0)
+				break;
+			continue;
+		}
+		pThr->bytes += len;
+		memcpy(&pThr->prints[r], buf, DTEST_PRINT_BYTES);
+		if (gPauseUs)
+			usleep(gPauseUs);
+	}
+
+	if (pShm != NULL) {
+		tztrngd_shm_close(pShm);
+		return NULL;
+	}
+	/* a refused chunk of a split request stops the pipeline: its successors are not counted */
+	if (pThr->rateLimited == 0)
+		pThr->errors += dtestCheckStats(fd, pThr);
+	tztrngd_close(fd);
+
+	return NULL;
+}
+
+static int dtestCmpU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int dtestCmpPrint(const void *a, const void *b)
+{
+	const DtestPrint_t *x = a, *y = b;
+
+	if (x->hi != y->hi)
+		return (x->hi > y->hi) - (x->hi < y->hi);
+	return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+static int dtestRun(DtestSrc_t src, uint32_t threads, uint32_t requests)
+{
+	DtestThread_t thr[DTEST_MAX_THREADS];
+	uint64_t *lat;
+	DtestPrint_t *prints;
+	uint64_t t0, t1, bytes = 0;
+	uint32_t i, started, total = threads * requests;
+	uint32_t errors = 0, rateLimited = 0, duplicates = 0, n = 0;
+
+	lat = malloc(total * sizeof(lat[0]));
+	prints = malloc(total * sizeof(prints[0]));
+	if ((lat == NULL) || (prints == NULL)) {
+		TZTRNG_PRINTF("failed to allocate buffers\n");
+		free(lat);
+		free(prints);
+		return 1;
+	}
+	memset(prints, 0, total * sizeof(prints[0]));
+
+	memset(thr, 0, sizeof(thr));
+	t0 = dtestNowNs();
+	for (started = 0; started < threads; started++) {
+		thr[started].src = src;
+		thr[started].requests = requests;
+		thr[started].rng = 0x9E3779B97F4A7C15ULL * (started + 1);
+		thr[started].lat = lat + started * requests;
+		thr[started].prints = prints + started * requests;
+		if (pthread_create(&thr[started].thread, NULL, dtestThread, &thr[started]) != 0) {
+			TZTRNG_PRINTF("failed to start thread %u\n", (unsigned int)started);
+			break;
+		}
+	}
+	for (i = 0; i < started; i++) {
+		pthread_join(thr[i].thread, NULL);
+		bytes += thr[i].bytes;
+		errors += thr[i].errors;
+		rateLimited += thr[i].rateLimited;
+	}
+	t1 = dtestNowNs();
+
+	/* failed requests left their fingerprint zero */
+	qsort(prints, started * requests, sizeof(prints[0]), dtestCmpPrint);
+	for (i = 0; i < started * requests; i++) {
+		if ((prints[i].lo == 0) && (prints[i].hi == 0))
+			continue;
+		if ((n > 0) && (dtestCmpPrint(&prints[i], &prints[n - 1]) == 0))
+			duplicates++;
+		prints[n++] = prints[i];
+	}
+
+	total = started * requests;
+	qsort(lat, total, sizeof(lat[0]), dtestCmpU64);
+	printf("%s,%u,%u,%u,%u,%u,%.0f,%.1f,%.1f,%.1f\n", (src == DTEST_SRC_SHM) ? "shm" : "socket",
+	       (unsigned int)started, (unsigned int)total, (unsigned int)errors, (unsigned int)rateLimited,
+	       (unsigned int)duplicates,
+	       (t1 > t0) ? (double)bytes * DTEST_NS_PER_SEC / (t1 - t0) : 0.0,
+	       lat[(total - 1) * 50 / 100] / 1000.0, lat[(total - 1) * 99 / 100] / 1000.0,
+	       lat[total - 1] / 1000.0);
+	fflush(stdout);
+
+	free(lat);
+	free(prints);
+
+	/* the ring is not rate limited */
+	if (src == DTEST_SRC_SHM)
+		return ((started != threads) || errors || duplicates) ? 1 : 0;
+	if (gExpectLimit && (rateLimited == 0))
+		TZTRNG_PRINTF("no request was rate limited\n");
+
+	return ((started != threads) || errors || duplicates || (gExpectLimit && (rateLimited == 0))) ? 1 : 0;
+}
+
+static int dtestCheck(int cond, const char *what)
+{
+	if (!cond)
+		TZTRNG_PRINTF("check failed: %s\n", what);
+	return cond ? 0 : 1;
+}
+
+/* send 'len' bytes of 'req' as one record; the status of the reply, -1 on failure */
+static int dtestRaw(int fd, const TztrngdHdr_t *pReq, size_t len)
+{
+	TztrngdHdr_t rep;
+	uint8_t payload[TZTRNGD_MAX_REQUEST_BYTES];
+	struct iovec iov[2];
+	struct msghdr msg;
+
+	if (send(fd, pReq, len, MSG_NOSIGNAL) != (ssize_t)len)
+		return -1;
+	iov[0].iov_base = &rep;
+	iov[0].iov_len = sizeof(rep);
+	iov[1].iov_base = payload;
+	iov[1].iov_len = sizeof(payload);
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	if (recvmsg(fd, &msg, 0) < (ssize_t)sizeof(rep))
+		return -1;
+
+	return (int)rep.status;
+}
+
+/* connection failures, argument errors and malformed requests */
+static int dtestApiChecks(void)
+{
+	TztrngdHdr_t req;
+	TztrngdStats_t stats;
+	uint8_t buf[DTEST_PRINT_BYTES];
+	int fd, fail = 0;
+
+	fail |= dtestCheck(tztrngd_connect("/nonexistent/tztrngd.sock") < 0, "connect to a missing socket fails");
+
+	fd = tztrngd_connect(gPath);
+	if (fd < 0) {
+		TZTRNG_PRINTF("connect to %s: %s\n", gPath, strerror(errno));
+		return 1;
+	}
+	fail |= dtestCheck(tztrngd_get(fd, NULL, 1) < 0, "NULL get fails");
+	fail |= dtestCheck(tztrngd_get(fd, buf, 0) == 0, "empty get");
+	fail |= dtestCheck(tztrngd_stats(fd, NULL) < 0, "NULL stats fails");
+	fail |= dtestCheck(tztrngd_get(fd, buf, sizeof(buf)) == 0, "get");
+
+	memset(&req, 0, sizeof(req));
+	req.version = TZTRNGD_PROTO_VERSION;
+	req.type = TZTRNGD_MSG_GET;
+	req.length = TZTRNGD_MAX_REQUEST_BYTES + 1;
+	fail |= dtestCheck(dtestRaw(fd, &req, sizeof(req)) == TZTRNGD_STATUS_BAD_REQUEST, "oversized GET refused");
+	req.length = 0;
+	fail |= dtestCheck(dtestRaw(fd, &req, sizeof(req)) == TZTRNGD_STATUS_BAD_REQUEST, "empty GET refused");
+	req.length = 1;
+	fail |= dtestCheck(dtestRaw(fd, &req, sizeof(req) - 1) == TZTRNGD_STATUS_BAD_REQUEST, "truncated GET refused");
+	req.version = TZTRNGD_PROTO_VERSION + 1;
+	fail |= dtestCheck(dtestRaw(fd, &req, sizeof(req)) == TZTRNGD_STATUS_BAD_REQUEST, "unknown version refused");
+	req.version = TZTRNGD_PROTO_VERSION;
+	req.type = 0xFF;
+	fail |= dtestCheck(dtestRaw(fd, &req, sizeof(req)) == TZTRNGD_STATUS_BAD_REQUEST, "unknown type refused");
+
+	fail |= dtestCheck((tztrngd_stats(fd, &stats) == 0) && (stats.errors == 5) && (stats.bytes == sizeof(buf)),
+			   "stats count the connection");
+	tztrngd_close(fd);
+
+	return fail;
+}
+
+/* mapping errors, claim and release, and a ring that the producer refills */
+static int dtestShmChecks(void)
+{
+	TztrngdShm_t *pShm;
+	TztrngdShmBlock_t block;
+	TztrngdShmStats_t stats;
+	uint8_t buf[DTEST_PRINT_BYTES];
+	uint32_t ms, i;
+	int fail = 0;
+
+	fail |= dtestCheck(tztrngd_shm_open("/tztrngd-nonexistent") == NULL, "open of a missing ring fails");
+
+	pShm = tztrngd_shm_open(gShmName);
+	if (pShm == NULL) {
+		TZTRNG_PRINTF("shm %s: %s\n", gShmName, strerror(errno));
+		return 1;
+	}
+	fail |= dtestCheck(tztrngd_shm_claim(pShm, NULL) < 0, "NULL claim fails");
+	fail |= dtestCheck(tztrngd_shm_read(pShm, NULL, 1) < 0, "NULL read fails");
+	fail |= dtestCheck(tztrngd_shm_stats(pShm, NULL) < 0, "NULL stats fails");
+
+	/* let the producer fill the ring */
+	for (ms = 0; ms < DTEST_FILL_TIMEOUT_MS; ms++) {
+		if ((tztrngd_shm_stats(pShm, &stats) == 0) && (stats.level == TZTRNGD_SHM_SLOTS))
+			break;
+		usleep(1000);
+	}
+	fail |= dtestCheck(stats.level == TZTRNGD_SHM_SLOTS, "the producer fills the ring");
+
+	fail |= dtestCheck(tztrngd_shm_claim(pShm, &block) == 0, "claim");
+	if (block.data != NULL) {
+		for (i = 0; (i < TZTRNGD_SHM_BLOCK_BYTES) && (block.data[i] == 0); i++)
+			;
+		fail |= dtestCheck(i < TZTRNGD_SHM_BLOCK_BYTES, "a claimed block holds data");
+		tztrngd_shm_release(pShm, &block);
+		fail |= dtestCheck(block.data == NULL, "release forgets the block");
+	}
+	fail |= dtestCheck(tztrngd_shm_read(pShm, buf, sizeof(buf)) == 0, "read");
+	fail |= dtestCheck((tztrngd_shm_stats(pShm, &stats) == 0) && !stats.stopped && (stats.error == 0),
+			   "the ring is running");
+	tztrngd_shm_close(pShm);
+
+	return fail;
+}
+
+/* a consumer killed while it holds a block must not stop the producer */
+static int dtestShmDeadConsumer(void)
+{
+	TztrngdShm_t *pShm;
+	TztrngdShmBlock_t block;
+	TztrngdShmStats_t before, stats;
+	uint32_t ms, n;
+	int sync[2], status, fail = 0;
+	pid_t pid;
+	char c = 0;
+
+	pShm = tztrngd_shm_open(gShmName);
+	if ((pShm == NULL) || (tztrngd_shm_stats(pShm, &before) != 0) || (pipe(sync) != 0)) {
+		TZTRNG_PRINTF("shm %s: %s\n", gShmName, strerror(errno));
+		tztrngd_shm_close(pShm);
+		return 1;
+	}
+
+	pid = fork();
+	if (pid == 0) {
+		TztrngdShm_t *pChild = tztrngd_shm_open(gShmName);
+
+		/* hold the block until killed */
+		if ((pChild != NULL) && (tztrngd_shm_claim(pChild, &block) == 0))
+			c = 1;
+		if (write(sync[1], &c, 1) != 1)
+			_exit(1);
+		for (;;)
+			pause();
+	}
+	close(sync[1]);
+	if ((pid < 0) || (read(sync[0], &c, 1) != 1) || (c != 1)) {
+		TZTRNG_PRINTF("consumer process failed to claim a block\n");
+		fail = 1;
+	}
+	if (pid > 0) {
+		kill(pid, SIGKILL);
+		waitpid(pid, &status, 0);
+	}
+	close(sync[0]);
+
+	/* drain what is published until the producer reaches the dead block */
+	for (ms = 0; !fail && (ms < DTEST_FILL_TIMEOUT_MS); ms++) {
+		if ((tztrngd_shm_stats(pShm, &stats) != 0) || (stats.reclaims != before.reclaims))
+			break;
+		for (n = 0; n < stats.level; n++) {
+			if (tztrngd_shm_claim(pShm, &block) != 0)
+				break;
+			tztrngd_shm_release(pShm, &block);
+		}
+		usleep(1000);
+	}
+	if (!fail)
+		fail |= dtestCheck(stats.reclaims == before.reclaims + 1, "the block of a dead consumer is taken back");
+	/* a stuck producer would leave the claim waiting */
+	if (!fail) {
+		fail |= dtestCheck(tztrngd_shm_claim(pShm, &block) == 0, "claim after the reclaim");
+		tztrngd_shm_release(pShm, &block);
+	}
+	tztrngd_shm_close(pShm);
+
+	return fail;
+}
+
+static void dtestUsage(const char *prog)
+{
+	TZTRNG_PRINTF("usage: %s [-s socket] [-S shmName] [-t threads] [-n requestsPerThread] [-p pauseUs] [-l]\n", prog);
+	TZTRNG_PRINTF("  -s  daemon socket (default %s)\n", TZTRNGD_DEFAULT_SOCKET);
+	TZTRNG_PRINTF("  -S  also read the shared-memory ring of the daemon\n");
+	TZTRNG_PRINTF("  -p  pause of each client between requests (default 0)\n");
+	TZTRNG_PRINTF("  -l  the daemon runs with a rate limit: expect refusals\n");
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t threads = DTEST_DEFAULT_THREADS, requests = DTEST_DEFAULT_REQUESTS;
+	int opt, fail = 0, shmFail = 0;
+
+	while ((opt = getopt(argc, argv, "s:S:t:n:p:l")) != -1) {
+		switch (opt) {
+		case 's':
+			gPath = optarg;
+			break;
+		case 'S':
+			gShmName = optarg;
+			break;
+		case 'p':
+			gPauseUs = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			threads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			requests = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			gExpectLimit = 1;
+			break;
+		default:
+			dtestUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((threads == 0) || (threads > DTEST_MAX_THREADS) || (requests == 0)) {
+		dtestUsage(argv[0]);
+		return 1;
+	}
+
+	fail |= dtestApiChecks();
+	if (gShmName != NULL)
+		shmFail = dtestShmChecks() | dtestShmDeadConsumer();
+
+	printf("# tztrngd_test socket=%s shm=%s rate_limited=%s pause_us=%u\n", gPath,
+	       (gShmName != NULL) ? gShmName : "none", gExpectLimit ? "expected" : "no", (unsigned int)gPauseUs);
+	printf("source,threads,requests,errors,rate_limited,duplicates,bytes_per_sec,p50_us,p99_us,max_us\n");
+
+	fail |= dtestRun(DTEST_SRC_SOCKET, threads, requests);
+
+	/* the clients would wait forever on a stuck ring */
+	fail |= shmFail;
+	if ((gShmName != NULL) && !shmFail) {
+		TztrngdShm_t *pShm = tztrngd_shm_open(gShmName);
+		TztrngdShmStats_t before, after;
+
+		if ((pShm == NULL) || (tztrngd_shm_stats(pShm, &before) != 0)) {
+			TZTRNG_PRINTF("shm %s: %s\n", gShmName, strerror(errno));
+			fail = 1;
+		} else {
+			fail |= dtestRun(DTEST_SRC_SHM, threads, requests);
+			tztrngd_shm_stats(pShm, &after);
+			printf("# shm published=%llu claimed=%llu empty_waits=%u full_waits=%u refill_errors=%u reclaims=%u\n",
+			       (unsigned long long)(after.published - before.published),
+			       (unsigned long long)(after.claimed - before.claimed),
+			       (unsigned int)(after.emptyWaits - before.emptyWaits),
+			       (unsigned int)(after.fullWaits - before.fullWaits),
+			       (unsigned int)(after.refillErrors - before.refillErrors),
+			       (unsigned int)(after.reclaims - before.reclaims));
+		}
+		tztrngd_shm_close(pShm);
+	}
+
+	TZTRNG_PRINTF("%s\n", fail ? "FAILED" : "PASSED");
+
+	return fail;
+}
@@ -29,5 +29,27 @@ This file should be updated according to the characterization process.
 #define CC_CONFIG_SAMPLE_CNT_ROSC_3		300
 #define CC_CONFIG_SAMPLE_CNT_ROSC_4		100
 
+/* drift monitor (CC_CONFIG_TRNG_DRIFT_MONITOR): allowed sample count range for each
+   ring oscillator. The monitor never leaves these bounds, so they must come from the
+   characterization of the lowest sample count that still passes at every corner (MIN)
+   and the worst-case corner value (MAX). */
+#define CC_CONFIG_SAMPLE_CNT_ROSC_1_MIN		100
+#define CC_CONFIG_SAMPLE_CNT_ROSC_1_MAX		400
+#define CC_CONFIG_SAMPLE_CNT_ROSC_2_MIN		100
+#define CC_CONFIG_SAMPLE_CNT_ROSC_2_MAX		400
+#define CC_CONFIG_SAMPLE_CNT_ROSC_3_MIN		150
+#define CC_CONFIG_SAMPLE_CNT_ROSC_3_MAX		600
+#define CC_CONFIG_SAMPLE_CNT_ROSC_4_MIN		50
+#define CC_CONFIG_SAMPLE_CNT_ROSC_4_MAX		200
+
+/* number of APT windows (1024 bits each) observed before each adjustment decision */
+#define CC_CONFIG_TRNG_DRIFT_EVAL_WINDOWS		32
+/* APT margin (cutoff minus highest count seen) below which the sample count is raised */
+#define CC_CONFIG_TRNG_DRIFT_APT_MARGIN_LOW		150
+/* APT margin above which the sample count may be lowered */
+#define CC_CONFIG_TRNG_DRIFT_APT_MARGIN_HIGH		250
+/* lowest min-entropy estimate per bit (Q16, 65536 = 1 bit) that still allows lowering */
+#define CC_CONFIG_TRNG_DRIFT_MIN_ENTROPY_Q16		52429	/* 0.8 */
+
 #endif
 
@@ -20,6 +20,10 @@
 
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*******************************************************************************/
 /**
  * @brief The CC_TrngGetSource reads random source of needed size from TRNG.
@@ -38,4 +42,1099 @@ uint32_t CC_TrngGetSource(unsigned long rngRegBase, /* in */
                         size_t *outLen,             /* out */
                         size_t reqBits);            /* in */
 
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngIrqHandler is the RNG interrupt handler of the FreeRTOS
+ *        interrupt driven EHR wait (built with CC_CONFIG_TRNG_WAIT_IRQ = 1 and
+ *        TEE_OS = freertos). It must be installed in the vector table for the
+ *        RNG interrupt line. The Linux build uses a UIO device instead.
+ */
+void CC_TrngIrqHandler(void);
+
+/*******************************************************************************/
+/* Entropy drift monitor (built with CC_CONFIG_TRNG_DRIFT_MONITOR = 1)         */
+/*******************************************************************************/
+
+#define CC_TRNG_NUM_OF_ROSCS            4
+#define CC_TRNG_DRIFT_LOG_ENTRIES       8
+
+/* Per ring oscillator state of the drift monitor */
+typedef struct {
+    uint32_t sampleCnt;             /* sample count currently used for this ROSC */
+    uint32_t sampleCntMin;          /* characterization bounds for the sample count */
+    uint32_t sampleCntMax;
+    uint32_t minEntropyQ16;         /* last min-entropy estimate per bit (65536 = 1 bit) */
+    uint32_t aptMaxCount;           /* highest APT count seen in the last evaluation */
+    uint32_t rawBitsPerSec;         /* raw bit rate at the current sample count */
+    uint32_t entropyBitsPerSec;     /* rawBitsPerSec scaled by minEntropyQ16 */
+    uint32_t adjustments;           /* number of sample count changes */
+} CCTrngDriftRosc_t;
+
+/* One sample count adjustment */
+typedef struct {
+    uint32_t seq;                   /* running adjustment number, starting from 1 */
+    uint32_t rosc;                  /* ROSC index 0..3 */
+    uint32_t oldSampleCnt;
+    uint32_t newSampleCnt;
+    uint32_t aptMaxCount;           /* APT count that triggered the adjustment */
+    uint32_t minEntropyQ16;         /* min-entropy estimate at the time of the adjustment */
+} CCTrngDriftLogEntry_t;
+
+typedef struct {
+    CCTrngDriftRosc_t rosc[CC_TRNG_NUM_OF_ROSCS];
+    uint32_t logCount;              /* valid entries in log[], oldest first */
+    CCTrngDriftLogEntry_t log[CC_TRNG_DRIFT_LOG_ENTRIES];
+} CCTrngDriftReport_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngGetDriftReport returns the state of the entropy drift monitor:
+ *        the sample count in use for each ROSC, the current min-entropy and APT
+ *        margin figures, the resulting bit rates and the last adjustments made.
+ *
+ * @param[out] pReport - The report, prepared by the caller.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngGetDriftReport(CCTrngDriftReport_t *pReport);  /* out */
+
+/*******************************************************************************/
+/* Driver statistics (built with CC_CONFIG_TRNG_STATS = 1)                     */
+/*******************************************************************************/
+
+/* Event counters, counted since start-up or the last CC_TrngResetStats() */
+typedef struct {
+    uint32_t requests;              /* CC_TrngGetSource calls */
+    uint32_t requestErrors;         /* CC_TrngGetSource calls that returned an error */
+    uint32_t startupTests;          /* start-up tests run */
+    uint32_t ehrRead;               /* EHRs read from the hardware */
+    uint32_t bytesDelivered;        /* bytes returned to the callers */
+    uint32_t bytesDiscarded;        /* bytes read but not returned (start-up test, failed tests, rounding) */
+    uint32_t crngtErrors;           /* CRNGT errors reported by the hardware */
+    uint32_t vnErrors;              /* von Neumann errors reported by the hardware (FE mode) */
+    uint32_t autocorrErrors;        /* autocorrelation errors reported by the hardware (FE mode) */
+    uint32_t rctFailures;           /* repetition count test failures (TRNG90B mode) */
+    uint32_t aptFailures;           /* adaptive proportion test failures (TRNG90B mode) */
+    uint32_t roscFailures[CC_TRNG_NUM_OF_ROSCS]; /* fallbacks from each ROSC to the next */
+    uint32_t pollSpins;             /* ISR reads that found no valid EHR */
+    uint32_t restarts;              /* full TRNG restarts */
+    uint32_t resetLoops;            /* sample count write and read-back iterations */
+} CCTrngStats_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngGetStats returns a snapshot of the driver event counters.
+ *        The counters are not updated atomically; take the snapshot while no
+ *        CC_TrngGetSource call is running to get a consistent view.
+ *
+ * @param[out] pStats - The counters, prepared by the caller.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngGetStats(CCTrngStats_t *pStats);   /* out */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngResetStats clears all driver event counters.
+ */
+void CC_TrngResetStats(void);
+
+/*******************************************************************************/
+/* Phase profiler (built with CC_CONFIG_TRNG_PROFILE = 1)                      */
+/*******************************************************************************/
+
+/* Phases of a CC_TrngGetSource call. SAMPLE_CNT is part of START_HW;
+   START_HW, WAIT and EHR_READ repeat for every EHR. */
+typedef enum {
+    CC_TRNG_PROF_PARAMS = 0,        /* parameter setup */
+    CC_TRNG_PROF_START_HW,          /* TRNG (re)start */
+    CC_TRNG_PROF_SAMPLE_CNT,        /* SAMPLE_CNT1 write and read-back loop */
+    CC_TRNG_PROF_WAIT,              /* CC_HalWaitInterrupt */
+    CC_TRNG_PROF_EHR_READ,          /* EHR readout */
+    CC_TRNG_PROF_CONT_TEST,         /* continuous health tests (TRNG90B mode) */
+    CC_TRNG_PROF_COPY,              /* copy to the caller's buffer */
+    CC_TRNG_PROF_WIPE,              /* wipe of the work buffer */
+    CC_TRNG_PROF_TOTAL,             /* whole successful CC_TrngGetSource call */
+    CC_TRNG_PROF_NUM_PHASES
+} CCTrngProfPhase_t;
+
+/* bucket i holds the durations d with 2^(i-1) <= d < 2^i (bucket 0: d = 0), the last
+   bucket also all longer ones */
+#define CC_TRNG_PROF_NUM_BUCKETS        33
+
+/* Durations are in 64-bit timestamp ticks: nanoseconds on Linux, CPU cycles on bare metal */
+typedef struct {
+    uint32_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint32_t hist[CC_TRNG_PROF_NUM_BUCKETS];
+} CCTrngProfHist_t;
+
+typedef struct {
+    CCTrngProfHist_t phase[CC_TRNG_PROF_NUM_PHASES];
+} CCTrngProfile_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngGetProfile returns a snapshot of the phase histograms.
+ *
+ * @param[out] pProfile - The histograms, prepared by the caller.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngGetProfile(CCTrngProfile_t *pProfile);   /* out */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngResetProfile clears all phase histograms.
+ */
+void CC_TrngResetProfile(void);
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngProfileToCsv formats the phase histograms as CSV text, one
+ *        header line and one line per phase:
+ *        phase,count,min,max,sum,b0,...,b32
+ *
+ * @param[out] outBuf - The text buffer, prepared by the caller.
+ * @param[in,out] outLen - In: size of outBuf. Out: length of the text, without
+ *                         the terminating NUL (the required size minus one if
+ *                         the buffer is too small).
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngProfileToCsv(char *outBuf,      /* out */
+                             size_t *outLen);   /* in/out */
+
+/*******************************************************************************/
+/* Hardware telemetry (built with CC_CONFIG_TRNG_TELEMETRY = 1)                */
+/*******************************************************************************/
+
+#define CC_TRNG_ISR_HISTORY_ENTRIES     16
+#define CC_TRNG_NUM_OF_BIST_CNTRS       3
+
+typedef struct {
+    uint32_t rosc;                  /* ROSC selected in TRNG_CONFIG (0..3) */
+    uint32_t sampleCnt;             /* SAMPLE_CNT1 */
+    uint32_t busy;                  /* RNG_BUSY: 1 while the TRNG is collecting */
+    uint32_t autocorrTrys;          /* AUTOCORR_STATISTIC: autocorrelation test runs */
+    uint32_t autocorrFails;         /* AUTOCORR_STATISTIC: autocorrelation test failures */
+    uint32_t bistCntr[CC_TRNG_NUM_OF_BIST_CNTRS]; /* RNG_BIST_CNTR_0..2 */
+    uint32_t isrCount;              /* non-zero ISR values seen by the EHR wait since start-up */
+    uint32_t isrHistoryLen;         /* valid entries in isrHistory[], oldest first */
+    uint32_t isrHistory[CC_TRNG_ISR_HISTORY_ENTRIES];
+} CCTrngHwTelemetry_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngGetHwTelemetry takes a snapshot of the TRNG status registers
+ *        (autocorrelation statistics, BIST counters, busy flag, ROSC and sample
+ *        count in use) and of the last ISR values seen by the driver. It only
+ *        reads registers and may be called after every CC_TrngGetSource call.
+ *        With CC_CONFIG_TRNG_LOCK=1 it takes the driver lock, so it may also be
+ *        called while other threads collect.
+ *
+ * @param[in] rngRegBase - TRNG base address, given by the system.
+ * @param[out] pTelemetry - The snapshot, prepared by the caller.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngGetHwTelemetry(unsigned long rngRegBase,           /* in */
+                               CCTrngHwTelemetry_t *pTelemetry);   /* out */
+
+/*******************************************************************************/
+/* MMIO hooks (built with CC_CONFIG_TRNG_MMIO_HOOKS = 1)                       */
+/*******************************************************************************/
+
+/* Register access backend: every CC_HAL_READ_REGISTER/CC_HAL_WRITE_REGISTER of the
+   driver goes through it. 'offset' is relative to the register base. */
+typedef struct {
+    uint32_t (*read)(void *ctx, unsigned long regBase, uint32_t offset);
+    void (*write)(void *ctx, unsigned long regBase, uint32_t offset, uint32_t val);
+    /* optional: called at the start of every CC_TrngGetSource call */
+    void (*request)(void *ctx, size_t reqBits);
+    void *ctx;
+} CCTrngMmioOps_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngSetMmioOps installs a register access backend.
+ *
+ * @param[in] pOps - The backend, kept by reference; NULL restores direct access.
+ */
+void CC_TrngSetMmioOps(const CCTrngMmioOps_t *pOps);
+
+/* MMIO trace format: a header followed by 'records' records, native byte order */
+#define CC_TRNG_MMIO_TRACE_MAGIC        0x544D5A54UL    /* "TZMT" */
+#define CC_TRNG_MMIO_TRACE_VERSION      1
+
+typedef enum {
+    CC_TRNG_MMIO_OP_READ = 0,
+    CC_TRNG_MMIO_OP_WRITE = 1,
+    CC_TRNG_MMIO_OP_REQUEST = 2,    /* start of CC_TrngGetSource, value = reqBits */
+} CCTrngMmioOp_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t trngMode;              /* CC_CONFIG_TRNG_MODE of the recording build */
+    uint32_t records;
+    uint32_t flags;                 /* CC_TRNG_MMIO_TRACE_TRUNCATED */
+} CCTrngMmioTraceHdr_t;
+
+#define CC_TRNG_MMIO_TRACE_TRUNCATED    0x1     /* the record buffer overflowed */
+
+typedef struct {
+    uint32_t tsDelta;               /* timestamp ticks since the previous record */
+    uint16_t offset;                /* register offset */
+    uint8_t  op;                    /* CCTrngMmioOp_t */
+    uint8_t  reserved;
+    uint32_t value;                 /* value read or written, reqBits for requests */
+} CCTrngMmioTraceRec_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngMmioRecordStart starts logging every register access (and
+ *        every CC_TrngGetSource request) into a caller buffer. The accesses are
+ *        passed on to the backend installed before, direct access by default.
+ *
+ * @param[out] traceBuf - The trace buffer, 4 bytes aligned, prepared by the caller.
+ * @param[in] traceSize - The size of traceBuf; recording stops when it is full.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngMmioRecordStart(void *traceBuf,     /* out */
+                                size_t traceSize);  /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngMmioRecordStop stops recording and restores the previous backend.
+ *
+ * @param[out] traceLen - The length of the trace in traceBuf.
+ *
+ * @return uint32_t - On success 0 is returned; if the buffer overflowed the trace is
+ *                    still valid but truncated, and an error is returned.
+ *
+ */
+uint32_t CC_TrngMmioRecordStop(size_t *traceLen);   /* out */
+
+typedef struct {
+    uint32_t records;               /* records in the trace */
+    uint32_t consumed;              /* records matched or skipped */
+    uint32_t requests;              /* CC_TrngGetSource requests replayed */
+    uint32_t reads;                 /* register reads made by the driver */
+    uint32_t writes;                /* register writes made by the driver */
+    uint32_t divergences;           /* accesses that did not match the trace */
+    uint32_t exhausted;             /* 1 if the driver read past the end of the trace */
+    uint64_t tracedTicks;           /* recorded time of the consumed records */
+    /* first divergence: the expected record and the access actually made */
+    uint32_t firstDivergenceIdx;
+    CCTrngMmioTraceRec_t expected;
+    CCTrngMmioTraceRec_t actual;
+} CCTrngMmioReplayReport_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngMmioReplayStart installs a backend that serves the register
+ *        reads of the driver from a recorded trace and checks its writes against
+ *        it. On a mismatch the replay resynchronizes on the next matching record;
+ *        reads that cannot be served return the last value written to the register,
+ *        and the ISR reports CRNGT errors so that a waiting driver gives up.
+ *
+ * @param[in] traceBuf - The trace, 4 bytes aligned.
+ * @param[in] traceLen - The length of the trace.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngMmioReplayStart(const void *traceBuf,   /* in */
+                                size_t traceLen);       /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngMmioReplayStop restores direct register access and reports
+ *        the replay.
+ *
+ * @param[out] pReport - The replay report, prepared by the caller.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngMmioReplayStop(CCTrngMmioReplayReport_t *pReport); /* out */
+
+/*******************************************************************************/
+/* CTR_DRBG (built with CC_CONFIG_TRNG_DRBG = 1)                               */
+/*******************************************************************************/
+
+/* NIST SP 800-90A CTR_DRBG with AES-256 and the derivation function, 256 bit
+   security strength. Entropy input and nonce are taken from CC_TrngGetSource(),
+   or from CC_TrngGetFullEntropy() with CC_CONFIG_TRNG_CONDITIONING = 1. */
+#define CC_DRBG_AES_ROUND_KEY_WORDS     60
+#define CC_DRBG_BLOCK_BYTES             16
+#define CC_DRBG_MAX_REQUEST_BYTES       0x10000UL   /* 2^19 bits per generate call */
+#define CC_DRBG_MAX_INPUT_BYTES         0x10000UL   /* personalization string and additional input */
+
+/* Working state, owned by the caller. A state must not be used by several
+   threads at once; separate states may be used concurrently if
+   CC_TrngGetSource() is serialized (CC_CONFIG_TRNG_LOCK = 1). */
+typedef struct {
+    uint32_t roundKeys[CC_DRBG_AES_ROUND_KEY_WORDS]; /* key schedule of Key */
+    uint8_t  v[CC_DRBG_BLOCK_BYTES];                /* V */
+    uint32_t reseedCounter;                         /* generate calls since the last (re)seed, plus one */
+    uint32_t predictionResistance;                  /* reseed before every generate call */
+    uint32_t instantiated;
+    unsigned long rngRegBase;                       /* TRNG base address of the entropy source */
+} CCDrbgState_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_DrbgInstantiate seeds a DRBG state from the TRNG. The known
+ *        answer tests of CC_DrbgSelfTest() run on the first call.
+ *
+ * @param[out] pState - The DRBG state, prepared by the caller.
+ * @param[in] rngRegBase - TRNG base address, given by the system.
+ * @param[in] pers - Personalization string, may be NULL.
+ * @param[in] persLen - The length of pers, at most CC_DRBG_MAX_INPUT_BYTES.
+ * @param[in] predictionResistance - 1: reseed from the TRNG before every
+ *                                   CC_DrbgGenerate() call.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_DrbgInstantiate(CCDrbgState_t *pState,         /* out */
+                            unsigned long rngRegBase,      /* in */
+                            const uint8_t *pers,           /* in */
+                            size_t persLen,                /* in */
+                            uint32_t predictionResistance);/* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_DrbgReseed mixes fresh TRNG entropy and optional additional
+ *        input into an instantiated state.
+ *
+ * @param[in,out] pState - The DRBG state.
+ * @param[in] addInput - Additional input, may be NULL.
+ * @param[in] addInputLen - The length of addInput, at most CC_DRBG_MAX_INPUT_BYTES.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_DrbgReseed(CCDrbgState_t *pState,       /* in/out */
+                       const uint8_t *addInput,     /* in */
+                       size_t addInputLen);         /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_DrbgGenerate returns pseudorandom bytes. The state is reseeded
+ *        from the TRNG first when prediction resistance is on or after
+ *        CC_CONFIG_DRBG_RESEED_INTERVAL generate calls.
+ *
+ * @param[in,out] pState - The DRBG state.
+ * @param[out] out - The output buffer, prepared by the caller.
+ * @param[in] outLen - The number of bytes, at most CC_DRBG_MAX_REQUEST_BYTES.
+ * @param[in] addInput - Additional input, may be NULL.
+ * @param[in] addInputLen - The length of addInput, at most CC_DRBG_MAX_INPUT_BYTES.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_DrbgGenerate(CCDrbgState_t *pState,     /* in/out */
+                         uint8_t *out,              /* out */
+                         size_t outLen,             /* in */
+                         const uint8_t *addInput,   /* in */
+                         size_t addInputLen);       /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_DrbgUninstantiate wipes a DRBG state.
+ *
+ * @param[in,out] pState - The DRBG state.
+ */
+void CC_DrbgUninstantiate(CCDrbgState_t *pState);
+
+/*******************************************************************************/
+/**
+ * @brief The CC_DrbgSelfTest runs the CTR_DRBG known answer tests (instantiate,
+ *        reseed with prediction resistance, generate with additional input).
+ *        A failure disables CC_DrbgInstantiate() until the test passes.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_DrbgSelfTest(void);
+
+/*******************************************************************************/
+/* Conditioning (built with CC_CONFIG_TRNG_CONDITIONING = 1)                   */
+/*******************************************************************************/
+
+/* NIST SP 800-90B vetted conditioning functions */
+typedef enum {
+    CC_TRNG_COND_SHA256 = 0,        /* SHA-256, 256 bit output blocks */
+    CC_TRNG_COND_CBC_MAC = 1,       /* AES-256 CBC-MAC with a fixed key, 128 bit output blocks */
+} CCTrngCondFunc_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngGetFullEntropy returns full entropy output. Every output block
+ *        of the conditioning function is computed over health-tested TRNG data
+ *        holding at least 64 bits of min-entropy more than the block length, at
+ *        CC_CONFIG_TRNG_COND_ENTROPY_RATE bits of min-entropy per 1024 data bits.
+ *        Unlike CC_TrngGetSource(), reqBits counts bits of min-entropy.
+ *
+ * @param[in] rngRegBase - TRNG base address, given by the system.
+ * @param[in] condFunc - The conditioning function.
+ * @param[out] outAddr - The output buffer, prepared by the caller.
+ * @param[out] outLen - The number of bytes returned, ROUND_UP(reqBits / 8).
+ * @param[in] reqBits - The request size in bits of min-entropy.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngGetFullEntropy(unsigned long rngRegBase,      /* in */
+                               CCTrngCondFunc_t condFunc,     /* in */
+                               uint8_t *outAddr,              /* out */
+                               size_t *outLen,                /* out */
+                               size_t reqBits);               /* in */
+
+/*******************************************************************************/
+/* Entropy pool (built with CC_CONFIG_TRNG_POOL = 1)                           */
+/*******************************************************************************/
+
+/* Pool state, counted since CC_TrngPoolStart() */
+typedef struct {
+    uint32_t capacity;              /* CC_CONFIG_TRNG_POOL_BYTES */
+    uint32_t lowWatermark;          /* refill starts at or below this level */
+    uint32_t highWatermark;         /* refill stops at this level */
+    uint32_t level;                 /* bytes in the pool */
+    uint32_t refills;               /* successful collections */
+    uint32_t refillErrors;          /* failed collections, retried after CC_CONFIG_TRNG_POOL_RETRY_MS */
+    uint32_t lastError;             /* error of the last collection, 0 once one succeeds again */
+    uint32_t reads;                 /* CC_TrngPoolRead calls */
+    uint32_t readWaits;             /* times a reader found the pool empty and waited */
+    uint32_t bytesRead;             /* bytes returned to the readers */
+} CCTrngPoolStatus_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngPoolStart locks the pool buffer in memory and starts the
+ *        producer thread. The producer is then the only user of the TRNG: it
+ *        refills the pool with health-tested CC_TrngGetSource() output
+ *        whenever the level drops to the low watermark, up to the high watermark.
+ *        CC_TrngPoolStart and CC_TrngPoolStop must be called from one thread.
+ *
+ * @param[in] rngRegBase - TRNG base address, given by the system.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngPoolStart(unsigned long rngRegBase);    /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngPoolRead copies bytes out of the pool and wipes them there.
+ *        It may be called from any number of threads and never accesses the
+ *        TRNG; it waits only while the pool is empty. If the producer's last
+ *        collection failed and the pool is empty, that error is returned.
+ *
+ * @param[out] outAddr - The output buffer, prepared by the caller.
+ * @param[in] outLen - The number of bytes.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *                    (outAddr is then wiped)
+ *
+ */
+uint32_t CC_TrngPoolRead(uint8_t *outAddr,  /* out */
+                         size_t outLen);    /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngPoolStop stops the producer thread, wakes the waiting readers
+ *        with an error, wipes the pool and unlocks its memory.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngPoolStop(void);
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngPoolGetStatus returns the pool level and counters.
+ *
+ * @param[out] pStatus - The status, prepared by the caller.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngPoolGetStatus(CCTrngPoolStatus_t *pStatus);   /* out */
+
+/*******************************************************************************/
+/* Request coalescing (built with CC_CONFIG_TRNG_COALESCE = 1)                 */
+/*******************************************************************************/
+
+/* Priority classes of CC_TrngGetSourceCoalesced(), served highest first and in
+   arrival order within a class */
+typedef enum {
+    CC_TRNG_PRIO_LOW = 0,           /* background, e.g. reseeds */
+    CC_TRNG_PRIO_NORMAL = 1,
+    CC_TRNG_PRIO_HIGH = 2,          /* latency critical: closes the collection window */
+} CCTrngPriority_t;
+
+/* Scheduler counters, counted since start-up or the last CC_TrngResetCoalesceStats() */
+typedef struct {
+    uint32_t requests;              /* CC_TrngGetSourceCoalesced calls */
+    uint32_t requestErrors;         /* calls that returned an error */
+    uint32_t batches;               /* collections issued */
+    uint32_t batchedBytes;          /* bytes collected for the batches */
+    uint32_t maxBatchRequests;      /* most requests served by one collection */
+    uint32_t windowExpired;         /* batches started when the window ran out */
+    uint32_t thresholdReached;      /* batches started early on CC_CONFIG_TRNG_COALESCE_THRESHOLD_BYTES */
+    uint32_t priorityKicks;         /* batches started early for a CC_TRNG_PRIO_HIGH request */
+} CCTrngCoalesceStats_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngGetSourceCoalesced returns the same output as
+ *        CC_TrngGetSource(), but requests arriving together share one
+ *        collection: the pending requests are gathered for up to
+ *        CC_CONFIG_TRNG_COALESCE_WINDOW_US, or until they add up to
+ *        CC_CONFIG_TRNG_COALESCE_THRESHOLD_BYTES, then one caller collects for
+ *        all of them (at most CC_CONFIG_TRNG_COALESCE_MAX_BATCH_BYTES) and the
+ *        health-tested bytes are scattered to each. A CC_TRNG_PRIO_HIGH request
+ *        goes ahead of the queue and starts the collection right away.
+ *
+ * @param[in] rngRegBase - TRNG base address, given by the system.
+ * @param[out] *outAddr - The pointer to the buffer address for TRNG data output,
+ *                        prepared by the caller.
+ * @param[out] *outLen - The pointer to size of TRNG returned data.
+ * @param[in] reqBits - The request size of entropy in bits.
+ * @param[in] prio - The priority class.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngGetSourceCoalesced(unsigned long rngRegBase,    /* in */
+                                   uint8_t *outAddr,            /* out */
+                                   size_t *outLen,              /* out */
+                                   size_t reqBits,              /* in */
+                                   CCTrngPriority_t prio);      /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngGetCoalesceStats returns a snapshot of the scheduler counters.
+ *
+ * @param[out] pStats - The counters, prepared by the caller.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngGetCoalesceStats(CCTrngCoalesceStats_t *pStats);  /* out */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngResetCoalesceStats clears the scheduler counters.
+ */
+void CC_TrngResetCoalesceStats(void);
+
+/*******************************************************************************/
+/* Asynchronous collection (built with CC_CONFIG_TRNG_ASYNC = 1)               */
+/*******************************************************************************/
+
+/* CC_TrngAsyncPoll: the collection waits for the next EHR */
+#define CC_TRNG_ASYNC_PENDING           1
+/* noise of one health-tested block: the 528 bytes of the TRNG90B start-up test */
+#define CC_TRNG_ASYNC_WORK_WORDS        132
+
+/* Collection context, owned by the caller and kept in place until the
+   collection completes or is cancelled. The fields are internal. */
+typedef struct {
+    uint32_t work[CC_TRNG_ASYNC_WORK_WORDS];        /* noise of the block being collected */
+    uint32_t sampleCnt[CC_TRNG_NUM_OF_ROSCS];       /* sample counts, 0 for a ROSC not allowed */
+    unsigned long rngRegBase;
+    uint8_t *outAddr;
+    uint8_t *outPos;                                /* next byte to deliver */
+    uint32_t outLen;
+    uint32_t remaining;                             /* bytes still to deliver */
+    uint32_t state;
+    uint32_t procState;                             /* ROSCs started and processed */
+    uint32_t rosc;                                  /* ROSC mask collecting the block */
+    uint32_t blockBytes;                            /* size of the block being collected */
+    uint32_t fill;                                  /* bytes of the block read so far */
+    uint32_t crngtErrors;                           /* CRNGT errors while waiting for this EHR */
+    uint32_t vnErrors;                              /* VN errors while waiting for this EHR */
+} CCTrngAsync_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngAsyncStart starts a collection of the same output as
+ *        CC_TrngGetSource(), run as a state machine that never waits for the
+ *        hardware: each CC_TrngAsyncPoll() call reads the ISR and does
+ *        the work that is ready (read the EHR, run the health tests, move to
+ *        the next ROSC, restart the TRNG for the next block). Call it when the
+ *        RNG interrupt fires or from a timer. One collection runs at a time;
+ *        it owns the TRNG until it completes or is cancelled. Meanwhile
+ *        CC_TrngGetSource(), the pool and the coalescer fail with
+ *        CC_RND_TRNG_ASYNC_BUSY_ERROR.
+ *
+ * @param[out] pCtx - The collection context, prepared by the caller.
+ * @param[in] rngRegBase - TRNG base address, given by the system.
+ * @param[out] outAddr - The output buffer of ROUND_UP(reqBits / 8) bytes,
+ *                       prepared by the caller and kept until completion.
+ * @param[in] reqBits - The request size of entropy in bits.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngAsyncStart(CCTrngAsync_t *pCtx,         /* out */
+                           unsigned long rngRegBase,    /* in */
+                           uint8_t *outAddr,            /* out */
+                           size_t reqBits);             /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngAsyncPoll advances the collection of pCtx without waiting.
+ *
+ * @param[in,out] pCtx - The collection context of CC_TrngAsyncStart().
+ *
+ * @return uint32_t - CC_TRNG_ASYNC_PENDING while the collection waits for the
+ *                    hardware, 0 once the output is complete, on failure,
+ *                    check CC_Error_t codes (the output is then wiped). The TRNG
+ *                    is free for the next collection when 0 or an error is returned.
+ *
+ */
+uint32_t CC_TrngAsyncPoll(CCTrngAsync_t *pCtx);    /* in/out */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngAsyncCancel stops the collection of pCtx, turns the TRNG
+ *        off and wipes the output and the context.
+ *
+ * @param[in,out] pCtx - The collection context of CC_TrngAsyncStart().
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngAsyncCancel(CCTrngAsync_t *pCtx);  /* in/out */
+
+/*******************************************************************************/
+/* TLS entropy poll adapter (built with CC_CONFIG_TRNG_TLS_POLL = 1)           */
+/*******************************************************************************/
+
+/* bytes per collection of the adapter: four TRNG90B blocks after one start-up test */
+#ifndef CC_TRNG_TLS_POLL_BYTES
+#define CC_TRNG_TLS_POLL_BYTES          576
+#endif
+/* CC_TrngTlsPoll failure, the value of MBEDTLS_ERR_ENTROPY_SOURCE_FAILED */
+#define CC_TRNG_TLS_POLL_FAILED         (-0x003C)
+
+/* Adapter counters, counted since CC_TrngTlsPollInit() */
+typedef struct {
+    uint32_t polls;                 /* CC_TrngTlsPoll calls */
+    uint32_t pollCollections;       /* polls that had to wait for a collection */
+    uint32_t prefetches;            /* CC_TrngTlsPrefetch calls that collected */
+    uint32_t collections;           /* TRNG collections, by polls and prefetches */
+    uint32_t errors;                /* failed collections */
+    uint32_t lastError;             /* CC error of the last failed collection */
+    uint64_t bytes;                 /* bytes handed to the TLS stack */
+    uint64_t entropyBits;           /* min-entropy of those bytes */
+} CCTrngTlsPollStats_t;
+
+/* Adapter state, owned by the caller. Not thread safe: one adapter per
+   entropy context, or serialized by the TLS stack. */
+typedef struct {
+    uint8_t buf[CC_TRNG_TLS_POLL_BYTES];    /* health-tested bytes, [0, level) not handed out yet */
+    uint32_t level;
+    unsigned long rngRegBase;
+    CCTrngTlsPollStats_t stats;
+} CCTrngTlsPoll_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngTlsPollInit prepares an adapter over the TRNG. No
+ *        collection is made before the first poll or prefetch.
+ *
+ * @param[out] pCtx - The adapter, prepared by the caller.
+ * @param[in] rngRegBase - TRNG base address, given by the system.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngTlsPollInit(CCTrngTlsPoll_t *pCtx,         /* out */
+                            unsigned long rngRegBase);     /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngTlsPoll is an entropy source callback of the signature
+ *        TLS stacks use (mbedtls_entropy_f_source_ptr). It serves the request
+ *        from the adapter buffer and collects CC_TRNG_TLS_POLL_BYTES at a time
+ *        when the buffer runs out, so small polls share the start-up test of
+ *        one CC_TrngGetSource() collection. Every byte handed out is wiped from
+ *        the buffer. Each output byte holds CC_TrngTlsPollEntropyBits(1) / 8
+ *        bits of min-entropy: register the source with the threshold of
+ *        CC_TrngTlsPollThreshold().
+ *
+ * @param[in,out] data - The adapter of CC_TrngTlsPollInit().
+ * @param[out] output - The output buffer.
+ * @param[in] len - The number of bytes requested.
+ * @param[out] olen - The number of bytes written: len, or 0 on failure.
+ *
+ * @return int - 0 on success, CC_TRNG_TLS_POLL_FAILED on failure (the CC
+ *               error is in the adapter counters, the output is wiped)
+ *
+ */
+int CC_TrngTlsPoll(void *data,                  /* in/out */
+                   unsigned char *output,       /* out */
+                   size_t len,                  /* in */
+                   size_t *olen);               /* out */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngTlsPrefetch tops the adapter buffer up to at least 'bytes'
+ *        ahead of a known reseed point (a connection about to be accepted, a
+ *        DRBG near its reseed interval), so the polls at that point do not
+ *        wait for the TRNG. Call it where a collection does not add latency.
+ *
+ * @param[in,out] pCtx - The adapter.
+ * @param[in] bytes - The bytes to have buffered, at most CC_TRNG_TLS_POLL_BYTES.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngTlsPrefetch(CCTrngTlsPoll_t *pCtx,  /* in/out */
+                            size_t bytes);          /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngTlsPollThreshold returns the output bytes of the adapter
+ *        that carry 'entropyBits' of min-entropy, at the characterized
+ *        entropy per bit of the TRNG (CC_CONFIG_TRNG_ENTROPY_PER_BIT_Q8).
+ */
+size_t CC_TrngTlsPollThreshold(size_t entropyBits);
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngTlsPollEntropyBits returns the min-entropy in bits of
+ *        'bytes' output bytes of the adapter.
+ */
+size_t CC_TrngTlsPollEntropyBits(size_t bytes);
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngTlsPollFree wipes the adapter buffer and counters.
+ */
+void CC_TrngTlsPollFree(CCTrngTlsPoll_t *pCtx);    /* in/out */
+
+/*******************************************************************************/
+/* FreeRTOS entropy service (built with CC_CONFIG_TRNG_SERVICE = 1)            */
+/*******************************************************************************/
+
+/* CC_TrngServiceGet: queue ahead of the other requests and lend the caller's priority */
+#define CC_TRNG_SERVICE_URGENT          1
+
+/* Service counters, counted since CC_TrngServiceStart() */
+typedef struct {
+    uint32_t level;                 /* bytes in the prefill buffer */
+    uint32_t requests;              /* requests served, including failed ones */
+    uint32_t urgentRequests;        /* of which CC_TRNG_SERVICE_URGENT */
+    uint32_t bufferHits;            /* requests served from the prefill buffer alone */
+    uint32_t collections;           /* successful collections */
+    uint32_t errors;                /* failed collections */
+    uint32_t lastError;             /* CC error of the last failed collection */
+    uint32_t irqWakeups;            /* service wake-ups by the RNG interrupt */
+    uint32_t timeoutWakeups;        /* polls after CC_CONFIG_TRNG_SERVICE_WAIT_MS without one */
+    uint32_t boosts;                /* times the service ran above its own priority */
+    uint32_t bytes;                 /* bytes returned to the requesters */
+} CCTrngServiceStats_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngServiceStart starts the entropy service task. The task
+ *        is then the only user of the TRNG: it runs the collections of
+ *        CC_TrngAsyncStart() and sleeps on its task notification between two
+ *        EHRs, woken by CC_TrngServiceIrqHandler(). While idle it keeps a
+ *        prefill buffer of CC_CONFIG_TRNG_SERVICE_BUF_BYTES full, and it serves
+ *        the requests of CC_TrngServiceGet() from that buffer.
+ *        CC_TrngServiceStart and CC_TrngServiceStop must be called from one task.
+ *
+ * @param[in] rngRegBase - TRNG base address, given by the system.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngServiceStart(unsigned long rngRegBase);    /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngServiceGet queues a request to the service task and blocks
+ *        the calling task until it is served. An urgent request goes to the
+ *        front of the queue, and the service runs at least at the caller's
+ *        priority until it is served, so tasks of a priority in between cannot
+ *        delay it. The completion is signalled through the caller's task
+ *        notification of index CC_CONFIG_TRNG_SERVICE_NOTIFY_INDEX (by default
+ *        the last one of configTASK_NOTIFICATION_ARRAY_ENTRIES, which must be
+ *        at least 2), cleared again before returning.
+ *        Not callable from an interrupt.
+ *
+ * @param[out] outAddr - The output buffer, prepared by the caller.
+ * @param[in] outLen - The number of bytes.
+ * @param[in] flags - 0, or CC_TRNG_SERVICE_URGENT.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *                    (outAddr is then wiped)
+ *
+ */
+uint32_t CC_TrngServiceGet(uint8_t *outAddr,    /* out */
+                           size_t outLen,       /* in */
+                           uint32_t flags);     /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngServiceIrqHandler is the RNG interrupt handler of the
+ *        service. It masks the RNG interrupts and notifies the service task,
+ *        which reads the ISR and unmasks them again before its next sleep.
+ */
+void CC_TrngServiceIrqHandler(void);
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngServiceStop stops the service task, fails the requests
+ *        still queued and wipes the prefill buffer. CC_TrngServiceGet() calls
+ *        made meanwhile fail, and the task exits once none is left inside;
+ *        later calls fail as well.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngServiceStop(void);
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngServiceGetStats returns the service counters.
+ *
+ * @param[out] pStats - The counters, prepared by the caller.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngServiceGetStats(CCTrngServiceStats_t *pStats);   /* out */
+
+/*******************************************************************************/
+/* Cross-world entropy mailbox (built with CC_CONFIG_TRNG_MAILBOX = 1)         */
+/*******************************************************************************/
+
+/* bytes of a mailbox block, the unit the secure side publishes */
+#ifndef CC_TRNG_MAILBOX_BLOCK_BYTES
+#define CC_TRNG_MAILBOX_BLOCK_BYTES     64
+#endif
+/* blocks of the mailbox ring, a power of 2; a gateway call refills all consumed blocks
+   with one collection */
+#ifndef CC_TRNG_MAILBOX_BLOCKS
+#define CC_TRNG_MAILBOX_BLOCKS          16
+#endif
+#define CC_TRNG_MAILBOX_MAGIC           0x584D5A54UL    /* "TZMX" */
+/* CC_TrngMailboxAttach / CC_TrngMailboxRead failure of the non-secure side, which sees
+   tztrng.h only: an illegal argument, a mailbox the secure side did not initialize, or
+   inconsistent ring indexes. The value of CC_RND_TRNG_MAILBOX_STATE_ERROR. */
+#define CC_TRNG_MAILBOX_ERROR           0x00F00C49UL
+
+/* Mailbox in memory both worlds can access, placed by the integrator. The secure side
+   writes the blocks, 'head' and the counters, the non-secure side writes 'tail' only.
+   Neither side trusts what the other writes: the secure side keeps its own copy of
+   'head' and checks 'tail' against it. */
+typedef struct {
+    uint32_t magic;                 /* CC_TRNG_MAILBOX_MAGIC once the ring is filled */
+    uint32_t head;                  /* blocks published, free running */
+    uint32_t tail;                  /* blocks consumed, free running */
+    uint32_t gatewayCalls;          /* CC_TrngMailboxGateway calls, including failed ones */
+    uint32_t collections;           /* successful refills */
+    uint32_t blocksPublished;
+    uint32_t errors;                /* failed refills and rejected ring indexes */
+    uint32_t lastError;             /* CC error of the last failure */
+    uint8_t block[CC_TRNG_MAILBOX_BLOCKS][CC_TRNG_MAILBOX_BLOCK_BYTES];
+} CCTrngMailbox_t;
+
+/* Entry into the secure side from the non-secure client: a function calling the
+   cmse_nonsecure_entry CC_TrngMailboxGateway() on Armv8-M, an IPC stub where the
+   worlds are two processes. Returns its CC error. */
+typedef uint32_t (*CCTrngMailboxGateway_t)(void *ctx);
+
+/* Client counters, counted since CC_TrngMailboxAttach() */
+typedef struct {
+    uint32_t reads;                 /* CC_TrngMailboxRead calls */
+    uint32_t bytes;                 /* bytes read */
+    uint32_t gatewayCalls;          /* gateway calls, two world switches each */
+    uint32_t errors;                /* failed reads */
+    uint32_t lastError;             /* error of the last failed read */
+} CCTrngMailboxClientStats_t;
+
+/* Non-secure client state, owned by the caller. Not thread safe: one client per
+   mailbox, its reads serialized by the caller. */
+typedef struct {
+    CCTrngMailbox_t *pMbox;
+    CCTrngMailboxGateway_t gateway;
+    void *gatewayCtx;
+    uint32_t tail;                  /* blocks consumed */
+    uint32_t offset;                /* bytes consumed of block 'tail' */
+    CCTrngMailboxClientStats_t stats;
+} CCTrngMailboxClient_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngMailboxInit is called by the secure image. It takes the
+ *        mailbox in non-secure memory, fills its ring with health-tested
+ *        blocks and publishes it. On Armv8-M the mailbox must be non-secure
+ *        and writable by the non-secure world (cmse_check_address_range).
+ *
+ * @param[in] rngRegBase - TRNG base address, given by the system.
+ * @param[out] pMbox - The mailbox, in memory the non-secure world can access.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngMailboxInit(unsigned long rngRegBase,     /* in */
+                            CCTrngMailbox_t *pMbox);      /* out */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngMailboxGateway is the secure entry of the non-secure
+ *        world (cmse_nonsecure_entry on Armv8-M). It refills every block the
+ *        client consumed with one CC_TrngGetSource() collection into secure
+ *        memory, copies the blocks to the ring and publishes them. A failed
+ *        collection publishes nothing.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngMailboxGateway(void);
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngMailboxClose is called by the secure image. It wipes the
+ *        mailbox and stops serving gateway calls.
+ */
+void CC_TrngMailboxClose(void);
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngMailboxAttach prepares a non-secure client of a mailbox
+ *        the secure side initialized (tztrng_mailbox_ns.c, built into the
+ *        non-secure image).
+ *
+ * @param[out] pCli - The client, prepared by the caller.
+ * @param[in] pMbox - The mailbox.
+ * @param[in] gateway - The entry into the secure side.
+ * @param[in] gatewayCtx - The argument of 'gateway'.
+ *
+ * @return uint32_t - On success 0 is returned, on failure CC_TRNG_MAILBOX_ERROR
+ *
+ */
+uint32_t CC_TrngMailboxAttach(CCTrngMailboxClient_t *pCli,        /* out */
+                              CCTrngMailbox_t *pMbox,             /* in */
+                              CCTrngMailboxGateway_t gateway,     /* in */
+                              void *gatewayCtx);                  /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngMailboxRead copies 'outLen' bytes out of the mailbox ring
+ *        and wipes them there. It calls the gateway only when the ring runs
+ *        empty, so the world switches are paid once per ring of
+ *        CC_TRNG_MAILBOX_BLOCKS blocks rather than once per request.
+ *
+ * @param[in,out] pCli - The client of CC_TrngMailboxAttach().
+ * @param[out] outAddr - The output buffer.
+ * @param[in] outLen - The number of bytes.
+ *
+ * @return uint32_t - On success 0 is returned, on failure the error of the
+ *                    gateway or CC_TRNG_MAILBOX_ERROR (outAddr is then wiped)
+ *
+ */
+uint32_t CC_TrngMailboxRead(CCTrngMailboxClient_t *pCli,     /* in/out */
+                            uint8_t *outAddr,                /* out */
+                            size_t outLen);                  /* in */
+
+/*******************************************************************************/
+/* Raw-noise tap (built with CC_CONFIG_TRNG_NOISE_TAP = 1)                     */
+/*******************************************************************************/
+
+#define CC_TRNG_EHR_WORDS               6
+
+/* One EHR as read from the hardware, before the continuous health tests */
+typedef struct {
+    uint32_t seq;                   /* EHR number, counted while the tap is on: a gap is a drop */
+    uint32_t rosc;                  /* ROSC number, 0 to 3 */
+    uint32_t sampleCnt;             /* SAMPLE_CNT1, rng clocks per raw bit */
+    uint32_t ehr[CC_TRNG_EHR_WORDS];
+} CCTrngNoiseRecord_t;
+
+/* Tap counters, counted since the first CC_TrngNoiseTapStart() */
+typedef struct {
+    uint32_t ehrs;                  /* EHRs read while the tap was on */
+    uint32_t records;               /* EHRs put in the ring */
+    uint32_t drops;                 /* EHRs not recorded: the ring was full */
+    uint32_t level;                 /* records waiting in the ring */
+} CCTrngNoiseTapStats_t;
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngNoiseTapStart turns the raw-noise tap on. From then on
+ *        every EHR the driver reads, including those of the start-up test and
+ *        of blocks failing the health tests, is copied with its ROSC and
+ *        sample count into a ring of CC_CONFIG_TRNG_NOISE_TAP_RECORDS records.
+ *        The collection never waits for the consumer: an EHR that finds the
+ *        ring full is dropped and counted. Records still in the ring are
+ *        discarded. In TRNG90B mode the records are the output bits: the tap
+ *        is meant for SP 800-90B validation and field analysis only, never
+ *        for a system whose output must stay secret.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngNoiseTapStart(void);
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngNoiseTapStop turns the tap off. The records in the ring
+ *        stay readable.
+ */
+void CC_TrngNoiseTapStop(void);
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngNoiseTapRead moves the oldest records out of the ring and
+ *        wipes their slots. It does not wait: with an empty ring it returns 0
+ *        records. A single consumer thread calls it, and CC_TrngNoiseTapStart
+ *        and CC_TrngNoiseTapStop.
+ *
+ * @param[out] pRecords - The records, prepared by the caller.
+ * @param[in] maxRecords - The number of records pRecords holds.
+ * @param[out] pNumRecords - The number of records read.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngNoiseTapRead(CCTrngNoiseRecord_t *pRecords,   /* out */
+                             uint32_t maxRecords,             /* in */
+                             uint32_t *pNumRecords);          /* out */
+
+/*******************************************************************************/
+/**
+ * @brief The CC_TrngNoiseTapGetStats returns the tap counters.
+ *
+ * @param[out] pStats - The counters, prepared by the caller.
+ *
+ * @return uint32_t - On success 0 is returned, on failure, check CC_Error_t codes
+ *
+ */
+uint32_t CC_TrngNoiseTapGetStats(CCTrngNoiseTapStats_t *pStats);   /* out */
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
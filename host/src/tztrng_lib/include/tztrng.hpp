@@ -0,0 +1,369 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#ifndef _TZTRNG_HPP_
+#define _TZTRNG_HPP_
+
+#include <array>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "tztrng.h"
+
+/*
+ * C++20 front end of the TZ-TRNG driver, header only.
+ *
+ * Session and PoolSession fill std::span buffers from CC_TrngGetSource() and
+ * from the entropy pool (library built with CC_CONFIG_TRNG_POOL = 1). Failures
+ * throw tztrng::Error, which carries the CC error code.
+ *
+ * Generator adapts either one to std::uniform_random_bit_generator. It draws
+ * from an internal aligned block of BlockBytes, refilled with one fill() call
+ * when it runs out, so the start-up test of a collection is paid once per
+ * block instead of once per draw. Every byte handed out, and the block itself
+ * on destruction, is wiped.
+ *
+ * AsyncSession (library built with CC_CONFIG_TRNG_ASYNC = 1) makes reads
+ * awaitable: co_await session.read(span) suspends the coroutine until its bytes
+ * are collected. The pending reads queue up in their coroutine frames, without
+ * a thread each; poll() advances the collection at the head of the queue and
+ * resumes the coroutines whose reads completed.
+ */
+
+namespace tztrng {
+
+inline constexpr std::size_t kCacheLineBytes = 64;
+
+/* A failed driver call; code() is the CC error code */
+class Error : public std::runtime_error {
+public:
+    Error(uint32_t code, const char *call) : std::runtime_error(Format(code, call)), mCode(code) {}
+
+    uint32_t code() const noexcept { return mCode; }
+
+private:
+    static std::string Format(uint32_t code, const char *call)
+    {
+        char text[80];
+
+        std::snprintf(text, sizeof(text), "%s failed: error(0x%X)", call, static_cast<unsigned int>(code));
+        return text;
+    }
+
+    uint32_t mCode;
+};
+
+namespace detail {
+
+/* never optimized away */
+inline void SecureZero(void *buf, std::size_t size) noexcept
+{
+    volatile unsigned char *p = static_cast<volatile unsigned char *>(buf);
+
+    while (size--)
+        *p++ = 0;
+}
+
+inline void Check(uint32_t err, const char *call)
+{
+    if (err != 0)
+        throw Error(err, call);
+}
+
+} // namespace detail
+
+/* Anything that fills a byte span with random bytes, or throws */
+template <class S>
+concept ByteSource = requires(S &source, std::span<std::byte> out) {
+    source.fill(out);
+};
+
+/* Direct access: each fill() is one CC_TrngGetSource() collection */
+class Session {
+public:
+    explicit Session(unsigned long rngRegBase) : mRegBase(rngRegBase) {}
+
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
+
+    void fill(std::span<std::byte> out)
+    {
+        std::size_t outLen = 0;
+
+        if (out.empty())
+            return;
+        detail::Check(CC_TrngGetSource(mRegBase, reinterpret_cast<uint8_t *>(out.data()), &outLen,
+                                       out.size() * 8),
+                      "CC_TrngGetSource");
+    }
+
+    template <class T, std::size_t N>
+        requires std::is_trivially_copyable_v<T> && (!std::is_const_v<T>)
+    void fill(std::span<T, N> out)
+    {
+        fill(std::span<std::byte>(std::as_writable_bytes(out)));
+    }
+
+    unsigned long regBase() const noexcept { return mRegBase; }
+
+private:
+    unsigned long mRegBase;
+};
+
+/* The entropy pool for the lifetime of the object: CC_TrngPoolStart() to
+   CC_TrngPoolStop(). There is one pool, so there is at most one PoolSession. */
+class PoolSession {
+public:
+    explicit PoolSession(unsigned long rngRegBase)
+    {
+        detail::Check(CC_TrngPoolStart(rngRegBase), "CC_TrngPoolStart");
+    }
+
+    ~PoolSession() { CC_TrngPoolStop(); }
+
+    PoolSession(const PoolSession &) = delete;
+    PoolSession &operator=(const PoolSession &) = delete;
+
+    /* may be called from any number of threads */
+    void fill(std::span<std::byte> out)
+    {
+        if (out.empty())
+            return;
+        detail::Check(CC_TrngPoolRead(reinterpret_cast<uint8_t *>(out.data()), out.size()), "CC_TrngPoolRead");
+    }
+
+    template <class T, std::size_t N>
+        requires std::is_trivially_copyable_v<T> && (!std::is_const_v<T>)
+    void fill(std::span<T, N> out)
+    {
+        fill(std::span<std::byte>(std::as_writable_bytes(out)));
+    }
+
+    CCTrngPoolStatus_t status() const
+    {
+        CCTrngPoolStatus_t status;
+
+        detail::Check(CC_TrngPoolGetStatus(&status), "CC_TrngPoolGetStatus");
+        return status;
+    }
+};
+
+/* std::uniform_random_bit_generator over a ByteSource, refilled a block at a
+   time. Not thread safe: one Generator per thread. */
+template <ByteSource Source, std::unsigned_integral UIntType = uint32_t, std::size_t BlockBytes = 1024>
+class Generator {
+    static_assert((BlockBytes > 0) && (BlockBytes % sizeof(UIntType) == 0),
+                  "BlockBytes must be a non zero multiple of the result size");
+
+public:
+    using result_type = UIntType;
+
+    explicit Generator(Source &source) noexcept : mSource(source) {}
+
+    ~Generator() { detail::SecureZero(mBlock.data(), mBlock.size()); }
+
+    Generator(const Generator &) = delete;
+    Generator &operator=(const Generator &) = delete;
+
+    static constexpr result_type min() noexcept { return std::numeric_limits<result_type>::min(); }
+    static constexpr result_type max() noexcept { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        result_type value;
+
+        if (mUsed == BlockBytes)
+            Refill();
+        std::memcpy(&value, mBlock.data() + mUsed, sizeof(value));
+        detail::SecureZero(mBlock.data() + mUsed, sizeof(value));
+        mUsed += sizeof(value);
+
+        return value;
+    }
+
+    /* the source fills of this generator */
+    uint64_t refills() const noexcept { return mRefills; }
+
+    static constexpr std::size_t blockBytes() noexcept { return BlockBytes; }
+
+private:
+    void Refill()
+    {
+        try {
+            mSource.fill(std::span<std::byte>(mBlock));
+        } catch (...) {
+            detail::SecureZero(mBlock.data(), mBlock.size());
+            throw;
+        }
+        mUsed = 0;
+        mRefills++;
+    }
+
+    Source &mSource;
+    alignas(kCacheLineBytes) std::array<std::byte, BlockBytes> mBlock{};
+    std::size_t mUsed = BlockBytes;
+    uint64_t mRefills = 0;
+};
+
+/* Awaitable reads, served in arrival order by one CC_TrngAsyncStart()
+   collection at a time. The executor thread calls poll() when the RNG
+   interrupt fires, or from a timer; completed reads resume from inside poll().
+   Not thread safe: the session, its reads and poll() belong to one thread. */
+class AsyncSession {
+public:
+    class ReadAwaiter {
+    public:
+        bool await_ready() const noexcept { return mOut.empty(); }
+
+        /* false, so the coroutine goes on, if the collection could not start */
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+            mHandle = handle;
+            return mSession.Enqueue(this);
+        }
+
+        /* throws tztrng::Error if the collection failed; the bytes are then wiped */
+        void await_resume() const { detail::Check(mErr, mCall); }
+
+    private:
+        friend class AsyncSession;
+
+        ReadAwaiter(AsyncSession &session, std::span<std::byte> out) noexcept : mSession(session), mOut(out) {}
+
+        AsyncSession &mSession;
+        std::span<std::byte> mOut;
+        std::coroutine_handle<> mHandle;
+        ReadAwaiter *mNext = nullptr;
+        uint32_t mErr = 0;
+        const char *mCall = "CC_TrngAsyncPoll";
+    };
+
+    explicit AsyncSession(unsigned long rngRegBase) noexcept : mRegBase(rngRegBase) {}
+
+    /* stops the running collection; reads still queued are never resumed */
+    ~AsyncSession()
+    {
+        if (mActive)
+            CC_TrngAsyncCancel(&mCtx);
+    }
+
+    AsyncSession(const AsyncSession &) = delete;
+    AsyncSession &operator=(const AsyncSession &) = delete;
+
+    /* 'out' must stay valid until the read completes */
+    [[nodiscard]] ReadAwaiter read(std::span<std::byte> out) noexcept { return ReadAwaiter(*this, out); }
+
+    template <class T, std::size_t N>
+        requires std::is_trivially_copyable_v<T> && (!std::is_const_v<T>)
+    [[nodiscard]] ReadAwaiter read(std::span<T, N> out) noexcept
+    {
+        return read(std::span<std::byte>(std::as_writable_bytes(out)));
+    }
+
+    /* Advance the collection and resume the completed reads; returns their number */
+    std::size_t poll()
+    {
+        std::size_t completed = 0;
+
+        while (mHead != nullptr) {
+            ReadAwaiter *read = mHead;
+
+            if (mActive) {
+                uint32_t err = CC_TrngAsyncPoll(&mCtx);
+
+                if (err == CC_TRNG_ASYNC_PENDING)
+                    break;
+                mActive = false;
+                read->mErr = err;
+            }
+
+            mHead = read->mNext;
+            if (mHead == nullptr)
+                mTail = nullptr;
+            mPending--;
+            completed++;
+            /* the next collection runs while the coroutine does */
+            StartHead();
+            read->mHandle.resume();
+        }
+
+        return completed;
+    }
+
+    /* reads queued, including the one being collected */
+    std::size_t pending() const noexcept { return mPending; }
+
+    bool idle() const noexcept { return mHead == nullptr; }
+
+    unsigned long regBase() const noexcept { return mRegBase; }
+
+private:
+    bool Enqueue(ReadAwaiter *read) noexcept
+    {
+        if (mTail != nullptr) {
+            mTail->mNext = read;
+            mTail = read;
+            mPending++;
+            return true;
+        }
+
+        mHead = mTail = read;
+        mPending++;
+        StartHead();
+        if (read->mErr == 0)
+            return true;
+        mHead = mTail = nullptr;
+        mPending--;
+        return false;
+    }
+
+    /* Start the collection of the read at the head; a failure completes it with the error */
+    void StartHead() noexcept
+    {
+        uint32_t err;
+
+        if ((mHead == nullptr) || mActive)
+            return;
+        err = CC_TrngAsyncStart(&mCtx, mRegBase, reinterpret_cast<uint8_t *>(mHead->mOut.data()),
+                                mHead->mOut.size() * 8);
+        if (err != 0) {
+            mHead->mErr = err;
+            mHead->mCall = "CC_TrngAsyncStart";
+        }
+        mActive = (err == 0);
+    }
+
+    unsigned long mRegBase;
+    CCTrngAsync_t mCtx{};
+    bool mActive = false;
+    ReadAwaiter *mHead = nullptr;
+    ReadAwaiter *mTail = nullptr;
+    std::size_t mPending = 0;
+};
+
+} // namespace tztrng
+
+#endif
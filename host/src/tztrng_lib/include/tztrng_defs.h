@@ -73,6 +73,7 @@ Default values for Zynq FPGA:
 /*** NIST SP 800-90B (2nd Draft) 4.4.2 ***/
 /* C =CRITBINOM(W, power(2,(-H)),1-a), W = 1024, a = 2^(-40), H=(entropy per bit) */
 #define CC_CONFIG_TRNG90B_ADAPTIVE_PROPORTION_CUTOFF           823      /* =CRITBINOM(1024, power(2,(-0.5)),1-2^(-40)) */
+#define CC_CONFIG_TRNG90B_ADAPTIVE_PROPORTION_WINDOW_SIZE      1024 /* binary noise source */
 
 /*** For Startup Tests ***/
 /* amount of bytes for the startup test = 528 (at least 4096 bits (NIST SP 800-90B (2nd Draft) 4.3.12) = 22 EHRs = 4224 bits) */
@@ -130,8 +131,15 @@ typedef  struct
  * \param regOffset The offset of the ARM TRNG register to read
  * \return uint32_t Return the value of the given register
  */
+#ifdef CC_CONFIG_TRNG_MMIO_HOOKS
+/* through the installed register access backend (tztrng_mmio.c) */
+uint32_t tztrng_mmio_read(uint32_t regOffset);
+#define CC_HAL_READ_REGISTER(regOffset) 				\
+		tztrng_mmio_read(regOffset)
+#else
 #define CC_HAL_READ_REGISTER(regOffset) 				\
 		(*((volatile uint32_t *)(gCcRegBase + (regOffset))))
+#endif
 
 /*!
  * Write TRNG memory-mapped-IO register.
@@ -142,8 +150,17 @@ typedef  struct
  * \param regOffset The offset of the ARM TRNG register to write
  * \param val The value to write
  */
+#ifdef CC_CONFIG_TRNG_MMIO_HOOKS
+void tztrng_mmio_write(uint32_t regOffset, uint32_t val);
+void tztrng_mmio_request(size_t reqBits);
+#define CC_HAL_WRITE_REGISTER(regOffset, val) \
+		tztrng_mmio_write((regOffset), (val))
+#define TRNG_MMIO_REQUEST(reqBits)  tztrng_mmio_request(reqBits)
+#else
 #define CC_HAL_WRITE_REGISTER(regOffset, val) \
 		(*((volatile uint32_t *)(gCcRegBase + (regOffset))) = (val))
+#define TRNG_MMIO_REQUEST(reqBits)  do {} while (0)
+#endif
 
 #define LLF_RND_HW_TRNG_EHR_WIDTH_IN_WORDS  6
 #define LLF_RND_HW_TRNG_EHR_WIDTH_IN_BYTES  (LLF_RND_HW_TRNG_EHR_WIDTH_IN_WORDS * sizeof(uint32_t))
@@ -162,8 +179,20 @@ typedef  struct
 #define LLF_RND_HW_RND_SRC_ENABLE_VAL      	1UL
 #define LLF_RND_HW_RND_SRC_DISABLE_VAL     	0UL
 #define LLF_RND_HW_TRNG_WITH_DMA_CONFIG_VAL    0x4
+#if defined(CC_CONFIG_TRNG_WAIT_IRQ) || defined(CC_CONFIG_TRNG_ASYNC)
+/* interrupt driven wait, or CC_TrngAsyncPoll() called on the interrupt: EHR_VALID and the
+   errors handled by CC_HalWaitInterrupt() must raise the IRQ */
+#define LLF_RNG_INT_MASK_ON_TRNG90B_MODE  0xFFFFFFFA
+#define LLF_RNG_INT_MASK_ON_FETRNG_MODE  0xFFFFFFF0
+#else
 #define LLF_RNG_INT_MASK_ON_TRNG90B_MODE  0xFFFFFFC5
 #define LLF_RNG_INT_MASK_ON_FETRNG_MODE  0xFFFFFFEC
+#endif
+#if (CC_CONFIG_TRNG_MODE == 1)
+#define LLF_RNG_INT_MASK_ON_CURRENT_MODE  LLF_RNG_INT_MASK_ON_TRNG90B_MODE
+#else
+#define LLF_RNG_INT_MASK_ON_CURRENT_MODE  LLF_RNG_INT_MASK_ON_FETRNG_MODE
+#endif
 
 #define LLF_RND_HW_DMA_EHR_SAMPLES_NUM_ON_FE_MODE  2UL /*for both AES128 and AES256*/
 
@@ -184,6 +213,57 @@ typedef  struct
 #define TRNG_EHR_DUMP(format, ...) do {} while (0)
 #endif
 
+#ifdef CC_CONFIG_TRNG_STATS
+#include "tztrng.h"
+/* Driver event counters (tztrng_stats.c) */
+extern CCTrngStats_t gTrngStats;
+#define TRNG_STAT_INC(counter)      (gTrngStats.counter++)
+#define TRNG_STAT_ADD(counter, n)   (gTrngStats.counter += (n))
+#else
+#define TRNG_STAT_INC(counter)      do {} while (0)
+#define TRNG_STAT_ADD(counter, n)   do {} while (0)
+#endif
+
+#ifdef CC_CONFIG_TRNG_PROFILE
+#include "tztrng.h"
+/* Phase profiler (tztrng_prof.c) */
+void LLF_RND_ProfRecord(CCTrngProfPhase_t phase, uint64_t startTs);
+#define TRNG_PROF_VAR(ts)           uint64_t ts = 0
+#define TRNG_PROF_BEGIN(ts)         ((ts) = tztrng_pal_timestamp())
+#define TRNG_PROF_END(phase, ts)    LLF_RND_ProfRecord(CC_TRNG_PROF_##phase, (ts))
+#else
+#define TRNG_PROF_VAR(ts)           do {} while (0)
+#define TRNG_PROF_BEGIN(ts)         do {} while (0)
+#define TRNG_PROF_END(phase, ts)    do {} while (0)
+#endif
+
+#ifdef CC_CONFIG_TRNG_TELEMETRY
+/* ISR history of the hardware telemetry (tztrng_telemetry.c) */
+void LLF_RND_TelemetryRecordIsr(uint32_t isr);
+#define TRNG_TELEMETRY_ISR(isr)     do { if ((isr) != 0) LLF_RND_TelemetryRecordIsr(isr); } while (0)
+#else
+#define TRNG_TELEMETRY_ISR(isr)     do {} while (0)
+#endif
+
+#ifdef CC_CONFIG_TRNG_NOISE_TAP
+/* Raw-noise tap (tztrng_tap.c): the ROSC and sample count of the TRNG start, then
+   each EHR read under them */
+void LLF_RND_NoiseTapSetSource(uint32_t rosc, uint32_t sampleCnt);
+void LLF_RND_NoiseTapPush(const uint32_t *ehr);
+#define TRNG_NOISE_TAP_SOURCE(rosc, sampleCnt)  LLF_RND_NoiseTapSetSource((rosc), (sampleCnt))
+#define TRNG_NOISE_TAP(ehr)                     LLF_RND_NoiseTapPush(ehr)
+#else
+#define TRNG_NOISE_TAP_SOURCE(rosc, sampleCnt)  do {} while (0)
+#define TRNG_NOISE_TAP(ehr)                     do {} while (0)
+#endif
+
+#ifdef CC_CONFIG_TRNG_ASYNC
+#include "tztrng.h"
+/* The asynchronous collection owning the TRNG (tztrng_async.c), NULL when none;
+   read and written under TZTRNG_PAL_LOCK() */
+extern CCTrngAsync_t *gAsyncOwner;
+#endif
+
 #define CC_ERROR_BASE          0x00F00000UL
 #define CC_ERROR_LAYER_RANGE   0x00010000UL
 #define CC_ERROR_MODULE_RANGE  0x00000100UL
@@ -217,9 +297,20 @@ typedef  struct
 #define LLF_RND_TRNG_ILLEGAL_PTR_ERROR   	            (LLF_RND_MODULE_ERROR_BASE + 0x35UL)
 #define LLF_RND_TRNG_REPETITION_COUNTER_ERROR           (LLF_RND_MODULE_ERROR_BASE + 0x36UL)
 #define LLF_RND_TRNG_ADAPTION_PROPORTION_ERROR          (LLF_RND_MODULE_ERROR_BASE + 0x37UL)
+#define LLF_RND_TRNG_BUFFER_TOO_SMALL_ERROR             (LLF_RND_MODULE_ERROR_BASE + 0x38UL)
 
 #define CC_RND_CPRNG_TEST_FAIL_ERROR		       	    (CC_RND_MODULE_ERROR_BASE + 0x2UL)
 #define CC_RND_TRNG_KAT_NOT_SUPPORTED_ERROR             (CC_RND_MODULE_ERROR_BASE + 0x34UL)
+#define CC_RND_DRBG_NOT_INSTANTIATED_ERROR              (CC_RND_MODULE_ERROR_BASE + 0x40UL)
+#define CC_RND_DRBG_ILLEGAL_LENGTH_ERROR                (CC_RND_MODULE_ERROR_BASE + 0x41UL)
+#define CC_RND_TRNG_ILLEGAL_COND_FUNC_ERROR             (CC_RND_MODULE_ERROR_BASE + 0x42UL)
+#define CC_RND_TRNG_POOL_STATE_ERROR                    (CC_RND_MODULE_ERROR_BASE + 0x43UL)
+#define CC_RND_TRNG_POOL_RESOURCE_ERROR                 (CC_RND_MODULE_ERROR_BASE + 0x44UL)
+#define CC_RND_TRNG_ILLEGAL_PRIORITY_ERROR              (CC_RND_MODULE_ERROR_BASE + 0x45UL)
+#define CC_RND_TRNG_ASYNC_BUSY_ERROR                    (CC_RND_MODULE_ERROR_BASE + 0x46UL)
+#define CC_RND_TRNG_SERVICE_STATE_ERROR                 (CC_RND_MODULE_ERROR_BASE + 0x47UL)
+#define CC_RND_TRNG_SERVICE_RESOURCE_ERROR              (CC_RND_MODULE_ERROR_BASE + 0x48UL)
+#define CC_RND_TRNG_MAILBOX_STATE_ERROR                 (CC_RND_MODULE_ERROR_BASE + 0x49UL)
 
 void LLF_RND_TurnOffTrng(void);
 CCError_t LLF_RND_GetFastestRosc( CCRndParams_t *trngParams_ptr, uint32_t *rosc_ptr/*in/out*/);
@@ -245,5 +336,207 @@ CCError_t LLF_RND_GetTrngSource(
 				 uint32_t       *sourceOutSize_ptr, /*in/out*/
 				 uint32_t       *rndWorkBuff_ptr);   /*in*/
 
+/* Consumer of the health-tested TRNG data, called once per collected buffer */
+typedef void (*LLFRndSink_t)(void *ctx, const uint8_t *data, uint32_t len);
+/* Collect ROUND_UP(reqBits / 8) bytes from the TRNG into 'sink', serialized with
+   CC_TrngGetSource() (tztrng_driver.c) */
+CCError_t LLF_RND_CollectSource(unsigned long rngRegBase, size_t reqBits, LLFRndSink_t sink, void *ctx);
+/* Sample counts and allowed ROSCs of the configuration or the drift monitor (tztrng_driver.c) */
+CCError_t RNG_PLAT_SetUserRngParameters(CCRndParams_t *pTrngParams);
+/* Program the TRNG for *roscsToStart_ptr, or for the fastest ROSC on a restart (llf_rnd_<mode>.c) */
+CCError_t LLF_RND_StartTrngHW(
+                 CCRndState_t   *rndState_ptr,      /*in/out*/
+                 CCRndParams_t  *trngParams_ptr,    /*in/out*/
+                 CCBool_t       isRestart,          /*in*/
+                 uint32_t       *roscsToStart_ptr); /*in/out*/
+
+#ifdef CC_CONFIG_TRNG_DRIFT_MONITOR
+/* Entropy drift monitor (llf_rnd_drift.c) */
+uint32_t LLF_RND_DriftGetSampleCnt(uint32_t roscIdx);
+void LLF_RND_DriftUpdate(uint32_t rosc, uint32_t *pData, uint32_t sizeInBytes);
+void LLF_RND_DriftFailure(uint32_t rosc);
+#endif
+
+#ifdef CC_CONFIG_TRNG_DRBG
+#include "tztrng.h"
+/* generate calls between reseeds from the TRNG (SP 800-90A allows up to 2^48) */
+#ifndef CC_CONFIG_DRBG_RESEED_INTERVAL
+#define CC_CONFIG_DRBG_RESEED_INTERVAL  0x10000UL
 #endif
 
+#ifdef CC_CONFIG_TRNG_CONDITIONING
+/* full entropy bits from CC_TrngGetFullEntropy() for the entropy input and the nonce */
+#define LLF_DRBG_ENTROPY_INPUT_BITS     256
+#define LLF_DRBG_NONCE_BITS             128
+#else
+/* raw TRNG bits for the entropy input (256 bits) and the nonce (128 bits) at
+   entropy per bit = 0.5 */
+#define LLF_DRBG_ENTROPY_INPUT_BITS     512
+#define LLF_DRBG_NONCE_BITS             256
+#endif
+
+/* CTR_DRBG mechanism with caller supplied entropy (tztrng_drbg.c) */
+void LLF_DRBG_Instantiate(CCDrbgState_t *pState,
+                          const uint8_t *entropy, size_t entropyLen,
+                          const uint8_t *nonce, size_t nonceLen,
+                          const uint8_t *pers, size_t persLen);
+void LLF_DRBG_Reseed(CCDrbgState_t *pState,
+                     const uint8_t *entropy, size_t entropyLen,
+                     const uint8_t *addInput, size_t addInputLen);
+void LLF_DRBG_Generate(CCDrbgState_t *pState,
+                       uint8_t *out, size_t outLen,
+                       const uint8_t *addInput, size_t addInputLen);
+#endif
+
+#ifdef CC_CONFIG_TRNG_AES
+/* AES-256 forward cipher (tztrng_aes.c), used by the CTR_DRBG and the CBC-MAC conditioning */
+#define LLF_AES256_ROUND_KEY_WORDS      60
+void LLF_AES_SetKey256(uint32_t *roundKeys, const uint8_t *key);
+void LLF_AES_Encrypt(const uint32_t *roundKeys, const uint8_t *in, uint8_t *out);
+/* CTR mode keystream: counter = counter + 1, then out = E(counter), 'blocks' times */
+void LLF_AES_Ctr(const uint32_t *roundKeys, uint8_t *counter, uint8_t *out, size_t blocks);
+#endif
+
+#ifdef CC_CONFIG_TRNG_CONDITIONING
+#include "tztrng.h"
+/* min-entropy of the health-tested TRNG data in bits per 1024 bits (entropy per bit = 0.5) */
+#ifndef CC_CONFIG_TRNG_COND_ENTROPY_RATE
+#define CC_CONFIG_TRNG_COND_ENTROPY_RATE    512
+#endif
+#if (CC_CONFIG_TRNG_COND_ENTROPY_RATE < 1) || (CC_CONFIG_TRNG_COND_ENTROPY_RATE > 1024)
+#error "CC_CONFIG_TRNG_COND_ENTROPY_RATE must be in 1..1024"
+#endif
+
+/* SHA-256 (tztrng_sha256.c) */
+#define LLF_SHA256_BLOCK_BYTES          64
+#define LLF_SHA256_DIGEST_BYTES         32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t totalBytes;
+    uint8_t buf[LLF_SHA256_BLOCK_BYTES];
+    uint32_t fill;
+} LLFSha256Ctx_t;
+
+void LLF_SHA256_Init(LLFSha256Ctx_t *pCtx);
+void LLF_SHA256_Update(LLFSha256Ctx_t *pCtx, const uint8_t *data, size_t len);
+/* writes the digest and wipes the context */
+void LLF_SHA256_Final(LLFSha256Ctx_t *pCtx, uint8_t *digest);
+
+#define LLF_COND_AES_BLOCK_BYTES        16
+
+/* Conditioning of a data stream into full entropy output blocks (tztrng_cond.c) */
+typedef struct {
+    CCTrngCondFunc_t func;
+    uint32_t outBits;               /* bits per output block */
+    uint32_t dataBytes;             /* data bytes per output block */
+    uint32_t dataFill;              /* data bytes absorbed into the current block */
+    uint8_t *out;
+    size_t outRemain;
+    LLFSha256Ctx_t sha;
+    uint32_t roundKeys[LLF_AES256_ROUND_KEY_WORDS];
+    uint8_t chain[LLF_COND_AES_BLOCK_BYTES];
+    uint8_t block[LLF_COND_AES_BLOCK_BYTES];
+    uint32_t blockFill;
+} LLFCondCtx_t;
+
+/* output goes to 'out' until outLen bytes are written; the rest is dropped */
+CCError_t LLF_COND_Init(LLFCondCtx_t *pCtx, CCTrngCondFunc_t condFunc, uint8_t *out, size_t outLen);
+/* LLFRndSink_t: absorbs data and writes every completed output block */
+void LLF_COND_Sink(void *ctx, const uint8_t *data, uint32_t len);
+#endif
+
+#ifdef CC_CONFIG_TRNG_POOL
+/* Entropy pool (tztrng_pool.c) */
+#ifndef CC_CONFIG_TRNG_POOL_BYTES
+#define CC_CONFIG_TRNG_POOL_BYTES           4096
+#endif
+/* the producer starts refilling at or below the low watermark and stops at the high one */
+#ifndef CC_CONFIG_TRNG_POOL_LOW_WATERMARK
+#define CC_CONFIG_TRNG_POOL_LOW_WATERMARK   (CC_CONFIG_TRNG_POOL_BYTES / 4)
+#endif
+#ifndef CC_CONFIG_TRNG_POOL_HIGH_WATERMARK
+#define CC_CONFIG_TRNG_POOL_HIGH_WATERMARK  CC_CONFIG_TRNG_POOL_BYTES
+#endif
+/* bytes per collection: each one runs the start-up test, larger chunks amortize it */
+#ifndef CC_CONFIG_TRNG_POOL_CHUNK_BYTES
+#define CC_CONFIG_TRNG_POOL_CHUNK_BYTES     1024
+#endif
+/* delay before the producer retries a failed collection */
+#ifndef CC_CONFIG_TRNG_POOL_RETRY_MS
+#define CC_CONFIG_TRNG_POOL_RETRY_MS        100
+#endif
+#ifndef CC_CONFIG_TRNG_CACHE_LINE_BYTES
+#define CC_CONFIG_TRNG_CACHE_LINE_BYTES     64
+#endif
+#if (CC_CONFIG_TRNG_POOL_BYTES % CC_CONFIG_TRNG_CACHE_LINE_BYTES) != 0
+#error "CC_CONFIG_TRNG_POOL_BYTES must be a multiple of CC_CONFIG_TRNG_CACHE_LINE_BYTES"
+#endif
+#if (CC_CONFIG_TRNG_POOL_LOW_WATERMARK >= CC_CONFIG_TRNG_POOL_HIGH_WATERMARK) || \
+    (CC_CONFIG_TRNG_POOL_HIGH_WATERMARK > CC_CONFIG_TRNG_POOL_BYTES)
+#error "pool watermarks must satisfy LOW < HIGH <= CC_CONFIG_TRNG_POOL_BYTES"
+#endif
+#if (CC_CONFIG_TRNG_POOL_CHUNK_BYTES < 1) || (CC_CONFIG_TRNG_POOL_CHUNK_BYTES > CC_CONFIG_TRNG_POOL_BYTES)
+#error "CC_CONFIG_TRNG_POOL_CHUNK_BYTES must be in 1..CC_CONFIG_TRNG_POOL_BYTES"
+#endif
+#endif
+
+#ifdef CC_CONFIG_TRNG_TLS_POLL
+/* TLS entropy poll adapter (tztrng_tls.c) */
+/* min-entropy per output bit in 1/256, the characterization value behind
+   CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES (0.5) */
+#ifndef CC_CONFIG_TRNG_ENTROPY_PER_BIT_Q8
+#define CC_CONFIG_TRNG_ENTROPY_PER_BIT_Q8   128
+#endif
+#if (CC_CONFIG_TRNG_ENTROPY_PER_BIT_Q8 < 1) || (CC_CONFIG_TRNG_ENTROPY_PER_BIT_Q8 > 256)
+#error "CC_CONFIG_TRNG_ENTROPY_PER_BIT_Q8 must be in 1..256"
+#endif
+#endif
+
+#ifdef CC_CONFIG_TRNG_SERVICE
+/* FreeRTOS entropy service (pal/freertos/tztrng_service.c) */
+/* prefill buffer, kept full while no request waits; each refill runs the start-up test */
+#ifndef CC_CONFIG_TRNG_SERVICE_BUF_BYTES
+#define CC_CONFIG_TRNG_SERVICE_BUF_BYTES        576
+#endif
+/* upper bound of a sleep between two EHRs, in case the interrupt is lost */
+#ifndef CC_CONFIG_TRNG_SERVICE_WAIT_MS
+#define CC_CONFIG_TRNG_SERVICE_WAIT_MS          10
+#endif
+#if (CC_CONFIG_TRNG_SERVICE_BUF_BYTES < 1)
+#error "CC_CONFIG_TRNG_SERVICE_BUF_BYTES must be at least 1"
+#endif
+#endif
+
+#ifdef CC_CONFIG_TRNG_NOISE_TAP
+/* Raw-noise tap (tztrng_tap.c) */
+/* records of the tap ring, a power of 2: the EHRs the consumer may fall behind */
+#ifndef CC_CONFIG_TRNG_NOISE_TAP_RECORDS
+#define CC_CONFIG_TRNG_NOISE_TAP_RECORDS        128
+#endif
+#if (CC_CONFIG_TRNG_NOISE_TAP_RECORDS < 1) || \
+    ((CC_CONFIG_TRNG_NOISE_TAP_RECORDS & (CC_CONFIG_TRNG_NOISE_TAP_RECORDS - 1)) != 0)
+#error "CC_CONFIG_TRNG_NOISE_TAP_RECORDS must be a power of 2"
+#endif
+#endif
+
+#ifdef CC_CONFIG_TRNG_COALESCE
+/* Request coalescing (tztrng_coalesce.c) */
+/* time a batch stays open for more requests, from the arrival of its oldest request */
+#ifndef CC_CONFIG_TRNG_COALESCE_WINDOW_US
+#define CC_CONFIG_TRNG_COALESCE_WINDOW_US       250
+#endif
+/* pending bytes that close the window early: one TRNG90B collection block */
+#ifndef CC_CONFIG_TRNG_COALESCE_THRESHOLD_BYTES
+#define CC_CONFIG_TRNG_COALESCE_THRESHOLD_BYTES CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES
+#endif
+/* upper bound of a batch; a larger request is collected on its own */
+#ifndef CC_CONFIG_TRNG_COALESCE_MAX_BATCH_BYTES
+#define CC_CONFIG_TRNG_COALESCE_MAX_BATCH_BYTES 1024
+#endif
+#if (CC_CONFIG_TRNG_COALESCE_THRESHOLD_BYTES > CC_CONFIG_TRNG_COALESCE_MAX_BATCH_BYTES)
+#error "CC_CONFIG_TRNG_COALESCE_THRESHOLD_BYTES must not exceed CC_CONFIG_TRNG_COALESCE_MAX_BATCH_BYTES"
+#endif
+#endif
+
+#endif
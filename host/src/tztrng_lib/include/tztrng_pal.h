@@ -18,9 +18,90 @@
 #ifndef _TZTRNG_PAL_H_
 #define _TZTRNG_PAL_H_
 
+#include <stddef.h>
 #include <stdint.h>
 uint32_t CC_HalWaitInterrupt(void);
+
+#ifdef CC_CONFIG_TRNG_WAIT_IRQ
+#ifndef CC_CONFIG_TRNG_WAIT_TIMEOUT_MS
+/* upper bound of a single sleep, in case the interrupt is lost */
+#define CC_CONFIG_TRNG_WAIT_TIMEOUT_MS 10
+#endif
+
+/* Sleep until the RNG interrupt fires or the timeout expires (pal/<os>/tztrng_pal_os.c) */
+void tztrng_pal_waitIrq(void);
+#define TZTRNG_PAL_WAIT_EVENT()     tztrng_pal_waitIrq()
+#else
+/* Polled: read the ISR again right away */
+#define TZTRNG_PAL_WAIT_EVENT()     do {} while (0)
+#endif
+
+#ifdef CC_CONFIG_TRNG_WAIT_PREDICT
+#ifndef CC_CONFIG_TRNG_WAIT_SPIN_US
+/* polling time left before the predicted EHR fill, covers the OS wake-up latency */
+#define CC_CONFIG_TRNG_WAIT_SPIN_US 50
+#endif
+
+/* Give up the CPU for about 'us' microseconds; yields if that is below the OS granularity */
+void tztrng_pal_sleepUs(uint32_t us);
+#endif
+
+#ifdef CC_CONFIG_TRNG_LOCK
+/* Mutual exclusion of CC_TrngGetSource callers: the register sequence and the driver
+   globals are not reentrant (pal/<os>/tztrng_pal_os.c) */
+void tztrng_pal_lock(void);
+void tztrng_pal_unlock(void);
+#define TZTRNG_PAL_LOCK()           tztrng_pal_lock()
+#define TZTRNG_PAL_UNLOCK()         tztrng_pal_unlock()
+#else
+/* Single caller at a time is the integrator's responsibility */
+#define TZTRNG_PAL_LOCK()           do {} while (0)
+#define TZTRNG_PAL_UNLOCK()         do {} while (0)
+#endif
+
+#ifdef CC_CONFIG_TRNG_SYNC
+/* Lock and events of the entropy pool (tztrng_pool.c) and the request coalescer
+   (tztrng_coalesce.c) on the OS (pal/<os>/tztrng_pal_os.c). Created on first use
+   and kept, so a late caller never finds them freed. */
+#define TZTRNG_PAL_EVT_POOL_DATA        0   /* bytes were added to the pool, or it failed or stopped */
+#define TZTRNG_PAL_EVT_POOL_REFILL      1   /* the pool fell below the low watermark, or is stopping */
+#define TZTRNG_PAL_EVT_COALESCE_KICK    2   /* a request closes the collection window early */
+#define TZTRNG_PAL_EVT_COALESCE_DONE    3   /* a batch was collected */
+#define TZTRNG_PAL_NUM_EVTS             4
+
+void tztrng_pal_syncLock(void);
+void tztrng_pal_syncUnlock(void);
+/* With the lock held: release it, sleep until 'evt' is signalled or timeoutUs
+   expires, take it again. Spurious wake-ups are allowed. */
+void tztrng_pal_syncWait(uint32_t evt, uint32_t timeoutUs);
+/* With the lock held: wake all threads waiting for 'evt' */
+void tztrng_pal_syncSignal(uint32_t evt);
+#endif
+
+#if defined(CC_CONFIG_TRNG_WAIT_PREDICT) || defined(CC_CONFIG_TRNG_SYNC)
+/* Monotonic time in microseconds, wrapping (pal/<os>/tztrng_pal_os.c) */
+uint32_t tztrng_pal_timeUs(void);
+#endif
+
+#ifdef CC_CONFIG_TRNG_POOL
+/* Start 'entry' in the producer thread of the entropy pool; 0 on success */
+int tztrng_pal_poolStart(void (*entry)(void));
+/* Wait for the producer thread to return from 'entry' */
+void tztrng_pal_poolJoin(void);
+/* Keep the pool buffer out of swap; 0 on success */
+int tztrng_pal_memLock(void *buf, size_t size);
+void tztrng_pal_memUnlock(void *buf, size_t size);
+#endif
+
+#ifdef CC_CONFIG_TRNG_TIMESTAMP
+/* Free running 64-bit timestamp for the phase profiler and the MMIO trace: the CPU
+   cycle counter on bare metal (tztrng_pal.c), nanoseconds on Linux (pal/linux/tztrng_pal_os.c) */
+uint64_t tztrng_pal_timestamp(void);
+#endif
+
 void tztrng_memcpy(uint8_t *dst, uint8_t *src, size_t size);
 void tztrng_memset(uint8_t *dst, uint8_t value, size_t size);
+/* Wipe a buffer holding entropy; never optimized away */
+void tztrng_secure_zero(void *buf, size_t size);
 
 #endif
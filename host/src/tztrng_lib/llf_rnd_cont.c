@@ -19,7 +19,6 @@
 #include "tztrng_pal.h"
 
 #define LLF_RND_TRNG90B_MAX_BYTES ( LLF_RND_HW_DMA_EHR_SAMPLES_NUM_ON_TRNG90B_MODE * LLF_RND_HW_TRNG_EHR_WIDTH_IN_BYTES)
-#define CC_CONFIG_TRNG90B_ADAPTIVE_PROPORTION_WINDOW_SIZE      1024 /* binary noise source */
 
 
 #define UINT8_SIZE_IN_BITS  8
@@ -99,7 +98,7 @@ CCError_t LLF_RND_RepetitionCounterTest(uint32_t* pData, uint32_t sizeInBytes, u
   N = the total number of samples that must be observed in one run of the test, also known as the "window size" of the test
   C = the cutoff value above which the test should fail
 */
-static CCError_t LLF_RND_AdaptiveProportionTest(uint32_t* pData, uint32_t sizeInBytes, uint32_t C, uint32_t W)
+CCError_t LLF_RND_AdaptiveProportionTest(uint32_t* pData, uint32_t sizeInBytes, uint32_t C, uint32_t W)
 {
     uint32_t bitOffset=0;
     uint32_t currentSample = 0;
@@ -154,10 +153,12 @@ CCError_t runContinuousTesting(uint32_t* pData, uint32_t sizeInBytes)
 
     error = LLF_RND_RepetitionCounterTest(pData, sizeInBytes, repC);
     if (error != CC_OK) {
+        TRNG_STAT_INC(rctFailures);
         return error;
     }
         error = LLF_RND_AdaptiveProportionTest(pData, sizeInBytes, adpC, adpW);
     if (error != CC_OK) {
+        TRNG_STAT_INC(aptFailures);
         return error;
     }
 
@@ -0,0 +1,272 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  Entropy drift monitor.
+
+  The monitor looks at the data that already passed the continuous tests and
+  tracks, per ROSC, two figures over CC_CONFIG_TRNG_DRIFT_EVAL_WINDOWS APT windows:
+  - the highest APT count (the margin to the APT cutoff shrinks as the source degrades),
+  - a most-common-value min-entropy estimate (NIST SP 800-90B 6.3.1).
+  At the end of each evaluation period the sample count of the ROSC is lowered
+  when both figures are comfortable, and raised when the APT margin shrinks.
+  A failing continuous test raises the sample count immediately.
+  The sample count always stays within the characterization bounds.
+*/
+
+#define LLF_RND_DRIFT_Q16_ONE           0x10000UL
+/* upper bound of the 99% confidence interval: Z(0.995) = 2.576 in Q16 */
+#define LLF_RND_DRIFT_Z_99_Q16          168821UL
+#define LLF_RND_DRIFT_WINDOW_WORDS      (CC_CONFIG_TRNG90B_ADAPTIVE_PROPORTION_WINDOW_SIZE / 32)
+/* ehr bits per second at sample count 1 */
+#define LLF_RND_DRIFT_RNG_CLK_HZ        (DX_SEP_FREQ_MHZ * 1000000UL)
+
+typedef struct {
+    uint32_t sampleCnt;
+    uint32_t sampleCntMin;
+    uint32_t sampleCntMax;
+    uint32_t windows;           /* windows observed in the current evaluation period */
+    uint32_t aptMaxCount;       /* highest APT count in the current evaluation period */
+    uint32_t onesCount;         /* ones counted in the current evaluation period */
+    uint32_t lastAptMaxCount;   /* figures of the last completed evaluation */
+    uint32_t lastMinEntropyQ16;
+    uint32_t adjustments;
+} LLF_RND_DriftRosc_t;
+
+static LLF_RND_DriftRosc_t gDriftRosc[LLF_RND_NUM_OF_ROSCS] = {
+    { CC_CONFIG_SAMPLE_CNT_ROSC_1, CC_CONFIG_SAMPLE_CNT_ROSC_1_MIN, CC_CONFIG_SAMPLE_CNT_ROSC_1_MAX, 0, 0, 0, 0, 0, 0 },
+    { CC_CONFIG_SAMPLE_CNT_ROSC_2, CC_CONFIG_SAMPLE_CNT_ROSC_2_MIN, CC_CONFIG_SAMPLE_CNT_ROSC_2_MAX, 0, 0, 0, 0, 0, 0 },
+    { CC_CONFIG_SAMPLE_CNT_ROSC_3, CC_CONFIG_SAMPLE_CNT_ROSC_3_MIN, CC_CONFIG_SAMPLE_CNT_ROSC_3_MAX, 0, 0, 0, 0, 0, 0 },
+    { CC_CONFIG_SAMPLE_CNT_ROSC_4, CC_CONFIG_SAMPLE_CNT_ROSC_4_MIN, CC_CONFIG_SAMPLE_CNT_ROSC_4_MAX, 0, 0, 0, 0, 0, 0 },
+};
+
+static CCTrngDriftLogEntry_t gDriftLog[CC_TRNG_DRIFT_LOG_ENTRIES];
+static uint32_t gDriftLogSeq = 0;
+
+static uint32_t LLF_RND_DriftPopCount(uint32_t word)
+{
+    word = word - ((word >> 1) & 0x55555555);
+    word = (word & 0x33333333) + ((word >> 2) & 0x33333333);
+    word = (word + (word >> 4)) & 0x0F0F0F0F;
+    return (word * 0x01010101) >> 24;
+}
+
+static uint32_t LLF_RND_DriftSqrt(uint64_t val)
+{
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > val)
+        bit >>= 2;
+
+    while (bit != 0) {
+        if (val >= res + bit) {
+            val -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)res;
+}
+
+/* -log2(x) for x in (0, 1], both in Q16 */
+static uint32_t LLF_RND_DriftNegLog2Q16(uint32_t xQ16)
+{
+    uint32_t res = 0;
+    uint32_t bit;
+    uint64_t m;
+
+    if (xQ16 == 0)
+        return CC_MAX_UINT32_VAL;
+
+    while (xQ16 < (LLF_RND_DRIFT_Q16_ONE >> 1)) {
+        xQ16 <<= 1;
+        res += LLF_RND_DRIFT_Q16_ONE;
+    }
+    if (xQ16 >= LLF_RND_DRIFT_Q16_ONE)
+        return res;
+
+    /* x in [0.5,1): -log2(x) = 1 - log2(2x), 2x in [1,2) */
+    m = (uint64_t)xQ16 << 1;
+    res += LLF_RND_DRIFT_Q16_ONE;
+    for (bit = LLF_RND_DRIFT_Q16_ONE >> 1; bit != 0; bit >>= 1) {
+        m = (m * m) >> 16;
+        if (m >= (LLF_RND_DRIFT_Q16_ONE << 1)) {
+            m >>= 1;
+            res -= bit;
+        }
+    }
+
+    return res;
+}
+
+/* most common value estimate over nBits samples of a binary source (SP 800-90B 6.3.1) */
+static uint32_t LLF_RND_DriftMinEntropyQ16(uint32_t onesCount, uint32_t nBits)
+{
+    uint32_t mcvCount = (onesCount > nBits - onesCount) ? onesCount : nBits - onesCount;
+    uint64_t pQ16 = ((uint64_t)mcvCount << 16) / nBits;
+    uint64_t varQ32 = (pQ16 * (LLF_RND_DRIFT_Q16_ONE - pQ16)) / (nBits - 1);
+    uint64_t puQ16 = pQ16 + ((LLF_RND_DRIFT_Z_99_Q16 * LLF_RND_DriftSqrt(varQ32)) >> 16);
+
+    if (puQ16 > LLF_RND_DRIFT_Q16_ONE)
+        puQ16 = LLF_RND_DRIFT_Q16_ONE;
+
+    return LLF_RND_DriftNegLog2Q16((uint32_t)puQ16);
+}
+
+static void LLF_RND_DriftSetSampleCnt(uint32_t roscIdx, uint32_t newSampleCnt)
+{
+    LLF_RND_DriftRosc_t *pRosc = &gDriftRosc[roscIdx];
+    CCTrngDriftLogEntry_t *pEntry;
+
+    if (newSampleCnt < pRosc->sampleCntMin)
+        newSampleCnt = pRosc->sampleCntMin;
+    if (newSampleCnt > pRosc->sampleCntMax)
+        newSampleCnt = pRosc->sampleCntMax;
+    if (newSampleCnt == pRosc->sampleCnt)
+        return;
+
+    pEntry = &gDriftLog[gDriftLogSeq % CC_TRNG_DRIFT_LOG_ENTRIES];
+    pEntry->seq = ++gDriftLogSeq;
+    pEntry->rosc = roscIdx;
+    pEntry->oldSampleCnt = pRosc->sampleCnt;
+    pEntry->newSampleCnt = newSampleCnt;
+    pEntry->aptMaxCount = pRosc->lastAptMaxCount;
+    pEntry->minEntropyQ16 = pRosc->lastMinEntropyQ16;
+
+    TRNG_LOG_DEBUG("rosc[%d] sample count %d -> %d (apt max %d, min-entropy %d/65536)\n",
+                   (int)roscIdx, (int)pRosc->sampleCnt, (int)newSampleCnt,
+                   (int)pRosc->lastAptMaxCount, (int)pRosc->lastMinEntropyQ16);
+
+    pRosc->sampleCnt = newSampleCnt;
+    pRosc->adjustments++;
+}
+
+static void LLF_RND_DriftEvaluate(uint32_t roscIdx)
+{
+    LLF_RND_DriftRosc_t *pRosc = &gDriftRosc[roscIdx];
+    uint32_t aptMargin;
+
+    pRosc->lastAptMaxCount = pRosc->aptMaxCount;
+    pRosc->lastMinEntropyQ16 = LLF_RND_DriftMinEntropyQ16(pRosc->onesCount,
+                                    pRosc->windows * CC_CONFIG_TRNG90B_ADAPTIVE_PROPORTION_WINDOW_SIZE);
+    aptMargin = (pRosc->aptMaxCount < CC_CONFIG_TRNG90B_ADAPTIVE_PROPORTION_CUTOFF) ?
+                    CC_CONFIG_TRNG90B_ADAPTIVE_PROPORTION_CUTOFF - pRosc->aptMaxCount : 0;
+
+    pRosc->windows = 0;
+    pRosc->aptMaxCount = 0;
+    pRosc->onesCount = 0;
+
+    if (aptMargin < CC_CONFIG_TRNG_DRIFT_APT_MARGIN_LOW) {
+        /* margin shrinks: back off quickly */
+        LLF_RND_DriftSetSampleCnt(roscIdx, pRosc->sampleCnt + (pRosc->sampleCnt / 4) + 1);
+    } else if ((aptMargin > CC_CONFIG_TRNG_DRIFT_APT_MARGIN_HIGH) &&
+               (pRosc->lastMinEntropyQ16 >= CC_CONFIG_TRNG_DRIFT_MIN_ENTROPY_Q16)) {
+        /* comfortable: speed up slowly */
+        LLF_RND_DriftSetSampleCnt(roscIdx, pRosc->sampleCnt - (pRosc->sampleCnt / 16) - 1);
+    }
+}
+
+/****************************************************************************************/
+/*****************************       Public Functions      ******************************/
+/****************************************************************************************/
+
+uint32_t LLF_RND_DriftGetSampleCnt(uint32_t roscIdx)
+{
+    return gDriftRosc[roscIdx].sampleCnt;
+}
+
+/* Feed data that passed the continuous tests on ROSC (mask) 'rosc' */
+void LLF_RND_DriftUpdate(uint32_t rosc, uint32_t *pData, uint32_t sizeInBytes)
+{
+    uint32_t roscIdx = LLF_RND_TRNG_RoscMaskToNum(rosc);
+    LLF_RND_DriftRosc_t *pRosc = &gDriftRosc[roscIdx];
+    uint32_t numOfWindows = sizeInBytes / (LLF_RND_DRIFT_WINDOW_WORDS * sizeof(uint32_t));
+    uint32_t w, i, ones, aptCount;
+
+    if (pRosc->sampleCnt == 0)
+        return;
+
+    /* only full windows are accounted, as in the APT itself */
+    for (w = 0; w < numOfWindows; w++, pData += LLF_RND_DRIFT_WINDOW_WORDS) {
+        ones = 0;
+        for (i = 0; i < LLF_RND_DRIFT_WINDOW_WORDS; i++)
+            ones += LLF_RND_DriftPopCount(pData[i]);
+
+        /* the APT counts the occurrences of the first sample of the window */
+        aptCount = (pData[0] & 0x1) ? ones : CC_CONFIG_TRNG90B_ADAPTIVE_PROPORTION_WINDOW_SIZE - ones;
+        if (aptCount > pRosc->aptMaxCount)
+            pRosc->aptMaxCount = aptCount;
+        pRosc->onesCount += ones;
+
+        if (++pRosc->windows == CC_CONFIG_TRNG_DRIFT_EVAL_WINDOWS)
+            LLF_RND_DriftEvaluate(roscIdx);
+    }
+}
+
+/* A continuous test failed on ROSC (mask) 'rosc' */
+void LLF_RND_DriftFailure(uint32_t rosc)
+{
+    uint32_t roscIdx = LLF_RND_TRNG_RoscMaskToNum(rosc);
+    LLF_RND_DriftRosc_t *pRosc = &gDriftRosc[roscIdx];
+
+    if (pRosc->sampleCnt == 0)
+        return;
+
+    pRosc->lastAptMaxCount = pRosc->aptMaxCount;
+    pRosc->windows = 0;
+    pRosc->aptMaxCount = 0;
+    pRosc->onesCount = 0;
+
+    LLF_RND_DriftSetSampleCnt(roscIdx, pRosc->sampleCnt + (pRosc->sampleCnt / 4) + 1);
+}
+
+uint32_t CC_TrngGetDriftReport(CCTrngDriftReport_t *pReport)
+{
+    uint32_t i, first;
+    LLF_RND_DriftRosc_t *pRosc;
+
+    if (pReport == NULL)
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+
+    for (i = 0; i < LLF_RND_NUM_OF_ROSCS; i++) {
+        pRosc = &gDriftRosc[i];
+        pReport->rosc[i].sampleCnt = pRosc->sampleCnt;
+        pReport->rosc[i].sampleCntMin = pRosc->sampleCntMin;
+        pReport->rosc[i].sampleCntMax = pRosc->sampleCntMax;
+        pReport->rosc[i].minEntropyQ16 = pRosc->lastMinEntropyQ16;
+        pReport->rosc[i].aptMaxCount = pRosc->lastAptMaxCount;
+        pReport->rosc[i].rawBitsPerSec = (pRosc->sampleCnt != 0) ? LLF_RND_DRIFT_RNG_CLK_HZ / pRosc->sampleCnt : 0;
+        pReport->rosc[i].entropyBitsPerSec =
+            (uint32_t)(((uint64_t)pReport->rosc[i].rawBitsPerSec * pRosc->lastMinEntropyQ16) >> 16);
+        pReport->rosc[i].adjustments = pRosc->adjustments;
+    }
+
+    pReport->logCount = (gDriftLogSeq < CC_TRNG_DRIFT_LOG_ENTRIES) ? gDriftLogSeq : CC_TRNG_DRIFT_LOG_ENTRIES;
+    first = gDriftLogSeq - pReport->logCount;
+    for (i = 0; i < pReport->logCount; i++)
+        pReport->log[i] = gDriftLog[(first + i) % CC_TRNG_DRIFT_LOG_ENTRIES];
+
+    return CC_OK;
+}
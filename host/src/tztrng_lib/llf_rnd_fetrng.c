@@ -22,22 +22,29 @@ static CCError_t LLF_RND_TRNG_ReadEhrData(uint32_t *pSourceOut)
 {
     CCError_t error = CC_OK;
     uint32_t i;
+    TRNG_PROF_VAR(phaseTs);
 
     error = LLF_RND_TRNG_REQUIRED_ROSCS_NOT_ALLOWED_ERROR;
 
     /* wait RNG interrupt: isr signals error bits */
+    TRNG_PROF_BEGIN(phaseTs);
     error = CC_HalWaitInterrupt();
+    TRNG_PROF_END(WAIT, phaseTs);
 
     /* in case of AUTOCORR_ERR or RNG_WATCHDOG, keep the default error value. will try the next ROSC. */
     CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_ICR), 0xFFFFFFFF);
 
     if (error == CC_OK) {
+        TRNG_PROF_BEGIN(phaseTs);
         for (i = 0; i < LLF_RND_HW_TRNG_EHR_WIDTH_IN_WORDS; i++)
         {
             /* load the current random data to the output buffer */
             *(pSourceOut++) = CC_HAL_READ_REGISTER(DX_EHR_DATA_0_REG_OFFSET + (i*sizeof(uint32_t)));
             TRNG_EHR_DUMP("EHR[%d][0x%x].\n", i, *(pSourceOut - 1));
         }
+        TRNG_NOISE_TAP(pSourceOut - LLF_RND_HW_TRNG_EHR_WIDTH_IN_WORDS);
+        TRNG_STAT_INC(ehrRead);
+        TRNG_PROF_END(EHR_READ, phaseTs);
         CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, RNG_ISR));
     }
 
@@ -57,6 +64,10 @@ CCError_t LLF_RND_StartTrngHW(
     CCError_t error = CC_OK;
     uint32_t tmpSamplCnt = 0;
     uint32_t roscNum = 0;
+    TRNG_PROF_VAR(startTs);
+    TRNG_PROF_VAR(phaseTs);
+
+    TRNG_PROF_BEGIN(startTs);
 
     /* Check pointers */
     if ((rndState_ptr == NULL) || (trngParams_ptr == NULL) ||
@@ -72,6 +83,8 @@ CCError_t LLF_RND_StartTrngHW(
 
             /* init rndState flags to zero */
             rndState_ptr->TrngProcesState = 0;
+
+            TRNG_STAT_INC(restarts);
     }
 
     if (*roscsToStart_ptr == 0)
@@ -99,14 +112,17 @@ CCError_t LLF_RND_StartTrngHW(
     /* do software reset */
     CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_SW_RESET), 0x1);
     /* in order to verify that the reset has completed the sample count need to be verified */
+    TRNG_PROF_BEGIN(phaseTs);
     do {
         /* set sampling ratio (rng_clocks) between consecutive bits */
         CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, SAMPLE_CNT1), trngParams_ptr->SubSamplingRatio);
 
         /* read the sampling ratio  */
         tmpSamplCnt = CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, SAMPLE_CNT1));
+        TRNG_STAT_INC(resetLoops);
 
     } while (tmpSamplCnt != trngParams_ptr->SubSamplingRatio);
+    TRNG_PROF_END(SAMPLE_CNT, phaseTs);
 
 
     /* disable the RND source for setting new parameters in HW */
@@ -118,6 +134,7 @@ CCError_t LLF_RND_StartTrngHW(
     CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_IMR), LLF_RNG_INT_MASK_ON_FETRNG_MODE);
 
     CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, TRNG_CONFIG), roscNum);
+    TRNG_NOISE_TAP_SOURCE(roscNum, trngParams_ptr->SubSamplingRatio);
 
     /* Debug Control register: set to 0 - no bypasses */
     CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, TRNG_DEBUG_CONTROL), LLF_RND_HW_DEBUG_CONTROL_VALUE_ON_FE_MODE);
@@ -130,6 +147,8 @@ CCError_t LLF_RND_StartTrngHW(
     /*total started*/
     rndState_ptr->TrngProcesState |= (*roscsToStart_ptr << 8);
 
+    TRNG_PROF_END(START_HW, startTs);
+
     return error;
 }
 
@@ -191,9 +210,13 @@ CCError_t LLF_RND_GetTrngSource(
             if (error == CC_OK) {
                 break;
             }
+            /* the first EHR is dropped with the failing ROSC */
+            TRNG_STAT_ADD(bytesDiscarded, LLF_RND_HW_TRNG_EHR_WIDTH_IN_BYTES);
         }
 
         if (error != CC_OK) {
+            TRNG_STAT_INC(roscFailures[LLF_RND_TRNG_RoscMaskToNum(roscToStart)]);
+
             /* try next rosc */
             /* if no remain roscs to start, return error */
             if (roscToStart == 0x8) {
@@ -243,6 +266,9 @@ End:
     /* turn the RNG off */
     LLF_RND_TurnOffTrng();
 
+    /* do not leave raw noise on the stack */
+    tztrng_secure_zero(trngBuff, sizeof(trngBuff));
+
     return error;
 } /* END of LLF_RND_GetTrngSource */
 
@@ -63,6 +63,7 @@ static int32_t readEhrData(uint32_t *sample,
 {
     uint32_t i;
     CCError_t err = CC_OK;
+    TRNG_PROF_VAR(phaseTs);
 
     err = startTrngHW(rndState_ptr, trngParams_ptr, CC_FALSE, roscsToStart_ptr, CC_FALSE);
     if (err) {
@@ -71,18 +72,24 @@ static int32_t readEhrData(uint32_t *sample,
     }
 
     /* Read 1 EHR of random bits */
+    TRNG_PROF_BEGIN(phaseTs);
     if (CC_HalWaitInterrupt()) {
         TRNG_LOG_DEBUG("CC_HalWaitInterrupt() failed..\n");
         LLF_RND_TurnOffTrng();
         return (-1);
     }
+    TRNG_PROF_END(WAIT, phaseTs);
 
     /* Read EHR into tmp buffer */
+    TRNG_PROF_BEGIN(phaseTs);
     for (i = 0; i < TRNG_EHR_SIZE; i++) {
         uint32_t ehr = CC_HAL_READ_REGISTER(DX_EHR_DATA_0_REG_OFFSET + (i * sizeof(uint32_t)));
-        TRNG_EHR_DUMP("EHR[%i][0x%x]\n", i, ehrp);
+        TRNG_EHR_DUMP("EHR[%i][0x%x]\n", i, ehr);
         sample[i] = ehr;
     }
+    TRNG_NOISE_TAP(sample);
+    TRNG_STAT_INC(ehrRead);
+    TRNG_PROF_END(EHR_READ, phaseTs);
 
     return CC_OK;
 }
@@ -101,7 +108,7 @@ static CCError_t readMultipleEHR(uint32_t inSize, uint8_t *ramAddr,
         LLF_RND_TurnOffTrng();
         err = readEhrData(noise_samples, rndState_ptr, trngParams_ptr, roscsToStart_ptr);
         if (err != CC_OK)
-            return err;
+            break;
 
         /* Copy the needed amount of bytes to the result buffer */
         tztrng_memcpy(ramAddr, (uint8_t *)noise_samples, read_size);
@@ -110,7 +117,9 @@ static CCError_t readMultipleEHR(uint32_t inSize, uint8_t *ramAddr,
         ramAddr += read_size;
     }
 
-    return CC_OK;
+    tztrng_secure_zero(noise_samples, sizeof(noise_samples));
+
+    return err;
 }
 
 static CCError_t startTrngHW(
@@ -125,9 +134,13 @@ static CCError_t startTrngHW(
     CCError_t error = CC_OK;
     uint32_t  tmpSamplCnt = 0;
     uint32_t roscNum = 0;
+    TRNG_PROF_VAR(startTs);
+    TRNG_PROF_VAR(phaseTs);
 
     CC_UNUSED_PARAM(isStartup);
 
+    TRNG_PROF_BEGIN(startTs);
+
     /* FUNCTION LOGIC */
 
     /* Check pointers */
@@ -144,6 +157,8 @@ static CCError_t startTrngHW(
 
             /* init rndState flags to zero */
             rndState_ptr->TrngProcesState = 0;
+
+            TRNG_STAT_INC(restarts);
     }
 
 
@@ -169,20 +184,24 @@ static CCError_t startTrngHW(
     /*--------------------------------------------------------------*/
 
     /* in order to verify that the reset has completed the sample count need to be verified */
+    TRNG_PROF_BEGIN(phaseTs);
     do {
         /* set sampling ratio (rng_clocks) between consequtive bits */
         CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, SAMPLE_CNT1), trngParams_ptr->SubSamplingRatio);
 
         /* read the sampling ratio  */
         tmpSamplCnt = CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, SAMPLE_CNT1));
+        TRNG_STAT_INC(resetLoops);
 
     } while (tmpSamplCnt != trngParams_ptr->SubSamplingRatio);
+    TRNG_PROF_END(SAMPLE_CNT, phaseTs);
 
     /* disable the RND source for setting new parameters in HW */
     CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RND_SOURCE_ENABLE), LLF_RND_HW_RND_SRC_DISABLE_VAL);
 
     /* set TRNG_CONFIG to choose SOP_SEL = 1 - i.e. EHR output */
     CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, TRNG_CONFIG), roscNum);
+    TRNG_NOISE_TAP_SOURCE(roscNum, trngParams_ptr->SubSamplingRatio);
 
     /* Debug Control register: set to 0 - no bypasses */
     CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, TRNG_DEBUG_CONTROL), LLF_RND_HW_DEBUG_CONTROL_VALUE_ON_TRNG90B_MODE);
@@ -201,6 +220,8 @@ static CCError_t startTrngHW(
     /*total started*/
     rndState_ptr->TrngProcesState |= (*roscsToStart_ptr << 8);
 
+    TRNG_PROF_END(START_HW, startTs);
+
     /* end  of function */
     return error;
 }
@@ -223,6 +244,7 @@ static CCError_t getTrngSource(
     uint32_t roscToStart;
     uint32_t *ramAddr;
     const uint32_t trng90bRequiredBytes = (isStartup == CC_FALSE ? CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES : CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES_STARTUP);
+    TRNG_PROF_VAR(phaseTs);
 
     /* FUNCTION LOGIC */
 
@@ -288,10 +310,22 @@ static CCError_t getTrngSource(
                                         &roscToStart);
 
         if (descrError == CC_OK) {
+            TRNG_PROF_BEGIN(phaseTs);
             error = runContinuousTesting(ramAddr, *sourceOutSize_ptr);
+            TRNG_PROF_END(CONT_TEST, phaseTs);
             if (error == CC_OK) {
+#ifdef CC_CONFIG_TRNG_DRIFT_MONITOR
+                LLF_RND_DriftUpdate(roscToStart, ramAddr, *sourceOutSize_ptr);
+#endif
+                /* the start-up test data is not handed out */
+                if (isStartup == CC_TRUE)
+                    TRNG_STAT_ADD(bytesDiscarded, *sourceOutSize_ptr);
                 break;
             }
+#ifdef CC_CONFIG_TRNG_DRIFT_MONITOR
+            LLF_RND_DriftFailure(roscToStart);
+#endif
+            TRNG_STAT_ADD(bytesDiscarded, *sourceOutSize_ptr);
             *sourceOutSize_ptr = 0;
         }
         else {
@@ -304,6 +338,8 @@ static CCError_t getTrngSource(
         /*clean started & not processed*/
         rndState_ptr->TrngProcesState &= 0x00FFFFFF;
 
+        TRNG_STAT_INC(roscFailures[LLF_RND_TRNG_RoscMaskToNum(roscToStart)]);
+
         /* case of erors or watchdog exceed  - try next rosc */
         /*  if no remain roscs to start, return error */
         if (roscToStart == 0x8) {
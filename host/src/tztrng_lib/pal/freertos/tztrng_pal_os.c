@@ -0,0 +1,261 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+#ifdef CC_CONFIG_TRNG_LOCK
+static SemaphoreHandle_t gTrngLock = NULL;
+
+void tztrng_pal_lock(void)
+{
+    /* created on first use; the scheduler is suspended so two tasks cannot both create it */
+    if (gTrngLock == NULL) {
+        vTaskSuspendAll();
+        if (gTrngLock == NULL)
+            gTrngLock = xSemaphoreCreateMutex();
+        (void)xTaskResumeAll();
+    }
+
+    if (gTrngLock != NULL)
+        xSemaphoreTake(gTrngLock, portMAX_DELAY);
+}
+
+void tztrng_pal_unlock(void)
+{
+    if (gTrngLock != NULL)
+        xSemaphoreGive(gTrngLock);
+}
+#endif
+
+#ifdef CC_CONFIG_TRNG_SYNC
+#ifndef CC_CONFIG_TRNG_SYNC_MAX_WAITERS
+/* tasks waiting for one event at a time */
+#define CC_CONFIG_TRNG_SYNC_MAX_WAITERS         32
+#endif
+
+/*
+ * An event is a counting semaphore: a signal gives it once per waiting task, so
+ * all of them wake as with a condition variable. A waiter that timed out before
+ * the signal leaves its token behind; the next wait returns early, which is an
+ * allowed spurious wake-up.
+ */
+typedef struct {
+    SemaphoreHandle_t sem;
+    uint32_t waiters;
+    uint32_t gen;                   /* signals so far */
+} TztrngPalEvt_t;
+
+static SemaphoreHandle_t gSyncLock = NULL;
+static TztrngPalEvt_t gSyncEvt[TZTRNG_PAL_NUM_EVTS];
+
+static void tztrng_pal_syncCreate(void)
+{
+    uint32_t i;
+
+    /* the scheduler is suspended so two tasks cannot both create them */
+    vTaskSuspendAll();
+    for (i = 0; i < TZTRNG_PAL_NUM_EVTS; i++) {
+        if (gSyncEvt[i].sem == NULL)
+            gSyncEvt[i].sem = xSemaphoreCreateCounting(CC_CONFIG_TRNG_SYNC_MAX_WAITERS, 0);
+    }
+    if (gSyncLock == NULL)
+        gSyncLock = xSemaphoreCreateMutex();
+    (void)xTaskResumeAll();
+}
+
+void tztrng_pal_syncLock(void)
+{
+    if (gSyncLock == NULL)
+        tztrng_pal_syncCreate();
+
+    if (gSyncLock != NULL)
+        xSemaphoreTake(gSyncLock, portMAX_DELAY);
+}
+
+void tztrng_pal_syncUnlock(void)
+{
+    if (gSyncLock != NULL)
+        xSemaphoreGive(gSyncLock);
+}
+
+void tztrng_pal_syncWait(uint32_t evt, uint32_t timeoutUs)
+{
+    TztrngPalEvt_t *pEvt = &gSyncEvt[evt];
+    TickType_t ticks = (TickType_t)((timeoutUs + portTICK_PERIOD_MS * 1000UL - 1) /
+                                    (portTICK_PERIOD_MS * 1000UL));
+    uint32_t gen = pEvt->gen;
+    BaseType_t taken;
+
+    if (pEvt->sem == NULL) {
+        /* no semaphore: poll */
+        tztrng_pal_syncUnlock();
+        taskYIELD();
+        tztrng_pal_syncLock();
+        return;
+    }
+
+    pEvt->waiters++;
+    tztrng_pal_syncUnlock();
+    taken = xSemaphoreTake(pEvt->sem, ticks);
+    tztrng_pal_syncLock();
+    /* timed out before any signal: still counted as a waiter */
+    if ((taken != pdPASS) && (pEvt->gen == gen))
+        pEvt->waiters--;
+}
+
+void tztrng_pal_syncSignal(uint32_t evt)
+{
+    TztrngPalEvt_t *pEvt = &gSyncEvt[evt];
+
+    if (pEvt->sem == NULL)
+        return;
+    for (; pEvt->waiters > 0; pEvt->waiters--)
+        xSemaphoreGive(pEvt->sem);
+    pEvt->gen++;
+}
+#endif
+
+#if defined(CC_CONFIG_TRNG_WAIT_PREDICT) || defined(CC_CONFIG_TRNG_SYNC)
+uint32_t tztrng_pal_timeUs(void)
+{
+    return (uint32_t)xTaskGetTickCount() * (portTICK_PERIOD_MS * 1000UL);
+}
+#endif
+
+#ifdef CC_CONFIG_TRNG_TIMESTAMP_OS_CLOCK
+/* no cycle counter of tztrng_pal.c on the port (POSIX on a host): the tick count, in microseconds */
+uint64_t tztrng_pal_timestamp(void)
+{
+    return (uint64_t)xTaskGetTickCount() * (portTICK_PERIOD_MS * 1000UL);
+}
+#endif
+
+#ifdef CC_CONFIG_TRNG_POOL
+#ifndef CC_CONFIG_TRNG_POOL_TASK_STACK_WORDS
+/* the collection keeps a CC_RND_WORK_BUFFER_SIZE_WORDS work buffer on the stack */
+#define CC_CONFIG_TRNG_POOL_TASK_STACK_WORDS    512
+#endif
+#ifndef CC_CONFIG_TRNG_POOL_TASK_PRIORITY
+#define CC_CONFIG_TRNG_POOL_TASK_PRIORITY       (tskIDLE_PRIORITY + 1)
+#endif
+
+static SemaphoreHandle_t gPoolDone = NULL;
+static void (*gPoolEntry)(void);
+
+static void tztrng_pal_poolTask(void *arg)
+{
+    CC_UNUSED_PARAM(arg);
+    gPoolEntry();
+    /* a FreeRTOS task must not return */
+    xSemaphoreGive(gPoolDone);
+    vTaskDelete(NULL);
+}
+
+int tztrng_pal_poolStart(void (*entry)(void))
+{
+    /* kept for the next start once created */
+    if (gPoolDone == NULL)
+        gPoolDone = xSemaphoreCreateBinary();
+    if (gPoolDone == NULL)
+        return -1;
+
+    gPoolEntry = entry;
+    if (xTaskCreate(tztrng_pal_poolTask, "tztrng_pool", CC_CONFIG_TRNG_POOL_TASK_STACK_WORDS, NULL,
+                    CC_CONFIG_TRNG_POOL_TASK_PRIORITY, NULL) != pdPASS)
+        return -1;
+
+    return 0;
+}
+
+void tztrng_pal_poolJoin(void)
+{
+    xSemaphoreTake(gPoolDone, portMAX_DELAY);
+}
+
+/* no paging: the pool buffer never leaves RAM */
+int tztrng_pal_memLock(void *buf, size_t size)
+{
+    CC_UNUSED_PARAM(buf);
+    CC_UNUSED_PARAM(size);
+    return 0;
+}
+
+void tztrng_pal_memUnlock(void *buf, size_t size)
+{
+    CC_UNUSED_PARAM(buf);
+    CC_UNUSED_PARAM(size);
+}
+#endif
+
+#ifdef CC_CONFIG_TRNG_WAIT_PREDICT
+void tztrng_pal_sleepUs(uint32_t us)
+{
+    TickType_t ticks = (TickType_t)(us / (portTICK_PERIOD_MS * 1000UL));
+
+    if (ticks == 0)
+        taskYIELD();
+    else
+        vTaskDelay(ticks);
+}
+#endif
+
+#ifdef CC_CONFIG_TRNG_WAIT_IRQ
+/*
+ * FreeRTOS backend of the EHR wait.
+ * CC_TrngIrqHandler() must be installed as the RNG interrupt handler. It masks the
+ * RNG interrupts (the ISR bits stay set until the waiting task clears them) and
+ * wakes the task through a binary semaphore. The task unmasks the interrupts again
+ * before each sleep.
+ */
+
+static SemaphoreHandle_t gTrngIrqSem = NULL;
+
+void CC_TrngIrqHandler(void)
+{
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+
+    CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_IMR), 0xFFFFFFFF);
+
+    if (gTrngIrqSem != NULL)
+        xSemaphoreGiveFromISR(gTrngIrqSem, &higherPriorityTaskWoken);
+
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+void tztrng_pal_waitIrq(void)
+{
+    if (gTrngIrqSem == NULL) {
+        gTrngIrqSem = xSemaphoreCreateBinary();
+        if (gTrngIrqSem == NULL) {
+            /* no semaphore: stay polled */
+            TRNG_LOG_DEBUG("failed to create semaphore, polling\n");
+            return;
+        }
+    }
+
+    /* unmask; an event that is already pending fires right away */
+    CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_IMR), LLF_RNG_INT_MASK_ON_CURRENT_MODE);
+
+    xSemaphoreTake(gTrngIrqSem, pdMS_TO_TICKS(CC_CONFIG_TRNG_WAIT_TIMEOUT_MS));
+}
+#endif
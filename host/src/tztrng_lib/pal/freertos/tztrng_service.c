@@ -0,0 +1,466 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "task.h"
+
+/*
+  FreeRTOS entropy service.
+
+  One task owns the TRNG and serves the requests of all other tasks from a
+  queue. The requests live on the requesters' stacks; the queue holds their
+  addresses, urgent ones at the front. The task runs the collections of
+  tztrng_async.c into a staging buffer and sleeps on its task notification
+  between two EHRs: CC_TrngServiceIrqHandler() masks the RNG interrupts and
+  sets the IRQ bit, CC_TrngServiceGet() sets the REQ bit. Completed
+  collections go to a prefill buffer, which the task keeps full while no
+  request waits, so most requests are copied out without touching the TRNG.
+  The buffer is a stack: bytes are taken from the top and wiped there.
+
+  Priority inheritance: an urgent requester raises the service task to its
+  own priority when it queues the request. The task keeps the highest
+  priority of the request it serves and of the urgent request at the front
+  of the queue, and drops back to its own priority once none is left.
+
+  Stopping: CC_TrngServiceGet() counts itself in 'requesters' while it is
+  inside, in the critical section that checks 'running'. After the stop the
+  task fails every request it receives and exits only once that count is
+  zero, so a requester that passed the check always gets its request
+  completed and never uses the task handle after the task is gone.
+*/
+
+#ifndef CC_CONFIG_TRNG_SERVICE_TASK_STACK_WORDS
+#define CC_CONFIG_TRNG_SERVICE_TASK_STACK_WORDS     256
+#endif
+#ifndef CC_CONFIG_TRNG_SERVICE_TASK_PRIORITY
+#define CC_CONFIG_TRNG_SERVICE_TASK_PRIORITY        (tskIDLE_PRIORITY + 1)
+#endif
+/* requests queued at once; CC_TrngServiceGet() waits for a free slot */
+#ifndef CC_CONFIG_TRNG_SERVICE_QUEUE_LEN
+#define CC_CONFIG_TRNG_SERVICE_QUEUE_LEN            8
+#endif
+/* task notification of the requesters that signals the completion; index 0 is
+   left to the application (xTaskNotify, stream and message buffers) */
+#if configTASK_NOTIFICATION_ARRAY_ENTRIES < 2
+#error "CC_CONFIG_TRNG_SERVICE needs configTASK_NOTIFICATION_ARRAY_ENTRIES >= 2"
+#endif
+#ifndef CC_CONFIG_TRNG_SERVICE_NOTIFY_INDEX
+#define CC_CONFIG_TRNG_SERVICE_NOTIFY_INDEX         (configTASK_NOTIFICATION_ARRAY_ENTRIES - 1)
+#endif
+#if (CC_CONFIG_TRNG_SERVICE_NOTIFY_INDEX < 1) || (CC_CONFIG_TRNG_SERVICE_NOTIFY_INDEX >= configTASK_NOTIFICATION_ARRAY_ENTRIES)
+#error "CC_CONFIG_TRNG_SERVICE_NOTIFY_INDEX must be within 1 .. configTASK_NOTIFICATION_ARRAY_ENTRIES - 1"
+#endif
+
+/* notification bits of the service task */
+#define SERVICE_NOTIFY_IRQ      0x1UL   /* the RNG interrupt fired */
+#define SERVICE_NOTIFY_REQ      0x2UL   /* a request was queued, or the service stops */
+
+typedef struct {
+    uint8_t *outAddr;
+    uint32_t outLen;
+    uint32_t pos;                   /* bytes copied so far */
+    uint32_t waited;                /* a collection was needed */
+    UBaseType_t priority;           /* priority lent to the service, 0 if not urgent */
+    TaskHandle_t task;
+    volatile uint32_t done;
+    uint32_t err;
+} ServiceReq_t;
+
+typedef struct {
+    TaskHandle_t task;
+    QueueHandle_t queue;
+    SemaphoreHandle_t exited;
+    unsigned long rngRegBase;
+    volatile uint32_t running;      /* started and not stopping */
+    uint32_t requesters;            /* CC_TrngServiceGet calls inside, in critical sections */
+    uint32_t collecting;            /* a collection into stage[] is running */
+    uint32_t held;                  /* refill while idle held after a failed collection */
+    uint32_t level;                 /* bytes in buf[] */
+    uint32_t stageLen;
+    CCTrngServiceStats_t stats;
+    CCTrngAsync_t async;
+    uint8_t buf[CC_CONFIG_TRNG_SERVICE_BUF_BYTES];
+    uint8_t stage[CC_CONFIG_TRNG_SERVICE_BUF_BYTES];
+} Service_t;
+
+static Service_t gService;
+
+void CC_TrngServiceIrqHandler(void)
+{
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+
+    CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_IMR), 0xFFFFFFFF);
+
+    if (gService.task != NULL)
+        xTaskNotifyFromISR(gService.task, SERVICE_NOTIFY_IRQ, eSetBits, &higherPriorityTaskWoken);
+
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+/* Run at the priority of the urgent request at the front of the queue, or at the own one */
+static void ServiceRestorePriority(void)
+{
+    ServiceReq_t *pNext;
+    UBaseType_t priority = CC_CONFIG_TRNG_SERVICE_TASK_PRIORITY;
+
+    /* the scheduler is suspended so a requester cannot lend its priority in between */
+    vTaskSuspendAll();
+    if ((xQueuePeek(gService.queue, &pNext, 0) == pdPASS) && (pNext->priority > priority))
+        priority = pNext->priority;
+    if (uxTaskPriorityGet(NULL) != priority)
+        vTaskPrioritySet(NULL, priority);
+    (void)xTaskResumeAll();
+}
+
+static void ServiceAccept(ServiceReq_t *pReq)
+{
+    gService.stats.requests++;
+    if (pReq->priority == 0)
+        return;
+
+    gService.stats.urgentRequests++;
+    if (pReq->priority > CC_CONFIG_TRNG_SERVICE_TASK_PRIORITY) {
+        gService.stats.boosts++;
+        if (uxTaskPriorityGet(NULL) < pReq->priority)
+            vTaskPrioritySet(NULL, pReq->priority);
+    }
+}
+
+/* Hand the request back to its task: done is set last, the task's stack frame goes away */
+static void ServiceComplete(ServiceReq_t *pReq, CCError_t err)
+{
+    TaskHandle_t task = pReq->task;
+
+    if (err != CC_OK) {
+        tztrng_secure_zero(pReq->outAddr, pReq->outLen);
+    } else {
+        gService.stats.bytes += pReq->outLen;
+        if (!pReq->waited)
+            gService.stats.bufferHits++;
+    }
+    pReq->err = err;
+    /* the give lands before the task can see done and clear its notification */
+    vTaskSuspendAll();
+    pReq->done = 1;
+    xTaskNotifyGiveIndexed(task, CC_CONFIG_TRNG_SERVICE_NOTIFY_INDEX);
+    (void)xTaskResumeAll();
+}
+
+/* Copy what the prefill buffer holds; CC_TRUE once the request is complete */
+static CCBool_t ServiceCopy(ServiceReq_t *pReq)
+{
+    uint32_t n = pReq->outLen - pReq->pos;
+
+    if (n > gService.level)
+        n = gService.level;
+    gService.level -= n;
+    tztrng_memcpy(pReq->outAddr + pReq->pos, gService.buf + gService.level, n);
+    tztrng_secure_zero(gService.buf + gService.level, n);
+    pReq->pos += n;
+
+    return (pReq->pos == pReq->outLen) ? CC_TRUE : CC_FALSE;
+}
+
+static void ServiceStartCollection(void)
+{
+    CCError_t err;
+
+    gService.stageLen = CC_CONFIG_TRNG_SERVICE_BUF_BYTES - gService.level;
+    err = CC_TrngAsyncStart(&gService.async, gService.rngRegBase, gService.stage,
+                            (size_t)gService.stageLen * 8);
+    if (err != CC_OK) {
+        gService.stats.errors++;
+        gService.stats.lastError = err;
+        gService.held = 1;
+        return;
+    }
+    gService.collecting = 1;
+}
+
+/* Sleep until the RNG interrupt, a request or the timeout; CC_TRUE to poll the collection */
+static CCBool_t ServiceWait(void)
+{
+    uint32_t notified = 0;
+
+    if (!gService.collecting) {
+        (void)xTaskNotifyWait(0, SERVICE_NOTIFY_IRQ | SERVICE_NOTIFY_REQ, &notified, portMAX_DELAY);
+        return CC_FALSE;
+    }
+
+    /* unmask; an event that is already pending fires right away */
+    gCcRegBase = gService.rngRegBase;
+    CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_IMR), LLF_RNG_INT_MASK_ON_CURRENT_MODE);
+
+    if (xTaskNotifyWait(0, SERVICE_NOTIFY_IRQ | SERVICE_NOTIFY_REQ, &notified,
+                        pdMS_TO_TICKS(CC_CONFIG_TRNG_SERVICE_WAIT_MS)) != pdPASS) {
+        gService.stats.timeoutWakeups++;
+        return CC_TRUE;
+    }
+    if (notified & SERVICE_NOTIFY_IRQ) {
+        gService.stats.irqWakeups++;
+        return CC_TRUE;
+    }
+
+    return CC_FALSE;
+}
+
+/* One step of the running collection; the error of a failed one */
+static CCError_t ServicePoll(void)
+{
+    CCError_t err;
+
+    err = CC_TrngAsyncPoll(&gService.async);
+    if (err == CC_TRNG_ASYNC_PENDING)
+        return CC_OK;
+
+    gService.collecting = 0;
+    if (err != CC_OK) {
+        TRNG_LOG_DEBUG("service collection failed, err[0x%X]\n", (unsigned int)err);
+        gService.stats.errors++;
+        gService.stats.lastError = err;
+        gService.held = 1;
+        return err;
+    }
+
+    /* the level only dropped since the start: the collection fits */
+    tztrng_memcpy(gService.buf + gService.level, gService.stage, gService.stageLen);
+    tztrng_secure_zero(gService.stage, gService.stageLen);
+    gService.level += gService.stageLen;
+    gService.stats.collections++;
+    gService.held = 0;
+
+    return CC_OK;
+}
+
+static void ServiceTask(void *arg)
+{
+    ServiceReq_t *pReq = NULL;
+    uint32_t requesters;
+    CCError_t err;
+
+    CC_UNUSED_PARAM(arg);
+
+    while (gService.running) {
+        /* the next request: urgent ones are at the front */
+        if ((pReq == NULL) && (xQueueReceive(gService.queue, &pReq, 0) == pdPASS))
+            ServiceAccept(pReq);
+
+        if (pReq != NULL) {
+            if (ServiceCopy(pReq)) {
+                ServiceComplete(pReq, CC_OK);
+                pReq = NULL;
+                ServiceRestorePriority();
+                continue;
+            }
+            pReq->waited = 1;
+        }
+
+        /* refill for the waiting request, or ahead of the next one */
+        if (!gService.collecting && (gService.level < CC_CONFIG_TRNG_SERVICE_BUF_BYTES) &&
+            ((pReq != NULL) || !gService.held)) {
+            ServiceStartCollection();
+            if (!gService.collecting && (pReq != NULL)) {
+                ServiceComplete(pReq, gService.stats.lastError);
+                pReq = NULL;
+                ServiceRestorePriority();
+                continue;
+            }
+        }
+
+        if (!ServiceWait())
+            continue;
+
+        err = ServicePoll();
+        if ((err != CC_OK) && (pReq != NULL)) {
+            ServiceComplete(pReq, err);
+            pReq = NULL;
+            ServiceRestorePriority();
+        }
+    }
+
+    /* stopping: fail the request being served, the queued ones and those still
+       to be queued by the requesters inside CC_TrngServiceGet() */
+    if (gService.collecting) {
+        (void)CC_TrngAsyncCancel(&gService.async);
+        gService.collecting = 0;
+    }
+    if (pReq != NULL)
+        ServiceComplete(pReq, CC_RND_TRNG_SERVICE_STATE_ERROR);
+    for (;;) {
+        while (xQueueReceive(gService.queue, &pReq, 0) == pdPASS)
+            ServiceComplete(pReq, CC_RND_TRNG_SERVICE_STATE_ERROR);
+
+        taskENTER_CRITICAL();
+        requesters = gService.requesters;
+        taskEXIT_CRITICAL();
+        if (requesters == 0)
+            break;
+        (void)xTaskNotifyWait(0, SERVICE_NOTIFY_IRQ | SERVICE_NOTIFY_REQ, NULL,
+                              pdMS_TO_TICKS(CC_CONFIG_TRNG_SERVICE_WAIT_MS));
+    }
+    tztrng_secure_zero(gService.buf, sizeof(gService.buf));
+    tztrng_secure_zero(gService.stage, sizeof(gService.stage));
+    gService.level = 0;
+
+    /* a FreeRTOS task must not return */
+    xSemaphoreGive(gService.exited);
+    vTaskDelete(NULL);
+}
+
+uint32_t CC_TrngServiceStart(unsigned long rngRegBase)
+{
+    if (0 == rngRegBase) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+    if (gService.running || (gService.task != NULL))
+        return CC_RND_TRNG_SERVICE_STATE_ERROR;
+
+    /* kept for the next start once created */
+    if (gService.queue == NULL)
+        gService.queue = xQueueCreate(CC_CONFIG_TRNG_SERVICE_QUEUE_LEN, sizeof(ServiceReq_t *));
+    if (gService.exited == NULL)
+        gService.exited = xSemaphoreCreateBinary();
+    if ((gService.queue == NULL) || (gService.exited == NULL))
+        return CC_RND_TRNG_SERVICE_RESOURCE_ERROR;
+
+    tztrng_memset((uint8_t *)&gService.stats, 0, sizeof(gService.stats));
+    gService.rngRegBase = rngRegBase;
+    gService.collecting = 0;
+    gService.held = 0;
+    gService.level = 0;
+    gService.running = 1;
+
+    /* requests are accepted once the task handle is set */
+    if (xTaskCreate(ServiceTask, "tztrng_svc", CC_CONFIG_TRNG_SERVICE_TASK_STACK_WORDS, NULL,
+                    CC_CONFIG_TRNG_SERVICE_TASK_PRIORITY, &gService.task) != pdPASS) {
+        gService.task = NULL;
+        gService.running = 0;
+        return CC_RND_TRNG_SERVICE_RESOURCE_ERROR;
+    }
+
+    return CC_OK;
+}
+
+/* Leave CC_TrngServiceGet(): the stopping service task may exit once none is inside */
+static void ServiceLeave(void)
+{
+    taskENTER_CRITICAL();
+    gService.requesters--;
+    taskEXIT_CRITICAL();
+}
+
+uint32_t CC_TrngServiceGet(uint8_t *outAddr, size_t outLen, uint32_t flags)
+{
+    ServiceReq_t req;
+    ServiceReq_t *pReq = &req;
+    TaskHandle_t service;
+    BaseType_t sent;
+    uint32_t err;
+
+    if ((NULL == outAddr) || (0 == outLen) || (outLen > 0xFFFFFFFFUL)) {
+        TRNG_LOG_DEBUG("illegal request!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+
+    /* the task handle stays valid while the request is counted */
+    taskENTER_CRITICAL();
+    service = gService.running ? gService.task : NULL;
+    if (service != NULL)
+        gService.requesters++;
+    taskEXIT_CRITICAL();
+    if (service == NULL)
+        return CC_RND_TRNG_SERVICE_STATE_ERROR;
+
+    tztrng_memset((uint8_t *)&req, 0, sizeof(req));
+    req.outAddr = outAddr;
+    req.outLen = (uint32_t)outLen;
+    req.task = xTaskGetCurrentTaskHandle();
+    if (flags & CC_TRNG_SERVICE_URGENT)
+        req.priority = uxTaskPriorityGet(NULL);
+
+    do {
+        if (flags & CC_TRNG_SERVICE_URGENT)
+            sent = xQueueSendToFront(gService.queue, &pReq, pdMS_TO_TICKS(CC_CONFIG_TRNG_SERVICE_WAIT_MS));
+        else
+            sent = xQueueSendToBack(gService.queue, &pReq, pdMS_TO_TICKS(CC_CONFIG_TRNG_SERVICE_WAIT_MS));
+        if ((sent != pdPASS) && !gService.running) {
+            ServiceLeave();
+            return CC_RND_TRNG_SERVICE_STATE_ERROR;
+        }
+    } while (sent != pdPASS);
+
+    /* lend the priority until served; the scheduler is suspended so the
+       service cannot drop it in between. A stopping service fails the
+       request instead and runs at its own priority. */
+    if (req.priority != 0) {
+        vTaskSuspendAll();
+        if (gService.running && !req.done && (uxTaskPriorityGet(service) < req.priority))
+            vTaskPrioritySet(service, req.priority);
+        (void)xTaskResumeAll();
+    }
+    xTaskNotify(service, SERVICE_NOTIFY_REQ, eSetBits);
+
+    while (!req.done)
+        (void)ulTaskNotifyTakeIndexed(CC_CONFIG_TRNG_SERVICE_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+    /* no completion left pending for the next request of this task */
+    (void)xTaskNotifyStateClearIndexed(NULL, CC_CONFIG_TRNG_SERVICE_NOTIFY_INDEX);
+    (void)ulTaskNotifyValueClearIndexed(NULL, CC_CONFIG_TRNG_SERVICE_NOTIFY_INDEX, 0xFFFFFFFFUL);
+    err = req.err;
+
+    ServiceLeave();
+
+    return err;
+}
+
+uint32_t CC_TrngServiceStop(void)
+{
+    TaskHandle_t service;
+
+    taskENTER_CRITICAL();
+    service = gService.running ? gService.task : NULL;
+    gService.running = 0;
+    taskEXIT_CRITICAL();
+    if (service == NULL)
+        return CC_RND_TRNG_SERVICE_STATE_ERROR;
+
+    /* the task exits once the requesters inside CC_TrngServiceGet() are served */
+    xTaskNotify(service, SERVICE_NOTIFY_REQ, eSetBits);
+    xSemaphoreTake(gService.exited, portMAX_DELAY);
+    gService.task = NULL;
+
+    return CC_OK;
+}
+
+uint32_t CC_TrngServiceGetStats(CCTrngServiceStats_t *pStats)
+{
+    if (NULL == pStats)
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+
+    vTaskSuspendAll();
+    *pStats = gService.stats;
+    pStats->level = gService.level;
+    (void)xTaskResumeAll();
+
+    return CC_OK;
+}
@@ -0,0 +1,223 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef CC_CONFIG_TRNG_LOCK
+static pthread_mutex_t gTrngLock = PTHREAD_MUTEX_INITIALIZER;
+
+void tztrng_pal_lock(void)
+{
+    pthread_mutex_lock(&gTrngLock);
+}
+
+void tztrng_pal_unlock(void)
+{
+    pthread_mutex_unlock(&gTrngLock);
+}
+#endif
+
+#ifdef CC_CONFIG_TRNG_SYNC
+static pthread_mutex_t gSyncLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gSyncEvt[TZTRNG_PAL_NUM_EVTS];
+static pthread_once_t gSyncOnce = PTHREAD_ONCE_INIT;
+
+static void tztrng_pal_syncInit(void)
+{
+    pthread_condattr_t attr;
+    uint32_t i;
+
+    /* timed waits on the monotonic clock, immune to wall clock changes */
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    for (i = 0; i < TZTRNG_PAL_NUM_EVTS; i++)
+        pthread_cond_init(&gSyncEvt[i], &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+void tztrng_pal_syncLock(void)
+{
+    pthread_once(&gSyncOnce, tztrng_pal_syncInit);
+    pthread_mutex_lock(&gSyncLock);
+}
+
+void tztrng_pal_syncUnlock(void)
+{
+    pthread_mutex_unlock(&gSyncLock);
+}
+
+void tztrng_pal_syncWait(uint32_t evt, uint32_t timeoutUs)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += timeoutUs / 1000000UL;
+    ts.tv_nsec += (long)(timeoutUs % 1000000UL) * 1000;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&gSyncEvt[evt], &gSyncLock, &ts);
+}
+
+void tztrng_pal_syncSignal(uint32_t evt)
+{
+    pthread_cond_broadcast(&gSyncEvt[evt]);
+}
+#endif
+
+#if defined(CC_CONFIG_TRNG_WAIT_PREDICT) || defined(CC_CONFIG_TRNG_SYNC)
+uint32_t tztrng_pal_timeUs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000000UL + (uint32_t)(ts.tv_nsec / 1000);
+}
+#endif
+
+#ifdef CC_CONFIG_TRNG_POOL
+static pthread_t gPoolThread;
+static void (*gPoolEntry)(void);
+
+static void *tztrng_pal_poolThread(void *arg)
+{
+    CC_UNUSED_PARAM(arg);
+    gPoolEntry();
+    return NULL;
+}
+
+int tztrng_pal_poolStart(void (*entry)(void))
+{
+    gPoolEntry = entry;
+    if (pthread_create(&gPoolThread, NULL, tztrng_pal_poolThread, NULL) != 0)
+        return -1;
+
+    return 0;
+}
+
+void tztrng_pal_poolJoin(void)
+{
+    pthread_join(gPoolThread, NULL);
+}
+
+int tztrng_pal_memLock(void *buf, size_t size)
+{
+    if (mlock(buf, size) != 0) {
+        TRNG_LOG_DEBUG("mlock failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+void tztrng_pal_memUnlock(void *buf, size_t size)
+{
+    munlock(buf, size);
+}
+#endif
+
+#ifdef CC_CONFIG_TRNG_TIMESTAMP
+/* the PMU cycle counter is not readable from user space by default; use the
+   monotonic clock, in nanoseconds */
+uint64_t tztrng_pal_timestamp(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#ifdef CC_CONFIG_TRNG_WAIT_PREDICT
+/* below this, a sleep costs more than it saves */
+#define TZTRNG_PAL_MIN_SLEEP_US 20
+
+void tztrng_pal_sleepUs(uint32_t us)
+{
+    struct timespec ts;
+
+    if (us < TZTRNG_PAL_MIN_SLEEP_US) {
+        sched_yield();
+        return;
+    }
+
+    ts.tv_sec = us / 1000000UL;
+    ts.tv_nsec = (long)(us % 1000000UL) * 1000;
+    nanosleep(&ts, NULL);
+}
+#endif
+
+#ifdef CC_CONFIG_TRNG_WAIT_IRQ
+/*
+ * Linux UIO backend of the EHR wait.
+ * The RNG interrupt is exported through a UIO device (e.g. uio_pdrv_genirq):
+ * reading the device blocks until the interrupt fires, and the kernel keeps the
+ * line disabled until 1 is written back to the device.
+ */
+
+#ifndef CC_CONFIG_TRNG_UIO_DEV
+#define CC_CONFIG_TRNG_UIO_DEV "/dev/uio0"
+#endif
+
+#define TZTRNG_UIO_FD_CLOSED       (-1)
+#define TZTRNG_UIO_FD_UNAVAILABLE  (-2)
+
+static int gUioFd = TZTRNG_UIO_FD_CLOSED;
+
+void tztrng_pal_waitIrq(void)
+{
+    struct pollfd pfd;
+    int32_t irqOn = 1;
+    uint32_t irqCount;
+
+    if (gUioFd == TZTRNG_UIO_FD_UNAVAILABLE)
+        return;
+
+    if (gUioFd == TZTRNG_UIO_FD_CLOSED) {
+        gUioFd = open(CC_CONFIG_TRNG_UIO_DEV, O_RDWR | O_CLOEXEC);
+        if (gUioFd < 0) {
+            /* no interrupt available: stay polled */
+            TRNG_LOG_DEBUG("failed to open %s, polling\n", CC_CONFIG_TRNG_UIO_DEV);
+            gUioFd = TZTRNG_UIO_FD_UNAVAILABLE;
+            return;
+        }
+    }
+
+    /* re-enable the interrupt; a level still pending fires right away,
+       so an EHR that became valid after the ISR read is not missed */
+    if (write(gUioFd, &irqOn, sizeof(irqOn)) != sizeof(irqOn))
+        return;
+
+    pfd.fd = gUioFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, CC_CONFIG_TRNG_WAIT_TIMEOUT_MS) > 0 && (pfd.revents & POLLIN)) {
+        /* consume the event count */
+        if (read(gUioFd, &irqCount, sizeof(irqCount)) != sizeof(irqCount))
+            TRNG_LOG_DEBUG("failed to read %s\n", CC_CONFIG_TRNG_UIO_DEV);
+    }
+}
+#endif
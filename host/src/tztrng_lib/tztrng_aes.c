@@ -0,0 +1,307 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+
+/*
+  AES-256 block encryption for the CTR_DRBG and the CBC-MAC conditioning.
+
+  Only the forward cipher is needed (CTR mode, CBC-MAC and the block cipher
+  derivation function never decrypt). Two implementations, selected at build time:
+  - Armv8 Cryptography Extension (AESE/AESMC), used when the compiler targets
+    it (CC_CONFIG_TRNG_CRYPTO_EXT=1 adds -march=armv8-a+crypto on ARCH=arm64);
+    CTR mode keeps four blocks in flight to hide the AESE/AESMC latency,
+  - portable C with a single 1 KiB T-table and rotations. Table lookups are
+    indexed by key dependent data, so this path is not constant time with
+    respect to the cache; prefer the Cryptography Extension on shared cores.
+
+  The round keys are kept in the caller's uint32_t array: big endian word values
+  for the portable path, the key schedule bytes in memory order for the
+  Cryptography Extension.
+*/
+
+#if (defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO)) && !defined(__ARM_BIG_ENDIAN)
+#define LLF_AES_USE_CE
+#include <arm_neon.h>
+#endif
+
+#define LLF_AES256_ROUNDS   14
+
+#define GETU32(p)   (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | \
+                     ((uint32_t)(p)[2] << 8) | ((uint32_t)(p)[3]))
+#define PUTU32(p, v) do { (p)[0] = (uint8_t)((v) >> 24); (p)[1] = (uint8_t)((v) >> 16); \
+                          (p)[2] = (uint8_t)((v) >> 8); (p)[3] = (uint8_t)(v); } while (0)
+
+static const uint8_t gAesSbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static const uint8_t gAesRcon[7] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40 };
+
+static uint32_t AesSubWord(uint32_t w)
+{
+    return ((uint32_t)gAesSbox[w >> 24] << 24) |
+           ((uint32_t)gAesSbox[(w >> 16) & 0xff] << 16) |
+           ((uint32_t)gAesSbox[(w >> 8) & 0xff] << 8) |
+           ((uint32_t)gAesSbox[w & 0xff]);
+}
+
+void LLF_AES_SetKey256(uint32_t *roundKeys, const uint8_t *key)
+{
+    uint32_t i;
+    uint32_t temp;
+
+    for (i = 0; i < 8; i++)
+        roundKeys[i] = GETU32(key + 4 * i);
+
+    for (i = 8; i < LLF_AES256_ROUND_KEY_WORDS; i++) {
+        temp = roundKeys[i - 1];
+        if ((i % 8) == 0)
+            temp = AesSubWord((temp << 8) | (temp >> 24)) ^ ((uint32_t)gAesRcon[i / 8 - 1] << 24);
+        else if ((i % 8) == 4)
+            temp = AesSubWord(temp);
+        roundKeys[i] = roundKeys[i - 8] ^ temp;
+    }
+
+#ifdef LLF_AES_USE_CE
+    /* AESE takes the round key as bytes */
+    for (i = 0; i < LLF_AES256_ROUND_KEY_WORDS; i++) {
+        temp = roundKeys[i];
+        PUTU32((uint8_t *)&roundKeys[i], temp);
+    }
+#endif
+}
+
+#ifdef LLF_AES_USE_CE
+
+#define AES_CE_ROUND(b, k)  ((b) = vaesmcq_u8(vaeseq_u8((b), (k))))
+
+static void AesLoadKeys(const uint32_t *roundKeys, uint8x16_t *k)
+{
+    uint32_t r;
+
+    for (r = 0; r <= LLF_AES256_ROUNDS; r++)
+        k[r] = vld1q_u8((const uint8_t *)&roundKeys[4 * r]);
+}
+
+static uint8x16_t AesEncryptCe(const uint8x16_t *k, uint8x16_t b)
+{
+    uint32_t r;
+
+    for (r = 0; r < LLF_AES256_ROUNDS - 1; r++)
+        AES_CE_ROUND(b, k[r]);
+    b = vaeseq_u8(b, k[LLF_AES256_ROUNDS - 1]);
+    return veorq_u8(b, k[LLF_AES256_ROUNDS]);
+}
+
+void LLF_AES_Encrypt(const uint32_t *roundKeys, const uint8_t *in, uint8_t *out)
+{
+    uint8x16_t k[LLF_AES256_ROUNDS + 1];
+
+    AesLoadKeys(roundKeys, k);
+    vst1q_u8(out, AesEncryptCe(k, vld1q_u8(in)));
+}
+
+/* counter block from the two big endian halves */
+static uint8x16_t AesCtrBlock(uint64_t hi, uint64_t lo)
+{
+    return vrev64q_u8(vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(hi), vcreate_u64(lo))));
+}
+
+void LLF_AES_Ctr(const uint32_t *roundKeys, uint8_t *counter, uint8_t *out, size_t blocks)
+{
+    uint8x16_t k[LLF_AES256_ROUNDS + 1];
+    uint8x16_t b0, b1, b2, b3;
+    uint64_t hi = ((uint64_t)GETU32(counter) << 32) | GETU32(counter + 4);
+    uint64_t lo = ((uint64_t)GETU32(counter + 8) << 32) | GETU32(counter + 12);
+    uint32_t r;
+
+    AesLoadKeys(roundKeys, k);
+
+    for (; blocks >= 4; blocks -= 4, out += 64) {
+        /* V = V + 1 before every block; carry into the upper half on wrap */
+        hi += (++lo == 0);
+        b0 = AesCtrBlock(hi, lo);
+        hi += (++lo == 0);
+        b1 = AesCtrBlock(hi, lo);
+        hi += (++lo == 0);
+        b2 = AesCtrBlock(hi, lo);
+        hi += (++lo == 0);
+        b3 = AesCtrBlock(hi, lo);
+
+        for (r = 0; r < LLF_AES256_ROUNDS - 1; r++) {
+            AES_CE_ROUND(b0, k[r]);
+            AES_CE_ROUND(b1, k[r]);
+            AES_CE_ROUND(b2, k[r]);
+            AES_CE_ROUND(b3, k[r]);
+        }
+        b0 = veorq_u8(vaeseq_u8(b0, k[LLF_AES256_ROUNDS - 1]), k[LLF_AES256_ROUNDS]);
+        b1 = veorq_u8(vaeseq_u8(b1, k[LLF_AES256_ROUNDS - 1]), k[LLF_AES256_ROUNDS]);
+        b2 = veorq_u8(vaeseq_u8(b2, k[LLF_AES256_ROUNDS - 1]), k[LLF_AES256_ROUNDS]);
+        b3 = veorq_u8(vaeseq_u8(b3, k[LLF_AES256_ROUNDS - 1]), k[LLF_AES256_ROUNDS]);
+
+        vst1q_u8(out, b0);
+        vst1q_u8(out + 16, b1);
+        vst1q_u8(out + 32, b2);
+        vst1q_u8(out + 48, b3);
+    }
+
+    for (; blocks > 0; blocks--, out += 16) {
+        hi += (++lo == 0);
+        vst1q_u8(out, AesEncryptCe(k, AesCtrBlock(hi, lo)));
+    }
+
+    PUTU32(counter, (uint32_t)(hi >> 32));
+    PUTU32(counter + 4, (uint32_t)hi);
+    PUTU32(counter + 8, (uint32_t)(lo >> 32));
+    PUTU32(counter + 12, (uint32_t)lo);
+}
+
+#else /* LLF_AES_USE_CE */
+
+
+static const uint32_t gAesTe0[256] = {
+    0xc66363a5UL, 0xf87c7c84UL, 0xee777799UL, 0xf67b7b8dUL, 0xfff2f20dUL, 0xd66b6bbdUL,
+    0xde6f6fb1UL, 0x91c5c554UL, 0x60303050UL, 0x02010103UL, 0xce6767a9UL, 0x562b2b7dUL,
+    0xe7fefe19UL, 0xb5d7d762UL, 0x4dababe6UL, 0xec76769aUL, 0x8fcaca45UL, 0x1f82829dUL,
+    0x89c9c940UL, 0xfa7d7d87UL, 0xeffafa15UL, 0xb25959ebUL, 0x8e4747c9UL, 0xfbf0f00bUL,
+    0x41adadecUL, 0xb3d4d467UL, 0x5fa2a2fdUL, 0x45afafeaUL, 0x239c9cbfUL, 0x53a4a4f7UL,
+    0xe4727296UL, 0x9bc0c05bUL, 0x75b7b7c2UL, 0xe1fdfd1cUL, 0x3d9393aeUL, 0x4c26266aUL,
+    0x6c36365aUL, 0x7e3f3f41UL, 0xf5f7f702UL, 0x83cccc4fUL, 0x6834345cUL, 0x51a5a5f4UL,
+    0xd1e5e534UL, 0xf9f1f108UL, 0xe2717193UL, 0xabd8d873UL, 0x62313153UL, 0x2a15153fUL,
+    0x0804040cUL, 0x95c7c752UL, 0x46232365UL, 0x9dc3c35eUL, 0x30181828UL, 0x379696a1UL,
+    0x0a05050fUL, 0x2f9a9ab5UL, 0x0e070709UL, 0x24121236UL, 0x1b80809bUL, 0xdfe2e23dUL,
+    0xcdebeb26UL, 0x4e272769UL, 0x7fb2b2cdUL, 0xea75759fUL, 0x1209091bUL, 0x1d83839eUL,
+    0x582c2c74UL, 0x341a1a2eUL, 0x361b1b2dUL, 0xdc6e6eb2UL, 0xb45a5aeeUL, 0x5ba0a0fbUL,
+    0xa45252f6UL, 0x763b3b4dUL, 0xb7d6d661UL, 0x7db3b3ceUL, 0x5229297bUL, 0xdde3e33eUL,
+    0x5e2f2f71UL, 0x13848497UL, 0xa65353f5UL, 0xb9d1d168UL, 0x00000000UL, 0xc1eded2cUL,
+    0x40202060UL, 0xe3fcfc1fUL, 0x79b1b1c8UL, 0xb65b5bedUL, 0xd46a6abeUL, 0x8dcbcb46UL,
+    0x67bebed9UL, 0x7239394bUL, 0x944a4adeUL, 0x984c4cd4UL, 0xb05858e8UL, 0x85cfcf4aUL,
+    0xbbd0d06bUL, 0xc5efef2aUL, 0x4faaaae5UL, 0xedfbfb16UL, 0x864343c5UL, 0x9a4d4dd7UL,
+    0x66333355UL, 0x11858594UL, 0x8a4545cfUL, 0xe9f9f910UL, 0x04020206UL, 0xfe7f7f81UL,
+    0xa05050f0UL, 0x783c3c44UL, 0x259f9fbaUL, 0x4ba8a8e3UL, 0xa25151f3UL, 0x5da3a3feUL,
+    0x804040c0UL, 0x058f8f8aUL, 0x3f9292adUL, 0x219d9dbcUL, 0x70383848UL, 0xf1f5f504UL,
+    0x63bcbcdfUL, 0x77b6b6c1UL, 0xafdada75UL, 0x42212163UL, 0x20101030UL, 0xe5ffff1aUL,
+    0xfdf3f30eUL, 0xbfd2d26dUL, 0x81cdcd4cUL, 0x180c0c14UL, 0x26131335UL, 0xc3ecec2fUL,
+    0xbe5f5fe1UL, 0x359797a2UL, 0x884444ccUL, 0x2e171739UL, 0x93c4c457UL, 0x55a7a7f2UL,
+    0xfc7e7e82UL, 0x7a3d3d47UL, 0xc86464acUL, 0xba5d5de7UL, 0x3219192bUL, 0xe6737395UL,
+    0xc06060a0UL, 0x19818198UL, 0x9e4f4fd1UL, 0xa3dcdc7fUL, 0x44222266UL, 0x542a2a7eUL,
+    0x3b9090abUL, 0x0b888883UL, 0x8c4646caUL, 0xc7eeee29UL, 0x6bb8b8d3UL, 0x2814143cUL,
+    0xa7dede79UL, 0xbc5e5ee2UL, 0x160b0b1dUL, 0xaddbdb76UL, 0xdbe0e03bUL, 0x64323256UL,
+    0x743a3a4eUL, 0x140a0a1eUL, 0x924949dbUL, 0x0c06060aUL, 0x4824246cUL, 0xb85c5ce4UL,
+    0x9fc2c25dUL, 0xbdd3d36eUL, 0x43acacefUL, 0xc46262a6UL, 0x399191a8UL, 0x319595a4UL,
+    0xd3e4e437UL, 0xf279798bUL, 0xd5e7e732UL, 0x8bc8c843UL, 0x6e373759UL, 0xda6d6db7UL,
+    0x018d8d8cUL, 0xb1d5d564UL, 0x9c4e4ed2UL, 0x49a9a9e0UL, 0xd86c6cb4UL, 0xac5656faUL,
+    0xf3f4f407UL, 0xcfeaea25UL, 0xca6565afUL, 0xf47a7a8eUL, 0x47aeaee9UL, 0x10080818UL,
+    0x6fbabad5UL, 0xf0787888UL, 0x4a25256fUL, 0x5c2e2e72UL, 0x381c1c24UL, 0x57a6a6f1UL,
+    0x73b4b4c7UL, 0x97c6c651UL, 0xcbe8e823UL, 0xa1dddd7cUL, 0xe874749cUL, 0x3e1f1f21UL,
+    0x964b4bddUL, 0x61bdbddcUL, 0x0d8b8b86UL, 0x0f8a8a85UL, 0xe0707090UL, 0x7c3e3e42UL,
+    0x71b5b5c4UL, 0xcc6666aaUL, 0x904848d8UL, 0x06030305UL, 0xf7f6f601UL, 0x1c0e0e12UL,
+    0xc26161a3UL, 0x6a35355fUL, 0xae5757f9UL, 0x69b9b9d0UL, 0x17868691UL, 0x99c1c158UL,
+    0x3a1d1d27UL, 0x279e9eb9UL, 0xd9e1e138UL, 0xebf8f813UL, 0x2b9898b3UL, 0x22111133UL,
+    0xd26969bbUL, 0xa9d9d970UL, 0x078e8e89UL, 0x339494a7UL, 0x2d9b9bb6UL, 0x3c1e1e22UL,
+    0x15878792UL, 0xc9e9e920UL, 0x87cece49UL, 0xaa5555ffUL, 0x50282878UL, 0xa5dfdf7aUL,
+    0x038c8c8fUL, 0x59a1a1f8UL, 0x09898980UL, 0x1a0d0d17UL, 0x65bfbfdaUL, 0xd7e6e631UL,
+    0x844242c6UL, 0xd06868b8UL, 0x824141c3UL, 0x299999b0UL, 0x5a2d2d77UL, 0x1e0f0f11UL,
+    0x7bb0b0cbUL, 0xa85454fcUL, 0x6dbbbbd6UL, 0x2c16163aUL,
+};
+
+#define ROR8(x)     (((x) >> 8) | ((x) << 24))
+#define ROR16(x)    (((x) >> 16) | ((x) << 16))
+#define ROR24(x)    (((x) >> 24) | ((x) << 8))
+
+#define AES_TE0(x)  (gAesTe0[(x) & 0xff])
+#define AES_TE1(x)  ROR8(gAesTe0[(x) & 0xff])
+#define AES_TE2(x)  ROR16(gAesTe0[(x) & 0xff])
+#define AES_TE3(x)  ROR24(gAesTe0[(x) & 0xff])
+
+void LLF_AES_Encrypt(const uint32_t *roundKeys, const uint8_t *in, uint8_t *out)
+{
+    const uint32_t *rk = roundKeys;
+    uint32_t s0, s1, s2, s3;
+    uint32_t t0, t1, t2, t3;
+    uint32_t r;
+
+    s0 = GETU32(in) ^ rk[0];
+    s1 = GETU32(in + 4) ^ rk[1];
+    s2 = GETU32(in + 8) ^ rk[2];
+    s3 = GETU32(in + 12) ^ rk[3];
+
+    for (r = 1; r < LLF_AES256_ROUNDS; r++) {
+        rk += 4;
+        t0 = AES_TE0(s0 >> 24) ^ AES_TE1(s1 >> 16) ^ AES_TE2(s2 >> 8) ^ AES_TE3(s3) ^ rk[0];
+        t1 = AES_TE0(s1 >> 24) ^ AES_TE1(s2 >> 16) ^ AES_TE2(s3 >> 8) ^ AES_TE3(s0) ^ rk[1];
+        t2 = AES_TE0(s2 >> 24) ^ AES_TE1(s3 >> 16) ^ AES_TE2(s0 >> 8) ^ AES_TE3(s1) ^ rk[2];
+        t3 = AES_TE0(s3 >> 24) ^ AES_TE1(s0 >> 16) ^ AES_TE2(s1 >> 8) ^ AES_TE3(s2) ^ rk[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    /* last round: no MixColumns */
+    rk += 4;
+    t0 = ((uint32_t)gAesSbox[s0 >> 24] << 24) ^ ((uint32_t)gAesSbox[(s1 >> 16) & 0xff] << 16) ^
+         ((uint32_t)gAesSbox[(s2 >> 8) & 0xff] << 8) ^ (uint32_t)gAesSbox[s3 & 0xff] ^ rk[0];
+    t1 = ((uint32_t)gAesSbox[s1 >> 24] << 24) ^ ((uint32_t)gAesSbox[(s2 >> 16) & 0xff] << 16) ^
+         ((uint32_t)gAesSbox[(s3 >> 8) & 0xff] << 8) ^ (uint32_t)gAesSbox[s0 & 0xff] ^ rk[1];
+    t2 = ((uint32_t)gAesSbox[s2 >> 24] << 24) ^ ((uint32_t)gAesSbox[(s3 >> 16) & 0xff] << 16) ^
+         ((uint32_t)gAesSbox[(s0 >> 8) & 0xff] << 8) ^ (uint32_t)gAesSbox[s1 & 0xff] ^ rk[2];
+    t3 = ((uint32_t)gAesSbox[s3 >> 24] << 24) ^ ((uint32_t)gAesSbox[(s0 >> 16) & 0xff] << 16) ^
+         ((uint32_t)gAesSbox[(s1 >> 8) & 0xff] << 8) ^ (uint32_t)gAesSbox[s2 & 0xff] ^ rk[3];
+
+    PUTU32(out, t0);
+    PUTU32(out + 4, t1);
+    PUTU32(out + 8, t2);
+    PUTU32(out + 12, t3);
+}
+
+/* Increment the 128 bit big endian counter block */
+static void AesCtrInc(uint8_t *counter)
+{
+    int i;
+
+    for (i = 15; i >= 0; i--) {
+        if (++counter[i] != 0)
+            break;
+    }
+}
+
+void LLF_AES_Ctr(const uint32_t *roundKeys, uint8_t *counter, uint8_t *out, size_t blocks)
+{
+    for (; blocks > 0; blocks--, out += 16) {
+        AesCtrInc(counter);
+        LLF_AES_Encrypt(roundKeys, counter, out);
+    }
+}
+
+#endif /* LLF_AES_USE_CE */
@@ -0,0 +1,361 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  Asynchronous collection.
+
+  The collection of LLF_RND_CollectSource() as a state machine over a caller
+  owned context. Each block is collected the way LLF_RND_GetTrngSource() does
+  it: a TRNG restart on the fastest allowed ROSC, the EHRs of the block, the
+  health tests, and on a failure the next ROSC. TRNG90B restarts the source
+  for every EHR and runs the continuous tests on the block, after a start-up
+  test block that is not handed out; the FE mode reads two EHRs per block from
+  one start. Instead of CC_HalWaitInterrupt(), every CC_TrngAsyncPoll() reads
+  the ISR once and returns CC_TRNG_ASYNC_PENDING when no EHR is valid yet, so
+  the caller decides when to look again: on the RNG interrupt, or on a timer.
+*/
+
+#if (CC_CONFIG_TRNG_MODE == 1)
+extern CCError_t runContinuousTesting(uint32_t* pData, uint32_t sizeInBytes);
+#endif
+
+#if (CC_TRNG_ASYNC_WORK_WORDS * 4) < CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES_STARTUP
+#error "CC_TRNG_ASYNC_WORK_WORDS does not hold the start-up test block"
+#endif
+
+typedef enum {
+    ASYNC_STATE_IDLE = 0,
+    ASYNC_STATE_STARTUP,            /* waiting for an EHR of the start-up test block */
+    ASYNC_STATE_COLLECT,            /* waiting for an EHR of an output block */
+} AsyncState_t;
+
+/* the collection owning the TRNG; LLF_RND_CollectSource() refuses to run under it */
+CCTrngAsync_t *gAsyncOwner = NULL;
+
+static void AsyncParams(const CCTrngAsync_t *pCtx, CCRndParams_t *pParams)
+{
+    tztrng_memset((uint8_t *)pParams, 0, sizeof(*pParams));
+    pParams->SubSamplingRatio1 = pCtx->sampleCnt[0];
+    pParams->SubSamplingRatio2 = pCtx->sampleCnt[1];
+    pParams->SubSamplingRatio3 = pCtx->sampleCnt[2];
+    pParams->SubSamplingRatio4 = pCtx->sampleCnt[3];
+    pParams->RoscsAllowed = ((pCtx->sampleCnt[0] > 0) ? 0x1 : 0x0) |
+            ((pCtx->sampleCnt[1] > 0) ? 0x2 : 0x0) |
+            ((pCtx->sampleCnt[2] > 0) ? 0x4 : 0x0) |
+            ((pCtx->sampleCnt[3] > 0) ? 0x8 : 0x0);
+}
+
+/* Start the source on pCtx->rosc, or on the fastest ROSC on a restart */
+static CCError_t AsyncStartHw(CCTrngAsync_t *pCtx, CCBool_t isRestart)
+{
+    CCRndParams_t params;
+    CCRndState_t state = {0};
+    CCError_t err;
+
+    AsyncParams(pCtx, &params);
+    state.TrngProcesState = pCtx->procState;
+
+#if (CC_CONFIG_TRNG_MODE == 1)
+    LLF_RND_TurnOffTrng();
+#endif
+    err = LLF_RND_StartTrngHW(&state, &params, isRestart, &pCtx->rosc);
+    pCtx->procState = state.TrngProcesState;
+    pCtx->crngtErrors = 0;
+    pCtx->vnErrors = 0;
+
+    return err;
+}
+
+/* Restart the TRNG for a new block */
+static CCError_t AsyncStartBlock(CCTrngAsync_t *pCtx, AsyncState_t state, uint32_t blockBytes)
+{
+    pCtx->state = state;
+    pCtx->blockBytes = blockBytes;
+    pCtx->fill = 0;
+
+    return AsyncStartHw(pCtx, CC_TRUE);
+}
+
+/* The source was (re)started: nothing more is ready in this call */
+static CCError_t AsyncPending(CCError_t err)
+{
+    return (err == CC_OK) ? CC_TRNG_ASYNC_PENDING : err;
+}
+
+/* The ROSC failed the block: go on with the next one */
+static CCError_t AsyncNextRosc(CCTrngAsync_t *pCtx)
+{
+    CCError_t err;
+
+    TRNG_STAT_ADD(bytesDiscarded, pCtx->fill);
+    TRNG_STAT_INC(roscFailures[LLF_RND_TRNG_RoscMaskToNum(pCtx->rosc)]);
+    tztrng_secure_zero(pCtx->work, pCtx->fill);
+    pCtx->fill = 0;
+
+    /* update total processed ROSCs, clean started & not processed */
+    pCtx->procState |= ((pCtx->procState >> 8) & 0x00FF0000);
+    pCtx->procState &= 0x00FFFFFF;
+
+    if (pCtx->rosc == 0x8)
+        return LLF_RND_TRNG_GENERATION_NOT_COMPLETED_ERROR;
+
+    pCtx->rosc <<= 1;
+    TRNG_LOG_DEBUG("process with next rosc[%d]\n", (int)pCtx->rosc);
+    err = AsyncStartHw(pCtx, CC_FALSE);
+    if ((err == LLF_RND_TRNG_REQUIRED_ROSCS_NOT_ALLOWED_ERROR) && (pCtx->sampleCnt[0] | pCtx->sampleCnt[1] |
+            pCtx->sampleCnt[2] | pCtx->sampleCnt[3]))
+        err = LLF_RND_TRNG_GENERATION_NOT_COMPLETED_ERROR;
+
+    return err;
+}
+
+/* The block is complete: health tests, then hand it out or go on to the next ROSC.
+   CC_OK once the output is complete. */
+static CCError_t AsyncBlockDone(CCTrngAsync_t *pCtx)
+{
+    uint32_t n;
+
+#if (CC_CONFIG_TRNG_MODE == 1)
+    if (runContinuousTesting(pCtx->work, pCtx->blockBytes) != CC_OK) {
+#ifdef CC_CONFIG_TRNG_DRIFT_MONITOR
+        LLF_RND_DriftFailure(pCtx->rosc);
+#endif
+        return AsyncPending(AsyncNextRosc(pCtx));
+    }
+#ifdef CC_CONFIG_TRNG_DRIFT_MONITOR
+    LLF_RND_DriftUpdate(pCtx->rosc, pCtx->work, pCtx->blockBytes);
+#endif
+#endif
+    LLF_RND_TurnOffTrng();
+
+    if (pCtx->state == ASYNC_STATE_STARTUP) {
+        /* the start-up test data is not handed out */
+        TRNG_STAT_ADD(bytesDiscarded, pCtx->blockBytes);
+        n = 0;
+    } else {
+        n = (pCtx->remaining < pCtx->blockBytes) ? pCtx->remaining : pCtx->blockBytes;
+        tztrng_memcpy(pCtx->outPos, (uint8_t *)pCtx->work, n);
+        TRNG_STAT_ADD(bytesDiscarded, pCtx->blockBytes - n);
+        pCtx->outPos += n;
+        pCtx->remaining -= n;
+    }
+    tztrng_secure_zero(pCtx->work, pCtx->blockBytes);
+    pCtx->fill = 0;
+
+    if (pCtx->remaining == 0) {
+        pCtx->state = ASYNC_STATE_IDLE;
+        return CC_OK;
+    }
+
+#if (CC_CONFIG_TRNG_MODE == 1)
+    return AsyncPending(AsyncStartBlock(pCtx, ASYNC_STATE_COLLECT, CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES));
+#else
+    return AsyncPending(AsyncStartBlock(pCtx, ASYNC_STATE_COLLECT,
+                        LLF_RND_HW_DMA_EHR_SAMPLES_NUM_ON_FE_MODE * LLF_RND_HW_TRNG_EHR_WIDTH_IN_BYTES));
+#endif
+}
+
+/* One look at the ISR and the step it allows: CC_TRNG_ASYNC_PENDING until the
+   output is complete */
+static CCError_t AsyncStep(CCTrngAsync_t *pCtx)
+{
+    uint32_t isr, i;
+    uint32_t abort = 0;
+
+    isr = CC_HAL_READ_REGISTER(DX_RNG_ISR_REG_OFFSET);
+    TRNG_TELEMETRY_ISR(isr);
+
+    if (isr & 0x1 << DX_RNG_ISR_EHR_VALID_BIT_SHIFT) {
+#if (CC_CONFIG_TRNG_MODE == 0)
+        CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_ICR), 0xFFFFFFFF);
+#endif
+        for (i = 0; i < TRNG_EHR_SIZE; i++) {
+            pCtx->work[pCtx->fill / sizeof(uint32_t) + i] =
+                    CC_HAL_READ_REGISTER(DX_EHR_DATA_0_REG_OFFSET + (i * sizeof(uint32_t)));
+        }
+        TRNG_NOISE_TAP(&pCtx->work[pCtx->fill / sizeof(uint32_t)]);
+        TRNG_STAT_INC(ehrRead);
+        pCtx->fill += TRNG_EHR_SIZE * sizeof(uint32_t);
+        pCtx->crngtErrors = 0;
+        pCtx->vnErrors = 0;
+
+        if (pCtx->fill >= pCtx->blockBytes)
+            return AsyncBlockDone(pCtx);
+#if (CC_CONFIG_TRNG_MODE == 1)
+        /* TRNG90B: a fresh start for every EHR */
+        return AsyncPending(AsyncStartHw(pCtx, CC_FALSE));
+#else
+        CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, RNG_ISR));
+        return CC_TRNG_ASYNC_PENDING;
+#endif
+    }
+    TRNG_STAT_INC(pollSpins);
+
+    if (isr & 0x1 << DX_RNG_ISR_CRNGT_ERR_BIT_SHIFT) {
+        CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_ICR), 0x1 << DX_RNG_ISR_CRNGT_ERR_BIT_SHIFT);
+        TRNG_STAT_INC(crngtErrors);
+        if (++pCtx->crngtErrors >= TRNG_MAX_CRNGT_ERRORS)
+            abort = 1;
+    }
+
+#ifdef CHECK_VN_AC_ERR
+    if (isr & 0x1 << DX_RNG_ISR_VN_ERR_BIT_SHIFT) {
+        CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_ICR), 0x1 << DX_RNG_ISR_VN_ERR_BIT_SHIFT);
+        TRNG_STAT_INC(vnErrors);
+        if (++pCtx->vnErrors >= TRNG_MAX_VN_ERRORS)
+            abort = 1;
+    }
+
+    if (isr & 0x1 << DX_RNG_ISR_AUTOCORR_ERR_BIT_SHIFT) {
+        TRNG_STAT_INC(autocorrErrors);
+        abort = 1;
+    }
+#endif
+
+    if (abort) {
+        TRNG_LOG_DEBUG("EHR wait aborted, rosc[%d]\n", (int)pCtx->rosc);
+#if (CC_CONFIG_TRNG_MODE == 0)
+        CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_ICR), 0xFFFFFFFF);
+#endif
+        return AsyncPending(AsyncNextRosc(pCtx));
+    }
+
+    return CC_TRNG_ASYNC_PENDING;
+}
+
+/* Turn the TRNG off and hand it to the next collection */
+static void AsyncRelease(CCTrngAsync_t *pCtx)
+{
+    LLF_RND_TurnOffTrng();
+    tztrng_secure_zero(pCtx->work, sizeof(pCtx->work));
+    pCtx->state = ASYNC_STATE_IDLE;
+    gAsyncOwner = NULL;
+}
+
+/* End of the collection: release the TRNG, wipe the output on an error */
+static CCError_t AsyncFinish(CCTrngAsync_t *pCtx, CCError_t err)
+{
+    AsyncRelease(pCtx);
+    if (err != CC_OK) {
+        TRNG_LOG_DEBUG("async collection failed, err[0x%X]\n", (unsigned int)err);
+        tztrng_secure_zero(pCtx->outAddr, pCtx->outLen);
+        TRNG_STAT_INC(requestErrors);
+    } else {
+        TRNG_STAT_ADD(bytesDelivered, pCtx->outLen);
+    }
+
+    return err;
+}
+
+uint32_t CC_TrngAsyncStart(CCTrngAsync_t *pCtx, unsigned long rngRegBase, uint8_t *outAddr, size_t reqBits)
+{
+    CCRndParams_t params;
+    CCError_t err;
+
+    if ((NULL == pCtx) || (NULL == outAddr) || (0 == rngRegBase)) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+
+    TZTRNG_PAL_LOCK();
+    if (gAsyncOwner != NULL) {
+        TZTRNG_PAL_UNLOCK();
+        return CC_RND_TRNG_ASYNC_BUSY_ERROR;
+    }
+
+    tztrng_memset((uint8_t *)pCtx, 0, sizeof(*pCtx));
+    tztrng_memset((uint8_t *)&params, 0, sizeof(params));
+    TRNG_MMIO_REQUEST(reqBits);
+    TRNG_STAT_INC(requests);
+
+    err = RNG_PLAT_SetUserRngParameters(&params);
+    if (err != CC_OK) {
+        TRNG_STAT_INC(requestErrors);
+        TZTRNG_PAL_UNLOCK();
+        return err;
+    }
+    pCtx->sampleCnt[0] = params.SubSamplingRatio1;
+    pCtx->sampleCnt[1] = params.SubSamplingRatio2;
+    pCtx->sampleCnt[2] = params.SubSamplingRatio3;
+    pCtx->sampleCnt[3] = params.SubSamplingRatio4;
+    pCtx->rngRegBase = rngRegBase;
+    pCtx->outAddr = outAddr;
+    pCtx->outPos = outAddr;
+    pCtx->outLen = (uint32_t)((reqBits % 8) ? (reqBits / 8 + 1) : (reqBits / 8));
+    pCtx->remaining = pCtx->outLen;
+    gAsyncOwner = pCtx;
+    gCcRegBase = rngRegBase;
+
+    TRNG_STAT_INC(startupTests);
+#if (CC_CONFIG_TRNG_MODE == 1)
+    err = AsyncStartBlock(pCtx, ASYNC_STATE_STARTUP, CC_CONFIG_TRNG90B_AMOUNT_OF_BYTES_STARTUP);
+#else
+    /* no start-up test in FE mode */
+    err = AsyncStartBlock(pCtx, ASYNC_STATE_COLLECT,
+                          LLF_RND_HW_DMA_EHR_SAMPLES_NUM_ON_FE_MODE * LLF_RND_HW_TRNG_EHR_WIDTH_IN_BYTES);
+#endif
+    if (err != CC_OK)
+        err = AsyncFinish(pCtx, err);
+    TZTRNG_PAL_UNLOCK();
+
+    return err;
+}
+
+uint32_t CC_TrngAsyncPoll(CCTrngAsync_t *pCtx)
+{
+    CCError_t err;
+
+    if (NULL == pCtx)
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+
+    TZTRNG_PAL_LOCK();
+    if ((gAsyncOwner != pCtx) || (pCtx->state == ASYNC_STATE_IDLE)) {
+        TZTRNG_PAL_UNLOCK();
+        return CC_RND_TRNG_ASYNC_BUSY_ERROR;
+    }
+    gCcRegBase = pCtx->rngRegBase;
+
+    err = AsyncStep(pCtx);
+    if (err != CC_TRNG_ASYNC_PENDING)
+        err = AsyncFinish(pCtx, err);
+    TZTRNG_PAL_UNLOCK();
+
+    return err;
+}
+
+uint32_t CC_TrngAsyncCancel(CCTrngAsync_t *pCtx)
+{
+    if (NULL == pCtx)
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+
+    TZTRNG_PAL_LOCK();
+    if (gAsyncOwner != pCtx) {
+        TZTRNG_PAL_UNLOCK();
+        return CC_RND_TRNG_ASYNC_BUSY_ERROR;
+    }
+    gCcRegBase = pCtx->rngRegBase;
+    AsyncRelease(pCtx);
+    tztrng_secure_zero(pCtx->outAddr, pCtx->outLen);
+    tztrng_secure_zero(pCtx, sizeof(*pCtx));
+    TZTRNG_PAL_UNLOCK();
+
+    return CC_OK;
+}
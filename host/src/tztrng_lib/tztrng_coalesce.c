@@ -0,0 +1,251 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  Request coalescing scheduler.
+
+  Each CC_TrngGetSourceCoalesced() call queues a request on its own stack, in
+  priority order. There is no scheduler thread: a caller that finds no
+  collection in progress becomes the leader. It keeps the batch open until
+  CC_CONFIG_TRNG_COALESCE_WINDOW_US after the arrival of the oldest queued
+  request, unless the queue reaches CC_CONFIG_TRNG_COALESCE_THRESHOLD_BYTES or
+  holds a CC_TRNG_PRIO_HIGH request. It then takes whole requests from the head
+  of the queue, up to CC_CONFIG_TRNG_COALESCE_MAX_BATCH_BYTES, runs one
+  collection for all of them and scatters the output in queue order. The
+  others wait for their request to complete or to become the leader.
+
+  Requests that queued up during a collection are already past their window
+  when it ends, so under load the next batch starts right away.
+*/
+
+typedef struct CoalesceReq {
+    struct CoalesceReq *next;
+    unsigned long rngRegBase;
+    uint8_t *out;
+    uint32_t len;
+    CCTrngPriority_t prio;
+    uint32_t arrivalUs;
+    uint32_t done;
+    CCError_t err;
+} CoalesceReq_t;
+
+/* Scatter position of the batch being collected */
+typedef struct {
+    CoalesceReq_t *req;
+    uint32_t offset;
+} CoalesceScatter_t;
+
+typedef struct {
+    CoalesceReq_t *head;            /* queued requests, not yet in a batch */
+    uint32_t pendingBytes;
+    uint32_t busy;                  /* a leader is collecting */
+    CCTrngCoalesceStats_t stats;
+} CoalesceCtl_t;
+
+static CoalesceCtl_t gCoal;
+
+/* LLFRndSink_t: hand the data to the batch requests in order */
+static void CoalesceSink(void *ctx, const uint8_t *data, uint32_t len)
+{
+    CoalesceScatter_t *pScatter = (CoalesceScatter_t *)ctx;
+    uint32_t n;
+
+    while ((len > 0) && (pScatter->req != NULL)) {
+        n = pScatter->req->len - pScatter->offset;
+        if (n > len)
+            n = len;
+        tztrng_memcpy(pScatter->req->out + pScatter->offset, (uint8_t *)data, n);
+        pScatter->offset += n;
+        data += n;
+        len -= n;
+        if (pScatter->offset == pScatter->req->len) {
+            pScatter->req = pScatter->req->next;
+            pScatter->offset = 0;
+        }
+    }
+}
+
+/* Insert after the requests of the same or a higher class */
+static void CoalesceEnqueue(CoalesceReq_t *pReq)
+{
+    CoalesceReq_t **pp = &gCoal.head;
+
+    while ((*pp != NULL) && ((*pp)->prio >= pReq->prio))
+        pp = &(*pp)->next;
+    pReq->next = *pp;
+    *pp = pReq;
+    gCoal.pendingBytes += pReq->len;
+}
+
+static uint32_t CoalesceOldestUs(void)
+{
+    CoalesceReq_t *pReq;
+    uint32_t now = tztrng_pal_timeUs();
+    uint32_t oldest = now;
+
+    /* wrapping microseconds: compare ages, not times */
+    for (pReq = gCoal.head; pReq != NULL; pReq = pReq->next) {
+        if ((now - pReq->arrivalUs) > (now - oldest))
+            oldest = pReq->arrivalUs;
+    }
+
+    return oldest;
+}
+
+/* Leader, with the lock held: wait for the window, collect one batch, complete it */
+static void CoalesceLead(void)
+{
+    CoalesceReq_t *pBatch, *pLast, *pReq;
+    CoalesceScatter_t scatter;
+    uint32_t elapsed, batchBytes, count;
+    CCError_t Err;
+
+    gCoal.busy = 1;
+
+    /* gather until the window of the oldest request closes */
+    for (;;) {
+        if (gCoal.head->prio == CC_TRNG_PRIO_HIGH) {
+            gCoal.stats.priorityKicks++;
+            break;
+        }
+        if (gCoal.pendingBytes >= CC_CONFIG_TRNG_COALESCE_THRESHOLD_BYTES) {
+            gCoal.stats.thresholdReached++;
+            break;
+        }
+        elapsed = tztrng_pal_timeUs() - CoalesceOldestUs();
+        if (elapsed >= CC_CONFIG_TRNG_COALESCE_WINDOW_US) {
+            gCoal.stats.windowExpired++;
+            break;
+        }
+        tztrng_pal_syncWait(TZTRNG_PAL_EVT_COALESCE_KICK, CC_CONFIG_TRNG_COALESCE_WINDOW_US - elapsed);
+    }
+
+    /* whole requests from the head, for one register base */
+    pBatch = gCoal.head;
+    pLast = pBatch;
+    batchBytes = pBatch->len;
+    count = 1;
+    while ((pLast->next != NULL) && (pLast->next->rngRegBase == pBatch->rngRegBase) &&
+           (batchBytes + pLast->next->len <= CC_CONFIG_TRNG_COALESCE_MAX_BATCH_BYTES)) {
+        pLast = pLast->next;
+        batchBytes += pLast->len;
+        count++;
+    }
+    gCoal.head = pLast->next;
+    pLast->next = NULL;
+    gCoal.pendingBytes -= batchBytes;
+
+    gCoal.stats.batches++;
+    gCoal.stats.batchedBytes += batchBytes;
+    if (count > gCoal.stats.maxBatchRequests)
+        gCoal.stats.maxBatchRequests = count;
+    tztrng_pal_syncUnlock();
+
+    scatter.req = pBatch;
+    scatter.offset = 0;
+    Err = LLF_RND_CollectSource(pBatch->rngRegBase, (size_t)batchBytes * 8, CoalesceSink, &scatter);
+
+    tztrng_pal_syncLock();
+    for (pReq = pBatch; pReq != NULL; pReq = pReq->next) {
+        pReq->err = Err;
+        pReq->done = 1;
+    }
+    gCoal.busy = 0;
+    tztrng_pal_syncSignal(TZTRNG_PAL_EVT_COALESCE_DONE);
+}
+
+uint32_t CC_TrngGetSourceCoalesced(unsigned long rngRegBase, uint8_t *outAddr, size_t *outLen,
+                                   size_t reqBits, CCTrngPriority_t prio)
+{
+    CoalesceReq_t req;
+    size_t reqBytes = (reqBits % 8) ? (reqBits / 8 + 1) : (reqBits / 8);
+
+    if (NULL == outAddr || NULL == outLen) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+    if ((prio != CC_TRNG_PRIO_LOW) && (prio != CC_TRNG_PRIO_NORMAL) && (prio != CC_TRNG_PRIO_HIGH))
+        return CC_RND_TRNG_ILLEGAL_PRIORITY_ERROR;
+    if (rngRegBase == 0) {
+        TRNG_LOG_DEBUG("register base not initialized\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+
+    *outLen = reqBytes;
+    if (reqBytes == 0)
+        return CC_OK;
+    if (reqBytes > CC_MAX_UINT32_VAL / 8) {
+        *outLen = 0;
+        return LLF_RND_TRNG_ENTR_ESTIM_SIZE_EXCEED_ERROR;
+    }
+
+    tztrng_memset((uint8_t *)&req, 0, sizeof(req));
+    req.rngRegBase = rngRegBase;
+    req.out = outAddr;
+    req.len = (uint32_t)reqBytes;
+    req.prio = prio;
+
+    tztrng_pal_syncLock();
+    req.arrivalUs = tztrng_pal_timeUs();
+    gCoal.stats.requests++;
+    CoalesceEnqueue(&req);
+    if ((prio == CC_TRNG_PRIO_HIGH) || (gCoal.pendingBytes >= CC_CONFIG_TRNG_COALESCE_THRESHOLD_BYTES))
+        tztrng_pal_syncSignal(TZTRNG_PAL_EVT_COALESCE_KICK);
+
+    while (!req.done) {
+        if (!gCoal.busy)
+            CoalesceLead();
+        else
+            tztrng_pal_syncWait(TZTRNG_PAL_EVT_COALESCE_DONE, CC_CONFIG_TRNG_COALESCE_WINDOW_US * 4);
+    }
+    if (req.err != CC_OK)
+        gCoal.stats.requestErrors++;
+    tztrng_pal_syncUnlock();
+
+    if (req.err != CC_OK) {
+        /* memset 0 to outAddr for security concern */
+        tztrng_secure_zero(outAddr, reqBytes);
+        *outLen = 0;
+    }
+
+    return req.err;
+}
+
+uint32_t CC_TrngGetCoalesceStats(CCTrngCoalesceStats_t *pStats)
+{
+    if (NULL == pStats) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+
+    tztrng_pal_syncLock();
+    *pStats = gCoal.stats;
+    tztrng_pal_syncUnlock();
+
+    return CC_OK;
+}
+
+void CC_TrngResetCoalesceStats(void)
+{
+    tztrng_pal_syncLock();
+    tztrng_memset((uint8_t *)&gCoal.stats, 0, sizeof(gCoal.stats));
+    tztrng_pal_syncUnlock();
+}
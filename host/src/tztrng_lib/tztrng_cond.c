@@ -0,0 +1,174 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  NIST SP 800-90B vetted conditioning component.
+
+  The health-tested TRNG data is streamed from LLF_RND_CollectSource() straight
+  into the conditioning function. Each output block of n_out bits is computed
+  over the data holding n_out + 64 bits of min-entropy (SP 800-90C full entropy
+  condition) at CC_CONFIG_TRNG_COND_ENTROPY_RATE bits per 1024 data bits:
+  - SHA-256:          256 bit blocks, 640 data bits each at entropy per bit = 0.5,
+  - AES-256 CBC-MAC:  128 bit blocks, 384 data bits each at entropy per bit = 0.5
+                      (a whole number of AES blocks, zero IV).
+  The last block is truncated to the request.
+*/
+
+#define COND_SHA256_OUT_BITS    (LLF_SHA256_DIGEST_BYTES * 8)
+#define COND_CBC_MAC_OUT_BITS   128
+#define COND_AES_BLOCK_BYTES    LLF_COND_AES_BLOCK_BYTES
+/* min-entropy above the output length for full entropy output */
+#define COND_ENTROPY_MARGIN_BITS 64
+
+/* data bytes holding (outBits + 64) bits of min-entropy */
+#define COND_DATA_BYTES(outBits) \
+    ((((outBits) + COND_ENTROPY_MARGIN_BITS) * 1024UL + CC_CONFIG_TRNG_COND_ENTROPY_RATE * 8UL - 1) / \
+     (CC_CONFIG_TRNG_COND_ENTROPY_RATE * 8UL))
+
+/* Any fixed key may be used; it need not be secret. SHA-256("TZ-TRNG CBC-MAC conditioning key") */
+static const uint8_t gCondCbcMacKey[32] = {
+    0x10, 0x81, 0xe2, 0xe1, 0x68, 0x58, 0x60, 0xc9, 0x77, 0x63, 0x88, 0x27, 0x7d, 0xaa, 0xaf, 0x8d,
+    0x3a, 0xe9, 0xb7, 0x9c, 0x95, 0x9c, 0x22, 0x74, 0x9f, 0x8d, 0x41, 0x1f, 0x91, 0xfa, 0xe1, 0x39,
+};
+
+static void CondCbcMacAbsorb(LLFCondCtx_t *pCtx, const uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+
+    while (len-- > 0) {
+        pCtx->block[pCtx->blockFill++] = *data++;
+        if (pCtx->blockFill < COND_AES_BLOCK_BYTES)
+            continue;
+        for (i = 0; i < COND_AES_BLOCK_BYTES; i++)
+            pCtx->chain[i] ^= pCtx->block[i];
+        LLF_AES_Encrypt(pCtx->roundKeys, pCtx->chain, pCtx->chain);
+        pCtx->blockFill = 0;
+    }
+}
+
+/* Output the current block and start the next one */
+static void CondEmit(LLFCondCtx_t *pCtx)
+{
+    uint8_t digest[LLF_SHA256_DIGEST_BYTES];
+    const uint8_t *block;
+    size_t n;
+
+    if (pCtx->func == CC_TRNG_COND_SHA256) {
+        LLF_SHA256_Final(&pCtx->sha, digest);
+        LLF_SHA256_Init(&pCtx->sha);
+        block = digest;
+        n = LLF_SHA256_DIGEST_BYTES;
+    } else {
+        block = pCtx->chain;
+        n = COND_AES_BLOCK_BYTES;
+    }
+
+    if (n > pCtx->outRemain)
+        n = pCtx->outRemain;
+    tztrng_memcpy(pCtx->out, (uint8_t *)block, n);
+    pCtx->out += n;
+    pCtx->outRemain -= n;
+
+    tztrng_secure_zero(digest, sizeof(digest));
+    tztrng_memset(pCtx->chain, 0, sizeof(pCtx->chain));
+    pCtx->dataFill = 0;
+}
+
+void LLF_COND_Sink(void *ctx, const uint8_t *data, uint32_t len)
+{
+    LLFCondCtx_t *pCtx = (LLFCondCtx_t *)ctx;
+    uint32_t n;
+
+    while (len > 0) {
+        n = pCtx->dataBytes - pCtx->dataFill;
+        if (n > len)
+            n = len;
+
+        if (pCtx->func == CC_TRNG_COND_SHA256)
+            LLF_SHA256_Update(&pCtx->sha, data, n);
+        else
+            CondCbcMacAbsorb(pCtx, data, n);
+
+        pCtx->dataFill += n;
+        data += n;
+        len -= n;
+        if (pCtx->dataFill == pCtx->dataBytes)
+            CondEmit(pCtx);
+    }
+}
+
+CCError_t LLF_COND_Init(LLFCondCtx_t *pCtx, CCTrngCondFunc_t condFunc, uint8_t *out, size_t outLen)
+{
+    tztrng_memset((uint8_t *)pCtx, 0, sizeof(LLFCondCtx_t));
+    pCtx->func = condFunc;
+    pCtx->out = out;
+    pCtx->outRemain = outLen;
+
+    switch (condFunc) {
+    case CC_TRNG_COND_SHA256:
+        pCtx->outBits = COND_SHA256_OUT_BITS;
+        pCtx->dataBytes = COND_DATA_BYTES(COND_SHA256_OUT_BITS);
+        LLF_SHA256_Init(&pCtx->sha);
+        break;
+    case CC_TRNG_COND_CBC_MAC:
+        pCtx->outBits = COND_CBC_MAC_OUT_BITS;
+        /* CBC-MAC input is a whole number of blocks */
+        pCtx->dataBytes = (COND_DATA_BYTES(COND_CBC_MAC_OUT_BITS) + COND_AES_BLOCK_BYTES - 1) &
+                          ~(uint32_t)(COND_AES_BLOCK_BYTES - 1);
+        LLF_AES_SetKey256(pCtx->roundKeys, gCondCbcMacKey);
+        break;
+    default:
+        return CC_RND_TRNG_ILLEGAL_COND_FUNC_ERROR;
+    }
+
+    return CC_OK;
+}
+
+uint32_t CC_TrngGetFullEntropy(unsigned long rngRegBase, CCTrngCondFunc_t condFunc,
+                               uint8_t *outAddr, size_t *outLen, size_t reqBits)
+{
+    CCError_t Err;
+    LLFCondCtx_t ctx;
+    size_t outBytes = (reqBits % 8) ? (reqBits / 8 + 1) : (reqBits / 8);
+    size_t blocks;
+
+    if (NULL == outAddr || NULL == outLen) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+
+    Err = LLF_COND_Init(&ctx, condFunc, outAddr, outBytes);
+    if (Err != CC_OK)
+        return Err;
+
+    *outLen = outBytes;
+    blocks = (reqBits + ctx.outBits - 1) / ctx.outBits;
+
+    Err = LLF_RND_CollectSource(rngRegBase, blocks * ctx.dataBytes * 8, LLF_COND_Sink, &ctx);
+    if (Err != CC_OK) {
+        tztrng_secure_zero(outAddr, *outLen);
+        *outLen = 0;
+    }
+
+    tztrng_secure_zero(&ctx, sizeof(ctx));
+
+    return Err;
+}
@@ -0,0 +1,407 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  NIST SP 800-90A CTR_DRBG, AES-256, with the block cipher derivation function.
+
+  seedlen = 384 bits (Key || V), ctr_len = 128 bits. The LLF_DRBG_* functions
+  are the mechanism with the entropy input passed in; they are shared by the
+  CC_Drbg* API, which takes the entropy input and the nonce from the TRNG, and
+  by the known answer tests. The TRNG data is full entropy from
+  CC_TrngGetFullEntropy() when the conditioning component is built in, raw
+  CC_TrngGetSource() data at entropy per bit = 0.5 otherwise.
+
+  The known answer vector below was cross-generated with the OpenSSL 3
+  CTR-DRBG (AES-256-CTR, derivation function, prediction resistance).
+*/
+
+#define DRBG_KEY_BYTES      32
+#define DRBG_SEED_BYTES     48      /* seedlen */
+#define DRBG_SEED_BLOCKS    (DRBG_SEED_BYTES / CC_DRBG_BLOCK_BYTES)
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+} DrbgSeg_t;
+
+/* BCC of the derivation function, computed for the three IVs at once while the
+   input string is streamed in */
+typedef struct {
+    uint32_t roundKeys[LLF_AES256_ROUND_KEY_WORDS];
+    uint8_t chain[DRBG_SEED_BLOCKS][CC_DRBG_BLOCK_BYTES];
+    uint8_t block[CC_DRBG_BLOCK_BYTES];
+    uint32_t fill;
+} DrbgDf_t;
+
+static uint32_t gDrbgSelfTestPassed = 0;
+
+static const uint8_t gDrbgKatEntropy[32] = {
+    0xcd, 0x74, 0xe4, 0x83, 0xf7, 0xf9, 0x12, 0xe4, 0xe1, 0xd7, 0xd3, 0x83, 0xe1, 0x82, 0x9c, 0x7e,
+    0x6d, 0xab, 0x49, 0xa9, 0xae, 0xe2, 0x9f, 0xd2, 0x44, 0xbc, 0x1b, 0xad, 0x40, 0x1d, 0x84, 0x3f,
+};
+
+static const uint8_t gDrbgKatNonce[16] = {
+    0x0b, 0x9f, 0x4a, 0x93, 0xa6, 0xa8, 0x96, 0xdc, 0x63, 0xd3, 0xfd, 0x5e, 0xa2, 0x0b, 0xf9, 0x65,
+};
+
+static const uint8_t gDrbgKatPers[32] = {
+    0x92, 0xfd, 0x3c, 0x8b, 0x0a, 0xc6, 0xde, 0x8d, 0x80, 0xff, 0x61, 0x2b, 0xca, 0xe2, 0x89, 0xba,
+    0xfd, 0x41, 0x86, 0x16, 0x04, 0x06, 0x16, 0xb2, 0xfe, 0x20, 0xd0, 0x68, 0x8b, 0x20, 0x29, 0x11,
+};
+
+static const uint8_t gDrbgKatEntropyPr1[32] = {
+    0x37, 0xc3, 0x1e, 0xa3, 0xf6, 0x1f, 0x1b, 0xbe, 0x45, 0x57, 0x78, 0x1b, 0x7f, 0x59, 0x02, 0xa7,
+    0x6c, 0xd9, 0xe0, 0x0f, 0xe0, 0x35, 0x56, 0x5f, 0x60, 0x4f, 0x4b, 0xe8, 0xac, 0x23, 0x50, 0x20,
+};
+
+static const uint8_t gDrbgKatAdd1[32] = {
+    0x37, 0x24, 0x51, 0x12, 0xb6, 0x00, 0x51, 0xd1, 0xf8, 0x9c, 0x8b, 0xbd, 0xbb, 0xd4, 0x39, 0xc6,
+    0xe2, 0x7c, 0xe1, 0x6c, 0xa8, 0xdf, 0xd6, 0xdd, 0xfd, 0x14, 0xca, 0x43, 0x3e, 0x06, 0xf7, 0xa2,
+};
+
+static const uint8_t gDrbgKatEntropyPr2[32] = {
+    0x95, 0x8a, 0x49, 0x48, 0x8e, 0xaa, 0xd7, 0xa6, 0xa4, 0x2e, 0x16, 0xa8, 0x42, 0xfb, 0x8e, 0x06,
+    0xf7, 0x48, 0x41, 0xc4, 0x40, 0xdc, 0x7c, 0x3f, 0x53, 0x07, 0x78, 0x20, 0x00, 0x5a, 0xba, 0x49,
+};
+
+static const uint8_t gDrbgKatAdd2[32] = {
+    0x90, 0x63, 0xc9, 0xad, 0xd6, 0xf4, 0x0a, 0x49, 0x32, 0x14, 0x46, 0x6e, 0xdd, 0xa2, 0x7b, 0x84,
+    0x1f, 0x8a, 0x2d, 0xfc, 0xcb, 0xb6, 0x86, 0xbb, 0xeb, 0xc2, 0x07, 0xd3, 0x50, 0x9e, 0x1c, 0x2d,
+};
+
+static const uint8_t gDrbgKatReturned[64] = {
+    0x0d, 0x1c, 0x1b, 0xa8, 0xe1, 0x4f, 0xb5, 0x57, 0x23, 0x3e, 0x0c, 0x11, 0x0b, 0xd3, 0xb2, 0x81,
+    0x87, 0xf8, 0x3f, 0x42, 0x5a, 0xe6, 0xb7, 0xd1, 0x42, 0xc6, 0x11, 0x69, 0x84, 0x09, 0x5a, 0x05,
+    0x97, 0x37, 0xf0, 0xf6, 0x8a, 0x86, 0xc2, 0xb1, 0xa9, 0x17, 0x77, 0x40, 0xdb, 0xa4, 0xe4, 0xd5,
+    0x3c, 0x31, 0xe6, 0x8c, 0xa7, 0x04, 0x24, 0x81, 0xe2, 0x00, 0x05, 0xd6, 0x1f, 0xfa, 0x9b, 0x9e,
+};
+
+static void DrbgDfAbsorb(DrbgDf_t *pDf, const uint8_t *data, size_t len)
+{
+    uint32_t i, j;
+
+    while (len-- > 0) {
+        pDf->block[pDf->fill++] = *data++;
+        if (pDf->fill < CC_DRBG_BLOCK_BYTES)
+            continue;
+
+        for (j = 0; j < DRBG_SEED_BLOCKS; j++) {
+            for (i = 0; i < CC_DRBG_BLOCK_BYTES; i++)
+                pDf->chain[j][i] ^= pDf->block[i];
+            LLF_AES_Encrypt(pDf->roundKeys, pDf->chain[j], pDf->chain[j]);
+        }
+        pDf->fill = 0;
+    }
+}
+
+/* Block_Cipher_df (SP 800-90A 10.3.2) of the concatenated segments, 48 bytes out */
+static void DrbgDf(const DrbgSeg_t *pSegs, uint32_t numSegs, uint8_t *out)
+{
+    DrbgDf_t df;
+    uint8_t temp[DRBG_SEED_BYTES];
+    uint8_t hdr[8];
+    uint32_t inputLen = 0;
+    uint32_t i;
+    const uint8_t pad = 0x80;
+    const uint8_t zero = 0;
+
+    for (i = 0; i < numSegs; i++)
+        inputLen += (uint32_t)pSegs[i].len;
+
+    /* K = leftmost keylen bits of 0x00010203...1F */
+    for (i = 0; i < DRBG_KEY_BYTES; i++)
+        temp[i] = (uint8_t)i;
+    LLF_AES_SetKey256(df.roundKeys, temp);
+
+    /* chaining value after the first block, IV = i || 0^96 */
+    tztrng_memset((uint8_t *)df.chain, 0, sizeof(df.chain));
+    for (i = 0; i < DRBG_SEED_BLOCKS; i++) {
+        df.chain[i][3] = (uint8_t)i;
+        LLF_AES_Encrypt(df.roundKeys, df.chain[i], df.chain[i]);
+    }
+    df.fill = 0;
+
+    /* S = L || N || input_string || 0x80, zero padded to the block length */
+    hdr[0] = (uint8_t)(inputLen >> 24);
+    hdr[1] = (uint8_t)(inputLen >> 16);
+    hdr[2] = (uint8_t)(inputLen >> 8);
+    hdr[3] = (uint8_t)inputLen;
+    hdr[4] = 0;
+    hdr[5] = 0;
+    hdr[6] = 0;
+    hdr[7] = DRBG_SEED_BYTES;
+    DrbgDfAbsorb(&df, hdr, sizeof(hdr));
+    for (i = 0; i < numSegs; i++)
+        DrbgDfAbsorb(&df, pSegs[i].data, pSegs[i].len);
+    DrbgDfAbsorb(&df, &pad, 1);
+    while (df.fill != 0)
+        DrbgDfAbsorb(&df, &zero, 1);
+
+    /* K = temp[0:32], X = temp[32:48], output X = E(K, X) three times */
+    tztrng_memcpy(temp, (uint8_t *)df.chain, DRBG_SEED_BYTES);
+    LLF_AES_SetKey256(df.roundKeys, temp);
+    LLF_AES_Encrypt(df.roundKeys, temp + DRBG_KEY_BYTES, out);
+    for (i = 1; i < DRBG_SEED_BLOCKS; i++)
+        LLF_AES_Encrypt(df.roundKeys, out + (i - 1) * CC_DRBG_BLOCK_BYTES, out + i * CC_DRBG_BLOCK_BYTES);
+
+    tztrng_secure_zero(&df, sizeof(df));
+    tztrng_secure_zero(temp, sizeof(temp));
+}
+
+/* CTR_DRBG_Update (SP 800-90A 10.2.1.2); provided is seedlen bytes or NULL for zeros */
+static void DrbgUpdate(CCDrbgState_t *pState, const uint8_t *provided)
+{
+    uint8_t temp[DRBG_SEED_BYTES];
+    uint32_t i;
+
+    LLF_AES_Ctr(pState->roundKeys, pState->v, temp, DRBG_SEED_BLOCKS);
+    if (provided != NULL) {
+        for (i = 0; i < DRBG_SEED_BYTES; i++)
+            temp[i] ^= provided[i];
+    }
+
+    LLF_AES_SetKey256(pState->roundKeys, temp);
+    tztrng_memcpy(pState->v, temp + DRBG_KEY_BYTES, CC_DRBG_BLOCK_BYTES);
+    tztrng_secure_zero(temp, sizeof(temp));
+}
+
+void LLF_DRBG_Instantiate(CCDrbgState_t *pState,
+                          const uint8_t *entropy, size_t entropyLen,
+                          const uint8_t *nonce, size_t nonceLen,
+                          const uint8_t *pers, size_t persLen)
+{
+    DrbgSeg_t segs[3];
+    uint8_t seed[DRBG_SEED_BYTES];
+
+    segs[0].data = entropy;
+    segs[0].len = entropyLen;
+    segs[1].data = nonce;
+    segs[1].len = nonceLen;
+    segs[2].data = pers;
+    segs[2].len = persLen;
+
+    /* Key = 0^keylen, V = 0^blocklen */
+    tztrng_memset(pState->v, 0, CC_DRBG_BLOCK_BYTES);
+    tztrng_memset(seed, 0, DRBG_KEY_BYTES);
+    LLF_AES_SetKey256(pState->roundKeys, seed);
+    DrbgDf(segs, 3, seed);
+    DrbgUpdate(pState, seed);
+
+    pState->reseedCounter = 1;
+    pState->instantiated = 1;
+    tztrng_secure_zero(seed, sizeof(seed));
+}
+
+void LLF_DRBG_Reseed(CCDrbgState_t *pState,
+                     const uint8_t *entropy, size_t entropyLen,
+                     const uint8_t *addInput, size_t addInputLen)
+{
+    DrbgSeg_t segs[2];
+    uint8_t seed[DRBG_SEED_BYTES];
+
+    segs[0].data = entropy;
+    segs[0].len = entropyLen;
+    segs[1].data = addInput;
+    segs[1].len = addInputLen;
+    DrbgDf(segs, 2, seed);
+    DrbgUpdate(pState, seed);
+
+    pState->reseedCounter = 1;
+    tztrng_secure_zero(seed, sizeof(seed));
+}
+
+void LLF_DRBG_Generate(CCDrbgState_t *pState,
+                       uint8_t *out, size_t outLen,
+                       const uint8_t *addInput, size_t addInputLen)
+{
+    DrbgSeg_t seg;
+    uint8_t addSeed[DRBG_SEED_BYTES];
+    uint8_t last[CC_DRBG_BLOCK_BYTES];
+    const uint8_t *provided = NULL;
+    size_t blocks = outLen / CC_DRBG_BLOCK_BYTES;
+    size_t rem = outLen % CC_DRBG_BLOCK_BYTES;
+
+    if (addInputLen > 0) {
+        seg.data = addInput;
+        seg.len = addInputLen;
+        DrbgDf(&seg, 1, addSeed);
+        DrbgUpdate(pState, addSeed);
+        provided = addSeed;
+    }
+
+    /* the keystream is written straight into the caller's buffer */
+    LLF_AES_Ctr(pState->roundKeys, pState->v, out, blocks);
+    if (rem > 0) {
+        LLF_AES_Ctr(pState->roundKeys, pState->v, last, 1);
+        tztrng_memcpy(out + blocks * CC_DRBG_BLOCK_BYTES, last, rem);
+        tztrng_secure_zero(last, sizeof(last));
+    }
+
+    DrbgUpdate(pState, provided);
+    pState->reseedCounter++;
+
+    if (provided != NULL)
+        tztrng_secure_zero(addSeed, sizeof(addSeed));
+}
+
+/* Full entropy from the conditioning component when built in, raw TRNG data otherwise */
+static uint32_t DrbgGetEntropy(unsigned long rngRegBase, uint8_t *buf, size_t *len, size_t reqBits)
+{
+    uint32_t Err;
+
+#ifdef CC_CONFIG_TRNG_CONDITIONING
+    Err = CC_TrngGetFullEntropy(rngRegBase, CC_TRNG_COND_SHA256, buf, len, reqBits);
+#else
+    Err = CC_TrngGetSource(rngRegBase, buf, len, reqBits);
+#endif
+    if (Err != CC_OK)
+        TRNG_LOG_DEBUG("entropy source failed, err[0x%X]\n", (unsigned int)Err);
+
+    return Err;
+}
+
+/* Reseed from the TRNG: LLF_DRBG_ENTROPY_INPUT_BITS of entropy input */
+static uint32_t DrbgReseedFromTrng(CCDrbgState_t *pState, const uint8_t *addInput, size_t addInputLen)
+{
+    uint32_t Err;
+    uint8_t entropy[LLF_DRBG_ENTROPY_INPUT_BITS / 8];
+    size_t entropyLen = 0;
+
+    Err = DrbgGetEntropy(pState->rngRegBase, entropy, &entropyLen, LLF_DRBG_ENTROPY_INPUT_BITS);
+    if (Err != CC_OK)
+        return Err;
+
+    LLF_DRBG_Reseed(pState, entropy, entropyLen, addInput, addInputLen);
+    tztrng_secure_zero(entropy, sizeof(entropy));
+
+    return CC_OK;
+}
+
+uint32_t CC_DrbgSelfTest(void)
+{
+    CCDrbgState_t state;
+    uint8_t out[sizeof(gDrbgKatReturned)];
+    uint32_t Err = CC_OK;
+
+    /* instantiate, then two generate calls with prediction resistance: each one
+       reseeds with the additional input and generates without it */
+    LLF_DRBG_Instantiate(&state, gDrbgKatEntropy, sizeof(gDrbgKatEntropy),
+                         gDrbgKatNonce, sizeof(gDrbgKatNonce),
+                         gDrbgKatPers, sizeof(gDrbgKatPers));
+    LLF_DRBG_Reseed(&state, gDrbgKatEntropyPr1, sizeof(gDrbgKatEntropyPr1),
+                    gDrbgKatAdd1, sizeof(gDrbgKatAdd1));
+    LLF_DRBG_Generate(&state, out, sizeof(out), NULL, 0);
+    LLF_DRBG_Reseed(&state, gDrbgKatEntropyPr2, sizeof(gDrbgKatEntropyPr2),
+                    gDrbgKatAdd2, sizeof(gDrbgKatAdd2));
+    LLF_DRBG_Generate(&state, out, sizeof(out), NULL, 0);
+
+    if (memcmp(out, gDrbgKatReturned, sizeof(out)) != 0) {
+        TRNG_LOG_DEBUG("CTR_DRBG known answer test failed\n");
+        Err = CC_RND_CPRNG_TEST_FAIL_ERROR;
+    }
+
+    CC_DrbgUninstantiate(&state);
+    tztrng_secure_zero(out, sizeof(out));
+    gDrbgSelfTestPassed = (Err == CC_OK);
+
+    return Err;
+}
+
+uint32_t CC_DrbgInstantiate(CCDrbgState_t *pState, unsigned long rngRegBase,
+                            const uint8_t *pers, size_t persLen, uint32_t predictionResistance)
+{
+    uint32_t Err;
+    uint8_t seedBuf[(LLF_DRBG_ENTROPY_INPUT_BITS + LLF_DRBG_NONCE_BITS) / 8];
+    size_t seedLen = 0;
+
+    if (NULL == pState || (NULL == pers && persLen > 0)) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+    if (persLen > CC_DRBG_MAX_INPUT_BYTES)
+        return CC_RND_DRBG_ILLEGAL_LENGTH_ERROR;
+
+    tztrng_memset((uint8_t *)pState, 0, sizeof(CCDrbgState_t));
+
+    if (!gDrbgSelfTestPassed) {
+        Err = CC_DrbgSelfTest();
+        if (Err != CC_OK)
+            return Err;
+    }
+
+    /* entropy input and nonce in one request */
+    Err = DrbgGetEntropy(rngRegBase, seedBuf, &seedLen, LLF_DRBG_ENTROPY_INPUT_BITS + LLF_DRBG_NONCE_BITS);
+    if (Err != CC_OK)
+        return Err;
+
+    LLF_DRBG_Instantiate(pState, seedBuf, LLF_DRBG_ENTROPY_INPUT_BITS / 8,
+                         seedBuf + LLF_DRBG_ENTROPY_INPUT_BITS / 8, LLF_DRBG_NONCE_BITS / 8,
+                         pers, persLen);
+    pState->rngRegBase = rngRegBase;
+    pState->predictionResistance = (predictionResistance != 0);
+    tztrng_secure_zero(seedBuf, sizeof(seedBuf));
+
+    return CC_OK;
+}
+
+uint32_t CC_DrbgReseed(CCDrbgState_t *pState, const uint8_t *addInput, size_t addInputLen)
+{
+    if (NULL == pState || (NULL == addInput && addInputLen > 0))
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    if (!pState->instantiated)
+        return CC_RND_DRBG_NOT_INSTANTIATED_ERROR;
+    if (addInputLen > CC_DRBG_MAX_INPUT_BYTES)
+        return CC_RND_DRBG_ILLEGAL_LENGTH_ERROR;
+
+    return DrbgReseedFromTrng(pState, addInput, addInputLen);
+}
+
+uint32_t CC_DrbgGenerate(CCDrbgState_t *pState, uint8_t *out, size_t outLen,
+                         const uint8_t *addInput, size_t addInputLen)
+{
+    uint32_t Err;
+
+    if (NULL == pState || NULL == out || (NULL == addInput && addInputLen > 0))
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    if (!pState->instantiated)
+        return CC_RND_DRBG_NOT_INSTANTIATED_ERROR;
+    if (outLen > CC_DRBG_MAX_REQUEST_BYTES || addInputLen > CC_DRBG_MAX_INPUT_BYTES)
+        return CC_RND_DRBG_ILLEGAL_LENGTH_ERROR;
+
+    /* SP 800-90A 9.3.1: the additional input goes into the reseed, not into the generate */
+    if (pState->predictionResistance || pState->reseedCounter > CC_CONFIG_DRBG_RESEED_INTERVAL) {
+        Err = DrbgReseedFromTrng(pState, addInput, addInputLen);
+        if (Err != CC_OK)
+            return Err;
+        addInput = NULL;
+        addInputLen = 0;
+    }
+
+    LLF_DRBG_Generate(pState, out, outLen, addInput, addInputLen);
+
+    return CC_OK;
+}
+
+void CC_DrbgUninstantiate(CCDrbgState_t *pState)
+{
+    if (pState != NULL)
+        tztrng_secure_zero(pState, sizeof(CCDrbgState_t));
+}
@@ -20,15 +20,23 @@
 
 unsigned long gCcRegBase = 0;
 
-static CCError_t RNG_PLAT_SetUserRngParameters(CCRndParams_t *pTrngParams)
+CCError_t RNG_PLAT_SetUserRngParameters(CCRndParams_t *pTrngParams)
 {
     CCError_t  error = CC_OK;
 
     /* Set TRNG parameters */
+#ifdef CC_CONFIG_TRNG_DRIFT_MONITOR
+    /* sample counts tuned by the drift monitor within the characterization bounds */
+    pTrngParams->SubSamplingRatio1 = LLF_RND_DriftGetSampleCnt(LLF_RND_HW_TRNG_ROSC0_NUM);
+    pTrngParams->SubSamplingRatio2 = LLF_RND_DriftGetSampleCnt(LLF_RND_HW_TRNG_ROSC1_NUM);
+    pTrngParams->SubSamplingRatio3 = LLF_RND_DriftGetSampleCnt(LLF_RND_HW_TRNG_ROSC2_NUM);
+    pTrngParams->SubSamplingRatio4 = LLF_RND_DriftGetSampleCnt(LLF_RND_HW_TRNG_ROSC3_NUM);
+#else
     pTrngParams->SubSamplingRatio1 = CC_CONFIG_SAMPLE_CNT_ROSC_1;
     pTrngParams->SubSamplingRatio2 = CC_CONFIG_SAMPLE_CNT_ROSC_2;
     pTrngParams->SubSamplingRatio3 = CC_CONFIG_SAMPLE_CNT_ROSC_3;
     pTrngParams->SubSamplingRatio4 = CC_CONFIG_SAMPLE_CNT_ROSC_4;
+#endif
 
     /* Allowed ROSCs lengths b'0-3. If bit value 1 - appropriate ROSC is allowed. */
     pTrngParams->RoscsAllowed = (((pTrngParams->SubSamplingRatio1 > 0) ? 0x1 : 0x0) |
@@ -45,7 +53,7 @@ static CCError_t RNG_PLAT_SetUserRngParameters(CCRndParams_t *pTrngParams)
     return error;
 }
 
-uint32_t CC_TrngGetSource(unsigned long rngRegBase, uint8_t *outAddr, size_t *outLen, size_t reqBits)
+static CCError_t TrngCollectLocked(unsigned long rngRegBase, size_t reqBits, LLFRndSink_t sink, void *ctx)
 {
     CCError_t Err = CC_OK;
     uint32_t rndWorkBuff[CC_RND_WORK_BUFFER_SIZE_WORDS];
@@ -54,11 +62,12 @@ uint32_t CC_TrngGetSource(unsigned long rngRegBase, uint8_t *outAddr, size_t *ou
     uint32_t  *rndSrc_ptr;
     uint32_t  sourceOutSizeBytes = 0;
     uint32_t requireBytes = (reqBits % 8) ? (reqBits / 8 + 1) : (reqBits / 8);
+    TRNG_PROF_VAR(totalTs);
+    TRNG_PROF_VAR(phaseTs);
 
-    if (NULL == outAddr || NULL == outLen) {
-        TRNG_LOG_DEBUG("NULL pointer!!\n");
-        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
-    }
+    TRNG_MMIO_REQUEST(reqBits);
+    TRNG_STAT_INC(requests);
+    TRNG_PROF_BEGIN(totalTs);
 
     /* zeroe the rnd buff  */
     tztrng_memset((uint8_t *)rndWorkBuff, 0, sizeof(rndWorkBuff));
@@ -71,15 +80,22 @@ uint32_t CC_TrngGetSource(unsigned long rngRegBase, uint8_t *outAddr, size_t *ou
     }
 
     /* Get parameters and set them in the RND structures */
+    TRNG_PROF_BEGIN(phaseTs);
     Err = RNG_PLAT_SetUserRngParameters(&rndParams);
-    if (Err != CC_OK)
+    TRNG_PROF_END(PARAMS, phaseTs);
+    if (Err != CC_OK) {
+        TRNG_STAT_INC(requestErrors);
         return Err;
+    }
 
+    TRNG_STAT_INC(startupTests);
     Err = LLF_RND_RunTrngStartupTest(&rndState, &rndParams, rndWorkBuff);
-    if (Err != CC_OK)
+    if (Err != CC_OK) {
+        TRNG_STAT_INC(requestErrors);
+        tztrng_secure_zero(rndWorkBuff, sizeof(rndWorkBuff));
         return Err;
+    }
 
-    *outLen = requireBytes;
     while (requireBytes > 0) {
         /* Get TRNG Source */
         Err = LLF_RND_GetTrngSource(
@@ -92,27 +108,83 @@ uint32_t CC_TrngGetSource(unsigned long rngRegBase, uint8_t *outAddr, size_t *ou
 
         if (Err) {
             TRNG_LOG_DEBUG("LLF_RND_GetTrngSource failed, err[0x%X]\n", (unsigned int)Err);
-            /* memset 0 to outAddr for security concern */
-            tztrng_memset(outAddr, 0, *outLen);
-            *outLen = 0;
+            tztrng_secure_zero(rndWorkBuff, sizeof(rndWorkBuff));
+            TRNG_STAT_INC(requestErrors);
             return Err;
         }
 
-        /* try to reduce the memcpy */
+        /* hand the health-tested data over without an intermediate copy */
+        TRNG_PROF_BEGIN(phaseTs);
         if (requireBytes < sourceOutSizeBytes) {
-            tztrng_memcpy(outAddr, (uint8_t *)rndSrc_ptr, requireBytes);
+            sink(ctx, (uint8_t *)rndSrc_ptr, requireBytes);
+            TRNG_STAT_ADD(bytesDiscarded, sourceOutSizeBytes - requireBytes);
             requireBytes = 0;
         } else {
-            tztrng_memcpy(outAddr, (uint8_t *)rndSrc_ptr, sourceOutSizeBytes);
+            sink(ctx, (uint8_t *)rndSrc_ptr, sourceOutSizeBytes);
             requireBytes -= sourceOutSizeBytes;
         }
 
-        outAddr += sourceOutSizeBytes;
+        TRNG_PROF_END(COPY, phaseTs);
     }
 
+    TRNG_STAT_ADD(bytesDelivered, (reqBits % 8) ? (reqBits / 8 + 1) : (reqBits / 8));
+
     /* Clear the rndWorkBuff to not leave entropy on the stack */
-    tztrng_memset((uint8_t *)rndWorkBuff, 0, sizeof(rndWorkBuff));
+    TRNG_PROF_BEGIN(phaseTs);
+    tztrng_secure_zero(rndWorkBuff, sizeof(rndWorkBuff));
+    TRNG_PROF_END(WIPE, phaseTs);
+
+    TRNG_PROF_END(TOTAL, totalTs);
+
+    return Err;
+}
+
+CCError_t LLF_RND_CollectSource(unsigned long rngRegBase, size_t reqBits, LLFRndSink_t sink, void *ctx)
+{
+    CCError_t Err;
+
+    /* gCcRegBase, the hardware and the driver counters are shared by all callers */
+    TZTRNG_PAL_LOCK();
+#ifdef CC_CONFIG_TRNG_ASYNC
+    /* the TRNG belongs to an asynchronous collection until it completes or is cancelled */
+    if (gAsyncOwner != NULL) {
+        TZTRNG_PAL_UNLOCK();
+        TRNG_LOG_DEBUG("TRNG owned by an asynchronous collection\n");
+        return CC_RND_TRNG_ASYNC_BUSY_ERROR;
+    }
+#endif
+    Err = TrngCollectLocked(rngRegBase, reqBits, sink, ctx);
+    TZTRNG_PAL_UNLOCK();
 
     return Err;
 }
 
+/* CC_TrngGetSource sink: copy to the caller's buffer */
+static void TrngCopySink(void *ctx, const uint8_t *data, uint32_t len)
+{
+    uint8_t **out_ptr_ptr = (uint8_t **)ctx;
+
+    tztrng_memcpy(*out_ptr_ptr, (uint8_t *)data, len);
+    *out_ptr_ptr += len;
+}
+
+uint32_t CC_TrngGetSource(unsigned long rngRegBase, uint8_t *outAddr, size_t *outLen, size_t reqBits)
+{
+    uint32_t Err;
+    uint8_t *out_ptr = outAddr;
+
+    if (NULL == outAddr || NULL == outLen) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+
+    *outLen = (reqBits % 8) ? (reqBits / 8 + 1) : (reqBits / 8);
+    Err = LLF_RND_CollectSource(rngRegBase, reqBits, TrngCopySink, &out_ptr);
+    if (Err != CC_OK) {
+        /* memset 0 to outAddr for security concern */
+        tztrng_secure_zero(outAddr, *outLen);
+        *outLen = 0;
+    }
+
+    return Err;
+}
@@ -0,0 +1,188 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+#if defined(__ARM_FEATURE_CMSE) && (__ARM_FEATURE_CMSE == 3)
+#include <arm_cmse.h>
+/* Armv8-M secure image: the gateway is called from the non-secure world through
+   its veneer in the non-secure callable region */
+#define MAILBOX_NSC_ENTRY       __attribute__((cmse_nonsecure_entry))
+#define MAILBOX_CHECK_NS        1
+#else
+#define MAILBOX_NSC_ENTRY
+#define MAILBOX_CHECK_NS        0
+#endif
+
+/*
+  Cross-world entropy mailbox, secure side.
+
+  A non-secure client crossing into the secure world for every small request
+  pays two world switches, and a TRNG restart with its start-up test, per
+  request. The mailbox is a ring of CC_TRNG_MAILBOX_BLOCKS blocks in memory the
+  non-secure world can read; the client consumes it without leaving its world
+  (tztrng_mailbox_ns.c) and enters CC_TrngMailboxGateway() only when the ring
+  is empty. Each gateway call refills all consumed blocks with one collection.
+
+  The collection goes to a staging buffer in secure memory first: the blocks
+  are copied to the ring only once the whole collection passed the health
+  tests, so a failing TRNG never leaves output in non-secure memory. The ring
+  head is kept here and only written to the mailbox; the tail written by the
+  non-secure world is checked against it on every call.
+*/
+
+#if (CC_TRNG_MAILBOX_BLOCKS < 1) || ((CC_TRNG_MAILBOX_BLOCKS & (CC_TRNG_MAILBOX_BLOCKS - 1)) != 0)
+#error "CC_TRNG_MAILBOX_BLOCKS must be a power of 2"
+#endif
+#if (CC_TRNG_MAILBOX_BLOCK_BYTES < 1)
+#error "CC_TRNG_MAILBOX_BLOCK_BYTES must be at least 1"
+#endif
+#if (CC_TRNG_MAILBOX_ERROR != CC_RND_TRNG_MAILBOX_STATE_ERROR)
+#error "CC_TRNG_MAILBOX_ERROR does not match CC_RND_TRNG_MAILBOX_STATE_ERROR"
+#endif
+
+#define MAILBOX_RING_BYTES      (CC_TRNG_MAILBOX_BLOCKS * CC_TRNG_MAILBOX_BLOCK_BYTES)
+
+typedef struct {
+    CCTrngMailbox_t *pMbox;         /* NULL while not initialized */
+    unsigned long rngRegBase;
+    uint32_t head;                  /* blocks published, the trusted copy */
+    uint32_t busy;                  /* a gateway call is running */
+    uint8_t stage[MAILBOX_RING_BYTES];
+} Mailbox_t;
+
+static Mailbox_t gMailbox;
+
+static CCError_t MailboxFail(CCTrngMailbox_t *pMbox, CCError_t err)
+{
+    pMbox->errors++;
+    pMbox->lastError = err;
+    return err;
+}
+
+/* Refill the blocks the client consumed and publish them */
+static CCError_t MailboxRefill(CCTrngMailbox_t *pMbox)
+{
+    uint32_t head = gMailbox.head;
+    uint32_t tail, used, count, first, n;
+    size_t outLen = 0;
+    CCError_t err;
+
+    /* written by the non-secure world: only trusted once it is in [head - BLOCKS, head] */
+    tail = __atomic_load_n(&pMbox->tail, __ATOMIC_ACQUIRE);
+    used = head - tail;
+    if (used > CC_TRNG_MAILBOX_BLOCKS) {
+        TRNG_LOG_DEBUG("mailbox tail %u out of the ring, head %u\n", tail, head);
+        return MailboxFail(pMbox, CC_RND_TRNG_MAILBOX_STATE_ERROR);
+    }
+    count = CC_TRNG_MAILBOX_BLOCKS - used;
+    if (count == 0)
+        return CC_OK;
+
+    err = CC_TrngGetSource(gMailbox.rngRegBase, gMailbox.stage, &outLen,
+                           (size_t)count * CC_TRNG_MAILBOX_BLOCK_BYTES * 8);
+    if (err != CC_OK) {
+        tztrng_secure_zero(gMailbox.stage, sizeof(gMailbox.stage));
+        return MailboxFail(pMbox, err);
+    }
+
+    /* the free blocks wrap around the end of the ring at most once */
+    first = head & (CC_TRNG_MAILBOX_BLOCKS - 1);
+    n = CC_TRNG_MAILBOX_BLOCKS - first;
+    if (n > count)
+        n = count;
+    tztrng_memcpy(pMbox->block[first], gMailbox.stage, (size_t)n * CC_TRNG_MAILBOX_BLOCK_BYTES);
+    if (n < count)
+        tztrng_memcpy(pMbox->block[0], gMailbox.stage + (size_t)n * CC_TRNG_MAILBOX_BLOCK_BYTES,
+                      (size_t)(count - n) * CC_TRNG_MAILBOX_BLOCK_BYTES);
+    tztrng_secure_zero(gMailbox.stage, (size_t)count * CC_TRNG_MAILBOX_BLOCK_BYTES);
+
+    gMailbox.head = head + count;
+    pMbox->collections++;
+    pMbox->blocksPublished += count;
+    /* the blocks are visible before the head that publishes them */
+    __atomic_store_n(&pMbox->head, gMailbox.head, __ATOMIC_RELEASE);
+
+    return CC_OK;
+}
+
+uint32_t CC_TrngMailboxInit(unsigned long rngRegBase, CCTrngMailbox_t *pMbox)
+{
+    CCError_t err;
+
+    if ((NULL == pMbox) || (0 == rngRegBase)) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+#if MAILBOX_CHECK_NS
+    /* the ring must not be a way to write secure memory */
+    if (cmse_check_address_range(pMbox, sizeof(*pMbox), CMSE_NONSECURE | CMSE_MPU_READWRITE) == NULL) {
+        TRNG_LOG_DEBUG("mailbox is not in non-secure memory\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+#endif
+    if (gMailbox.pMbox != NULL)
+        return CC_RND_TRNG_MAILBOX_STATE_ERROR;
+
+    __atomic_store_n(&pMbox->magic, 0, __ATOMIC_RELEASE);
+    tztrng_memset((uint8_t *)pMbox, 0, sizeof(*pMbox));
+    gMailbox.rngRegBase = rngRegBase;
+    gMailbox.head = 0;
+    gMailbox.busy = 0;
+
+    err = MailboxRefill(pMbox);
+    if (err != CC_OK)
+        return err;
+
+    gMailbox.pMbox = pMbox;
+    __atomic_store_n(&pMbox->magic, CC_TRNG_MAILBOX_MAGIC, __ATOMIC_RELEASE);
+
+    return CC_OK;
+}
+
+MAILBOX_NSC_ENTRY uint32_t CC_TrngMailboxGateway(void)
+{
+    CCTrngMailbox_t *pMbox = gMailbox.pMbox;
+    CCError_t err;
+
+    if (NULL == pMbox)
+        return CC_RND_TRNG_MAILBOX_STATE_ERROR;
+    /* the non-secure world may enter again from an interrupt while a refill runs */
+    if (__atomic_exchange_n(&gMailbox.busy, 1, __ATOMIC_ACQUIRE) != 0)
+        return CC_RND_TRNG_MAILBOX_STATE_ERROR;
+
+    pMbox->gatewayCalls++;
+    err = MailboxRefill(pMbox);
+
+    __atomic_store_n(&gMailbox.busy, 0, __ATOMIC_RELEASE);
+
+    return err;
+}
+
+void CC_TrngMailboxClose(void)
+{
+    CCTrngMailbox_t *pMbox = gMailbox.pMbox;
+
+    if (NULL == pMbox)
+        return;
+    gMailbox.pMbox = NULL;
+    __atomic_store_n(&pMbox->magic, 0, __ATOMIC_RELEASE);
+    tztrng_secure_zero(pMbox->block, sizeof(pMbox->block));
+    tztrng_secure_zero(gMailbox.stage, sizeof(gMailbox.stage));
+}
@@ -0,0 +1,117 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <string.h>
+
+#include "tztrng.h"
+
+/*
+  Cross-world entropy mailbox, non-secure side.
+
+  Built into the non-secure image with tztrng.h only: no register access and
+  no other file of the library. Reads copy out of the ring the secure side
+  fills (tztrng_mailbox.c) and wipe what they copied; a block goes back to the
+  secure side once it is consumed completely, by a release store of the tail.
+  The gateway, with its two world switches, is called only when the ring is
+  empty.
+*/
+
+/* Wipe entropy handed out; the volatile stores are not optimized away */
+static void MailboxWipe(void *buf, size_t size)
+{
+    volatile uint8_t *p = (volatile uint8_t *)buf;
+
+    while (size--)
+        *p++ = 0;
+}
+
+static uint32_t MailboxReadFail(CCTrngMailboxClient_t *pCli, uint8_t *outAddr, size_t outLen, uint32_t err)
+{
+    MailboxWipe(outAddr, outLen);
+    pCli->stats.errors++;
+    pCli->stats.lastError = err;
+    return err;
+}
+
+uint32_t CC_TrngMailboxAttach(CCTrngMailboxClient_t *pCli, CCTrngMailbox_t *pMbox,
+                              CCTrngMailboxGateway_t gateway, void *gatewayCtx)
+{
+    if ((NULL == pCli) || (NULL == pMbox) || (NULL == gateway))
+        return CC_TRNG_MAILBOX_ERROR;
+    if (__atomic_load_n(&pMbox->magic, __ATOMIC_ACQUIRE) != CC_TRNG_MAILBOX_MAGIC)
+        return CC_TRNG_MAILBOX_ERROR;
+
+    memset(pCli, 0, sizeof(*pCli));
+    pCli->pMbox = pMbox;
+    pCli->gateway = gateway;
+    pCli->gatewayCtx = gatewayCtx;
+    pCli->tail = __atomic_load_n(&pMbox->tail, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+uint32_t CC_TrngMailboxRead(CCTrngMailboxClient_t *pCli, uint8_t *outAddr, size_t outLen)
+{
+    CCTrngMailbox_t *pMbox;
+    uint8_t *pBlock;
+    uint32_t head, err;
+    size_t done = 0, n;
+    int refilled = 0;
+
+    if ((NULL == pCli) || (NULL == pCli->pMbox) || ((NULL == outAddr) && (outLen != 0)))
+        return CC_TRNG_MAILBOX_ERROR;
+    pMbox = pCli->pMbox;
+    pCli->stats.reads++;
+
+    while (done < outLen) {
+        head = __atomic_load_n(&pMbox->head, __ATOMIC_ACQUIRE);
+        if (head - pCli->tail > CC_TRNG_MAILBOX_BLOCKS)
+            return MailboxReadFail(pCli, outAddr, outLen, CC_TRNG_MAILBOX_ERROR);
+
+        if (head == pCli->tail) {
+            /* a successful refill publishes at least one block */
+            if (refilled)
+                return MailboxReadFail(pCli, outAddr, outLen, CC_TRNG_MAILBOX_ERROR);
+            pCli->stats.gatewayCalls++;
+            err = pCli->gateway(pCli->gatewayCtx);
+            if (err != 0)
+                return MailboxReadFail(pCli, outAddr, outLen, err);
+            refilled = 1;
+            continue;
+        }
+        refilled = 0;
+
+        pBlock = pMbox->block[pCli->tail & (CC_TRNG_MAILBOX_BLOCKS - 1)] + pCli->offset;
+        n = CC_TRNG_MAILBOX_BLOCK_BYTES - pCli->offset;
+        if (n > outLen - done)
+            n = outLen - done;
+        memcpy(outAddr + done, pBlock, n);
+        MailboxWipe(pBlock, n);
+        done += n;
+
+        pCli->offset += (uint32_t)n;
+        if (pCli->offset == CC_TRNG_MAILBOX_BLOCK_BYTES) {
+            pCli->offset = 0;
+            pCli->tail++;
+            /* the block is read and wiped before the secure side may refill it */
+            __atomic_store_n(&pMbox->tail, pCli->tail, __ATOMIC_RELEASE);
+        }
+    }
+    pCli->stats.bytes += (uint32_t)done;
+
+    return 0;
+}
@@ -0,0 +1,333 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  MMIO hook layer.
+
+  With CC_CONFIG_TRNG_MMIO_HOOKS, CC_HAL_READ_REGISTER/CC_HAL_WRITE_REGISTER call
+  tztrng_mmio_read/tztrng_mmio_write, which go to the installed backend or, when
+  none is installed, straight to the registers. Two backends are provided:
+  - record: logs every access into a CCTrngMmioTraceRec_t array and passes it on,
+  - replay: serves the accesses from such a trace, for running the driver on a
+    host without the hardware.
+*/
+
+/* records searched ahead for a match after a divergence */
+#define TZTRNG_MMIO_RESYNC_WINDOW   64
+/* register shadow of the replay, indexed by offset / 4 */
+#define TZTRNG_MMIO_SHADOW_WORDS    ((DX_RNG_BIST_CNTR_2_REG_OFFSET / sizeof(uint32_t)) + 1)
+
+static const CCTrngMmioOps_t *gMmioOps = NULL;
+
+uint32_t tztrng_mmio_read(uint32_t regOffset)
+{
+    if (gMmioOps == NULL)
+        return *((volatile uint32_t *)(gCcRegBase + regOffset));
+
+    return gMmioOps->read(gMmioOps->ctx, gCcRegBase, regOffset);
+}
+
+void tztrng_mmio_write(uint32_t regOffset, uint32_t val)
+{
+    if (gMmioOps == NULL) {
+        *((volatile uint32_t *)(gCcRegBase + regOffset)) = val;
+        return;
+    }
+
+    gMmioOps->write(gMmioOps->ctx, gCcRegBase, regOffset, val);
+}
+
+void tztrng_mmio_request(size_t reqBits)
+{
+    if ((gMmioOps != NULL) && (gMmioOps->request != NULL))
+        gMmioOps->request(gMmioOps->ctx, reqBits);
+}
+
+void CC_TrngSetMmioOps(const CCTrngMmioOps_t *pOps)
+{
+    gMmioOps = pOps;
+}
+
+/************************************************************************************/
+/* Record backend                                                                   */
+/************************************************************************************/
+
+typedef struct {
+    const CCTrngMmioOps_t *pNext;   /* backend the accesses are passed on to */
+    CCTrngMmioTraceHdr_t *pHdr;
+    CCTrngMmioTraceRec_t *pRec;
+    uint32_t maxRecords;
+    uint64_t lastTs;
+} TztrngMmioRecord_t;
+
+static TztrngMmioRecord_t gRecord;
+
+static void tztrng_mmioRecordAdd(CCTrngMmioOp_t op, uint32_t offset, uint32_t value)
+{
+    uint64_t ts = tztrng_pal_timestamp();
+    CCTrngMmioTraceRec_t *pRec;
+
+    if (gRecord.pHdr->records >= gRecord.maxRecords) {
+        gRecord.pHdr->flags |= CC_TRNG_MMIO_TRACE_TRUNCATED;
+        return;
+    }
+
+    pRec = &gRecord.pRec[gRecord.pHdr->records++];
+    pRec->tsDelta = (uint32_t)(ts - gRecord.lastTs);
+    pRec->offset = (uint16_t)offset;
+    pRec->op = (uint8_t)op;
+    pRec->reserved = 0;
+    pRec->value = value;
+    gRecord.lastTs = ts;
+}
+
+static uint32_t tztrng_mmioRecordRead(void *ctx, unsigned long regBase, uint32_t offset)
+{
+    uint32_t val;
+
+    CC_UNUSED_PARAM(ctx);
+
+    if (gRecord.pNext == NULL)
+        val = *((volatile uint32_t *)(regBase + offset));
+    else
+        val = gRecord.pNext->read(gRecord.pNext->ctx, regBase, offset);
+
+    tztrng_mmioRecordAdd(CC_TRNG_MMIO_OP_READ, offset, val);
+
+    return val;
+}
+
+static void tztrng_mmioRecordWrite(void *ctx, unsigned long regBase, uint32_t offset, uint32_t val)
+{
+    CC_UNUSED_PARAM(ctx);
+
+    tztrng_mmioRecordAdd(CC_TRNG_MMIO_OP_WRITE, offset, val);
+
+    if (gRecord.pNext == NULL)
+        *((volatile uint32_t *)(regBase + offset)) = val;
+    else
+        gRecord.pNext->write(gRecord.pNext->ctx, regBase, offset, val);
+}
+
+static void tztrng_mmioRecordRequest(void *ctx, size_t reqBits)
+{
+    CC_UNUSED_PARAM(ctx);
+
+    tztrng_mmioRecordAdd(CC_TRNG_MMIO_OP_REQUEST, 0, (uint32_t)reqBits);
+
+    if ((gRecord.pNext != NULL) && (gRecord.pNext->request != NULL))
+        gRecord.pNext->request(gRecord.pNext->ctx, reqBits);
+}
+
+static const CCTrngMmioOps_t gRecordOps = {
+    tztrng_mmioRecordRead,
+    tztrng_mmioRecordWrite,
+    tztrng_mmioRecordRequest,
+    NULL,
+};
+
+uint32_t CC_TrngMmioRecordStart(void *traceBuf, size_t traceSize)
+{
+    if ((traceBuf == NULL) || (((unsigned long)traceBuf & (sizeof(uint32_t) - 1)) != 0))
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    if (traceSize < sizeof(CCTrngMmioTraceHdr_t))
+        return LLF_RND_TRNG_BUFFER_TOO_SMALL_ERROR;
+    if (gMmioOps == &gRecordOps)
+        return LLF_RND_STATE_PTR_INVALID_ERROR;
+
+    gRecord.pNext = gMmioOps;
+    gRecord.pHdr = (CCTrngMmioTraceHdr_t *)traceBuf;
+    gRecord.pRec = (CCTrngMmioTraceRec_t *)(void *)(gRecord.pHdr + 1);
+    gRecord.maxRecords = (uint32_t)((traceSize - sizeof(CCTrngMmioTraceHdr_t)) / sizeof(CCTrngMmioTraceRec_t));
+    gRecord.lastTs = tztrng_pal_timestamp();
+
+    gRecord.pHdr->magic = CC_TRNG_MMIO_TRACE_MAGIC;
+    gRecord.pHdr->version = CC_TRNG_MMIO_TRACE_VERSION;
+    gRecord.pHdr->trngMode = CC_CONFIG_TRNG_MODE;
+    gRecord.pHdr->records = 0;
+    gRecord.pHdr->flags = 0;
+
+    gMmioOps = &gRecordOps;
+
+    return CC_OK;
+}
+
+uint32_t CC_TrngMmioRecordStop(size_t *traceLen)
+{
+    if (traceLen == NULL)
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    if (gMmioOps != &gRecordOps)
+        return LLF_RND_STATE_PTR_INVALID_ERROR;
+
+    gMmioOps = gRecord.pNext;
+
+    *traceLen = sizeof(CCTrngMmioTraceHdr_t) + gRecord.pHdr->records * sizeof(CCTrngMmioTraceRec_t);
+    if (gRecord.pHdr->flags & CC_TRNG_MMIO_TRACE_TRUNCATED)
+        return LLF_RND_TRNG_BUFFER_TOO_SMALL_ERROR;
+
+    return CC_OK;
+}
+
+/************************************************************************************/
+/* Replay backend                                                                   */
+/************************************************************************************/
+
+typedef struct {
+    const CCTrngMmioTraceRec_t *pRec;
+    uint32_t next;                  /* next record to match */
+    uint32_t shadow[TZTRNG_MMIO_SHADOW_WORDS];
+    CCTrngMmioReplayReport_t report;
+} TztrngMmioReplay_t;
+
+static TztrngMmioReplay_t gReplay;
+
+/* match the access against the next record, resynchronizing after a divergence;
+   returns the matching record or NULL */
+static const CCTrngMmioTraceRec_t *tztrng_mmioReplayMatch(CCTrngMmioOp_t op, uint32_t offset, uint32_t value)
+{
+    const CCTrngMmioTraceRec_t *pRec;
+    uint32_t i, end;
+
+    end = gReplay.next + TZTRNG_MMIO_RESYNC_WINDOW;
+    if (end > gReplay.report.records)
+        end = gReplay.report.records;
+
+    for (i = gReplay.next; i < end; i++) {
+        pRec = &gReplay.pRec[i];
+        if ((pRec->op != op) || (pRec->offset != offset))
+            continue;
+        if ((op != CC_TRNG_MMIO_OP_READ) && (pRec->value != value))
+            continue;
+        /* only an exact match of the next record is on track */
+        if (i != gReplay.next)
+            break;
+
+        gReplay.next++;
+        gReplay.report.consumed = gReplay.next;
+        gReplay.report.tracedTicks += pRec->tsDelta;
+        return pRec;
+    }
+
+    if (gReplay.report.divergences++ == 0) {
+        gReplay.report.firstDivergenceIdx = gReplay.next;
+        if (gReplay.next < gReplay.report.records)
+            gReplay.report.expected = gReplay.pRec[gReplay.next];
+        gReplay.report.actual.offset = (uint16_t)offset;
+        gReplay.report.actual.op = (uint8_t)op;
+        gReplay.report.actual.value = value;
+    }
+    if (gReplay.next >= gReplay.report.records)
+        gReplay.report.exhausted = 1;
+
+    if (i < end) {
+        /* skip to the matching record */
+        pRec = &gReplay.pRec[i];
+        gReplay.next = i + 1;
+        gReplay.report.consumed = gReplay.next;
+        gReplay.report.tracedTicks += pRec->tsDelta;
+        return pRec;
+    }
+
+    return NULL;
+}
+
+static uint32_t tztrng_mmioReplayRead(void *ctx, unsigned long regBase, uint32_t offset)
+{
+    const CCTrngMmioTraceRec_t *pRec;
+
+    CC_UNUSED_PARAM(ctx);
+    CC_UNUSED_PARAM(regBase);
+
+    gReplay.report.reads++;
+    pRec = tztrng_mmioReplayMatch(CC_TRNG_MMIO_OP_READ, offset, 0);
+    if (pRec != NULL)
+        return pRec->value;
+
+    /* off track: make a waiting driver give up rather than spin forever */
+    if (offset == DX_RNG_ISR_REG_OFFSET)
+        return 0x1 << DX_RNG_ISR_CRNGT_ERR_BIT_SHIFT;
+
+    return (offset / sizeof(uint32_t) < TZTRNG_MMIO_SHADOW_WORDS) ? gReplay.shadow[offset / sizeof(uint32_t)] : 0;
+}
+
+static void tztrng_mmioReplayWrite(void *ctx, unsigned long regBase, uint32_t offset, uint32_t val)
+{
+    CC_UNUSED_PARAM(ctx);
+    CC_UNUSED_PARAM(regBase);
+
+    gReplay.report.writes++;
+    if (offset / sizeof(uint32_t) < TZTRNG_MMIO_SHADOW_WORDS)
+        gReplay.shadow[offset / sizeof(uint32_t)] = val;
+
+    (void)tztrng_mmioReplayMatch(CC_TRNG_MMIO_OP_WRITE, offset, val);
+}
+
+static void tztrng_mmioReplayRequest(void *ctx, size_t reqBits)
+{
+    CC_UNUSED_PARAM(ctx);
+
+    gReplay.report.requests++;
+    (void)tztrng_mmioReplayMatch(CC_TRNG_MMIO_OP_REQUEST, 0, (uint32_t)reqBits);
+}
+
+static const CCTrngMmioOps_t gReplayOps = {
+    tztrng_mmioReplayRead,
+    tztrng_mmioReplayWrite,
+    tztrng_mmioReplayRequest,
+    NULL,
+};
+
+uint32_t CC_TrngMmioReplayStart(const void *traceBuf, size_t traceLen)
+{
+    const CCTrngMmioTraceHdr_t *pHdr = (const CCTrngMmioTraceHdr_t *)traceBuf;
+
+    if ((traceBuf == NULL) || (((unsigned long)traceBuf & (sizeof(uint32_t) - 1)) != 0))
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    if ((traceLen < sizeof(CCTrngMmioTraceHdr_t)) ||
+        (pHdr->magic != CC_TRNG_MMIO_TRACE_MAGIC) ||
+        (pHdr->version != CC_TRNG_MMIO_TRACE_VERSION) ||
+        (traceLen < sizeof(CCTrngMmioTraceHdr_t) + pHdr->records * sizeof(CCTrngMmioTraceRec_t)))
+        return LLF_RND_TRNG_BUFFER_TOO_SMALL_ERROR;
+    /* the engines access the registers differently */
+    if (pHdr->trngMode != CC_CONFIG_TRNG_MODE)
+        return LLF_RND_TRNG_PREVIOUS_PARAMS_NOT_MATCH_ERROR;
+
+    tztrng_memset((uint8_t *)&gReplay, 0, sizeof(gReplay));
+    gReplay.pRec = (const CCTrngMmioTraceRec_t *)(const void *)(pHdr + 1);
+    gReplay.report.records = pHdr->records;
+
+    gMmioOps = &gReplayOps;
+
+    return CC_OK;
+}
+
+uint32_t CC_TrngMmioReplayStop(CCTrngMmioReplayReport_t *pReport)
+{
+    if (pReport == NULL)
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    if (gMmioOps != &gReplayOps)
+        return LLF_RND_STATE_PTR_INVALID_ERROR;
+
+    gMmioOps = NULL;
+    *pReport = gReplay.report;
+
+    return CC_OK;
+}
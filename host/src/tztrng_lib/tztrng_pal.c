@@ -16,6 +16,172 @@
 * limitations under the License.                                              *
 ******************************************************************************/
 #include "tztrng_defs.h"
+#include "tztrng_pal.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef CC_CONFIG_TRNG_WAIT_PREDICT
+/*
+ * EHR fill time model.
+ * An EHR is ready after TZTRNG_WAIT_BITS_PER_EHR samples taken every SAMPLE_CNT1
+ * rng clocks, so the fill time is linear in the sample count. The slope is kept per
+ * ROSC (microseconds per sample count unit, Q16), starts at the nominal value and is
+ * calibrated online from the measured fill times.
+ */
+#if (CC_CONFIG_TRNG_MODE == 1)
+#define TZTRNG_WAIT_BITS_PER_EHR    (LLF_RND_HW_TRNG_EHR_WIDTH_IN_WORDS * 32)
+#else
+/* the von Neumann balancer keeps one bit out of four on average */
+#define TZTRNG_WAIT_BITS_PER_EHR    (LLF_RND_HW_TRNG_EHR_WIDTH_IN_WORDS * 32 * 4)
+#endif
+#define TZTRNG_WAIT_NOMINAL_US_PER_CNT_Q16  ((TZTRNG_WAIT_BITS_PER_EHR << 16) / DX_SEP_FREQ_MHZ)
+
+static uint32_t gWaitUsPerCntQ16[LLF_RND_NUM_OF_ROSCS] = {
+    TZTRNG_WAIT_NOMINAL_US_PER_CNT_Q16, TZTRNG_WAIT_NOMINAL_US_PER_CNT_Q16,
+    TZTRNG_WAIT_NOMINAL_US_PER_CNT_Q16, TZTRNG_WAIT_NOMINAL_US_PER_CNT_Q16
+};
+
+/* Sleep until shortly before the predicted fill time. Returns CC_TRUE if it slept. */
+static CCBool_t tztrng_waitPredictSleep(uint32_t startUs, uint32_t predictedUs)
+{
+    /* wake up early enough to absorb an 1/8 error of the model and the OS wake-up latency */
+    uint32_t wakeUs = predictedUs - (predictedUs / 8);
+    uint32_t elapsedUs;
+
+    if (wakeUs <= CC_CONFIG_TRNG_WAIT_SPIN_US)
+        return CC_FALSE;
+    wakeUs -= CC_CONFIG_TRNG_WAIT_SPIN_US;
+
+    elapsedUs = tztrng_pal_timeUs() - startUs;
+    if (elapsedUs >= wakeUs)
+        return CC_FALSE;
+
+    tztrng_pal_sleepUs(wakeUs - elapsedUs);
+    return CC_TRUE;
+}
+
+static void tztrng_waitPredictUpdate(uint32_t roscNum, uint32_t sampleCnt, uint32_t elapsedUs, CCBool_t isLate)
+{
+    uint32_t *pModel = &gWaitUsPerCntQ16[roscNum];
+    uint32_t measuredQ16;
+
+    if (sampleCnt == 0)
+        return;
+
+    if (isLate) {
+        /* the EHR was ready when the sleep ended: the fill time is unknown but shorter */
+        *pModel -= *pModel / 16;
+        return;
+    }
+
+    measuredQ16 = (uint32_t)(((uint64_t)elapsedUs << 16) / sampleCnt);
+    if (measuredQ16 > *pModel)
+        *pModel += (measuredQ16 - *pModel) / 8;
+    else
+        *pModel -= (*pModel - measuredQ16) / 8;
+}
+#endif
+
+#if defined(CC_CONFIG_TRNG_TIMESTAMP) && !defined(CC_CONFIG_TRNG_TIMESTAMP_OS_CLOCK)
+/*
+ * CPU cycle counter of tztrng_pal_timestamp() on bare metal (and RTOS) builds.
+ * The counter is enabled on first use; this needs a privileged mode. 32-bit
+ * counters are extended to 64 bits in software, which needs a call at least once
+ * per counter wrap (about 4 s at 1 GHz); every CC_TrngGetSource phase makes one.
+ */
+
+#if defined(__arm__)
+/* 64-bit extension of a 32-bit cycle count (DWT, Armv7 PMU) */
+static uint64_t tztrng_pal_extendTimestamp(uint32_t cycles)
+{
+    static uint32_t lastCycles;
+    static uint64_t high;
+
+    if (cycles < lastCycles)
+        high += 1ULL << 32;
+    lastCycles = cycles;
+
+    return high | cycles;
+}
+#endif
+
+#if defined(__ARM_ARCH_PROFILE) && (__ARM_ARCH_PROFILE == 'M')
+/* Cortex-M: DWT cycle counter */
+#define TZTRNG_DEMCR            (*(volatile uint32_t *)0xE000EDFCUL)
+#define TZTRNG_DEMCR_TRCENA     (1UL << 24)
+#define TZTRNG_DWT_CTRL         (*(volatile uint32_t *)0xE0001000UL)
+#define TZTRNG_DWT_CYCCNTENA    (1UL << 0)
+#define TZTRNG_DWT_CYCCNT       (*(volatile uint32_t *)0xE0001004UL)
+
+uint64_t tztrng_pal_timestamp(void)
+{
+    if ((TZTRNG_DWT_CTRL & TZTRNG_DWT_CYCCNTENA) == 0) {
+        TZTRNG_DEMCR |= TZTRNG_DEMCR_TRCENA;
+        TZTRNG_DWT_CYCCNT = 0;
+        TZTRNG_DWT_CTRL |= TZTRNG_DWT_CYCCNTENA;
+    }
+
+    return tztrng_pal_extendTimestamp(TZTRNG_DWT_CYCCNT);
+}
+#elif defined(__aarch64__)
+/* Armv8-A: PMU cycle counter, 64 bits wide */
+uint64_t tztrng_pal_timestamp(void)
+{
+    static CCBool_t isEnabled = CC_FALSE;
+    uint64_t val;
+
+    if (isEnabled == CC_FALSE) {
+        /* PMCR_EL0.E, then PMCNTENSET_EL0.C */
+        __asm__ __volatile__("mrs %0, pmcr_el0" : "=r"(val));
+        __asm__ __volatile__("msr pmcr_el0, %0" : : "r"(val | 1));
+        __asm__ __volatile__("msr pmcntenset_el0, %0" : : "r"(1UL << 31));
+        __asm__ __volatile__("isb");
+        isEnabled = CC_TRUE;
+    }
+
+    __asm__ __volatile__("mrs %0, pmccntr_el0" : "=r"(val));
+    return val;
+}
+#elif defined(__arm__)
+/* Armv7-A/R: PMU cycle counter */
+uint64_t tztrng_pal_timestamp(void)
+{
+    static CCBool_t isEnabled = CC_FALSE;
+    uint32_t val;
+
+    if (isEnabled == CC_FALSE) {
+        /* PMCR.E, then PMCNTENSET.C */
+        __asm__ __volatile__("mrc p15, 0, %0, c9, c12, 0" : "=r"(val));
+        __asm__ __volatile__("mcr p15, 0, %0, c9, c12, 0" : : "r"(val | 1));
+        __asm__ __volatile__("mcr p15, 0, %0, c9, c12, 1" : : "r"(1UL << 31));
+        __asm__ __volatile__("isb");
+        isEnabled = CC_TRUE;
+    }
+
+    __asm__ __volatile__("mrc p15, 0, %0, c9, c13, 0" : "=r"(val));
+    return tztrng_pal_extendTimestamp(val);
+}
+#elif defined(__unix__)
+/* no Arm cycle counter (a TEE_OS=no_os build on a host): the monotonic clock, in nanoseconds */
+#include <time.h>
+
+uint64_t tztrng_pal_timestamp(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#else
+/* no cycle counter known for this target: phase durations and trace deltas read 0 */
+uint64_t tztrng_pal_timestamp(void)
+{
+    return 0;
+}
+#endif
+#endif
 
 uint32_t CC_HalWaitInterrupt(void)
 {
@@ -27,16 +193,34 @@ uint32_t CC_HalWaitInterrupt(void)
     uint32_t vnerr = 0;
     #endif
 
+    #ifdef CC_CONFIG_TRNG_WAIT_PREDICT
+    /* the EHR started filling when the source was enabled or the previous EHR was read */
+    uint32_t startUs = tztrng_pal_timeUs();
+    uint32_t roscNum = CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, TRNG_CONFIG)) & (LLF_RND_NUM_OF_ROSCS - 1);
+    uint32_t sampleCnt = CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, SAMPLE_CNT1));
+    CCBool_t isFirstRead = tztrng_waitPredictSleep(startUs,
+                            (uint32_t)(((uint64_t)sampleCnt * gWaitUsPerCntQ16[roscNum]) >> 16));
+    #endif
+
     /* Polling ISR value */
     do {
         isr = CC_HAL_READ_REGISTER(DX_RNG_ISR_REG_OFFSET);
+        TRNG_TELEMETRY_ISR(isr);
         if (isr & 0x1 << DX_RNG_ISR_EHR_VALID_BIT_SHIFT) {
+            #ifdef CC_CONFIG_TRNG_WAIT_PREDICT
+            tztrng_waitPredictUpdate(roscNum, sampleCnt, tztrng_pal_timeUs() - startUs, isFirstRead);
+            #endif
             return 0;
         }
+        #ifdef CC_CONFIG_TRNG_WAIT_PREDICT
+        isFirstRead = CC_FALSE;
+        #endif
+        TRNG_STAT_INC(pollSpins);
 
         if (isr & 0x1 << DX_RNG_ISR_CRNGT_ERR_BIT_SHIFT) {
             CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_ICR), 0x1 << DX_RNG_ISR_CRNGT_ERR_BIT_SHIFT);
             crngterr++;
+            TRNG_STAT_INC(crngtErrors);
             TRNG_LOG_DEBUG("CRNGT error detected[%d]\n", (int)crngterr);
             if (crngterr >= TRNG_MAX_CRNGT_ERRORS)
                 abort = 1;
@@ -46,6 +230,7 @@ uint32_t CC_HalWaitInterrupt(void)
         if (isr & 0x1 << DX_RNG_ISR_VN_ERR_BIT_SHIFT) {
             CC_HAL_WRITE_REGISTER(CC_REG_OFFSET(RNG, RNG_ICR), 0x1 << DX_RNG_ISR_VN_ERR_BIT_SHIFT);
             vnerr++;
+            TRNG_STAT_INC(vnErrors);
             TRNG_LOG_DEBUG("VN error detected[%d]\n", vnerr);
             if (vnerr >= TRNG_MAX_VN_ERRORS)
                 abort = 1;
@@ -53,10 +238,14 @@ uint32_t CC_HalWaitInterrupt(void)
 
         if (isr & 0x1 << DX_RNG_ISR_AUTOCORR_ERR_BIT_SHIFT) {
             TRNG_LOG_DEBUG("AUTOCORR error detected\n");
+            TRNG_STAT_INC(autocorrErrors);
             abort = 1;
         }
         #endif
 
+        if (!abort)
+            TZTRNG_PAL_WAIT_EVENT();
+
     } while (!abort);
 
     TRNG_LOG_DEBUG("abort leave..\n");
@@ -83,17 +272,138 @@ void LLF_RND_TurnOffTrng(void)
 	return;
 }
 
+/*
+ * Memory primitives.
+ * Word accesses are used when source and destination share the same alignment
+ * (always the case for the driver's EHR buffers); NEON 16-byte accesses when the
+ * core has it. Anything else falls back to bytes.
+ */
+#if defined(__GNUC__)
+typedef uint32_t __attribute__((__may_alias__)) tztrng_word_t;
+#else
+typedef uint32_t tztrng_word_t;
+#endif
+
+#define TZTRNG_WORD_SIZE        sizeof(tztrng_word_t)
+#define TZTRNG_WORD_MASK        (TZTRNG_WORD_SIZE - 1)
+#define TZTRNG_IS_ALIGNED(p)    ((((unsigned long)(p)) & TZTRNG_WORD_MASK) == 0)
+
 void tztrng_memcpy(uint8_t *dst, uint8_t *src, size_t size)
 {
-	size_t i;
-	for(i = 0; i < size; i++)
-		dst[i] = src[i];
+    tztrng_word_t *wdst;
+    tztrng_word_t *wsrc;
+
+    if (((((unsigned long)dst) ^ ((unsigned long)src)) & TZTRNG_WORD_MASK) == 0) {
+        while ((size > 0) && !TZTRNG_IS_ALIGNED(dst)) {
+            *dst++ = *src++;
+            size--;
+        }
+
+#if defined(__ARM_NEON)
+        while (size >= 16) {
+            vst1q_u8(dst, vld1q_u8(src));
+            dst += 16;
+            src += 16;
+            size -= 16;
+        }
+#endif
+
+        wdst = (tztrng_word_t *)(void *)dst;
+        wsrc = (tztrng_word_t *)(void *)src;
+        while (size >= 4 * TZTRNG_WORD_SIZE) {
+            wdst[0] = wsrc[0];
+            wdst[1] = wsrc[1];
+            wdst[2] = wsrc[2];
+            wdst[3] = wsrc[3];
+            wdst += 4;
+            wsrc += 4;
+            size -= 4 * TZTRNG_WORD_SIZE;
+        }
+        while (size >= TZTRNG_WORD_SIZE) {
+            *wdst++ = *wsrc++;
+            size -= TZTRNG_WORD_SIZE;
+        }
+        dst = (uint8_t *)wdst;
+        src = (uint8_t *)wsrc;
+    }
+
+    while (size > 0) {
+        *dst++ = *src++;
+        size--;
+    }
 }
 
 void tztrng_memset(uint8_t *dst, uint8_t value, size_t size)
 {
-    size_t i;
-    for(i = 0; i < size; i++)
-        dst[i] = value;
+    tztrng_word_t *wdst;
+    tztrng_word_t word = value * 0x01010101UL;
+
+    while ((size > 0) && !TZTRNG_IS_ALIGNED(dst)) {
+        *dst++ = value;
+        size--;
+    }
+
+#if defined(__ARM_NEON)
+    {
+        uint8x16_t vec = vdupq_n_u8(value);
+
+        while (size >= 16) {
+            vst1q_u8(dst, vec);
+            dst += 16;
+            size -= 16;
+        }
+    }
+#endif
+
+    wdst = (tztrng_word_t *)(void *)dst;
+    while (size >= 4 * TZTRNG_WORD_SIZE) {
+        wdst[0] = word;
+        wdst[1] = word;
+        wdst[2] = word;
+        wdst[3] = word;
+        wdst += 4;
+        size -= 4 * TZTRNG_WORD_SIZE;
+    }
+    while (size >= TZTRNG_WORD_SIZE) {
+        *wdst++ = word;
+        size -= TZTRNG_WORD_SIZE;
+    }
+
+    dst = (uint8_t *)wdst;
+    while (size > 0) {
+        *dst++ = value;
+        size--;
+    }
 }
 
+/*
+ * Wipe a buffer holding entropy. The stores go through volatile pointers, so the
+ * compiler cannot drop them even when the buffer is dead afterwards.
+ */
+void tztrng_secure_zero(void *buf, size_t size)
+{
+    volatile uint8_t *dst = (volatile uint8_t *)buf;
+    volatile tztrng_word_t *wdst;
+
+    while ((size > 0) && !TZTRNG_IS_ALIGNED(dst)) {
+        *dst++ = 0;
+        size--;
+    }
+
+    wdst = (volatile tztrng_word_t *)(volatile void *)dst;
+    while (size >= TZTRNG_WORD_SIZE) {
+        *wdst++ = 0;
+        size -= TZTRNG_WORD_SIZE;
+    }
+
+    dst = (volatile uint8_t *)wdst;
+    while (size > 0) {
+        *dst++ = 0;
+        size--;
+    }
+
+#if defined(__GNUC__)
+    /* also keep later code from being reordered before the wipe */
+    __asm__ __volatile__("" : : "r"(buf) : "memory");
+#endif
+}
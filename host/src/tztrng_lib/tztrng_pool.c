@@ -0,0 +1,270 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  Entropy pool.
+
+  A producer thread owns the TRNG and keeps a ring buffer of health-tested
+  output between the low and the high watermark. Readers copy out of the ring
+  under the pool lock and wipe what they took, so a read costs a memcpy instead
+  of a start-up test and the EHR fills.
+
+  The producer collects CC_CONFIG_TRNG_POOL_CHUNK_BYTES at a time straight into
+  the free part of the ring, outside the pool lock: readers only touch the
+  [tail, tail + level) part, and only the producer adds to it. A chunk is
+  published when its collection succeeded and wiped when it failed, as
+  CC_TrngGetSource() does with its output.
+*/
+
+typedef struct {
+    unsigned long rngRegBase;
+    uint32_t starting;              /* claimed by a CC_TrngPoolStart that has not set 'running' yet */
+    uint32_t running;               /* between CC_TrngPoolStart and the end of CC_TrngPoolStop */
+    uint32_t stopping;
+    uint32_t filling;               /* refill in progress, from the low to the high watermark */
+    uint32_t tail;                  /* oldest byte in the ring */
+    uint32_t level;
+    CCTrngPoolStatus_t status;
+} PoolCtl_t;
+
+/* Collection position in the ring */
+typedef struct {
+    uint32_t pos;
+} PoolFill_t;
+
+static uint8_t gPoolBuf[CC_CONFIG_TRNG_POOL_BYTES]
+    __attribute__((aligned(CC_CONFIG_TRNG_CACHE_LINE_BYTES)));
+/* written on every read and refill: kept off the cache lines of the buffer */
+static PoolCtl_t gPool __attribute__((aligned(CC_CONFIG_TRNG_CACHE_LINE_BYTES)));
+
+/* LLFRndSink_t: write into the ring, wrapping at its end */
+static void PoolSink(void *ctx, const uint8_t *data, uint32_t len)
+{
+    PoolFill_t *pFill = (PoolFill_t *)ctx;
+    uint32_t n = CC_CONFIG_TRNG_POOL_BYTES - pFill->pos;
+
+    if (n > len)
+        n = len;
+    tztrng_memcpy(gPoolBuf + pFill->pos, (uint8_t *)data, n);
+    tztrng_memcpy(gPoolBuf, (uint8_t *)data + n, len - n);
+    pFill->pos = (pFill->pos + len) % CC_CONFIG_TRNG_POOL_BYTES;
+}
+
+/* Wipe 'len' bytes of the ring from 'pos' on */
+static void PoolWipe(uint32_t pos, uint32_t len)
+{
+    uint32_t n = CC_CONFIG_TRNG_POOL_BYTES - pos;
+
+    if (n > len)
+        n = len;
+    tztrng_secure_zero(gPoolBuf + pos, n);
+    tztrng_secure_zero(gPoolBuf, len - n);
+}
+
+static void PoolProducer(void)
+{
+    CCError_t Err;
+    PoolFill_t fill;
+    uint32_t start, n;
+
+    tztrng_pal_syncLock();
+    while (!gPool.stopping) {
+        if (gPool.level <= CC_CONFIG_TRNG_POOL_LOW_WATERMARK)
+            gPool.filling = 1;
+        if (gPool.level >= CC_CONFIG_TRNG_POOL_HIGH_WATERMARK)
+            gPool.filling = 0;
+        if (!gPool.filling) {
+            tztrng_pal_syncWait(TZTRNG_PAL_EVT_POOL_REFILL, CC_CONFIG_TRNG_POOL_RETRY_MS * 1000UL);
+            continue;
+        }
+
+        /* the free part only grows while the lock is released */
+        n = CC_CONFIG_TRNG_POOL_HIGH_WATERMARK - gPool.level;
+        if (n > CC_CONFIG_TRNG_POOL_CHUNK_BYTES)
+            n = CC_CONFIG_TRNG_POOL_CHUNK_BYTES;
+        start = (gPool.tail + gPool.level) % CC_CONFIG_TRNG_POOL_BYTES;
+        fill.pos = start;
+        tztrng_pal_syncUnlock();
+
+        Err = LLF_RND_CollectSource(gPool.rngRegBase, (size_t)n * 8, PoolSink, &fill);
+
+        tztrng_pal_syncLock();
+        if (Err != CC_OK) {
+            TRNG_LOG_DEBUG("pool refill failed, err[0x%X]\n", (unsigned int)Err);
+            PoolWipe(start, n);
+            gPool.status.lastError = Err;
+            gPool.status.refillErrors++;
+            /* readers waiting on an empty pool fail instead of waiting for the retry */
+            tztrng_pal_syncSignal(TZTRNG_PAL_EVT_POOL_DATA);
+            tztrng_pal_syncWait(TZTRNG_PAL_EVT_POOL_REFILL, CC_CONFIG_TRNG_POOL_RETRY_MS * 1000UL);
+            continue;
+        }
+
+        gPool.level += n;
+        gPool.status.lastError = CC_OK;
+        gPool.status.refills++;
+        tztrng_pal_syncSignal(TZTRNG_PAL_EVT_POOL_DATA);
+    }
+    tztrng_pal_syncUnlock();
+}
+
+uint32_t CC_TrngPoolStart(unsigned long rngRegBase)
+{
+    if (rngRegBase == 0) {
+        TRNG_LOG_DEBUG("register base not initialized\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+
+    /* claim the pool in the same section as the check: a concurrent start fails */
+    tztrng_pal_syncLock();
+    if (gPool.running || gPool.starting) {
+        tztrng_pal_syncUnlock();
+        return CC_RND_TRNG_POOL_STATE_ERROR;
+    }
+    tztrng_memset((uint8_t *)&gPool, 0, sizeof(gPool));
+    gPool.starting = 1;
+    gPool.rngRegBase = rngRegBase;
+    gPool.status.capacity = CC_CONFIG_TRNG_POOL_BYTES;
+    gPool.status.lowWatermark = CC_CONFIG_TRNG_POOL_LOW_WATERMARK;
+    gPool.status.highWatermark = CC_CONFIG_TRNG_POOL_HIGH_WATERMARK;
+    tztrng_pal_syncUnlock();
+
+    if (tztrng_pal_memLock(gPoolBuf, sizeof(gPoolBuf)) != 0) {
+        tztrng_pal_syncLock();
+        gPool.starting = 0;
+        tztrng_pal_syncUnlock();
+        return CC_RND_TRNG_POOL_RESOURCE_ERROR;
+    }
+
+    /* readers and CC_TrngPoolStop see the pool once its producer runs */
+    if (tztrng_pal_poolStart(PoolProducer) != 0) {
+        TRNG_LOG_DEBUG("failed to start the pool producer\n");
+        tztrng_pal_syncLock();
+        gPool.starting = 0;
+        tztrng_pal_syncUnlock();
+        tztrng_pal_memUnlock(gPoolBuf, sizeof(gPoolBuf));
+        return CC_RND_TRNG_POOL_RESOURCE_ERROR;
+    }
+
+    tztrng_pal_syncLock();
+    gPool.running = 1;
+    gPool.starting = 0;
+    tztrng_pal_syncUnlock();
+
+    return CC_OK;
+}
+
+uint32_t CC_TrngPoolRead(uint8_t *outAddr, size_t outLen)
+{
+    CCError_t Err = CC_OK;
+    size_t done = 0;
+    uint32_t n, part;
+
+    if (NULL == outAddr) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+
+    tztrng_pal_syncLock();
+    gPool.status.reads++;
+    while (done < outLen) {
+        if (!gPool.running || gPool.stopping) {
+            Err = CC_RND_TRNG_POOL_STATE_ERROR;
+            break;
+        }
+        if (gPool.level == 0) {
+            if (gPool.status.lastError != CC_OK) {
+                Err = gPool.status.lastError;
+                break;
+            }
+            gPool.status.readWaits++;
+            tztrng_pal_syncSignal(TZTRNG_PAL_EVT_POOL_REFILL);
+            tztrng_pal_syncWait(TZTRNG_PAL_EVT_POOL_DATA, CC_CONFIG_TRNG_POOL_RETRY_MS * 1000UL);
+            continue;
+        }
+
+        n = gPool.level;
+        if (n > outLen - done)
+            n = (uint32_t)(outLen - done);
+        part = CC_CONFIG_TRNG_POOL_BYTES - gPool.tail;
+        if (part > n)
+            part = n;
+        tztrng_memcpy(outAddr + done, gPoolBuf + gPool.tail, part);
+        tztrng_memcpy(outAddr + done + part, gPoolBuf, n - part);
+        PoolWipe(gPool.tail, n);
+
+        gPool.tail = (gPool.tail + n) % CC_CONFIG_TRNG_POOL_BYTES;
+        gPool.level -= n;
+        gPool.status.bytesRead += n;
+        done += n;
+        if (gPool.level <= CC_CONFIG_TRNG_POOL_LOW_WATERMARK)
+            tztrng_pal_syncSignal(TZTRNG_PAL_EVT_POOL_REFILL);
+    }
+    tztrng_pal_syncUnlock();
+
+    if (Err != CC_OK)
+        tztrng_secure_zero(outAddr, outLen);
+
+    return Err;
+}
+
+uint32_t CC_TrngPoolStop(void)
+{
+    tztrng_pal_syncLock();
+    if (!gPool.running || gPool.stopping) {
+        tztrng_pal_syncUnlock();
+        return CC_RND_TRNG_POOL_STATE_ERROR;
+    }
+    gPool.stopping = 1;
+    tztrng_pal_syncSignal(TZTRNG_PAL_EVT_POOL_REFILL);
+    tztrng_pal_syncSignal(TZTRNG_PAL_EVT_POOL_DATA);
+    tztrng_pal_syncUnlock();
+
+    /* the producer finishes its current collection first */
+    tztrng_pal_poolJoin();
+
+    tztrng_pal_syncLock();
+    tztrng_secure_zero(gPoolBuf, sizeof(gPoolBuf));
+    gPool.tail = 0;
+    gPool.level = 0;
+    gPool.running = 0;
+    gPool.stopping = 0;
+    tztrng_pal_syncUnlock();
+
+    tztrng_pal_memUnlock(gPoolBuf, sizeof(gPoolBuf));
+
+    return CC_OK;
+}
+
+uint32_t CC_TrngPoolGetStatus(CCTrngPoolStatus_t *pStatus)
+{
+    if (NULL == pStatus) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+
+    tztrng_pal_syncLock();
+    *pStatus = gPool.status;
+    pStatus->level = gPool.level;
+    tztrng_pal_syncUnlock();
+
+    return CC_OK;
+}
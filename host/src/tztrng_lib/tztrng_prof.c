@@ -0,0 +1,130 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  Phase profiler.
+
+  TRNG_PROF_BEGIN/TRNG_PROF_END take a tztrng_pal_timestamp() at each phase
+  boundary; the duration goes into a log2 bucketed histogram of the phase.
+  Without CC_CONFIG_TRNG_PROFILE the macros expand to nothing and this file is
+  not built.
+*/
+
+static const char *gProfPhaseName[CC_TRNG_PROF_NUM_PHASES] = {
+    "params",
+    "start_hw",
+    "sample_cnt",
+    "wait",
+    "ehr_read",
+    "cont_test",
+    "copy",
+    "wipe",
+    "total",
+};
+
+static CCTrngProfile_t gProfile;
+
+static uint32_t LLF_RND_ProfBucket(uint64_t ticks)
+{
+    uint32_t bucket = 0;
+
+    while ((ticks != 0) && (bucket < CC_TRNG_PROF_NUM_BUCKETS - 1)) {
+        ticks >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+void LLF_RND_ProfRecord(CCTrngProfPhase_t phase, uint64_t startTs)
+{
+    uint64_t ticks = tztrng_pal_timestamp() - startTs;
+    CCTrngProfHist_t *pHist = &gProfile.phase[phase];
+
+    if ((pHist->count == 0) || (ticks < pHist->min))
+        pHist->min = ticks;
+    if (ticks > pHist->max)
+        pHist->max = ticks;
+    pHist->count++;
+    pHist->sum += ticks;
+    pHist->hist[LLF_RND_ProfBucket(ticks)]++;
+}
+
+uint32_t CC_TrngGetProfile(CCTrngProfile_t *pProfile)
+{
+    if (pProfile == NULL)
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+
+    tztrng_memcpy((uint8_t *)pProfile, (uint8_t *)&gProfile, sizeof(CCTrngProfile_t));
+
+    return CC_OK;
+}
+
+void CC_TrngResetProfile(void)
+{
+    tztrng_memset((uint8_t *)&gProfile, 0, sizeof(CCTrngProfile_t));
+}
+
+uint32_t CC_TrngProfileToCsv(char *outBuf, size_t *outLen)
+{
+    size_t size, len = 0;
+    uint32_t i, b;
+    int n;
+    CCTrngProfHist_t *pHist;
+
+    if ((outBuf == NULL) || (outLen == NULL))
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+
+    size = *outLen;
+
+    /* snprintf reports the full length even when it truncates, so 'len' keeps
+       counting the required size once the buffer is exhausted */
+#define TZTRNG_PROF_PRINT(...) \
+    do { \
+        n = snprintf(outBuf + ((len < size) ? len : size), \
+                     (len < size) ? size - len : 0, __VA_ARGS__); \
+        if (n > 0) \
+            len += (size_t)n; \
+    } while (0)
+
+    TZTRNG_PROF_PRINT("phase,count,min,max,sum");
+    for (b = 0; b < CC_TRNG_PROF_NUM_BUCKETS; b++)
+        TZTRNG_PROF_PRINT(",b%u", (unsigned int)b);
+    TZTRNG_PROF_PRINT("\n");
+
+    for (i = 0; i < CC_TRNG_PROF_NUM_PHASES; i++) {
+        pHist = &gProfile.phase[i];
+        TZTRNG_PROF_PRINT("%s,%u,%llu,%llu,%llu", gProfPhaseName[i],
+                          (unsigned int)pHist->count, (unsigned long long)pHist->min,
+                          (unsigned long long)pHist->max, (unsigned long long)pHist->sum);
+        for (b = 0; b < CC_TRNG_PROF_NUM_BUCKETS; b++)
+            TZTRNG_PROF_PRINT(",%u", (unsigned int)pHist->hist[b]);
+        TZTRNG_PROF_PRINT("\n");
+    }
+
+#undef TZTRNG_PROF_PRINT
+
+    *outLen = len;
+    if (len >= size)
+        return LLF_RND_TRNG_BUFFER_TOO_SMALL_ERROR;
+
+    return CC_OK;
+}
@@ -0,0 +1,215 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+
+/*
+  SHA-256 (FIPS 180-4) for the vetted conditioning component.
+
+  The compression function uses the Armv8 SHA2 instructions (SHA256H/H2/SU0/SU1)
+  when the compiler targets them (CC_CONFIG_TRNG_CRYPTO_EXT=1 adds
+  -march=armv8-a+crypto on ARCH=arm64), portable C otherwise.
+*/
+
+#if defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+#define LLF_SHA256_USE_CE
+#include <arm_neon.h>
+#endif
+
+#define GETU32(p)   (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | \
+                     ((uint32_t)(p)[2] << 8) | ((uint32_t)(p)[3]))
+#define PUTU32(p, v) do { (p)[0] = (uint8_t)((v) >> 24); (p)[1] = (uint8_t)((v) >> 16); \
+                          (p)[2] = (uint8_t)((v) >> 8); (p)[3] = (uint8_t)(v); } while (0)
+
+static const uint32_t gSha256K[64] = {
+    0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+    0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL, 0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+    0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL, 0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+    0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL, 0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+    0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL, 0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+    0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL, 0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+    0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL, 0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+    0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL, 0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL,
+};
+
+#ifdef LLF_SHA256_USE_CE
+
+static void Sha256Blocks(uint32_t *state, const uint8_t *data, size_t blocks)
+{
+    uint32x4_t abcd = vld1q_u32(&state[0]);
+    uint32x4_t efgh = vld1q_u32(&state[4]);
+    uint32x4_t abcdSave, efghSave, wk, tmp;
+    uint32x4_t w[4];
+    uint32_t i;
+
+    for (; blocks > 0; blocks--, data += 64) {
+        abcdSave = abcd;
+        efghSave = efgh;
+
+        for (i = 0; i < 4; i++)
+            w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+
+        /* 16 groups of 4 rounds; the schedule runs 3 groups ahead */
+        for (i = 0; i < 16; i++) {
+            wk = vaddq_u32(w[i & 3], vld1q_u32(&gSha256K[4 * i]));
+            if (i < 12)
+                w[i & 3] = vsha256su1q_u32(vsha256su0q_u32(w[i & 3], w[(i + 1) & 3]),
+                                           w[(i + 2) & 3], w[(i + 3) & 3]);
+            tmp = abcd;
+            abcd = vsha256hq_u32(abcd, efgh, wk);
+            efgh = vsha256h2q_u32(efgh, tmp, wk);
+        }
+
+        abcd = vaddq_u32(abcd, abcdSave);
+        efgh = vaddq_u32(efgh, efghSave);
+    }
+
+    vst1q_u32(&state[0], abcd);
+    vst1q_u32(&state[4], efgh);
+}
+
+#else /* LLF_SHA256_USE_CE */
+
+#define ROR32(x, n)     (((x) >> (n)) | ((x) << (32 - (n))))
+#define SHA_CH(x, y, z)     (((x) & (y)) ^ (~(x) & (z)))
+#define SHA_MAJ(x, y, z)    (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define SHA_S0(x)       (ROR32((x), 2) ^ ROR32((x), 13) ^ ROR32((x), 22))
+#define SHA_S1(x)       (ROR32((x), 6) ^ ROR32((x), 11) ^ ROR32((x), 25))
+#define SHA_G0(x)       (ROR32((x), 7) ^ ROR32((x), 18) ^ ((x) >> 3))
+#define SHA_G1(x)       (ROR32((x), 17) ^ ROR32((x), 19) ^ ((x) >> 10))
+
+static void Sha256Blocks(uint32_t *state, const uint8_t *data, size_t blocks)
+{
+    uint32_t w[16];
+    uint32_t a, b, c, d, e, f, g, h, t1, t2;
+    uint32_t i;
+
+    for (; blocks > 0; blocks--, data += 64) {
+        a = state[0];
+        b = state[1];
+        c = state[2];
+        d = state[3];
+        e = state[4];
+        f = state[5];
+        g = state[6];
+        h = state[7];
+
+        for (i = 0; i < 64; i++) {
+            /* message schedule in a 16 word ring */
+            if (i < 16)
+                w[i] = GETU32(data + 4 * i);
+            else
+                w[i & 15] += SHA_G1(w[(i + 14) & 15]) + w[(i + 9) & 15] + SHA_G0(w[(i + 1) & 15]);
+
+            t1 = h + SHA_S1(e) + SHA_CH(e, f, g) + gSha256K[i] + w[i & 15];
+            t2 = SHA_S0(a) + SHA_MAJ(a, b, c);
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+
+    tztrng_secure_zero(w, sizeof(w));
+}
+
+#endif /* LLF_SHA256_USE_CE */
+
+void LLF_SHA256_Init(LLFSha256Ctx_t *pCtx)
+{
+    pCtx->state[0] = 0x6a09e667UL;
+    pCtx->state[1] = 0xbb67ae85UL;
+    pCtx->state[2] = 0x3c6ef372UL;
+    pCtx->state[3] = 0xa54ff53aUL;
+    pCtx->state[4] = 0x510e527fUL;
+    pCtx->state[5] = 0x9b05688cUL;
+    pCtx->state[6] = 0x1f83d9abUL;
+    pCtx->state[7] = 0x5be0cd19UL;
+    pCtx->totalBytes = 0;
+    pCtx->fill = 0;
+}
+
+void LLF_SHA256_Update(LLFSha256Ctx_t *pCtx, const uint8_t *data, size_t len)
+{
+    size_t n;
+
+    pCtx->totalBytes += len;
+
+    if (pCtx->fill > 0) {
+        n = LLF_SHA256_BLOCK_BYTES - pCtx->fill;
+        if (n > len)
+            n = len;
+        tztrng_memcpy(pCtx->buf + pCtx->fill, (uint8_t *)data, n);
+        pCtx->fill += (uint32_t)n;
+        data += n;
+        len -= n;
+        if (pCtx->fill < LLF_SHA256_BLOCK_BYTES)
+            return;
+        Sha256Blocks(pCtx->state, pCtx->buf, 1);
+        pCtx->fill = 0;
+    }
+
+    /* whole blocks straight from the input */
+    n = len / LLF_SHA256_BLOCK_BYTES;
+    if (n > 0) {
+        Sha256Blocks(pCtx->state, data, n);
+        data += n * LLF_SHA256_BLOCK_BYTES;
+        len -= n * LLF_SHA256_BLOCK_BYTES;
+    }
+
+    if (len > 0) {
+        tztrng_memcpy(pCtx->buf, (uint8_t *)data, len);
+        pCtx->fill = (uint32_t)len;
+    }
+}
+
+void LLF_SHA256_Final(LLFSha256Ctx_t *pCtx, uint8_t *digest)
+{
+    uint64_t bits = pCtx->totalBytes * 8;
+    uint32_t i;
+
+    /* 0x80, zeros, 64 bit big endian message length */
+    pCtx->buf[pCtx->fill++] = 0x80;
+    if (pCtx->fill > LLF_SHA256_BLOCK_BYTES - 8) {
+        tztrng_memset(pCtx->buf + pCtx->fill, 0, LLF_SHA256_BLOCK_BYTES - pCtx->fill);
+        Sha256Blocks(pCtx->state, pCtx->buf, 1);
+        pCtx->fill = 0;
+    }
+    tztrng_memset(pCtx->buf + pCtx->fill, 0, LLF_SHA256_BLOCK_BYTES - 8 - pCtx->fill);
+    PUTU32(pCtx->buf + LLF_SHA256_BLOCK_BYTES - 8, (uint32_t)(bits >> 32));
+    PUTU32(pCtx->buf + LLF_SHA256_BLOCK_BYTES - 4, (uint32_t)bits);
+    Sha256Blocks(pCtx->state, pCtx->buf, 1);
+
+    for (i = 0; i < 8; i++)
+        PUTU32(digest + 4 * i, pCtx->state[i]);
+
+    tztrng_secure_zero(pCtx, sizeof(LLFSha256Ctx_t));
+}
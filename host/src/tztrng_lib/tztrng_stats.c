@@ -0,0 +1,45 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  Driver statistics.
+
+  The counters are updated in place by TRNG_STAT_INC/TRNG_STAT_ADD, one plain
+  increment per event. Without CC_CONFIG_TRNG_STATS the macros expand to nothing
+  and this file is not built.
+*/
+
+CCTrngStats_t gTrngStats;
+
+uint32_t CC_TrngGetStats(CCTrngStats_t *pStats)
+{
+    if (pStats == NULL)
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+
+    tztrng_memcpy((uint8_t *)pStats, (uint8_t *)&gTrngStats, sizeof(CCTrngStats_t));
+
+    return CC_OK;
+}
+
+void CC_TrngResetStats(void)
+{
+    tztrng_memset((uint8_t *)&gTrngStats, 0, sizeof(CCTrngStats_t));
+}
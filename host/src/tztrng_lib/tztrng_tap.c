@@ -0,0 +1,138 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  Raw-noise tap.
+
+  The EHR readouts of the driver (readEhrData() in TRNG90B mode,
+  LLF_RND_TRNG_ReadEhrData() in FE mode, the asynchronous collection) push a
+  copy of each EHR into a ring that a consumer drains with
+  CC_TrngNoiseTapRead(), to a file or a socket. The TRNG is owned by one
+  collection at a time, so there is one producer and the ring needs no lock:
+  the producer owns the head, the consumer the tail, and each publishes its
+  index with a release store. A push costs a copy of one record. When the ring
+  is full the EHR is dropped and counted rather than waited for: a slow
+  consumer loses records, the collection never stalls.
+*/
+
+#define NOISE_TAP_MASK  (CC_CONFIG_TRNG_NOISE_TAP_RECORDS - 1)
+
+typedef struct {
+    uint32_t enabled;
+    uint32_t head;                  /* records pushed, producer */
+    uint32_t tail;                  /* records read, consumer */
+    uint32_t rosc;                  /* source of the EHRs read now, producer */
+    uint32_t sampleCnt;
+    uint32_t ehrs;                  /* counters, written by the producer */
+    uint32_t records;
+    uint32_t drops;
+    CCTrngNoiseRecord_t ring[CC_CONFIG_TRNG_NOISE_TAP_RECORDS];
+} NoiseTap_t;
+
+static NoiseTap_t gNoiseTap;
+
+void LLF_RND_NoiseTapSetSource(uint32_t rosc, uint32_t sampleCnt)
+{
+    gNoiseTap.rosc = rosc;
+    gNoiseTap.sampleCnt = sampleCnt;
+}
+
+void LLF_RND_NoiseTapPush(const uint32_t *ehr)
+{
+    CCTrngNoiseRecord_t *pRec;
+    uint32_t head, seq;
+
+    if (!__atomic_load_n(&gNoiseTap.enabled, __ATOMIC_RELAXED))
+        return;
+
+    seq = gNoiseTap.ehrs;
+    __atomic_store_n(&gNoiseTap.ehrs, seq + 1, __ATOMIC_RELAXED);
+    head = gNoiseTap.head;
+    if (head - __atomic_load_n(&gNoiseTap.tail, __ATOMIC_ACQUIRE) >= CC_CONFIG_TRNG_NOISE_TAP_RECORDS) {
+        __atomic_store_n(&gNoiseTap.drops, gNoiseTap.drops + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    pRec = &gNoiseTap.ring[head & NOISE_TAP_MASK];
+    pRec->seq = seq;
+    pRec->rosc = gNoiseTap.rosc;
+    pRec->sampleCnt = gNoiseTap.sampleCnt;
+    tztrng_memcpy((uint8_t *)pRec->ehr, (uint8_t *)ehr, sizeof(pRec->ehr));
+    __atomic_store_n(&gNoiseTap.records, gNoiseTap.records + 1, __ATOMIC_RELAXED);
+    /* the record is complete before the consumer sees it */
+    __atomic_store_n(&gNoiseTap.head, head + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t CC_TrngNoiseTapStart(void)
+{
+    uint32_t head = __atomic_load_n(&gNoiseTap.head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&gNoiseTap.tail, __ATOMIC_RELAXED);
+
+    /* discard what the last session left */
+    for (; tail != head; tail++)
+        tztrng_secure_zero(&gNoiseTap.ring[tail & NOISE_TAP_MASK], sizeof(CCTrngNoiseRecord_t));
+    __atomic_store_n(&gNoiseTap.tail, tail, __ATOMIC_RELEASE);
+    __atomic_store_n(&gNoiseTap.enabled, 1, __ATOMIC_RELEASE);
+
+    return CC_OK;
+}
+
+void CC_TrngNoiseTapStop(void)
+{
+    __atomic_store_n(&gNoiseTap.enabled, 0, __ATOMIC_RELEASE);
+}
+
+uint32_t CC_TrngNoiseTapRead(CCTrngNoiseRecord_t *pRecords, uint32_t maxRecords, uint32_t *pNumRecords)
+{
+    CCTrngNoiseRecord_t *pRec;
+    uint32_t head, tail, n = 0;
+
+    if ((pRecords == NULL) || (pNumRecords == NULL))
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+
+    head = __atomic_load_n(&gNoiseTap.head, __ATOMIC_ACQUIRE);
+    tail = __atomic_load_n(&gNoiseTap.tail, __ATOMIC_RELAXED);
+    while ((tail != head) && (n < maxRecords)) {
+        pRec = &gNoiseTap.ring[tail & NOISE_TAP_MASK];
+        tztrng_memcpy((uint8_t *)&pRecords[n++], (uint8_t *)pRec, sizeof(*pRec));
+        tztrng_secure_zero(pRec, sizeof(*pRec));
+        tail++;
+    }
+    /* the slots are copied and wiped before the producer may refill them */
+    __atomic_store_n(&gNoiseTap.tail, tail, __ATOMIC_RELEASE);
+    *pNumRecords = n;
+
+    return CC_OK;
+}
+
+uint32_t CC_TrngNoiseTapGetStats(CCTrngNoiseTapStats_t *pStats)
+{
+    if (pStats == NULL)
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+
+    pStats->ehrs = __atomic_load_n(&gNoiseTap.ehrs, __ATOMIC_RELAXED);
+    pStats->records = __atomic_load_n(&gNoiseTap.records, __ATOMIC_RELAXED);
+    pStats->drops = __atomic_load_n(&gNoiseTap.drops, __ATOMIC_RELAXED);
+    pStats->level = __atomic_load_n(&gNoiseTap.head, __ATOMIC_ACQUIRE) -
+                    __atomic_load_n(&gNoiseTap.tail, __ATOMIC_ACQUIRE);
+
+    return CC_OK;
+}
@@ -0,0 +1,89 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  Hardware telemetry.
+
+  The snapshot only reads status registers, it does not start, stop or reset
+  the TRNG. RST_BITS_COUNTER is not part of it: writing it restarts the bit
+  counter, it does not hold a count to read.
+*/
+
+/* value of field 'fld' of register 'reg' */
+#define LLF_RND_TELEMETRY_FLD(reg, fld, val) \
+    (((val) >> DX_ ## reg ## _ ## fld ## _BIT_SHIFT) & \
+     ((1UL << DX_ ## reg ## _ ## fld ## _BIT_SIZE) - 1))
+
+static uint32_t gIsrHistory[CC_TRNG_ISR_HISTORY_ENTRIES];
+static uint32_t gIsrCount = 0;
+
+void LLF_RND_TelemetryRecordIsr(uint32_t isr)
+{
+    gIsrHistory[gIsrCount % CC_TRNG_ISR_HISTORY_ENTRIES] = isr;
+    gIsrCount++;
+}
+
+static void TelemetrySnapshotLocked(CCTrngHwTelemetry_t *pTelemetry)
+{
+    uint32_t i, first, regVal;
+
+    pTelemetry->rosc = CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, TRNG_CONFIG)) & (LLF_RND_NUM_OF_ROSCS - 1);
+    pTelemetry->sampleCnt = CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, SAMPLE_CNT1));
+
+    regVal = CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, RNG_BUSY));
+    pTelemetry->busy = LLF_RND_TELEMETRY_FLD(RNG_BUSY, RNG_BUSY, regVal);
+
+    regVal = CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, AUTOCORR_STATISTIC));
+    pTelemetry->autocorrTrys = LLF_RND_TELEMETRY_FLD(AUTOCORR_STATISTIC, AUTOCORR_TRYS, regVal);
+    pTelemetry->autocorrFails = LLF_RND_TELEMETRY_FLD(AUTOCORR_STATISTIC, AUTOCORR_FAILS, regVal);
+
+    regVal = CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, RNG_BIST_CNTR_0));
+    pTelemetry->bistCntr[0] = LLF_RND_TELEMETRY_FLD(RNG_BIST_CNTR_0, ROSC_CNTR_VAL, regVal);
+    regVal = CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, RNG_BIST_CNTR_1));
+    pTelemetry->bistCntr[1] = LLF_RND_TELEMETRY_FLD(RNG_BIST_CNTR_1, ROSC_CNTR_VAL, regVal);
+    regVal = CC_HAL_READ_REGISTER(CC_REG_OFFSET(RNG, RNG_BIST_CNTR_2));
+    pTelemetry->bistCntr[2] = LLF_RND_TELEMETRY_FLD(RNG_BIST_CNTR_2, ROSC_CNTR_VAL, regVal);
+
+    pTelemetry->isrCount = gIsrCount;
+    pTelemetry->isrHistoryLen = (gIsrCount < CC_TRNG_ISR_HISTORY_ENTRIES) ? gIsrCount : CC_TRNG_ISR_HISTORY_ENTRIES;
+    first = gIsrCount - pTelemetry->isrHistoryLen;
+    for (i = 0; i < pTelemetry->isrHistoryLen; i++)
+        pTelemetry->isrHistory[i] = gIsrHistory[(first + i) % CC_TRNG_ISR_HISTORY_ENTRIES];
+}
+
+uint32_t CC_TrngGetHwTelemetry(unsigned long rngRegBase, CCTrngHwTelemetry_t *pTelemetry)
+{
+    if (pTelemetry == NULL)
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+
+    if (rngRegBase == 0) {
+        TRNG_LOG_DEBUG("register base not initialized\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+
+    /* gCcRegBase and the ISR history are shared with CC_TrngGetSource callers */
+    TZTRNG_PAL_LOCK();
+    gCcRegBase = rngRegBase;
+    TelemetrySnapshotLocked(pTelemetry);
+    TZTRNG_PAL_UNLOCK();
+
+    return CC_OK;
+}
@@ -0,0 +1,142 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include "tztrng_defs.h"
+#include "tztrng_pal.h"
+#include "tztrng.h"
+
+/*
+  TLS entropy poll adapter.
+
+  TLS stacks gather seed material through many small entropy source polls,
+  at start-up and at every reseed. Each CC_TrngGetSource() call pays for a
+  TRNG restart and the start-up test, so the adapter collects
+  CC_TRNG_TLS_POLL_BYTES at a time into its buffer and serves the polls from
+  there. The buffer is used as a stack: polls take from the top, a collection
+  appends above the bytes still buffered, so a prefetch never moves data.
+*/
+
+/* Collect into the free part of the buffer, up to its end */
+static CCError_t TlsCollect(CCTrngTlsPoll_t *pCtx)
+{
+    size_t outLen = 0;
+    CCError_t err;
+
+    err = CC_TrngGetSource(pCtx->rngRegBase, pCtx->buf + pCtx->level, &outLen,
+                           (CC_TRNG_TLS_POLL_BYTES - pCtx->level) * 8);
+    pCtx->stats.collections++;
+    if (err != CC_OK) {
+        pCtx->stats.errors++;
+        pCtx->stats.lastError = err;
+        return err;
+    }
+    pCtx->level = CC_TRNG_TLS_POLL_BYTES;
+
+    return CC_OK;
+}
+
+uint32_t CC_TrngTlsPollInit(CCTrngTlsPoll_t *pCtx, unsigned long rngRegBase)
+{
+    if ((NULL == pCtx) || (0 == rngRegBase)) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+
+    tztrng_memset((uint8_t *)pCtx, 0, sizeof(*pCtx));
+    pCtx->rngRegBase = rngRegBase;
+
+    return CC_OK;
+}
+
+int CC_TrngTlsPoll(void *data, unsigned char *output, size_t len, size_t *olen)
+{
+    CCTrngTlsPoll_t *pCtx = (CCTrngTlsPoll_t *)data;
+    size_t done = 0, n;
+    uint32_t collected = 0;
+
+    if ((NULL == pCtx) || (NULL == output) || (NULL == olen))
+        return CC_TRNG_TLS_POLL_FAILED;
+
+    *olen = 0;
+    pCtx->stats.polls++;
+
+    while (done < len) {
+        if (pCtx->level == 0) {
+            if (!collected) {
+                pCtx->stats.pollCollections++;
+                collected = 1;
+            }
+            if (TlsCollect(pCtx) != CC_OK) {
+                tztrng_secure_zero(output, done);
+                return CC_TRNG_TLS_POLL_FAILED;
+            }
+        }
+
+        n = len - done;
+        if (n > pCtx->level)
+            n = pCtx->level;
+        pCtx->level -= (uint32_t)n;
+        tztrng_memcpy(output + done, pCtx->buf + pCtx->level, n);
+        tztrng_secure_zero(pCtx->buf + pCtx->level, n);
+        done += n;
+    }
+
+    /* 64 bit totals: size_t would wrap on a long-running 32 bit server */
+    pCtx->stats.bytes += len;
+    pCtx->stats.entropyBits = (pCtx->stats.bytes * 8 * CC_CONFIG_TRNG_ENTROPY_PER_BIT_Q8) / 256;
+    *olen = len;
+
+    return 0;
+}
+
+uint32_t CC_TrngTlsPrefetch(CCTrngTlsPoll_t *pCtx, size_t bytes)
+{
+    CCError_t err;
+
+    if (NULL == pCtx) {
+        TRNG_LOG_DEBUG("NULL pointer!!\n");
+        return LLF_RND_TRNG_ILLEGAL_PTR_ERROR;
+    }
+    if (bytes > CC_TRNG_TLS_POLL_BYTES)
+        return LLF_RND_TRNG_BUFFER_TOO_SMALL_ERROR;
+    if (pCtx->level >= bytes)
+        return CC_OK;
+
+    pCtx->stats.prefetches++;
+    err = TlsCollect(pCtx);
+
+    return err;
+}
+
+size_t CC_TrngTlsPollThreshold(size_t entropyBits)
+{
+    /* ROUND_UP(entropyBits / (8 * entropy per bit)) */
+    return (entropyBits * 256 + 8 * CC_CONFIG_TRNG_ENTROPY_PER_BIT_Q8 - 1) / (8 * CC_CONFIG_TRNG_ENTROPY_PER_BIT_Q8);
+}
+
+size_t CC_TrngTlsPollEntropyBits(size_t bytes)
+{
+    return (size_t)(((uint64_t)bytes * 8 * CC_CONFIG_TRNG_ENTROPY_PER_BIT_Q8) / 256);
+}
+
+void CC_TrngTlsPollFree(CCTrngTlsPoll_t *pCtx)
+{
+    if (NULL == pCtx)
+        return;
+
+    tztrng_secure_zero(pCtx, sizeof(*pCtx));
+}
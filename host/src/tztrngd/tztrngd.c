@@ -0,0 +1,813 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "tztrng.h"
+#include "tztrng_test_pal.h"
+#include "tztrng_test_pal_api.h"
+#include "tztrngd_proto.h"
+#include "tztrngd_shm.h"
+#ifdef TZTRNGD_MODEL
+#include "tztrng_target.h"
+#endif
+
+#include "dx_reg_base_host.h"
+
+/*
+ * Local entropy daemon (library built with CC_CONFIG_TRNG_POOL = 1).
+ *
+ * The daemon is the only process that maps the TRNG. Its entropy pool producer
+ * collects health-tested CC_TrngGetSource() output ahead of demand, so the
+ * hardware collection overlaps with serving the clients.
+ *
+ * Clients connect to a SOCK_SEQPACKET Unix socket and send the requests of
+ * tztrngd_proto.h. In each round of the event loop the daemon takes the
+ * pending requests of all readable clients (a few per client, so a pipelining
+ * client cannot starve the others), serves all their bytes with one
+ * CC_TrngPoolRead() and answers each request with one writev() of the header
+ * and its slice of the batch, which is then wiped.
+ *
+ * Each connection has a token bucket of -r bytes per second and -b bytes;
+ * a GET above the tokens left is refused with TZTRNGD_STATUS_RATE_LIMITED.
+ * SIGUSR1 writes the counters of the daemon and of every client to stderr,
+ * SIGINT and SIGTERM stop the daemon.
+ *
+ * With -S the daemon also publishes blocks of pool output into the shared
+ * memory ring of tztrngd_shm.h, for consumers that cannot afford a socket
+ * round trip per request. Its producer thread polls a full ring with a delay
+ * growing from TZTRNGD_SHM_FULL_MIN_US to TZTRNGD_SHM_FULL_MAX_US, so the
+ * consumers enter the kernel only when the ring runs empty. A block held by a
+ * consumer that died is wiped and taken back (DaemonShmReclaim). Every process
+ * that maps the ring can write to it, so it is created for the daemon's user
+ * only, or for one group given with -g, whatever the socket permissions are.
+ */
+
+#define TZTRNGD_MAX_CLIENTS             64
+/* requests taken from one client per round */
+#define TZTRNGD_RECV_PER_CLIENT         4
+#define TZTRNGD_BATCH_BYTES             (TZTRNGD_RECV_PER_CLIENT * TZTRNGD_MAX_REQUEST_BYTES)
+#define TZTRNGD_MAX_REPLIES             (TZTRNGD_MAX_CLIENTS * TZTRNGD_RECV_PER_CLIENT)
+#define TZTRNGD_DEFAULT_MODE            0666
+/* ring permissions: owner only, or owner and the -g group */
+#define TZTRNGD_DEFAULT_SHM_MODE        0600
+#define TZTRNGD_DEFAULT_SHM_GROUP_MODE  0660
+#define TZTRNGD_US_PER_SEC              1000000ULL
+#define TZTRNGD_SHM_FULL_MIN_US         1000
+#define TZTRNGD_SHM_FULL_MAX_US         50000
+#define TZTRNGD_SHM_RETRY_US            100000
+
+typedef struct {
+    int fd;                         /* -1: free slot */
+    int closing;
+    pid_t pid;
+    uid_t uid;
+    uint64_t tokens;                /* rate limit bucket, bytes * TZTRNGD_US_PER_SEC */
+    uint64_t refillUs;
+    uint32_t requests;
+    uint32_t rateLimited;
+    uint32_t errors;
+    uint64_t bytes;
+} DaemonClient_t;
+
+typedef struct {
+    DaemonClient_t *pClient;
+    TztrngdHdr_t hdr;               /* the reply */
+    uint32_t offset;                /* of the GET payload in gBatch */
+} DaemonReply_t;
+
+static DaemonClient_t gClients[TZTRNGD_MAX_CLIENTS];
+static uint32_t gNumClients;
+static DaemonReply_t gReplies[TZTRNGD_MAX_REPLIES];
+static uint32_t gNumReplies;
+static uint8_t gBatch[TZTRNGD_BATCH_BYTES];
+static uint32_t gBatchBytes;
+
+static uint32_t gRate;              /* bytes per second, 0: unlimited */
+static uint32_t gBurst;
+static uint32_t gBatches;
+static uint64_t gTotalBytes;
+
+static TztrngdShmRing_t *gShmRing;
+static pthread_t gShmThread;
+
+static volatile sig_atomic_t gStop;
+static volatile sig_atomic_t gDump;
+
+static uint64_t DaemonNowUs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * TZTRNGD_US_PER_SEC + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void DaemonSignal(int sig)
+{
+    if (sig == SIGUSR1)
+        gDump = 1;
+    else
+        gStop = 1;
+}
+
+#ifdef TZTRNGD_MODEL
+static int gUseModel;
+#endif
+
+/* 1 if the bucket of 'pClient' holds 'len' bytes, which are then taken */
+static int DaemonTakeTokens(DaemonClient_t *pClient, uint32_t len)
+{
+    uint64_t now, burst, need;
+
+    if (gRate == 0)
+        return 1;
+
+    now = DaemonNowUs();
+    burst = (uint64_t)gBurst * TZTRNGD_US_PER_SEC;
+    pClient->tokens += (now - pClient->refillUs) * gRate;
+    if (pClient->tokens > burst)
+        pClient->tokens = burst;
+    pClient->refillUs = now;
+
+    need = (uint64_t)len * TZTRNGD_US_PER_SEC;
+    if (pClient->tokens < need)
+        return 0;
+    pClient->tokens -= need;
+
+    return 1;
+}
+
+static void DaemonFillStats(const DaemonClient_t *pClient, TztrngdStats_t *pStats)
+{
+    CCTrngPoolStatus_t pool;
+
+    memset(pStats, 0, sizeof(*pStats));
+    pStats->requests = pClient->requests;
+    pStats->rateLimited = pClient->rateLimited;
+    pStats->errors = pClient->errors;
+    pStats->bytes = pClient->bytes;
+    pStats->rateBytesPerSec = gRate;
+    pStats->burstBytes = gBurst;
+    pStats->clients = gNumClients;
+    pStats->batches = gBatches;
+    pStats->totalBytes = gTotalBytes;
+    if (CC_TrngPoolGetStatus(&pool) == 0) {
+        pStats->poolLevel = pool.level;
+        pStats->poolRefills = pool.refills;
+        pStats->poolRefillErrors = pool.refillErrors;
+    }
+}
+
+/* answer the queued requests in order: one pool read for all GETs, one writev each */
+static void DaemonFlush(void)
+{
+    DaemonReply_t *pReply;
+    DaemonClient_t *pClient;
+    TztrngdStats_t stats;
+    struct iovec iov[2];
+    uint32_t i, Err = 0;
+    ssize_t n;
+
+    if (gBatchBytes > 0) {
+        Err = CC_TrngPoolRead(gBatch, gBatchBytes);
+        gBatches++;
+        if (Err != 0)
+            TZTRNG_PRINTF("pool read of %u bytes failed: error(0x%X)\n",
+                          (unsigned int)gBatchBytes, (unsigned int)Err);
+    }
+
+    for (i = 0; i < gNumReplies; i++) {
+        pReply = &gReplies[i];
+        pClient = pReply->pClient;
+
+        iov[0].iov_base = &pReply->hdr;
+        iov[0].iov_len = sizeof(pReply->hdr);
+        iov[1].iov_len = 0;
+        if ((pReply->hdr.type == TZTRNGD_MSG_GET) && (pReply->hdr.status == TZTRNGD_STATUS_OK)) {
+            if (Err != 0) {
+                pReply->hdr.status = TZTRNGD_STATUS_TRNG_ERROR;
+                pReply->hdr.length = 0;
+                pClient->errors++;
+            } else {
+                iov[1].iov_base = gBatch + pReply->offset;
+                iov[1].iov_len = pReply->hdr.length;
+            }
+        } else if ((pReply->hdr.type == TZTRNGD_MSG_STATS) && (pReply->hdr.status == TZTRNGD_STATUS_OK)) {
+            DaemonFillStats(pClient, &stats);
+            iov[1].iov_base = &stats;
+            iov[1].iov_len = sizeof(stats);
+            pReply->hdr.length = sizeof(stats);
+        }
+        if (pClient->closing)
+            continue;
+
+        n = writev(pClient->fd, iov, 2);
+        if (n != (ssize_t)(iov[0].iov_len + iov[1].iov_len)) {
+            /* a full socket buffer: the client stopped reading its replies */
+            TZTRNG_PRINTF("client fd %d pid %d: reply failed (%s), disconnecting\n",
+                          pClient->fd, (int)pClient->pid, (n < 0) ? strerror(errno) : "short write");
+            pClient->closing = 1;
+            continue;
+        }
+        if ((pReply->hdr.type == TZTRNGD_MSG_GET) && (iov[1].iov_len > 0)) {
+            pClient->bytes += iov[1].iov_len;
+            gTotalBytes += iov[1].iov_len;
+        }
+    }
+
+    explicit_bzero(gBatch, gBatchBytes);
+    gBatchBytes = 0;
+    gNumReplies = 0;
+}
+
+/* validate one request and queue its reply */
+static void DaemonRequest(DaemonClient_t *pClient, const TztrngdHdr_t *pReq, ssize_t len)
+{
+    DaemonReply_t *pReply;
+    int valid;
+
+    valid = (len == (ssize_t)sizeof(*pReq)) && (pReq->version == TZTRNGD_PROTO_VERSION);
+    if (valid && (pReq->type == TZTRNGD_MSG_GET)) {
+        valid = (pReq->length > 0) && (pReq->length <= TZTRNGD_MAX_REQUEST_BYTES);
+        /* the batch is full: serve it before this request */
+        if (valid && (gBatchBytes + pReq->length > TZTRNGD_BATCH_BYTES))
+            DaemonFlush();
+    } else if (valid) {
+        valid = (pReq->type == TZTRNGD_MSG_STATS);
+    }
+    if (gNumReplies == TZTRNGD_MAX_REPLIES)
+        DaemonFlush();
+
+    pReply = &gReplies[gNumReplies++];
+    memset(pReply, 0, sizeof(*pReply));
+    pReply->pClient = pClient;
+    pReply->hdr.version = TZTRNGD_PROTO_VERSION;
+    pReply->hdr.type = (len >= (ssize_t)sizeof(*pReq)) ? pReq->type : 0;
+    pReply->hdr.tag = (len >= (ssize_t)sizeof(*pReq)) ? pReq->tag : 0;
+
+    if (!valid) {
+        pReply->hdr.status = TZTRNGD_STATUS_BAD_REQUEST;
+        pClient->errors++;
+        return;
+    }
+    if (pReq->type != TZTRNGD_MSG_GET)
+        return;
+
+    pClient->requests++;
+    if (!DaemonTakeTokens(pClient, pReq->length)) {
+        pReply->hdr.status = TZTRNGD_STATUS_RATE_LIMITED;
+        pClient->rateLimited++;
+        return;
+    }
+    pReply->hdr.length = pReq->length;
+    pReply->offset = gBatchBytes;
+    gBatchBytes += pReq->length;
+}
+
+/* take up to TZTRNGD_RECV_PER_CLIENT requests; the rest waits for the next round */
+static void DaemonReceive(DaemonClient_t *pClient)
+{
+    TztrngdHdr_t req;
+    ssize_t n;
+    uint32_t i;
+
+    for (i = 0; i < TZTRNGD_RECV_PER_CLIENT; i++) {
+        memset(&req, 0, sizeof(req));
+        n = recv(pClient->fd, &req, sizeof(req), MSG_DONTWAIT | MSG_TRUNC);
+        if (n < 0) {
+            if ((errno != EAGAIN) && (errno != EINTR))
+                pClient->closing = 1;
+            return;
+        }
+        if (n == 0) {
+            pClient->closing = 1;
+            return;
+        }
+        DaemonRequest(pClient, &req, n);
+    }
+}
+
+static void DaemonAccept(int listenFd)
+{
+    DaemonClient_t *pClient = NULL;
+    struct ucred cred;
+    socklen_t credLen = sizeof(cred);
+    uint32_t i;
+    int fd;
+
+    while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        for (i = 0; i < TZTRNGD_MAX_CLIENTS; i++) {
+            if (gClients[i].fd < 0) {
+                pClient = &gClients[i];
+                break;
+            }
+        }
+        if (pClient == NULL) {
+            TZTRNG_PRINTF("too many clients, connection refused\n");
+            close(fd);
+            continue;
+        }
+
+        memset(pClient, 0, sizeof(*pClient));
+        pClient->fd = fd;
+        pClient->pid = -1;
+        pClient->uid = (uid_t)-1;
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) == 0) {
+            pClient->pid = cred.pid;
+            pClient->uid = cred.uid;
+        }
+        pClient->tokens = (uint64_t)gBurst * TZTRNGD_US_PER_SEC;
+        pClient->refillUs = DaemonNowUs();
+        gNumClients++;
+        pClient = NULL;
+    }
+}
+
+/* wake up to 'count' consumers sleeping on an empty ring, if there are any */
+static void DaemonShmWake(TztrngdShmRing_t *pRing, int count)
+{
+    /* orders the publication before the dataWaiters check (see ShmWaitData) */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pRing->dataWaiters, __ATOMIC_SEQ_CST) == 0)
+        return;
+    __atomic_fetch_add(&pRing->dataFutex, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &pRing->dataFutex, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+/*
+ * Take back the slot of position 'pos' from the consumer of its previous block,
+ * if that consumer died holding it or stalled in its claim or release for
+ * TZTRNGD_SHM_STALL_US (since *pStallUs). Returns 1 if the slot is free.
+ */
+static int DaemonShmReclaim(TztrngdShmRing_t *pRing, TztrngdShmSlot_t *pSlot, uint64_t pos, uint64_t *pStallUs)
+{
+    uint64_t prev = pos - TZTRNGD_SHM_SLOTS;
+    uint64_t owner, seq, now;
+    pid_t pid;
+
+    /* not claimed yet: the ring is full */
+    if ((pos < TZTRNGD_SHM_SLOTS) || (__atomic_load_n(&pRing->head, __ATOMIC_ACQUIRE) <= prev)) {
+        *pStallUs = 0;
+        return 0;
+    }
+
+    owner = __atomic_load_n(&pSlot->owner, __ATOMIC_ACQUIRE);
+    pid = (pid_t)(uint32_t)owner;
+    if ((owner == TZTRNGD_SHM_OWNER(prev, 0)) || (owner == TZTRNGD_SHM_OWNER(pos, 0))) {
+        /* between the claim of 'head' and 'owner', or between the release of 'owner' and 'seq' */
+        now = DaemonNowUs();
+        if (*pStallUs == 0)
+            *pStallUs = now;
+        if (now - *pStallUs < TZTRNGD_SHM_STALL_US)
+            return 0;
+    } else if ((owner != TZTRNGD_SHM_OWNER(prev, pid)) || (kill(pid, 0) == 0) || (errno != ESRCH)) {
+        return 0;
+    }
+
+    /* a late claim or release now fails on 'owner' or 'seq' */
+    if ((owner != TZTRNGD_SHM_OWNER(pos, 0)) &&
+        !__atomic_compare_exchange_n(&pSlot->owner, &owner, TZTRNGD_SHM_OWNER(pos, 0), 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return 0;
+    explicit_bzero(pSlot->data, sizeof(pSlot->data));
+    seq = prev + 1;
+    __atomic_compare_exchange_n(&pSlot->seq, &seq, pos, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&pRing->reclaims, 1, __ATOMIC_RELAXED);
+    *pStallUs = 0;
+
+    return 1;
+}
+
+/* single producer: fill the slot at 'pos' once its consumer released it, then publish */
+static void *DaemonShmProducer(void *arg)
+{
+    TztrngdShmRing_t *pRing = arg;
+    TztrngdShmSlot_t *pSlot;
+    uint64_t pos = 0, stallUs = 0;
+    uint32_t delayUs = TZTRNGD_SHM_FULL_MIN_US;
+    uint32_t Err;
+
+    while (!__atomic_load_n(&pRing->stopped, __ATOMIC_ACQUIRE)) {
+        pSlot = &pRing->ring[pos & (TZTRNGD_SHM_SLOTS - 1)];
+        if ((__atomic_load_n(&pSlot->seq, __ATOMIC_ACQUIRE) != pos) &&
+            !DaemonShmReclaim(pRing, pSlot, pos, &stallUs)) {
+            /* full, or the oldest block is still held */
+            __atomic_fetch_add(&pRing->fullWaits, 1, __ATOMIC_RELAXED);
+            usleep(delayUs);
+            delayUs = (delayUs * 2 > TZTRNGD_SHM_FULL_MAX_US) ? TZTRNGD_SHM_FULL_MAX_US : delayUs * 2;
+            continue;
+        }
+        delayUs = TZTRNGD_SHM_FULL_MIN_US;
+        stallUs = 0;
+
+        /* a failed read leaves the slot wiped */
+        Err = CC_TrngPoolRead(pSlot->data, sizeof(pSlot->data));
+        if (Err != 0) {
+            __atomic_store_n(&pRing->error, Err, __ATOMIC_RELEASE);
+            __atomic_fetch_add(&pRing->refillErrors, 1, __ATOMIC_RELAXED);
+            DaemonShmWake(pRing, INT_MAX);
+            usleep(TZTRNGD_SHM_RETRY_US);
+            continue;
+        }
+        __atomic_store_n(&pRing->error, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&pSlot->seq, pos + 1, __ATOMIC_SEQ_CST);
+        pos++;
+        __atomic_store_n(&pRing->tail, pos, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&pRing->published, 1, __ATOMIC_RELAXED);
+        /* one block for one sleeper */
+        DaemonShmWake(pRing, 1);
+    }
+
+    return NULL;
+}
+
+static int DaemonShmStart(const char *name, mode_t mode, gid_t gid)
+{
+    TztrngdShmRing_t *pRing;
+    uint32_t i;
+    int fd;
+
+    /* a ring left by an earlier run */
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        TZTRNG_PRINTF("shm %s: %s\n", name, strerror(errno));
+        return -1;
+    }
+    if (((gid != (gid_t)-1) && (fchown(fd, (uid_t)-1, gid) != 0)) || (fchmod(fd, mode) != 0) ||
+        (ftruncate(fd, sizeof(*pRing)) != 0)) {
+        TZTRNG_PRINTF("shm %s: %s\n", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    pRing = mmap(NULL, sizeof(*pRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pRing == MAP_FAILED) {
+        TZTRNG_PRINTF("shm %s: %s\n", name, strerror(errno));
+        shm_unlink(name);
+        return -1;
+    }
+    if (mlock(pRing, sizeof(*pRing)) != 0)
+        TZTRNG_PRINTF("warning: shm ring not locked in memory: %s\n", strerror(errno));
+
+    /* the object is zero filled: every slot is free for its first position */
+    for (i = 0; i < TZTRNGD_SHM_SLOTS; i++)
+        pRing->ring[i].seq = i;
+    pRing->version = TZTRNGD_SHM_VERSION;
+    pRing->slots = TZTRNGD_SHM_SLOTS;
+    pRing->blockBytes = TZTRNGD_SHM_BLOCK_BYTES;
+    __atomic_store_n(&pRing->magic, TZTRNGD_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    if (pthread_create(&gShmThread, NULL, DaemonShmProducer, pRing) != 0) {
+        TZTRNG_PRINTF("failed to start the shm producer\n");
+        munmap(pRing, sizeof(*pRing));
+        shm_unlink(name);
+        return -1;
+    }
+    gShmRing = pRing;
+
+    return 0;
+}
+
+static void DaemonShmStop(const char *name)
+{
+    TztrngdShmRing_t *pRing = gShmRing;
+
+    if (pRing == NULL)
+        return;
+
+    /* consumers already waiting, or mapping the ring later, find it stopped */
+    __atomic_store_n(&pRing->stopped, 1, __ATOMIC_RELEASE);
+    DaemonShmWake(pRing, INT_MAX);
+    pthread_join(gShmThread, NULL);
+    shm_unlink(name);
+
+    explicit_bzero(pRing->ring, sizeof(pRing->ring));
+    munlock(pRing, sizeof(*pRing));
+    munmap(pRing, sizeof(*pRing));
+    gShmRing = NULL;
+}
+
+static void DaemonDump(void)
+{
+    CCTrngPoolStatus_t pool;
+    uint32_t i;
+
+    memset(&pool, 0, sizeof(pool));
+    CC_TrngPoolGetStatus(&pool);
+    TZTRNG_PRINTF("clients=%u batches=%u bytes=%llu rate=%u burst=%u pool_level=%u refills=%u refill_errors=%u\n",
+                  (unsigned int)gNumClients, (unsigned int)gBatches, (unsigned long long)gTotalBytes,
+                  (unsigned int)gRate, (unsigned int)gBurst, (unsigned int)pool.level,
+                  (unsigned int)pool.refills, (unsigned int)pool.refillErrors);
+    for (i = 0; i < TZTRNGD_MAX_CLIENTS; i++) {
+        if (gClients[i].fd < 0)
+            continue;
+        TZTRNG_PRINTF("  fd=%d pid=%d uid=%u requests=%u bytes=%llu rate_limited=%u errors=%u\n",
+                      gClients[i].fd, (int)gClients[i].pid, (unsigned int)gClients[i].uid,
+                      (unsigned int)gClients[i].requests, (unsigned long long)gClients[i].bytes,
+                      (unsigned int)gClients[i].rateLimited, (unsigned int)gClients[i].errors);
+    }
+    if (gShmRing != NULL)
+        TZTRNG_PRINTF("shm published=%llu claimed=%llu full_waits=%u empty_waits=%u refill_errors=%u reclaims=%u\n",
+                      (unsigned long long)__atomic_load_n(&gShmRing->published, __ATOMIC_RELAXED),
+                      (unsigned long long)__atomic_load_n(&gShmRing->head, __ATOMIC_RELAXED),
+                      (unsigned int)__atomic_load_n(&gShmRing->fullWaits, __ATOMIC_RELAXED),
+                      (unsigned int)__atomic_load_n(&gShmRing->emptyWaits, __ATOMIC_RELAXED),
+                      (unsigned int)__atomic_load_n(&gShmRing->refillErrors, __ATOMIC_RELAXED),
+                      (unsigned int)__atomic_load_n(&gShmRing->reclaims, __ATOMIC_RELAXED));
+}
+
+/* group of the ring, by name or number */
+static int DaemonShmGroup(const char *name, gid_t *pGid)
+{
+    struct group *pGroup;
+    char *end;
+    unsigned long gid;
+
+    pGroup = getgrnam(name);
+    if (pGroup != NULL) {
+        *pGid = pGroup->gr_gid;
+        return 0;
+    }
+    gid = strtoul(name, &end, 10);
+    if ((*name == '\0') || (*end != '\0') || (gid >= (gid_t)-1))
+        return -1;
+    *pGid = (gid_t)gid;
+
+    return 0;
+}
+
+static int DaemonListen(const char *path, mode_t mode)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        TZTRNG_PRINTF("socket path too long: %s\n", path);
+        return -1;
+    }
+    /* a stale socket of an earlier run; never remove anything else */
+    if ((lstat(path, &st) == 0) && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        TZTRNG_PRINTF("socket: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) || (chmod(path, mode) != 0) ||
+        (listen(fd, TZTRNGD_MAX_CLIENTS) != 0)) {
+        TZTRNG_PRINTF("%s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int DaemonRun(int listenFd, const sigset_t *pWaitMask)
+{
+    struct pollfd pfd[1 + TZTRNGD_MAX_CLIENTS];
+    DaemonClient_t *map[1 + TZTRNGD_MAX_CLIENTS];
+    nfds_t nfds, i;
+    uint32_t c;
+
+    while (!gStop) {
+        pfd[0].fd = listenFd;
+        pfd[0].events = POLLIN;
+        nfds = 1;
+        for (c = 0; c < TZTRNGD_MAX_CLIENTS; c++) {
+            if (gClients[c].fd < 0)
+                continue;
+            map[nfds] = &gClients[c];
+            pfd[nfds].fd = gClients[c].fd;
+            pfd[nfds].events = POLLIN;
+            nfds++;
+        }
+
+        /* the signals are blocked except while waiting here */
+        if (ppoll(pfd, nfds, NULL, pWaitMask) < 0) {
+            if (errno != EINTR) {
+                TZTRNG_PRINTF("poll: %s\n", strerror(errno));
+                return 1;
+            }
+            if (gDump) {
+                gDump = 0;
+                DaemonDump();
+            }
+            continue;
+        }
+
+        for (i = 1; i < nfds; i++) {
+            if (pfd[i].revents & POLLIN)
+                DaemonReceive(map[i]);
+            else if (pfd[i].revents & (POLLHUP | POLLERR | POLLNVAL))
+                map[i]->closing = 1;
+        }
+        DaemonFlush();
+
+        for (i = 1; i < nfds; i++) {
+            if (!map[i]->closing)
+                continue;
+            close(map[i]->fd);
+            map[i]->fd = -1;
+            gNumClients--;
+        }
+        if (pfd[0].revents & POLLIN)
+            DaemonAccept(listenFd);
+    }
+
+    return 0;
+}
+
+static void DaemonUsage(const char *prog)
+{
+    TZTRNG_PRINTF("usage: %s [-s socket] [-S shmName] [-u mode] [-g group] [-U shmMode]\n"
+                  "       [-r bytesPerSec] [-b burstBytes]%s\n", prog,
+#ifdef TZTRNGD_MODEL
+                  " [-m]"
+#else
+                  ""
+#endif
+                  );
+    TZTRNG_PRINTF("  -s  socket path (default %s)\n", TZTRNGD_DEFAULT_SOCKET);
+    TZTRNG_PRINTF("  -S  also publish into a shared-memory ring, e.g. %s (not rate limited)\n", TZTRNGD_DEFAULT_SHM);
+    TZTRNG_PRINTF("  -u  socket permissions, octal (default %o)\n", TZTRNGD_DEFAULT_MODE);
+    TZTRNG_PRINTF("  -g  group of the ring, name or number (default the daemon's group, no access)\n");
+    TZTRNG_PRINTF("  -U  ring permissions, octal, none for others (default %o, %o with -g)\n",
+                  TZTRNGD_DEFAULT_SHM_MODE, TZTRNGD_DEFAULT_SHM_GROUP_MODE);
+    TZTRNG_PRINTF("  -r  byte rate of each client, 0: unlimited (default)\n");
+    TZTRNG_PRINTF("  -b  burst of each client (default the rate, at least %u)\n", TZTRNGD_MAX_REQUEST_BYTES);
+#ifdef TZTRNGD_MODEL
+    TZTRNG_PRINTF(TZTRNG_TEST_MODEL_USAGE);
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = TZTRNGD_DEFAULT_SOCKET;
+    const char *shmName = NULL;
+    mode_t mode = TZTRNGD_DEFAULT_MODE;
+    mode_t shmMode = (mode_t)-1;
+    gid_t shmGid = (gid_t)-1;
+    struct sigaction sa;
+    sigset_t block, waitMask;
+    unsigned long regBase;
+    uint32_t i, Err;
+    int opt, listenFd, fail;
+
+    while ((opt = getopt(argc, argv, "s:S:u:g:U:r:b:m")) != -1) {
+        switch (opt) {
+        case 's':
+            path = optarg;
+            break;
+        case 'S':
+            shmName = optarg;
+            break;
+        case 'u':
+            mode = (mode_t)strtoul(optarg, NULL, 8);
+            break;
+        case 'g':
+            if (DaemonShmGroup(optarg, &shmGid) != 0) {
+                TZTRNG_PRINTF("unknown group: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'U':
+            shmMode = (mode_t)strtoul(optarg, NULL, 8);
+            break;
+        case 'r':
+            gRate = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            gBurst = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+#ifdef TZTRNGD_MODEL
+        case 'm':
+            gUseModel = 1;
+            break;
+#endif
+        default:
+            DaemonUsage(argv[0]);
+            return 1;
+        }
+    }
+    /* the ring is one trust domain: never open to others, to a group only when named */
+    if (shmMode == (mode_t)-1)
+        shmMode = (shmGid == (gid_t)-1) ? TZTRNGD_DEFAULT_SHM_MODE : TZTRNGD_DEFAULT_SHM_GROUP_MODE;
+    if ((shmMode & ~(mode_t)0770) || ((shmMode & 0070) && (shmGid == (gid_t)-1))) {
+        TZTRNG_PRINTF("ring permissions %o: no access for others, group access needs -g\n",
+                      (unsigned int)shmMode);
+        return 1;
+    }
+    /* every legal request must fit in the bucket */
+    if (gBurst == 0)
+        gBurst = gRate;
+    if (gBurst < TZTRNGD_MAX_REQUEST_BYTES)
+        gBurst = TZTRNGD_MAX_REQUEST_BYTES;
+    for (i = 0; i < TZTRNGD_MAX_CLIENTS; i++)
+        gClients[i].fd = -1;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+    sa.sa_handler = DaemonSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGUSR1, &sa, NULL);
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    sigaddset(&block, SIGUSR1);
+    /* the pool producer inherits the mask and never takes the signals */
+    pthread_sigmask(SIG_BLOCK, &block, &waitMask);
+
+    if (mlock(gBatch, sizeof(gBatch)) != 0)
+        TZTRNG_PRINTF("warning: batch buffer not locked in memory: %s\n", strerror(errno));
+
+#ifdef TZTRNGD_MODEL
+    /* no model lock: the pool producer is the only thread accessing the registers */
+    regBase = tztrngTest_target(gUseModel, NULL, NULL);
+    CC_TrngSetMmioOps(tztrngTest_mmioOps());
+#else
+    regBase = tztrngTest_pal_mapCcRegs(DX_BASE_RNG);
+#endif
+
+    Err = CC_TrngPoolStart(regBase);
+    if (Err != 0) {
+        TZTRNG_PRINTF("failed to start the entropy pool: error(0x%X)\n", (unsigned int)Err);
+        fail = 1;
+    } else {
+        listenFd = DaemonListen(path, mode);
+        if ((listenFd >= 0) && (shmName != NULL) && (DaemonShmStart(shmName, shmMode, shmGid) != 0)) {
+            close(listenFd);
+            unlink(path);
+            listenFd = -1;
+        }
+        if (listenFd < 0) {
+            fail = 1;
+        } else {
+            TZTRNG_PRINTF("serving %s, rate %u burst %u\n", path, (unsigned int)gRate, (unsigned int)gBurst);
+            fail = DaemonRun(listenFd, &waitMask);
+            for (i = 0; i < TZTRNGD_MAX_CLIENTS; i++) {
+                if (gClients[i].fd >= 0)
+                    close(gClients[i].fd);
+            }
+            close(listenFd);
+            unlink(path);
+            DaemonDump();
+            if (shmName != NULL)
+                DaemonShmStop(shmName);
+        }
+        CC_TrngPoolStop();
+    }
+
+#ifdef TZTRNGD_MODEL
+    CC_TrngSetMmioOps(NULL);
+    tztrngTest_targetRelease(regBase);
+#else
+    tztrngTest_pal_unmapCcRegs(regBase);
+#endif
+    explicit_bzero(gBatch, sizeof(gBatch));
+    munlock(gBatch, sizeof(gBatch));
+
+    return fail;
+}
@@ -0,0 +1,198 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "tztrngd_client.h"
+
+static void ClientInitHdr(TztrngdHdr_t *pHdr, uint16_t type, uint32_t length, uint32_t tag)
+{
+    memset(pHdr, 0, sizeof(*pHdr));
+    pHdr->version = TZTRNGD_PROTO_VERSION;
+    pHdr->type = type;
+    pHdr->length = length;
+    pHdr->tag = tag;
+}
+
+static int ClientSend(int fd, const TztrngdHdr_t *pHdr)
+{
+    ssize_t n;
+
+    do {
+        n = send(fd, pHdr, sizeof(*pHdr), MSG_NOSIGNAL);
+    } while ((n < 0) && (errno == EINTR));
+
+    return (n == (ssize_t)sizeof(*pHdr)) ? 0 : -1;
+}
+
+/* receive one reply: the header, then the payload straight into 'payload' */
+static ssize_t ClientRecv(int fd, TztrngdHdr_t *pHdr, void *payload, size_t len)
+{
+    struct iovec iov[2];
+    ssize_t n;
+
+    iov[0].iov_base = pHdr;
+    iov[0].iov_len = sizeof(*pHdr);
+    iov[1].iov_base = payload;
+    iov[1].iov_len = len;
+    do {
+        n = readv(fd, iov, 2);
+    } while ((n < 0) && (errno == EINTR));
+    if (n == 0) {
+        errno = ECONNRESET;
+        return -1;
+    }
+
+    return n;
+}
+
+/* 0 if 'pHdr' is the complete reply to the request 'tag' of 'type' with 'len' bytes */
+static int ClientCheck(const TztrngdHdr_t *pHdr, ssize_t n, uint16_t type, uint32_t tag, size_t len)
+{
+    if ((n < (ssize_t)sizeof(*pHdr)) || (pHdr->version != TZTRNGD_PROTO_VERSION) ||
+        (pHdr->type != type) || (pHdr->tag != tag)) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (pHdr->status != TZTRNGD_STATUS_OK)
+        return (int)pHdr->status;
+    if ((pHdr->length != len) || ((size_t)n != sizeof(*pHdr) + len)) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    return 0;
+}
+
+int tztrngd_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd, err;
+
+    if (path == NULL)
+        path = TZTRNGD_DEFAULT_SOCKET;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    return fd;
+}
+
+int tztrngd_get(int fd, uint8_t *outAddr, size_t outLen)
+{
+    TztrngdHdr_t hdr;
+    size_t sent = 0, received = 0, len;
+    uint32_t tagSent = 0, tagReceived = 0;
+    ssize_t n;
+    int ret = 0, err = 0;
+
+    if ((outAddr == NULL) && (outLen != 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while (received < outLen) {
+        /* keep up to TZTRNGD_CLIENT_PIPELINE requests in flight; none after a failure */
+        while ((ret == 0) && (sent < outLen) && (tagSent - tagReceived < TZTRNGD_CLIENT_PIPELINE)) {
+            len = outLen - sent;
+            if (len > TZTRNGD_MAX_REQUEST_BYTES)
+                len = TZTRNGD_MAX_REQUEST_BYTES;
+            ClientInitHdr(&hdr, TZTRNGD_MSG_GET, (uint32_t)len, tagSent);
+            if (ClientSend(fd, &hdr) != 0) {
+                ret = -1;
+                err = errno;
+                break;
+            }
+            sent += len;
+            tagSent++;
+        }
+        if (tagReceived == tagSent)
+            break;
+
+        /* the daemon replies in request order: the oldest request owns the next bytes */
+        len = outLen - received;
+        if (len > TZTRNGD_MAX_REQUEST_BYTES)
+            len = TZTRNGD_MAX_REQUEST_BYTES;
+        n = ClientRecv(fd, &hdr, outAddr + received, len);
+        if (n < 0) {
+            /* the connection is out of step; the caller closes it */
+            if (ret == 0) {
+                ret = -1;
+                err = errno;
+            }
+            break;
+        }
+        if (ret == 0) {
+            ret = ClientCheck(&hdr, n, TZTRNGD_MSG_GET, tagReceived, len);
+            err = errno;
+        }
+        tagReceived++;
+        received += len;
+    }
+
+    if (ret != 0) {
+        explicit_bzero(outAddr, outLen);
+        errno = err;
+    }
+
+    return ret;
+}
+
+int tztrngd_stats(int fd, TztrngdStats_t *pStats)
+{
+    TztrngdHdr_t hdr;
+    ssize_t n;
+
+    if (pStats == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ClientInitHdr(&hdr, TZTRNGD_MSG_STATS, 0, 0);
+    if (ClientSend(fd, &hdr) != 0)
+        return -1;
+    n = ClientRecv(fd, &hdr, pStats, sizeof(*pStats));
+    if (n < 0)
+        return -1;
+
+    return ClientCheck(&hdr, n, TZTRNGD_MSG_STATS, 0, sizeof(*pStats));
+}
+
+void tztrngd_close(int fd)
+{
+    close(fd);
+}
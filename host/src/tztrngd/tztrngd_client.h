@@ -0,0 +1,169 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#ifndef _TZTRNGD_CLIENT_H_
+#define _TZTRNGD_CLIENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tztrngd_proto.h"
+#include "tztrngd_shm.h"
+
+/* GET requests tztrngd_get() keeps in flight on one connection */
+#define TZTRNGD_CLIENT_PIPELINE         4
+
+/*******************************************************************************/
+/**
+ * @brief The tztrngd_connect opens a connection to the entropy daemon.
+ *        A connection may be used by one thread at a time.
+ *
+ * @param[in] path - The daemon socket, NULL for TZTRNGD_DEFAULT_SOCKET.
+ *
+ * @return int - The connection on success, -1 with errno set on failure.
+ */
+int tztrngd_connect(const char *path);     /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The tztrngd_get reads health-tested random bytes from the daemon.
+ *        Requests above TZTRNGD_MAX_REQUEST_BYTES are split and pipelined;
+ *        the replies are received straight into the caller's buffer.
+ *        On failure the buffer is wiped.
+ *
+ * @param[in] fd - The connection.
+ * @param[out] outAddr - The output buffer, prepared by the caller.
+ * @param[in] outLen - The number of bytes to read.
+ *
+ * @return int - 0 on success, a TZTRNGD_STATUS_* value if the daemon refused
+ *               the request, -1 with errno set on a connection failure.
+ */
+int tztrngd_get(int fd,                     /* in */
+                uint8_t *outAddr,           /* out */
+                size_t outLen);             /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The tztrngd_stats returns the counters of the connection and the daemon.
+ *
+ * @param[in] fd - The connection.
+ * @param[out] pStats - The counters, prepared by the caller.
+ *
+ * @return int - 0 on success, a TZTRNGD_STATUS_* value or -1 as tztrngd_get.
+ */
+int tztrngd_stats(int fd,                   /* in */
+                  TztrngdStats_t *pStats);  /* out */
+
+/*******************************************************************************/
+/**
+ * @brief The tztrngd_close closes a connection.
+ *
+ * @param[in] fd - The connection.
+ */
+void tztrngd_close(int fd);                 /* in */
+
+/*******************************************************************************/
+/* Shared-memory ring (tztrngd -S)                                             */
+/*******************************************************************************/
+
+/* A mapping of the ring; one per thread */
+typedef struct TztrngdShm TztrngdShm_t;
+
+/* A claimed block: TZTRNGD_SHM_BLOCK_BYTES in the ring, until released */
+typedef struct {
+    uint8_t *data;
+    uint64_t pos;
+} TztrngdShmBlock_t;
+
+/*******************************************************************************/
+/**
+ * @brief The tztrngd_shm_open maps the shared-memory ring of the daemon. The
+ *        claimed blocks are owned by the calling process: a child that keeps
+ *        using the ring after fork() must open its own mapping.
+ *
+ * @param[in] name - The shared memory object, NULL for TZTRNGD_DEFAULT_SHM.
+ *
+ * @return TztrngdShm_t* - The mapping on success, NULL with errno set on failure.
+ */
+TztrngdShm_t *tztrngd_shm_open(const char *name);  /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The tztrngd_shm_claim takes the oldest published block out of the ring
+ *        without a copy. It makes no system call unless the ring is empty, then
+ *        it sleeps until the producer publishes. The block must be given back
+ *        with tztrngd_shm_release(), which wipes it.
+ *
+ * @param[in] pShm - The mapping.
+ * @param[out] pBlock - The claimed block, prepared by the caller.
+ *
+ * @return int - 0 on success, TZTRNGD_STATUS_TRNG_ERROR if the ring is empty
+ *               and the producer's last collection failed, -1 with errno set
+ *               (EPIPE: the daemon stopped) on failure.
+ */
+int tztrngd_shm_claim(TztrngdShm_t *pShm,           /* in */
+                      TztrngdShmBlock_t *pBlock);   /* out */
+
+/*******************************************************************************/
+/**
+ * @brief The tztrngd_shm_release wipes a claimed block and returns its slot
+ *        to the producer.
+ *
+ * @param[in] pShm - The mapping.
+ * @param[in] pBlock - The block, as claimed.
+ */
+void tztrngd_shm_release(TztrngdShm_t *pShm,        /* in */
+                         TztrngdShmBlock_t *pBlock); /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The tztrngd_shm_read copies random bytes out of the ring. The rest of
+ *        a partly used block is kept claimed for the next call, and every byte
+ *        returned is wiped in the ring. On failure the buffer is wiped.
+ *
+ * @param[in] pShm - The mapping.
+ * @param[out] outAddr - The output buffer, prepared by the caller.
+ * @param[in] outLen - The number of bytes to read.
+ *
+ * @return int - As tztrngd_shm_claim.
+ */
+int tztrngd_shm_read(TztrngdShm_t *pShm,            /* in */
+                     uint8_t *outAddr,              /* out */
+                     size_t outLen);                /* in */
+
+/*******************************************************************************/
+/**
+ * @brief The tztrngd_shm_stats returns the ring counters.
+ *
+ * @param[in] pShm - The mapping.
+ * @param[out] pStats - The counters, prepared by the caller.
+ *
+ * @return int - 0 on success, -1 with errno set on failure.
+ */
+int tztrngd_shm_stats(TztrngdShm_t *pShm,           /* in */
+                      TztrngdShmStats_t *pStats);   /* out */
+
+/*******************************************************************************/
+/**
+ * @brief The tztrngd_shm_close releases the block kept by tztrngd_shm_read
+ *        and unmaps the ring.
+ *
+ * @param[in] pShm - The mapping.
+ */
+void tztrngd_shm_close(TztrngdShm_t *pShm);         /* in */
+
+#endif
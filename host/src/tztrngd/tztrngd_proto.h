@@ -0,0 +1,75 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#ifndef _TZTRNGD_PROTO_H_
+#define _TZTRNGD_PROTO_H_
+
+#include <stdint.h>
+
+/*
+ * Wire protocol of the local entropy daemon (tztrngd).
+ *
+ * Every message is one SOCK_SEQPACKET record that starts with TztrngdHdr_t,
+ * in host byte order (the socket never leaves the machine). A request is the
+ * header alone; a reply is the header followed by 'length' payload bytes.
+ * A client may have several requests in flight: the daemon replies to each
+ * connection in request order, and echoes the tag.
+ */
+
+#define TZTRNGD_PROTO_VERSION           1
+#define TZTRNGD_DEFAULT_SOCKET          "/run/tztrngd.sock"
+/* largest GET; tztrngd_get() splits longer requests */
+#define TZTRNGD_MAX_REQUEST_BYTES       4096
+
+/* Message types */
+#define TZTRNGD_MSG_GET                 1   /* request: 'length' random bytes */
+#define TZTRNGD_MSG_STATS               2   /* request: TztrngdStats_t of this connection */
+
+/* Reply status */
+#define TZTRNGD_STATUS_OK               0
+#define TZTRNGD_STATUS_BAD_REQUEST      1   /* unknown version or type, or illegal length */
+#define TZTRNGD_STATUS_RATE_LIMITED     2   /* the connection is over its byte rate; retry later */
+#define TZTRNGD_STATUS_TRNG_ERROR       3   /* the collection failed; 'length' is 0 */
+
+typedef struct {
+    uint16_t version;               /* TZTRNGD_PROTO_VERSION */
+    uint16_t type;                  /* TZTRNGD_MSG_* */
+    uint32_t status;                /* reply: TZTRNGD_STATUS_*; request: 0 */
+    uint32_t length;                /* GET request: bytes wanted; reply: payload bytes */
+    uint32_t tag;                   /* chosen by the client, echoed in the reply */
+} TztrngdHdr_t;
+
+/* Payload of a TZTRNGD_MSG_STATS reply */
+typedef struct {
+    /* this connection */
+    uint32_t requests;              /* GET requests */
+    uint32_t rateLimited;           /* GET requests refused by the rate limit */
+    uint32_t errors;                /* bad requests and failed collections */
+    uint64_t bytes;                 /* bytes served */
+    uint32_t rateBytesPerSec;       /* rate limit, 0: unlimited */
+    uint32_t burstBytes;            /* token bucket size */
+    /* the daemon */
+    uint32_t clients;               /* connected clients */
+    uint32_t batches;               /* pool reads serving one or more GETs */
+    uint64_t totalBytes;            /* bytes served to all clients */
+    uint32_t poolLevel;             /* CCTrngPoolStatus_t of the entropy pool */
+    uint32_t poolRefills;
+    uint32_t poolRefillErrors;
+    uint32_t reserved;
+} TztrngdStats_t;
+
+#endif
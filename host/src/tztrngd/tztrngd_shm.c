@@ -0,0 +1,258 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "tztrngd_client.h"
+
+/* upper bound of one sleep on an empty ring, in case a wake-up is lost */
+#define SHM_EMPTY_WAIT_MS       100
+
+struct TztrngdShm {
+    TztrngdShmRing_t *pRing;
+    TztrngdShmBlock_t block;        /* partly read by tztrngd_shm_read */
+    uint32_t used;                  /* bytes of it returned so far */
+    int held;
+    pid_t pid;                      /* owner of the claimed slots; getpid() is a system call */
+};
+
+/* sleep on the empty ring at 'pos' until the producer bumps dataFutex */
+static void ShmWaitData(TztrngdShmRing_t *pRing, uint64_t pos)
+{
+    TztrngdShmSlot_t *pSlot = &pRing->ring[pos & (TZTRNGD_SHM_SLOTS - 1)];
+    struct timespec timeout = { 0, SHM_EMPTY_WAIT_MS * 1000000L };
+    uint32_t fut;
+
+    fut = __atomic_load_n(&pRing->dataFutex, __ATOMIC_ACQUIRE);
+    __atomic_fetch_add(&pRing->dataWaiters, 1, __ATOMIC_SEQ_CST);
+    /* the producer checks dataWaiters after publishing: look once more before sleeping */
+    if ((__atomic_load_n(&pSlot->seq, __ATOMIC_SEQ_CST) != pos + 1) &&
+        !__atomic_load_n(&pRing->stopped, __ATOMIC_SEQ_CST) &&
+        !__atomic_load_n(&pRing->error, __ATOMIC_SEQ_CST)) {
+        __atomic_fetch_add(&pRing->emptyWaits, 1, __ATOMIC_RELAXED);
+        syscall(SYS_futex, &pRing->dataFutex, FUTEX_WAIT, fut, &timeout, NULL, 0);
+    }
+    __atomic_fetch_sub(&pRing->dataWaiters, 1, __ATOMIC_SEQ_CST);
+}
+
+TztrngdShm_t *tztrngd_shm_open(const char *name)
+{
+    TztrngdShm_t *pShm;
+    TztrngdShmRing_t *pRing;
+    struct stat st;
+    int fd, err;
+
+    if (name == NULL)
+        name = TZTRNGD_DEFAULT_SHM;
+
+    fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0) {
+        err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(*pRing)) {
+        close(fd);
+        errno = EPROTO;
+        return NULL;
+    }
+    pRing = mmap(NULL, sizeof(*pRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    err = errno;
+    close(fd);
+    if (pRing == MAP_FAILED) {
+        errno = err;
+        return NULL;
+    }
+
+    if ((__atomic_load_n(&pRing->magic, __ATOMIC_ACQUIRE) != TZTRNGD_SHM_MAGIC) ||
+        (pRing->version != TZTRNGD_SHM_VERSION) || (pRing->slots != TZTRNGD_SHM_SLOTS) ||
+        (pRing->blockBytes != TZTRNGD_SHM_BLOCK_BYTES)) {
+        munmap(pRing, sizeof(*pRing));
+        errno = EPROTO;
+        return NULL;
+    }
+
+    pShm = calloc(1, sizeof(*pShm));
+    if (pShm == NULL) {
+        munmap(pRing, sizeof(*pRing));
+        errno = ENOMEM;
+        return NULL;
+    }
+    pShm->pRing = pRing;
+    pShm->pid = getpid();
+
+    return pShm;
+}
+
+int tztrngd_shm_claim(TztrngdShm_t *pShm, TztrngdShmBlock_t *pBlock)
+{
+    TztrngdShmRing_t *pRing;
+    TztrngdShmSlot_t *pSlot;
+    uint64_t pos, seq, owner;
+    int64_t diff;
+
+    if ((pShm == NULL) || (pBlock == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+    pRing = pShm->pRing;
+
+    pos = __atomic_load_n(&pRing->head, __ATOMIC_RELAXED);
+    for (;;) {
+        pSlot = &pRing->ring[pos & (TZTRNGD_SHM_SLOTS - 1)];
+        seq = __atomic_load_n(&pSlot->seq, __ATOMIC_ACQUIRE);
+        diff = (int64_t)(seq - (pos + 1));
+        if (diff == 0) {
+            /* published: claim it, or retry at the position that another consumer left */
+            if (!__atomic_compare_exchange_n(&pRing->head, &pos, pos + 1, 1,
+                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                continue;
+            /* record the owner, unless the producer took the slot back meanwhile */
+            owner = TZTRNGD_SHM_OWNER(pos, 0);
+            if (__atomic_compare_exchange_n(&pSlot->owner, &owner, TZTRNGD_SHM_OWNER(pos, pShm->pid), 0,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                break;
+            pos = __atomic_load_n(&pRing->head, __ATOMIC_RELAXED);
+        } else if (diff > 0) {
+            /* claimed by another consumer since 'head' was read */
+            pos = __atomic_load_n(&pRing->head, __ATOMIC_RELAXED);
+        } else {
+            if (__atomic_load_n(&pRing->stopped, __ATOMIC_ACQUIRE)) {
+                errno = EPIPE;
+                return -1;
+            }
+            if (__atomic_load_n(&pRing->error, __ATOMIC_ACQUIRE))
+                return TZTRNGD_STATUS_TRNG_ERROR;
+            ShmWaitData(pRing, pos);
+            pos = __atomic_load_n(&pRing->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    pBlock->data = pSlot->data;
+    pBlock->pos = pos;
+
+    return 0;
+}
+
+void tztrngd_shm_release(TztrngdShm_t *pShm, TztrngdShmBlock_t *pBlock)
+{
+    TztrngdShmSlot_t *pSlot;
+    uint64_t owner, seq;
+
+    if ((pShm == NULL) || (pBlock == NULL) || (pBlock->data == NULL))
+        return;
+
+    pSlot = &pShm->pRing->ring[pBlock->pos & (TZTRNGD_SHM_SLOTS - 1)];
+    explicit_bzero(pSlot->data, sizeof(pSlot->data));
+    /* the wipe is visible before the producer may refill the slot; a stalled
+       release may find the slot already taken back */
+    owner = TZTRNGD_SHM_OWNER(pBlock->pos, pShm->pid);
+    seq = pBlock->pos + 1;
+    if (__atomic_compare_exchange_n(&pSlot->owner, &owner, TZTRNGD_SHM_OWNER(pBlock->pos + TZTRNGD_SHM_SLOTS, 0),
+                                    0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        __atomic_compare_exchange_n(&pSlot->seq, &seq, pBlock->pos + TZTRNGD_SHM_SLOTS, 0,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    pBlock->data = NULL;
+}
+
+int tztrngd_shm_read(TztrngdShm_t *pShm, uint8_t *outAddr, size_t outLen)
+{
+    size_t done = 0;
+    uint32_t n;
+    int ret;
+
+    if ((pShm == NULL) || ((outAddr == NULL) && (outLen != 0))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while (done < outLen) {
+        if (!pShm->held) {
+            ret = tztrngd_shm_claim(pShm, &pShm->block);
+            if (ret != 0) {
+                explicit_bzero(outAddr, outLen);
+                return ret;
+            }
+            pShm->held = 1;
+            pShm->used = 0;
+        }
+
+        n = TZTRNGD_SHM_BLOCK_BYTES - pShm->used;
+        if (n > outLen - done)
+            n = (uint32_t)(outLen - done);
+        memcpy(outAddr + done, pShm->block.data + pShm->used, n);
+        explicit_bzero(pShm->block.data + pShm->used, n);
+        pShm->used += n;
+        done += n;
+
+        if (pShm->used == TZTRNGD_SHM_BLOCK_BYTES) {
+            tztrngd_shm_release(pShm, &pShm->block);
+            pShm->held = 0;
+        }
+    }
+
+    return 0;
+}
+
+int tztrngd_shm_stats(TztrngdShm_t *pShm, TztrngdShmStats_t *pStats)
+{
+    TztrngdShmRing_t *pRing;
+    uint64_t tail;
+
+    if ((pShm == NULL) || (pStats == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+    pRing = pShm->pRing;
+
+    memset(pStats, 0, sizeof(*pStats));
+    tail = __atomic_load_n(&pRing->tail, __ATOMIC_ACQUIRE);
+    pStats->claimed = __atomic_load_n(&pRing->head, __ATOMIC_ACQUIRE);
+    pStats->published = __atomic_load_n(&pRing->published, __ATOMIC_RELAXED);
+    pStats->level = (tail > pStats->claimed) ? (uint32_t)(tail - pStats->claimed) : 0;
+    pStats->fullWaits = __atomic_load_n(&pRing->fullWaits, __ATOMIC_RELAXED);
+    pStats->emptyWaits = __atomic_load_n(&pRing->emptyWaits, __ATOMIC_RELAXED);
+    pStats->refillErrors = __atomic_load_n(&pRing->refillErrors, __ATOMIC_RELAXED);
+    pStats->reclaims = __atomic_load_n(&pRing->reclaims, __ATOMIC_RELAXED);
+    pStats->error = __atomic_load_n(&pRing->error, __ATOMIC_RELAXED);
+    pStats->stopped = __atomic_load_n(&pRing->stopped, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+void tztrngd_shm_close(TztrngdShm_t *pShm)
+{
+    if (pShm == NULL)
+        return;
+
+    if (pShm->held)
+        tztrngd_shm_release(pShm, &pShm->block);
+    munmap(pShm->pRing, sizeof(*pShm->pRing));
+    free(pShm);
+}
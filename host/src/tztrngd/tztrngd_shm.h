@@ -0,0 +1,116 @@
+/******************************************************************************
+* Copyright (c) 2017-2017, ARM, All Rights Reserved                           *
+* SPDX-License-Identifier: Apache-2.0                                         *
+*                                                                             *
+* Licensed under the Apache License, Version 2.0 (the "License");             *
+* you may not use this file except in compliance with the License.            *
+*                                                                             *
+* You may obtain a copy of the License at                                     *
+* http://www.apache.org/licenses/LICENSE-2.0                                  *
+*                                                                             *
+* Unless required by applicable law or agreed to in writing, software         *
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT   *
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.            *
+*                                                                             *
+* See the License for the specific language governing permissions and         *
+* limitations under the License.                                              *
+******************************************************************************/
+#ifndef _TZTRNGD_SHM_H_
+#define _TZTRNGD_SHM_H_
+
+#include <stdint.h>
+
+/*
+ * Shared-memory entropy ring of the local entropy daemon (tztrngd -S).
+ *
+ * The daemon is the single producer: it maps the ring read-write from a POSIX
+ * shared memory object and publishes health-tested blocks of
+ * TZTRNGD_SHM_BLOCK_BYTES into it. Consumer processes map the same object and
+ * claim blocks without locks (libtztrngd_client, tztrngd_shm_*()).
+ *
+ * Slot sequence numbers, per ring position 'pos' of slot pos % TZTRNGD_SHM_SLOTS:
+ *   seq == pos                      the slot is free for the producer
+ *   seq == pos + 1                  the block is published; a consumer claims it by
+ *                                   moving 'head' from pos to pos + 1 (compare-and-swap)
+ *   seq == pos + TZTRNGD_SHM_SLOTS  the consumer wiped and released it
+ * The claiming consumer then moves the slot's 'owner' from
+ * TZTRNGD_SHM_OWNER(pos, 0) to its pid, and on release to
+ * TZTRNGD_SHM_OWNER(pos + TZTRNGD_SHM_SLOTS, 0) before the wipe is published
+ * in 'seq'. A producer that finds the oldest block held by a dead process
+ * (kill(pid, 0) fails with ESRCH), or stuck between these steps for
+ * TZTRNGD_SHM_STALL_US, wipes and takes back the slot; a consumer that finds
+ * 'owner' moved on retries its claim. Consumers and the daemon must therefore
+ * share a pid namespace.
+ * A consumer enters the kernel only when the ring is empty: it sleeps on the
+ * 'dataFutex' word, which the producer bumps and wakes only if 'dataWaiters'
+ * is non zero. A producer that finds the ring full polls with a growing delay,
+ * so releasing a block is never a system call either.
+ *
+ * Every process that maps the ring is in one trust domain with the daemon and
+ * the other consumers: claiming and releasing write to the shared header and
+ * slots, so a mapper can read the blocks of others, replay or forge blocks, or
+ * stall the ring. tztrngd creates it with mode 0600, or 0660 for the group of
+ * -g, and never gives others access, whatever the socket permissions (-u) are.
+ */
+
+#define TZTRNGD_SHM_MAGIC               0x474E5254  /* "TRNG" */
+#define TZTRNGD_SHM_VERSION             2
+#define TZTRNGD_DEFAULT_SHM             "/tztrngd"
+#define TZTRNGD_SHM_SLOTS               256         /* a power of 2 */
+#define TZTRNGD_SHM_BLOCK_BYTES         256
+#define TZTRNGD_SHM_CACHE_LINE_BYTES    64
+/* a claim or a release stalled longer than this is taken back by the producer */
+#define TZTRNGD_SHM_STALL_US            1000000
+
+/* 'owner' of a slot: the ring lap of position 'pos' and the holder's pid, 0 if none */
+#define TZTRNGD_SHM_OWNER(pos, pid)     ((((uint64_t)(pos) / TZTRNGD_SHM_SLOTS) << 32) | (uint32_t)(pid))
+
+#define TZTRNGD_SHM_ALIGNED             __attribute__((aligned(TZTRNGD_SHM_CACHE_LINE_BYTES)))
+
+typedef struct {
+    uint64_t seq TZTRNGD_SHM_ALIGNED;
+    uint64_t owner;
+    uint8_t data[TZTRNGD_SHM_BLOCK_BYTES] TZTRNGD_SHM_ALIGNED;
+} TztrngdShmSlot_t;
+
+typedef struct {
+    /* set by the producer before it publishes 'magic' */
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t blockBytes;
+    uint32_t stopped;               /* the producer is gone: the ring will stay empty */
+    uint32_t error;                 /* error of the last failed pool read, 0 after a success */
+
+    /* producer */
+    uint64_t tail TZTRNGD_SHM_ALIGNED;  /* next position to publish */
+    uint64_t published;             /* blocks published */
+    uint32_t fullWaits;             /* times the producer found the ring full */
+    uint32_t refillErrors;          /* failed pool reads */
+    uint32_t reclaims;              /* blocks taken back from dead or stalled consumers */
+
+    /* consumers */
+    uint64_t head TZTRNGD_SHM_ALIGNED;  /* next position to claim */
+
+    /* empty ring wake-up */
+    uint32_t dataFutex TZTRNGD_SHM_ALIGNED;
+    uint32_t dataWaiters;           /* consumers sleeping on dataFutex */
+    uint32_t emptyWaits;            /* times a consumer slept on an empty ring */
+
+    TztrngdShmSlot_t ring[TZTRNGD_SHM_SLOTS];
+} TztrngdShmRing_t;
+
+/* Ring counters, read by tztrngd_shm_stats() */
+typedef struct {
+    uint64_t published;
+    uint64_t claimed;               /* 'head' */
+    uint32_t level;                 /* published blocks not claimed yet */
+    uint32_t fullWaits;
+    uint32_t emptyWaits;
+    uint32_t refillErrors;
+    uint32_t reclaims;
+    uint32_t error;
+    uint32_t stopped;
+} TztrngdShmStats_t;
+
+#endif